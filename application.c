@@ -8,6 +8,25 @@
 
 #include "validations.h"
 #include "swapc.h"
+#include "headless.h"
+#include "gpu_timer.h"
+#include "profiler.h"
+#include "frame_stats.h"
+#include "mem_budget.h"
+#include "residency.h"
+#include "mesh.h"
+#include "mesh_opt.h"
+#include "mesh_lod.h"
+#include "meshlet.h"
+#include "transform.h"
+#include "bindless.h"
+#include "desc_alloc.h"
+#include "render_graph.h"
+#include "barrier.h"
+#include "variant_cache.h"
+#include "shader_cache.h"
+#include "vk_cache.h"
+#include "resources.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -26,10 +45,11 @@ const char *p_extensions[1] = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
 const char *p_layers[1] = { "VK_LAYER_KHRONOS_validation" };
 
 const int MAX_FRAMES_IN_FLIGHT = 2;
+const float INSTANCE_SPACING = 2.5f;
 size_t current_frame = 0;
 
 /**
- *	Raw vertex data waiting for Vertex / Uniform buffer implementation.
+ *	Default geometry when no model is given with `--model`.
  *	Given pos (x, y, z) and both color data (rgb), texel coordinates (u, v) in form of vertex_t struct.
  */
 const struct vertex_t vertices[] = {
@@ -44,36 +64,46 @@ const struct vertex_t vertices[] = {
     	{{-0.5f, 0.5f, -0.5f}, {1.0f, 1.0f, 1.0f}, {0.0f, 1.0f}}
 };
 
-const uint16_t indices[] = {
+const uint32_t indices[] = {
 	0, 1, 2, 2, 3, 0,
 	4, 5, 6, 6, 7, 4
 };
 
 /**
- *	Create and get associated `VkVertexInputBindingDescription` for
- *	vertex buffer creation in graphics pipeline.  
+ *	Fill the three `VkVertexInputBindingDescription` of the graphics
+ *	pipeline: the vertex buffer, then the per instance world matrices and
+ *	texture ids, both from the instance buffer.
  */
-static VkVertexInputBindingDescription get_binding_description() 
+static void get_binding_descriptions(int vertex_format, VkVertexInputBindingDescription *binding_descriptions)
 {
-	VkVertexInputBindingDescription binding_description = {};
-	binding_description.binding = 0;
-	binding_description.stride = sizeof(vertex_t);
-	binding_description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-	return binding_description;
+	binding_descriptions[0] = (VkVertexInputBindingDescription) {};
+	binding_descriptions[0].binding = 0;
+	binding_descriptions[0].stride = vertex_format == VERTEX_FORMAT_PACKED ? sizeof(packed_vertex_t) : sizeof(vertex_t);
+	binding_descriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	binding_descriptions[1] = (VkVertexInputBindingDescription) {};
+	binding_descriptions[1].binding = 1;
+	binding_descriptions[1].stride = sizeof(mat4);
+	binding_descriptions[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+	binding_descriptions[2] = (VkVertexInputBindingDescription) {};
+	binding_descriptions[2].binding = 2;
+	binding_descriptions[2].stride = sizeof(uint32_t);
+	binding_descriptions[2].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
 }
 
 /**
  *	Create and get associated `VkVertexInputAttributeDescription` for
- *	vertex buffer creation in graphics pipeline.
+ *	vertex buffer creation in graphics pipeline. Packed vertices feed the
+ *	same shader inputs, the formats convert to float on fetch.
  */
-static array get_attribute_description()
+static array get_attribute_description(int vertex_format)
 {
 	array attrib_desc;
 	array_init(&attrib_desc, sizeof(VkVertexInputAttributeDescription));
-	array_resize(&attrib_desc, 3, false);
+	array_resize(&attrib_desc, 8, false);
 
-	VkVertexInputAttributeDescription attrib_arr[3] = {};
+	VkVertexInputAttributeDescription attrib_arr[8] = {};
 
 	attrib_arr[0].binding = 0;
 	attrib_arr[0].location = 0;
@@ -90,7 +120,34 @@ static array get_attribute_description()
 	attrib_arr[2].format = VK_FORMAT_R32G32_SFLOAT;
 	attrib_arr[2].offset = offsetof(vertex_t, tex_coord);
 
-	for (int i = 0; i < 3; i++) {
+	if (vertex_format == VERTEX_FORMAT_PACKED) {
+		attrib_arr[0].format = VK_FORMAT_R16G16B16A16_SNORM;
+		attrib_arr[0].offset = offsetof(packed_vertex_t, pos);
+
+		attrib_arr[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+		attrib_arr[1].offset = offsetof(packed_vertex_t, color);
+
+		attrib_arr[2].format = VK_FORMAT_R16G16_SFLOAT;
+		attrib_arr[2].offset = offsetof(packed_vertex_t, tex_coord);
+	}
+
+	/**
+	 * The instance's world matrix, one location per column.
+	 */
+
+	for (int c = 0; c < 4; c++) {
+		attrib_arr[3 + c].binding = 1;
+		attrib_arr[3 + c].location = 3 + c;
+		attrib_arr[3 + c].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		attrib_arr[3 + c].offset = sizeof(vec4) * c;
+	}
+
+	attrib_arr[7].binding = 2;
+	attrib_arr[7].location = 7;
+	attrib_arr[7].format = VK_FORMAT_R32_UINT;
+	attrib_arr[7].offset = 0;
+
+	for (int i = 0; i < 8; i++) {
 
 		array_append(&attrib_desc, &attrib_arr[i]);
 	}
@@ -190,7 +247,7 @@ void setup_debug_messenger(struct _application *ref)
 	VkDebugUtilsMessengerCreateInfoEXT ci;
 	populate_debug_messenger_ci(&ci);
 
-	int res = create_debug_messenger_EXT(ref->vk_instance, &ci, NULL, &ref->debug_messenger);
+	int res = create_debug_messenger_EXT(ref->vk_instance, &ci, HOST_ALLOC(DEBUG), &ref->debug_messenger);
 	if (res != VK_SUCCESS) {
 		fprintf(stderr, "ERR: failed to create debug messenger \n // Assertion: `create_debug_messenger_EXT() != VK_SUCCESS`\n");
 		exit(EXIT_FAILURE);
@@ -202,7 +259,7 @@ void setup_debug_messenger(struct _application *ref)
  */
 queue_family_indices_t query_queue_families(VkPhysicalDevice phys_device, VkSurfaceKHR surface)
 {
-	queue_family_indices_t indices = {VK_NULL_HANDLE, VK_NULL_HANDLE};
+	queue_family_indices_t indices = {VK_NULL_HANDLE, VK_NULL_HANDLE, UINT32_MAX};
 
 	uint32_t queue_family_count = 0;
 	vkGetPhysicalDeviceQueueFamilyProperties(phys_device, &queue_family_count, NULL);
@@ -218,6 +275,21 @@ queue_family_indices_t query_queue_families(VkPhysicalDevice phys_device, VkSurf
 			indices.graphics_family = i;
 		}
 
+		/**
+		 * Prefer a family capable of both graphics and compute, so headless
+		 * work can share a single queue.
+		 */
+
+		if (props.queueFlags & VK_QUEUE_COMPUTE_BIT) {
+			if (indices.compute_family == UINT32_MAX || (props.queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+				indices.compute_family = i;
+			}
+		}
+
+		if (surface == VK_NULL_HANDLE) {
+			continue;
+		}
+
 		VkBool32 present_supp;
 		vkGetPhysicalDeviceSurfaceSupportKHR(phys_device, i, surface, &present_supp);
 
@@ -238,7 +310,10 @@ queue_family_indices_t query_queue_families(VkPhysicalDevice phys_device, VkSurf
  */
 void run(struct _application *ref)
 {
-	init_window(ref);
+	if (!ref->headless) {
+		init_window(ref);
+	}
+
 	init_vk(ref);
 
 	main_loop(ref);
@@ -252,13 +327,37 @@ void run(struct _application *ref)
  */
 void main_loop(struct _application *ref)
 {
+	if (ref->headless) {
+		headless_main_loop(ref);
+		return;
+	}
+
+	ref->frame_stats = malloc(sizeof(frame_stats_t));
+	init_frame_stats(ref->frame_stats);
+
+	host_alloc_frame_loop(true);
+
 	while (!glfwWindowShouldClose(ref->window))
 	{
 		glfwPollEvents();
+
+		frame_stats_begin_frame(ref->frame_stats);
 		draw_frame(ref);
+
+		frame_stats_summary(ref->frame_stats, 5.0);
 	}
 
 	vkDeviceWaitIdle(ref->device);
+
+	host_alloc_frame_loop(false);
+	host_alloc_report(true);
+
+	if (frame_stats_write_json(ref->frame_stats, FRAME_STATS_REPORT_PATH)) {
+		printf("frame stats written to %s\n", FRAME_STATS_REPORT_PATH);
+	}
+
+	free(ref->frame_stats);
+	ref->frame_stats = NULL;
 }
 
 /**
@@ -268,46 +367,111 @@ void draw_frame(struct _application *ref)
 {
 	VkResult res;
 
-	vkWaitForFences(ref->device, 1, &arr_get(ref->in_flight_fences, VkFence, current_frame), VK_TRUE, UINT64_MAX);
+	PROFILE_ZONE("draw_frame");
+
+	profiler_zone_t zone = profiler_zone_begin("acquire");
+
+	uint64_t t0 = profiler_now_ns();
+	vkWaitForFences(ref->device, 1, &((VkFence *) array_data(&ref->in_flight_fences))[current_frame], VK_TRUE, UINT64_MAX);
+	uint64_t fence_ns = profiler_now_ns() - t0;
 
+	vk_cache_frame(ref, ref->vk_cache);
+
+	/**
+	 * The recorded frames still bind the fallbacks of pipeline variants
+	 * that have finished since.
+	 */
+
+	if (variant_cache_poll(ref->variants)) {
+		ref->cmd_buffers_dirty = true;
+	}
+
+	residency_touch(ref, ref->texture_id);
+
+	if (ref->bindless) {
+		bindless_touch(ref, ref->bindless);
+	}
+
+	mem_budget_frame(ref);
+
+	if (ref->cmd_buffers_dirty) {
+		rerecord_command_buffers(ref);
+	}
+
+	t0 = profiler_now_ns();
 	uint32_t img_index;
-	res = vkAcquireNextImageKHR(ref->device, ref->swapchain, UINT64_MAX, arr_get(ref->img_available_semaphore, VkSemaphore, current_frame), VK_NULL_HANDLE, &img_index);
+	res = vkAcquireNextImageKHR(ref->device, ref->swapchain, UINT64_MAX, ((VkSemaphore *) array_data(&ref->img_available_semaphore))[current_frame], VK_NULL_HANDLE, &img_index);
+	frame_stats_record(ref->frame_stats, FRAME_STAT_ACQUIRE, profiler_now_ns() - t0);
+
+	profiler_zone_end(&zone);
 
 	if (res == VK_ERROR_OUT_OF_DATE_KHR) {
 		recreate_swapchain(ref);
+		return;
 	}
 	else if (res != VK_SUCCESS && res != VK_SUBOPTIMAL_KHR) {
 		fprintf(stderr, "ERR: failed to acquire swapchain image \n // Assertion: `vkAcquireNextImageKHR() != VK_SUCCESS`\n");
 		exit(EXIT_FAILURE);
 	}
 
+	t0 = profiler_now_ns();
+
+	/**
+	 * The image may still be drawn by the submission of another frame slot,
+	 * wait for it before its uniform, instance and indirect draw buffers
+	 * are rewritten.
+	 */
+
+	VkFence *img_fence = &((VkFence *) array_data(&ref->imgs_in_flight))[img_index];
+
+	if (*img_fence != VK_NULL_HANDLE) {
+		vkWaitForFences(ref->device, 1, img_fence, VK_TRUE, UINT64_MAX);
+	}
+
+	*img_fence = ((VkFence *) array_data(&ref->in_flight_fences))[current_frame];
+
+	frame_stats_record(ref->frame_stats, FRAME_STAT_FENCE_WAIT, fence_ns + profiler_now_ns() - t0);
+
 	update_uniform_buffer(ref, img_index);
 
-	if (array_get(&ref->imgs_in_flight, img_index) != NULL) {
-		vkWaitForFences(ref->device, 1, &arr_get(ref->imgs_in_flight, VkFence, img_index), VK_TRUE, UINT64_MAX);
+	/**
+	 * The image's previous submission has completed, its GPU timings can be
+	 * read back without stalling.
+	 */
+
+	if (gpu_timer_collect(ref, ref->gpu_timer, img_index)) {
+		const gpu_timer_scope_t *frame = gpu_timer_get(ref->gpu_timer, "frame");
+
+		if (frame) {
+			frame_stats_record(ref->frame_stats, FRAME_STAT_GPU_FRAME, (uint64_t) (frame->last_ms * 1e6));
+		}
 	}
 
-	array_set(&ref->imgs_in_flight, current_frame, array_get(&ref->in_flight_fences, current_frame));
+	zone = profiler_zone_begin("submit");
 
 	VkSubmitInfo submit_info = {};
 	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-	VkSemaphore wait_semaphores[] = { arr_get(ref->img_available_semaphore, VkSemaphore, current_frame) };
+	VkSemaphore wait_semaphores[] = { ((VkSemaphore *) array_data(&ref->img_available_semaphore))[current_frame] };
 	VkPipelineStageFlags wait_stages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
 	submit_info.waitSemaphoreCount = 1;
 	submit_info.pWaitSemaphores = wait_semaphores;
 	submit_info.pWaitDstStageMask = wait_stages;
 
 	submit_info.commandBufferCount = 1;
-	submit_info.pCommandBuffers = &arr_get(ref->cmd_buffers, VkCommandBuffer, img_index);
+	submit_info.pCommandBuffers = &((VkCommandBuffer *) array_data(&ref->cmd_buffers))[img_index];
 
-	VkSemaphore signal_semaphores[] = { arr_get(ref->render_finished_semaphore, VkSemaphore, current_frame) };
+	VkSemaphore signal_semaphores[] = { ((VkSemaphore *) array_data(&ref->render_finished_semaphore))[current_frame] };
 	submit_info.signalSemaphoreCount = 1;
 	submit_info.pSignalSemaphores = signal_semaphores;
 
-	vkResetFences(ref->device, 1, &arr_get(ref->in_flight_fences, VkFence, current_frame));
+	vkResetFences(ref->device, 1, &((VkFence *) array_data(&ref->in_flight_fences))[current_frame]);
+
+	res = vkQueueSubmit(ref->graphics_queue, 1, &submit_info, ((VkFence *) array_data(&ref->in_flight_fences))[current_frame]);
+	gpu_timer_submitted(ref->gpu_timer, img_index);
+
+	profiler_zone_end(&zone);
 
-	res = vkQueueSubmit(ref->graphics_queue, 1, &submit_info, arr_get(ref->in_flight_fences, VkFence, current_frame));
 	if (res == VK_ERROR_OUT_OF_DATE_KHR || res == VK_SUBOPTIMAL_KHR || ref->framebuffer_resized) {
 		ref->framebuffer_resized = false;
 		recreate_swapchain(ref);
@@ -328,14 +492,186 @@ void draw_frame(struct _application *ref)
 	present_info.pImageIndices = &img_index;
 
 
+	zone = profiler_zone_begin("present");
+	t0 = profiler_now_ns();
+
 	vkQueuePresentKHR(ref->present_queue, &present_info);
 
+	frame_stats_record(ref->frame_stats, FRAME_STAT_PRESENT, profiler_now_ns() - t0);
+	profiler_zone_end(&zone);
+
+	gpu_timer_log(ref->gpu_timer, 5.0);
+
 	current_frame = (current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
 }
 
+/**
+ *	Grid of `instance_count` copies of the mesh below the root transform,
+ *	spaced wide enough for the unit sized fitted models.
+ */
+void init_instances(struct _application *ref)
+{
+	if (ref->instance_count == 0) {
+		ref->instance_count = 1;
+	}
+
+	ref->transforms = malloc(sizeof(transforms_t));
+	init_transforms(ref->transforms, ref->instance_count + 1, 0);
+
+	uint32_t root = transform_add(ref->transforms, TRANSFORM_NO_PARENT);
+	uint32_t side = (uint32_t) ceilf(sqrtf((float) ref->instance_count));
+
+	for (uint32_t i = 0; i < ref->instance_count; i++) {
+		uint32_t id = transform_add(ref->transforms, root);
+
+		vec3 pos = {
+			((float) (i % side) - (side - 1) * 0.5f) * INSTANCE_SPACING,
+			((float) (i / side) - (side - 1) * 0.5f) * INSTANCE_SPACING,
+			0.0f
+		};
+
+		transform_set(ref->transforms, id, pos, (versor) {0.0f, 0.0f, 0.0f, 1.0f}, (vec3) {1.0f, 1.0f, 1.0f});
+	}
+
+	ref->instance_lods = malloc(sizeof(uint32_t) * ref->instance_count);
+	ref->instance_order = malloc(sizeof(uint32_t) * ref->instance_count);
+
+	if (ref->instance_count > 1) {
+		printf("Instances: %u, %s SIMD transforms on %d workers\n", ref->instance_count,
+			ref->transforms->avx ? "AVX" : ref->transforms->sse ? "SSE" : "no", tpool_size(&ref->transforms->pool));
+	}
+}
+
+/**
+ *	Spin every instance around Z, each with its own phase, and refresh the
+ *	world matrices. `t` is in the 5 ms steps of `update_uniform_buffer()`.
+ */
+void update_instances(struct _application *ref, uint64_t t)
+{
+	PROFILE_ZONE("update_instances");
+
+	for (uint32_t i = 0; i < ref->instance_count; i++) {
+		float angle = glm_rad(45.0f + (1.0f * t)) + 0.1f * i;
+
+		transform_set_rotation(ref->transforms, i + 1, (versor) {0.0f, 0.0f, sinf(angle * 0.5f), cosf(angle * 0.5f)});
+	}
+
+	transforms_update(ref->transforms);
+}
+
+/**
+ *	Pick the level of detail of every instance from its projected error,
+ *	write the instances sorted by level into the instance buffer of
+ *	`current_image` and one draw per level and submesh covering each
+ *	level's run of instances. `model` maps mesh space to instance space,
+ *	`eye` is the camera position.
+ */
+void update_lod_draws(struct _application *ref, uint32_t current_image, mat4 model, vec3 eye, float proj_scale)
+{
+	PROFILE_ZONE("update_lod_draws");
+
+	transforms_t *transforms = ref->transforms;
+
+	vec3 extent;
+	vec3 mesh_center;
+	vec3 model_center;
+
+	glm_vec3_sub(ref->mesh->max, ref->mesh->min, extent);
+	glm_vec3_center(ref->mesh->min, ref->mesh->max, mesh_center);
+	glm_mat4_mulv3(model, mesh_center, 1.0f, model_center);
+
+	float radius = glm_vec3_norm(extent) * 0.5f;
+	float model_scale = glm_vec3_norm(model[0]);
+	float threshold = MESH_LOD_THRESHOLD_PIXELS * 2.0f / (float) ref->swapc_extent.height;
+
+	uint32_t lod_count = ref->mesh->lod_count;
+	uint32_t finest = lod_count - 1;
+
+	for (uint32_t i = 0; i < ref->instance_count; i++) {
+		vec3 center;
+		glm_mat4_mulv3(transforms->world[i + 1], model_center, 1.0f, center);
+
+		/**
+		 * Errors are in mesh units, measure the distance in them as well.
+		 */
+
+		float scale = glm_vec3_norm(transforms->world[i + 1][0]) * model_scale;
+		float distance = glm_vec3_distance(center, eye) / (scale > 0.0f ? scale : 1.0f);
+
+		ref->instance_lods[i] = mesh_select_lod(ref->mesh->lod_error, lod_count, distance, radius, proj_scale, threshold);
+		finest = ref->instance_lods[i] < finest ? ref->instance_lods[i] : finest;
+	}
+
+	/**
+	 * Without `drawIndirectFirstInstance` every draw starts at instance 0,
+	 * all instances go with the finest level any of them needs.
+	 */
+
+	if (!ref->draw_first_instance) {
+		for (uint32_t i = 0; i < ref->instance_count; i++) {
+			ref->instance_lods[i] = finest;
+		}
+	}
+
+	uint32_t offsets[MESH_MAX_LODS + 1] = {};
+
+	for (uint32_t i = 0; i < ref->instance_count; i++) {
+		offsets[ref->instance_lods[i] + 1]++;
+	}
+
+	for (uint32_t l = 0; l < lod_count; l++) {
+		offsets[l + 1] += offsets[l];
+	}
+
+	uint32_t cursor[MESH_MAX_LODS];
+	memcpy(cursor, offsets, sizeof(cursor));
+
+	for (uint32_t i = 0; i < ref->instance_count; i++) {
+		ref->instance_order[cursor[ref->instance_lods[i]]++] = i + 1;
+	}
+
+	/**
+	 * Written in place while mapped: callers have waited for the fence of
+	 * the image's last submission (`imgs_in_flight`, or the frame slot
+	 * headless), no draw still reads these matrices.
+	 */
+
+	mat4 *instances = ((mat4 **) array_data(&ref->instance_mapped))[current_image];
+	uint32_t *instance_textures = (uint32_t *) &instances[ref->instance_count];
+
+	transforms_write(transforms, instances, ref->instance_order, ref->instance_count);
+
+	for (uint32_t k = 0; k < ref->instance_count; k++) {
+		instance_textures[k] = ref->bindless ? (ref->instance_order[k] - 1) % ref->bindless->count : 0;
+	}
+
+	const submesh_t *submeshes = (const submesh_t *) array_data(&ref->mesh->submeshes);
+	uint32_t submesh_count = array_size(&ref->mesh->submeshes);
+	VkDrawIndexedIndirectCommand *draws;
+
+	vkMapMemory(ref->device, ((VkDeviceMemory *) array_data(&ref->lod_draw_buffers_memory))[current_image], 0, VK_WHOLE_SIZE, 0, (void **) &draws);
+
+	for (uint32_t l = 0; l < lod_count; l++) {
+		for (uint32_t s = 0; s < submesh_count; s++) {
+			const mesh_lod_t *level = &submeshes[s].lods[l < submeshes[s].lod_count ? l : submeshes[s].lod_count - 1];
+			VkDrawIndexedIndirectCommand *draw = &draws[l * submesh_count + s];
+
+			draw->indexCount = level->index_count;
+			draw->instanceCount = offsets[l + 1] - offsets[l];
+			draw->firstIndex = level->first_index;
+			draw->vertexOffset = submeshes[s].vertex_offset;
+			draw->firstInstance = ref->draw_first_instance ? offsets[l] : 0;
+		}
+	}
+
+	vkUnmapMemory(ref->device, ((VkDeviceMemory *) array_data(&ref->lod_draw_buffers_memory))[current_image]);
+}
+
 void update_uniform_buffer(struct _application *ref, uint32_t current_image)
 {
-	ubo_t ubo = *(ubo_t *) malloc(sizeof(ubo_t));
+	PROFILE_ZONE("update_uniform_buffer");
+
+	ubo_t ubo = {};
 	struct timeval tv;
 	uint64_t t;
 
@@ -343,20 +679,62 @@ void update_uniform_buffer(struct _application *ref, uint32_t current_image)
 
 	t = ((tv.tv_sec * 1000 + tv.tv_usec / 1000) - (ref->start_tv.tv_sec * 1000 + ref->start_tv.tv_usec / 1000)) / 5;
 
+	update_instances(ref, t);
+
+	/**
+	 * Pull the camera and far plane back with the instance grid, a single
+	 * instance keeps the original view.
+	 */
+
+	float side = ceilf(sqrtf((float) ref->instance_count));
+	float distance = 1.0f + (side - 1.0f) * INSTANCE_SPACING * 0.5f;
+
 	float center[] = {0.0f, 0.0f, 0.0f};
-	float lookat_vec[] = {2.0f, 2.0f, 2.0f};
+	float lookat_vec[] = {2.0f * distance, 2.0f * distance, 2.0f * distance};
 	float vec_z[] = {0.0f, 0.0f, 1.0f};
 
-	glm_rotate_make(ubo.model, glm_rad(45.0f + (1.0f * t)), vec_z);
+	glm_mat4_identity(ubo.model);
+
+	/**
+	 * Fit loaded models into the unit sized view of the built-in quads, Y up
+	 * sources are turned Z up.
+	 */
+
+	if (ref->model_path) {
+		vec3 extent;
+		vec3 mesh_center;
+
+		glm_vec3_sub(ref->mesh->max, ref->mesh->min, extent);
+		glm_vec3_center(ref->mesh->min, ref->mesh->max, mesh_center);
+		glm_vec3_negate(mesh_center);
+
+		float radius = glm_vec3_norm(extent) * 0.5f;
+
+		if (ref->mesh->y_up) {
+			glm_rotate(ubo.model, glm_rad(90.0f), (vec3) {1.0f, 0.0f, 0.0f});
+		}
+
+		glm_scale_uni(ubo.model, radius > 0.0f ? 1.0f / radius : 1.0f);
+		glm_translate(ubo.model, mesh_center);
+	}
+
 	glm_lookat(lookat_vec, center, vec_z, ubo.view);
-	glm_perspective(glm_rad(60.0f), ref->swapc_extent.width / (float) ref->swapc_extent.height, 0.1f, 10.0f, ubo.proj);
+	glm_perspective(glm_rad(60.0f), ref->swapc_extent.width / (float) ref->swapc_extent.height, 0.1f, 10.0f * distance, ubo.proj);
 	ubo.proj[1][1] *= -1;
 
+	update_lod_draws(ref, current_image, ubo.model, lookat_vec, ubo.proj[1][1]);
+
+	if (ref->vertex_format == VERTEX_FORMAT_PACKED) {
+		mat4 dequantize;
+		mesh_dequantize_matrix(ref->mesh, dequantize);
+		glm_mat4_mul(ubo.model, dequantize, ubo.model);
+	}
+
 	void *data;
 
-	vkMapMemory(ref->device, arr_get(ref->uniform_buffers_memory, VkDeviceMemory, current_image), 0, sizeof(ubo), 0, &data);
+	vkMapMemory(ref->device, ((VkDeviceMemory *) array_data(&ref->uniform_buffers_memory))[current_image], 0, sizeof(ubo), 0, &data);
 	memcpy(data, &ubo, sizeof(ubo));
-	vkUnmapMemory(ref->device, arr_get(ref->uniform_buffers_memory, VkDeviceMemory, current_image));
+	vkUnmapMemory(ref->device, ((VkDeviceMemory *) array_data(&ref->uniform_buffers_memory))[current_image]);
 }
 
 /**
@@ -390,7 +768,7 @@ void init_window(struct _application *ref)
  */
 void create_surface(struct _application *ref)
 {
-	int res = glfwCreateWindowSurface(ref->vk_instance, ref->window, NULL, &ref->surface);
+	int res = glfwCreateWindowSurface(ref->vk_instance, ref->window, HOST_ALLOC(SURFACE), &ref->surface);
 	if (res != VK_SUCCESS) {
 		fprintf(stderr, "ERR: failed to create window surface via GLFW \n // Assertion: `glfwCreateWindowSurface() != VK_SUCCESS`\n");
 		exit(EXIT_FAILURE);
@@ -412,7 +790,8 @@ void create_sync_objects(struct _application *ref)
 	array_resize(&ref->img_available_semaphore, MAX_FRAMES_IN_FLIGHT, true);
 	array_resize(&ref->render_finished_semaphore, MAX_FRAMES_IN_FLIGHT, true);
 	array_resize(&ref->in_flight_fences, MAX_FRAMES_IN_FLIGHT, true);
-	array_resize(&ref->imgs_in_flight, array_size(&ref->swapc_imgs), false);
+
+	reset_image_fences(ref);
 
 	VkSemaphoreCreateInfo semaphore_ci = {};
 	semaphore_ci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -427,19 +806,19 @@ void create_sync_objects(struct _application *ref)
 
 	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
 
-		VkResult res = vkCreateSemaphore(ref->device, &semaphore_ci, NULL, &((VkSemaphore *) array_data(&ref->img_available_semaphore))[i]);
+		VkResult res = vkCreateSemaphore(ref->device, &semaphore_ci, HOST_ALLOC(SYNC), &((VkSemaphore *) array_data(&ref->img_available_semaphore))[i]);
 		if (res != VK_SUCCESS) {
 			fprintf(stderr, "ERR: failed to create semaphore for available images \n // Assertion: `vkCreateSemaphore() != VK_SUCCESS`\n");
 			exit(EXIT_FAILURE);
 		}
 
-		res = vkCreateSemaphore(ref->device, &semaphore_ci, NULL, &((VkSemaphore *) array_data(&ref->render_finished_semaphore))[i]);
+		res = vkCreateSemaphore(ref->device, &semaphore_ci, HOST_ALLOC(SYNC), &((VkSemaphore *) array_data(&ref->render_finished_semaphore))[i]);
 		if (res != VK_SUCCESS) {
 			fprintf(stderr, "ERR: failed to create semaphore for finished render \n // Assertion: `vkCreateSemaphore() != VK_SUCCESS`\n");
 			exit(EXIT_FAILURE);
 		}
 
-		res = vkCreateFence(ref->device, &fence_ci, NULL, &((VkFence *) array_data(&ref->in_flight_fences))[i]);
+		res = vkCreateFence(ref->device, &fence_ci, HOST_ALLOC(SYNC), &((VkFence *) array_data(&ref->in_flight_fences))[i]);
 		if (res != VK_SUCCESS) {
 			fprintf(stderr, "ERR: failed to create fences \n // Assertion: `vkCreateFence() != VK_SUCCESS`\n");
 			exit(EXIT_FAILURE);
@@ -448,14 +827,26 @@ void create_sync_objects(struct _application *ref)
 }
 
 /**
- *	Initialize all Vulkan stuff.
+ *	One fence slot per swapchain image, VK_NULL_HANDLE until the image is
+ *	first submitted. Called again when the swapchain is recreated, with the
+ *	device idle.
  */
-void init_vk(struct _application *ref)
+void reset_image_fences(struct _application *ref)
 {
-	VkResult res;
+	array_resize(&ref->imgs_in_flight, array_size(&ref->swapc_imgs), true);
 
-	ref->framebuffer_resized = false;
-	gettimeofday(&ref->start_tv, NULL);
+	for (int i = 0; i < array_size(&ref->imgs_in_flight); i++) {
+		((VkFence *) array_data(&ref->imgs_in_flight))[i] = VK_NULL_HANDLE;
+	}
+}
+
+/**
+ *	Create the Vulkan instance with the extensions and layers required
+ *	by the current mode (windowed or headless).
+ */
+void create_instance(struct _application *ref)
+{
+	VkResult res;
 
 	/**
 	 * Create VkInstance via filling up CREATE INFO struct.
@@ -468,7 +859,7 @@ void init_vk(struct _application *ref)
 	app_info.applicationVersion = VK_MAKE_VERSION(0, 9, 0);
 	app_info.pEngineName = "parallax-eng";
 	app_info.engineVersion = VK_MAKE_VERSION(0, 9, 0);
-	app_info.apiVersion = VK_API_VERSION_1_0;
+	app_info.apiVersion = VK_API_VERSION_1_1;
 
 	VkInstanceCreateInfo instance_ci = {};
 	instance_ci.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -479,7 +870,17 @@ void init_vk(struct _application *ref)
 	 */
 
 	array ext_arr;
-	query_req_ext(&ext_arr);
+
+	if (ref->headless) {
+		array_init(&ext_arr, sizeof(const char[256]));
+
+		if (enable_validation_layers) {
+			array_append(&ext_arr, (void *) VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+		}
+	}
+	else {
+		query_req_ext(&ext_arr);
+	}
 
 	const char *tmp_arr[array_size(&ext_arr)];
 
@@ -503,7 +904,7 @@ void init_vk(struct _application *ref)
 		instance_ci.pNext = NULL;
 	}
 
-	res = vkCreateInstance(&instance_ci, NULL, &ref->vk_instance);
+	res = vkCreateInstance(&instance_ci, HOST_ALLOC(INSTANCE), &ref->vk_instance);
 	if (res != VK_SUCCESS) {
 		fprintf(stderr, "ERR: Failed to instantiate Vulkan\n// Assertion: `vkCreateInstance() == VK_SUCCES`\n");
 		exit(EXIT_FAILURE);
@@ -522,44 +923,134 @@ void init_vk(struct _application *ref)
 	array_resize(&extensions, ext_count, true);
 
 	vkEnumerateInstanceExtensionProperties(NULL, &ext_count, (VkExtensionProperties *) array_data(&extensions));
+}
+
+/**
+ *	Initialize all Vulkan stuff.
+ */
+void init_vk(struct _application *ref)
+{
+	PROFILE_ZONE("init_vk");
+
+	ref->framebuffer_resized = false;
+	gettimeofday(&ref->start_tv, NULL);
+
+	PROFILE_CALL(create_instance(ref));
 
-	setup_debug_messenger(ref);
+	PROFILE_CALL(setup_debug_messenger(ref));
 
 	/**
-	 * Finalize by calling the other modules.
+	 * Finalize by calling the other modules. Headless mode renders into
+	 * offscreen images instead of a surface backed swapchain.
 	 */
 
-	create_surface(ref);
+	if (ref->headless) {
+		ref->surface = VK_NULL_HANDLE;
+		ref->window = NULL;
+	}
+	else {
+		PROFILE_CALL(create_surface(ref));
+	}
+
+	PROFILE_CALL(init_physical_device(ref));
+	PROFILE_CALL(init_logical_device(ref));
 
-	init_physical_device(ref);
-	init_logical_device(ref);
+	ref->shaders = malloc(sizeof(shader_cache_t));
+	init_shader_cache(ref->shaders);
 
-	init_swapchain(ref);
-	init_image_views(ref);
+	ref->vk_cache = malloc(sizeof(vk_cache_t));
+	init_vk_cache(ref->vk_cache);
 
-	create_renderpass(ref);
-	create_descriptor_set_layout(ref);
+	ref->resources = malloc(sizeof(resources_t));
+	init_resources(ref->resources);
+
+	if (ref->headless) {
+		PROFILE_CALL(init_offscreen_targets(ref));
+	}
+	else {
+		PROFILE_CALL(init_swapchain(ref));
+	}
 
-	create_graphics_pipeline(ref);
-	create_command_pool(ref);
+	PROFILE_CALL(init_image_views(ref));
 
-	create_depth_resources(ref);
+	PROFILE_CALL(create_renderpass(ref));
+	PROFILE_CALL(create_descriptor_set_layout(ref));
 
-	create_framebuffers(ref);
+	if (ref->texture_count > 0) {
+		ref->bindless = malloc(sizeof(bindless_t));
+		init_bindless(ref, ref->bindless, ref->descriptor_indexing);
+	}
 
-	create_texture_image(ref);
-	create_texture_image_view(ref);
-	create_texture_sampler(ref);
+	PROFILE_CALL(load_mesh(ref));
+	PROFILE_CALL(init_instances(ref));
 
-	create_vertex_buffer(ref);
-	create_index_buffer(ref);
-	create_uniform_buffers(ref);
+	ref->variants = malloc(sizeof(variant_cache_t));
+	init_variant_cache(ref, ref->variants, 0);
 
-	create_descriptor_pool(ref);
-	create_descriptor_sets(ref);
+	PROFILE_CALL(create_graphics_pipeline(ref));
+	PROFILE_CALL(create_command_pool(ref));
 
-	create_command_buffers(ref);
-	create_sync_objects(ref);
+	ref->residency = malloc(sizeof(residency_t));
+	init_residency(ref->residency);
+
+	PROFILE_CALL(create_texture_image(ref));
+	PROFILE_CALL(create_texture_sampler(ref));
+
+	if (ref->bindless) {
+		PROFILE_CALL(create_bindless_textures(ref));
+	}
+
+	handle_t streams[MESH_STREAM_COUNT] = {HANDLE_NULL, HANDLE_NULL, HANDLE_NULL};
+
+	PROFILE_CALL(streams[MESH_STREAM_VERTEX] = create_vertex_buffer(ref));
+
+	if (ref->depth_prepass) {
+		PROFILE_CALL(streams[MESH_STREAM_POSITION] = create_position_buffer(ref));
+	}
+
+	PROFILE_CALL(streams[MESH_STREAM_INDEX] = create_index_buffer(ref));
+
+	ref->scene_mesh = resource_create_mesh(ref->resources, streams, (uint32_t) array_size(&ref->mesh->indices), mesh_index_type(ref->mesh),
+		ref->scene_material);
+	PROFILE_CALL(create_uniform_buffers(ref));
+
+	ref->desc_alloc = malloc(sizeof(desc_alloc_t));
+	init_desc_alloc(ref, ref->desc_alloc);
+
+	PROFILE_CALL(create_descriptor_sets(ref));
+
+	/**
+	 * GPU cluster culling for a single large loaded model, the graphics
+	 * queue records the cull dispatch. Instanced scenes rely on the per
+	 * instance levels of detail instead.
+	 */
+
+	if (ref->model_path && !ref->no_meshlets && ref->instance_count == 1 && array_size(&ref->mesh->indices) / 3 >= MESHLET_MIN_TRIANGLES) {
+		if (meshlet_cull_supported(ref)) {
+			ref->meshlet_cull = calloc(1, sizeof(meshlet_cull_t));
+			init_meshlet_cull(ref, ref->meshlet_cull);
+			create_meshlet_cull_frames(ref, ref->meshlet_cull);
+		}
+		else {
+			fprintf(stderr, "WARN: graphics queue has no compute support, meshlet culling disabled\n");
+		}
+	}
+
+	/**
+	 * The graph declares the cull pass, the framebuffers take its depth
+	 * buffer.
+	 */
+
+	PROFILE_CALL(create_render_graph(ref));
+	rg_report(ref->render_graph);
+
+	PROFILE_CALL(create_framebuffers(ref));
+
+	ref->gpu_timer = calloc(1, sizeof(gpu_timer_t));
+	init_gpu_timer(ref, ref->gpu_timer, ref->graphics_queue_family_index, array_size(&ref->swapc_imgs), true);
+
+	PROFILE_CALL(create_command_buffers(ref));
+	PROFILE_CALL(create_sync_objects(ref));
 
 }
 
@@ -602,50 +1093,238 @@ VkFormat find_depth_format(struct _application *ref)
 	return find_supported_format(ref, *arr, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
 }
 
-void create_depth_resources(struct _application *ref)
+/**
+ *	Compute pass of the frame graph, see `meshlet_cmd_cull()`.
+ */
+static void record_meshlet_cull(struct _application *ref, VkCommandBuffer cmd, uint32_t image, void *user)
 {
-	VkFormat depth_format = find_depth_format(ref);
+	meshlet_cmd_cull(ref, ref->meshlet_cull, cmd, image);
+}
+
+/**
+ *	Index buffer and draws of the scene, with the pipeline and vertex
+ *	buffers bound.
+ */
+static void cmd_draw_scene(struct _application *ref, VkCommandBuffer cmd, uint32_t image)
+{
+	if (ref->meshlet_cull) {
+		meshlet_cmd_draw(ref, ref->meshlet_cull, cmd, image);
+	}
+	else {
+		vkCmdBindIndexBuffer(cmd, resource_mesh_buffer(ref->resources, ref->scene_mesh, MESH_STREAM_INDEX), 0, mesh_index_type(ref->mesh));
 
-	create_image(ref, ref->swapc_extent.width, ref->swapc_extent.height, depth_format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &ref->depth_image, &ref->depth_image_memory);
+		/**
+		 * One draw per level of detail and submesh, each instancing
+		 * the run of instances `update_lod_draws()` sorted into that
+		 * level. Single draws keep this on Vulkan 1.0 without
+		 * `multiDrawIndirect`.
+		 */
 
-	VkImageViewCreateInfo view_info = {};
-	view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-	view_info.image = ref->depth_image;
-	view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
-	view_info.format = depth_format;
-	view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-	view_info.subresourceRange.baseMipLevel = 0;
-	view_info.subresourceRange.levelCount = 1;
-	view_info.subresourceRange.baseArrayLayer = 0;
-	view_info.subresourceRange.layerCount = 1;
+		uint32_t draw_count = array_size(&ref->mesh->submeshes) * ref->mesh->lod_count;
 
-	int res = vkCreateImageView(ref->device, &view_info, NULL, &ref->depth_image_view);
-	if (res != VK_SUCCESS) {
-		fprintf(stderr, "ERR: Failed to create depth image view\n// Assertion: `vkCreateImageView() == VK_SUCCES`\n");
-		exit(EXIT_FAILURE);
+		for (uint32_t d = 0; d < draw_count; d++) {
+			vkCmdDrawIndexedIndirect(cmd, ((VkBuffer *) array_data(&ref->lod_draw_buffers))[image],
+				sizeof(VkDrawIndexedIndirectCommand) * d, 1, sizeof(VkDrawIndexedIndirectCommand));
+		}
 	}
-
 }
 
-void create_image(struct _application *ref, uint32_t x, uint32_t y, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage *img, VkDeviceMemory *mem)
+/**
+ *	Main render pass of the frame graph, the scene into the swapchain image.
+ */
+static void record_main_pass(struct _application *ref, VkCommandBuffer cmd, uint32_t image, void *user)
 {
-	VkImageCreateInfo image_info = {};
-	image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-	image_info.imageType = VK_IMAGE_TYPE_2D;
-	image_info.extent.width = x;
-	image_info.extent.height = y;
-	image_info.extent.depth = 1;
-	image_info.mipLevels = 1;
-	image_info.arrayLayers = 1;
-	image_info.format = format;
-	image_info.tiling = tiling;
-	image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	image_info.usage = usage;
-	image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-	image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+	VkOffset2D offset = {0, 0};
+	VkClearValue clear_color;
+
+	VkClearColorValue cc_val = {0.0f, 0.0f, 0.0f, 1.0f};
+
+	clear_color.color = cc_val;
+
+	VkClearDepthStencilValue cds_val = {1.0f, 0};
+
+	VkClearValue depth_stencil;
+	depth_stencil.depthStencil = cds_val;
+
+	VkClearValue clear_vals[2] = {clear_color, depth_stencil};
+
+	VkRenderPassBeginInfo render_pass_bi = {};
+	render_pass_bi.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	render_pass_bi.renderPass = ref->render_pass;
+	render_pass_bi.framebuffer = arr_get(ref->swapc_framebuffers, VkFramebuffer, image);
+	render_pass_bi.renderArea.offset = offset;
+	render_pass_bi.renderArea.extent = ref->swapc_extent;
+
+	render_pass_bi.clearValueCount = 2;
+	render_pass_bi.pClearValues = clear_vals;
+
+	/**
+	 * GPU time and shader invocations of the whole render pass.
+	 */
+
+	uint32_t timer_slot = gpu_timer_begin(ref->gpu_timer, cmd, image, gpu_timer_scope(ref->gpu_timer, "render_pass"), true);
+
+	vkCmdBeginRenderPass(cmd, &render_pass_bi, VK_SUBPASS_CONTENTS_INLINE);
+
+	/**
+	 * Instance matrices and texture ids share the instance buffer.
+	 */
+
+	VkBuffer instance_buffer = ((VkBuffer *) array_data(&ref->instance_buffers))[image];
+
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, ref->pipeline_layout, 0, 1, &((VkDescriptorSet *) array_data(&ref->descriptor_sets))[image], 0, NULL);
+
+	if (ref->bindless) {
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, ref->pipeline_layout, 1, 1, &ref->bindless->set, 0, NULL);
+	}
+
+	/**
+	 * The pre-pass lays down the depth of the nearest surfaces from the
+	 * position stream alone, then the scene is drawn again shaded.
+	 */
+
+	if (ref->depth_prepass) {
+		uint32_t prepass_slot = gpu_timer_begin(ref->gpu_timer, cmd, image, gpu_timer_scope(ref->gpu_timer, "depth_prepass"), false);
+
+		VkBuffer position_buffers[] = { resource_mesh_buffer(ref->resources, ref->scene_mesh, MESH_STREAM_POSITION), instance_buffer };
+		VkDeviceSize position_offsets[] = {0, 0};
+
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, ref->depth_prepass_pipeline);
+		vkCmdBindVertexBuffers(cmd, 0, 2, position_buffers, position_offsets);
+
+		cmd_draw_scene(ref, cmd, image);
+
+		gpu_timer_end(ref->gpu_timer, cmd, image, prepass_slot);
+	}
+
+	VkBuffer vertex_buffers[] = { resource_mesh_buffer(ref->resources, ref->scene_mesh, MESH_STREAM_VERTEX), instance_buffer, instance_buffer };
+	VkDeviceSize offsets[] = {0, 0, sizeof(mat4) * ref->instance_count};
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, variant_cache_get(ref->variants, ref->scene_variant, ref->graphics_pipeline));
+	vkCmdBindVertexBuffers(cmd, 0, 3, vertex_buffers, offsets);
+
+	cmd_draw_scene(ref, cmd, image);
+
+	vkCmdEndRenderPass(cmd);
+	gpu_timer_end(ref->gpu_timer, cmd, image, timer_slot);
+}
+
+/**
+ *	Declare the frame: the meshlet cull, when enabled, feeding the main
+ *	render pass, which draws into the swapchain image and a transient depth
+ *	buffer. The graph places every barrier in between, including the
+ *	swapchain image transitions the render pass used to do.
+ */
+void create_render_graph(struct _application *ref)
+{
+	ref->render_graph = malloc(sizeof(render_graph_t));
+	render_graph_t *graph = ref->render_graph;
+
+	init_render_graph(graph);
+
+	/**
+	 * The acquire semaphore is waited on at color attachment output, the
+	 * transition out of UNDEFINED has to come after it.
+	 */
+
+	rg_state_t acquired = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED};
+	rg_state_t presented = {VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR};
+
+	if (ref->headless) {
+		rg_state_t copied = {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL};
+		presented = copied;
+	}
+
+	ref->rg_backbuffer = rg_import_image(graph, "backbuffer", VK_IMAGE_ASPECT_COLOR_BIT, acquired, &presented);
+
+	VkFormat depth_format = find_depth_format(ref);
+	VkImageAspectFlags depth_aspect = VK_IMAGE_ASPECT_DEPTH_BIT | (has_stencil_component(depth_format) ? VK_IMAGE_ASPECT_STENCIL_BIT : 0);
+
+	ref->rg_depth = rg_create_image(graph, "depth", depth_format, ref->swapc_extent, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, depth_aspect);
+
+	/**
+	 * The cull buffers of an image are only reused after its previous
+	 * submission's fence, they start the frame without pending access.
+	 */
+
+	if (ref->meshlet_cull) {
+		rg_state_t idle = {};
+
+		ref->rg_cull_indices = rg_import_buffer(graph, "meshlet_indices", idle);
+		ref->rg_cull_indirect = rg_import_buffer(graph, "meshlet_indirect", idle);
+
+		uint32_t cull = rg_add_pass(graph, "meshlet_cull", record_meshlet_cull, NULL, false);
+
+		rg_write(graph, cull, ref->rg_cull_indices, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+		rg_write(graph, cull, ref->rg_cull_indirect, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+	}
+
+	uint32_t main_pass = rg_add_pass(graph, "main", record_main_pass, NULL, false);
+
+	rg_write(graph, main_pass, ref->rg_backbuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+	rg_write(graph, main_pass, ref->rg_depth, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+		VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+
+	if (ref->meshlet_cull) {
+		rg_read(graph, main_pass, ref->rg_cull_indirect, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+		rg_read(graph, main_pass, ref->rg_cull_indices, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+	}
+
+	rg_compile(ref, graph);
+}
+
+/**
+ *	Allocate through the memory budget. Device local memory that is still
+ *	exhausted after the residency manager evicted what it could is replaced
+ *	by system memory: slower to access, but the frame keeps rendering.
+ */
+static VkResult allocate_with_fallback(struct _application *ref, VkMemoryAllocateInfo *alloc_info, uint32_t type_filter,
+	VkMemoryPropertyFlags props, VkDeviceMemory *mem)
+{
+	VkResult res = mem_budget_allocate(ref, alloc_info, mem);
+
+	if (res == VK_SUCCESS || !(props & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)) {
+		return res;
+	}
+
+	uint32_t fallback = mem_budget_fallback_type(ref, type_filter, alloc_info->memoryTypeIndex);
+	if (fallback == UINT32_MAX) {
+		return res;
+	}
+
+	fprintf(stderr, "WARN: out of device local memory, placing %.1f MiB in system memory\n", (double) alloc_info->allocationSize / (1024.0 * 1024.0));
+
+	alloc_info->memoryTypeIndex = fallback;
+	res = mem_budget_allocate(ref, alloc_info, mem);
+
+	if (res == VK_SUCCESS && ref->mem_budget) {
+		ref->mem_budget->fallback_allocations++;
+	}
+
+	return res;
+}
+
+void create_image(struct _application *ref, uint32_t x, uint32_t y, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage *img, VkDeviceMemory *mem)
+{
+	VkImageCreateInfo image_info = {};
+	image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	image_info.imageType = VK_IMAGE_TYPE_2D;
+	image_info.extent.width = x;
+	image_info.extent.height = y;
+	image_info.extent.depth = 1;
+	image_info.mipLevels = 1;
+	image_info.arrayLayers = 1;
+	image_info.format = format;
+	image_info.tiling = tiling;
+	image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	image_info.usage = usage;
+	image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	image_info.samples = VK_SAMPLE_COUNT_1_BIT;
 	image_info.flags = 0;
 
-	int res = vkCreateImage(ref->device, &image_info, NULL, img);
+	int res = vkCreateImage(ref->device, &image_info, HOST_ALLOC(IMAGE), img);
 	if (res != VK_SUCCESS) {
 		fprintf(stderr, "ERR: Failed to create image\n// Assertion: `vkCreateImage() == VK_SUCCES`\n");
 		exit(EXIT_FAILURE);
@@ -657,9 +1336,10 @@ void create_image(struct _application *ref, uint32_t x, uint32_t y, VkFormat for
 	VkMemoryAllocateInfo alloc_info = {};
 	alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
 	alloc_info.allocationSize = mem_req.size;
-	alloc_info.memoryTypeIndex = find_memory_type(ref, mem_req.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	alloc_info.memoryTypeIndex = (usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) ?
+		find_transient_memory_type(ref, mem_req.memoryTypeBits) : find_memory_type(ref, mem_req.memoryTypeBits, properties);
 
-	res = vkAllocateMemory(ref->device, &alloc_info, NULL, mem);
+	res = allocate_with_fallback(ref, &alloc_info, mem_req.memoryTypeBits, properties, mem);
 	if (res != VK_SUCCESS) {
 		fprintf(stderr, "ERR: Failed to allocate memory for image\n// Assertion: `vkAllocateMemory() == VK_SUCCES`\n");
 		exit(EXIT_FAILURE);
@@ -668,26 +1348,77 @@ void create_image(struct _application *ref, uint32_t x, uint32_t y, VkFormat for
 	vkBindImageMemory(ref->device, *img, *mem, 0);
 }
 
-void create_texture_image_view(struct _application *ref)
+void create_texture_image_view(struct _application *ref, VkImage image, VkFormat format, VkImageView *view)
 {
 	VkImageViewCreateInfo view_info = {};
 	view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-	view_info.image = ref->texture_image;
+	view_info.image = image;
 	view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
-	view_info.format = VK_FORMAT_R8G8B8A8_SRGB;
+	view_info.format = format;
 	view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 	view_info.subresourceRange.baseMipLevel = 0;
 	view_info.subresourceRange.levelCount = 1;
 	view_info.subresourceRange.baseArrayLayer = 0;
 	view_info.subresourceRange.layerCount = 1;
 
-	int res = vkCreateImageView(ref->device, &view_info, NULL, &ref->texture_image_view);
+	int res = vkCreateImageView(ref->device, &view_info, HOST_ALLOC(IMAGE_VIEW), view);
 	if (res != VK_SUCCESS) {
 		fprintf(stderr, "ERR: Failed to create texture image view\n// Assertion: `vkCreateImageView() == VK_SUCCES`\n");
 		exit(EXIT_FAILURE);
 	}
 }
 
+/**
+ *	Keep `ref->texture_*` and the descriptor sets in line with the residency
+ *	manager, which may rebuild the texture at a lower resolution.
+ */
+static void texture_residency_changed(struct _application *ref, uint32_t id, void *user)
+{
+	resident_texture_t *tex = residency_get(ref, id);
+
+	ref->texture_image = tex->image;
+	ref->texture_image_memory = tex->memory;
+	ref->texture_image_view = tex->view;
+
+	/**
+	 * An evicted texture samples the fallback until it is restored.
+	 */
+
+	if (tex->view == VK_NULL_HANDLE) {
+		ref->texture_image_view = residency_get(ref, ref->fallback_texture_id)->view;
+	}
+
+	if (array_size(&ref->descriptor_sets) == 0) {
+		return;
+	}
+
+	for (int i = 0; i < array_size(&ref->descriptor_sets); i++) {
+		VkDescriptorImageInfo image_info = {};
+		image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		image_info.imageView = ref->texture_image_view;
+		image_info.sampler = ref->texture_sampler;
+
+		VkWriteDescriptorSet descriptor_write = {};
+		descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptor_write.dstSet = arr_get(ref->descriptor_sets, VkDescriptorSet, i);
+		descriptor_write.dstBinding = 1;
+		descriptor_write.dstArrayElement = 0;
+		descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptor_write.descriptorCount = 1;
+		descriptor_write.pImageInfo = &image_info;
+
+		vkUpdateDescriptorSets(ref->device, 1, &descriptor_write, 0, NULL);
+	}
+
+	/**
+	 * The sets have no UPDATE_AFTER_BIND, the command buffers binding them
+	 * are invalid until recorded again. Residency waited for the device
+	 * before changing the texture.
+	 */
+
+	ref->cmd_buffers_dirty = true;
+}
+
 void create_texture_image(struct _application *ref)
 {
 	int tex_width;
@@ -696,35 +1427,83 @@ void create_texture_image(struct _application *ref)
 
 	stbi_uc *pixels = stbi_load("textures/chess.png", &tex_width, &tex_height, &tex_channels, STBI_rgb_alpha);
 
-	VkDeviceSize img_size = tex_width * tex_height * 4;
-
 	if (!pixels) {
 		fprintf(stderr, "Err: Failed to load texture image.\n");
 		exit(EXIT_FAILURE);
 	}
 
-	VkDeviceMemory staging_buffer_memory;
-	VkBuffer staging_buffer;
+	uint8_t white[4] = {255, 255, 255, 255};
 
-	create_buffer(ref, img_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &staging_buffer, &staging_buffer_memory);
+	ref->fallback_texture_id = residency_register_texture(ref, white, 1, 1, VK_FORMAT_R8G8B8A8_SRGB, NULL, NULL);
+	residency_pin(ref, ref->fallback_texture_id);
 
-	void *data;
+	ref->texture_id = residency_register_texture(ref, pixels, (uint32_t) tex_width, (uint32_t) tex_height, VK_FORMAT_R8G8B8A8_SRGB,
+		texture_residency_changed, NULL);
+	ref->scene_material = resource_create_material(ref->resources, ref->texture_id);
 
-	vkMapMemory(ref->device, staging_buffer_memory, 0, img_size, 0, &data);
-	memcpy(data, pixels, (size_t) img_size);
-	vkUnmapMemory(ref->device, staging_buffer_memory);
+	stbi_image_free(pixels);
+}
 
+/**
+ *	Checkerboard with a per index hue and cell size, standing in for the
+ *	textures of a large scene.
+ */
+static void generate_texture(uint8_t *pixels, uint32_t size, uint32_t index)
+{
+	float hue = fmodf(index * 0.618034f, 1.0f) * 6.0f;
+	float ramp = 1.0f - fabsf(fmodf(hue, 2.0f) - 1.0f);
+
+	float rgb[6][3] = {{1, ramp, 0}, {ramp, 1, 0}, {0, 1, ramp}, {0, ramp, 1}, {ramp, 0, 1}, {1, 0, ramp}};
+	float *color = rgb[(int) hue % 6];
+
+	uint32_t cell = 4u << (index % 4);
+
+	for (uint32_t y = 0; y < size; y++) {
+		for (uint32_t x = 0; x < size; x++) {
+			float shade = ((x / cell) + (y / cell)) % 2 ? 1.0f : 0.25f;
+			uint8_t *texel = &pixels[(y * size + x) * 4];
+
+			texel[0] = (uint8_t) (color[0] * shade * 255.0f);
+			texel[1] = (uint8_t) (color[1] * shade * 255.0f);
+			texel[2] = (uint8_t) (color[2] * shade * 255.0f);
+			texel[3] = 255;
+		}
+	}
+}
+
+/**
+ *	Fill the bindless set with `texture_count` textures: the chess texture
+ *	then generated ones.
+ */
+void create_bindless_textures(struct _application *ref)
+{
+	int tex_width;
+	int tex_height;
+	int tex_channels;
+
+	stbi_uc *pixels = stbi_load("textures/chess.png", &tex_width, &tex_height, &tex_channels, STBI_rgb_alpha);
+
+	if (!pixels) {
+		fprintf(stderr, "Err: Failed to load texture image.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	bindless_add_texture(ref, ref->bindless, pixels, (uint32_t) tex_width, (uint32_t) tex_height);
 	stbi_image_free(pixels);
 
-	create_image(ref, tex_width, tex_height, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &ref->texture_image, &ref->texture_image_memory);
+	uint8_t *generated = malloc((size_t) BINDLESS_LAYER_SIZE * BINDLESS_LAYER_SIZE * 4);
+
+	for (uint32_t i = 1; i < ref->texture_count && i < ref->bindless->capacity; i++) {
+		generate_texture(generated, BINDLESS_LAYER_SIZE, i);
+		bindless_add_texture(ref, ref->bindless, generated, BINDLESS_LAYER_SIZE, BINDLESS_LAYER_SIZE);
+	}
 
-	transition_image_layout(ref, ref->texture_image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-	copy_buffer_to_image(ref, staging_buffer, ref->texture_image, (uint32_t) tex_width, (uint32_t) tex_height);
+	free(generated);
 
-	transition_image_layout(ref, ref->texture_image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	bindless_finalize(ref, ref->bindless);
 
-	vkDestroyBuffer(ref->device, staging_buffer, NULL);
-	vkFreeMemory(ref->device, staging_buffer_memory, NULL);
+	printf("Bindless textures: %u, %s\n", ref->bindless->count,
+		ref->bindless->mode == BINDLESS_DESCRIPTOR_INDEXING ? "descriptor indexing" : "texture array");
 }
 
 void create_texture_sampler(struct _application *ref)
@@ -752,11 +1531,7 @@ void create_texture_sampler(struct _application *ref)
 	sampler_info.minLod = 0.0f;
 	sampler_info.maxLod = 0.0f;
 
-	int res = vkCreateSampler(ref->device, &sampler_info, NULL, &ref->texture_sampler);
-	if (res != VK_SUCCESS) {
-		fprintf(stderr, "ERR: Failed to create texture sampler\n// Assertion: `vkCreateSampler() == VK_SUCCES`\n");
-		exit(EXIT_FAILURE);
-	}
+	ref->texture_sampler = vk_cache_sampler(ref, ref->vk_cache, &sampler_info);
 }
 
 void create_descriptor_set_layout(struct _application *ref)
@@ -782,61 +1557,21 @@ void create_descriptor_set_layout(struct _application *ref)
 	layout_info.bindingCount = 2;
 	layout_info.pBindings = bindings;
 
-	int res = vkCreateDescriptorSetLayout(ref->device, &layout_info, NULL, &ref->descriptor_set_layout);
-	if (res != VK_SUCCESS) {
-		fprintf(stderr, "ERR: failed to create descriptor set layout\n // Assertion: `vkCreateDescriptorSetLayout == VK_SUCCESS`\n");
-		exit(EXIT_FAILURE);
-	}
-}
-
-void create_descriptor_pool(struct _application *ref)
-{
-	VkDescriptorPoolSize pool_size0 = {};
-	pool_size0.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	pool_size0.descriptorCount = (uint32_t) array_size(&ref->swapc_imgs);
-
-	VkDescriptorPoolSize pool_size1 = {};
-	pool_size1.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	pool_size1.descriptorCount = (uint32_t) array_size(&ref->swapc_imgs);
-
-	VkDescriptorPoolSize pool_sizes[2] = {pool_size0, pool_size1};
-
-	VkDescriptorPoolCreateInfo pool_info = {};
-	pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	pool_info.poolSizeCount = 2;
-	pool_info.pPoolSizes = pool_sizes;
-	pool_info.maxSets = (uint32_t) array_size(&ref->swapc_imgs);
-
-	int res = vkCreateDescriptorPool(ref->device, &pool_info, NULL, &ref->descriptor_pool);
-	if (res != VK_SUCCESS) {
-		fprintf(stderr, "ERR: failed to create descriptor pool\n // Assertion: `vkCreateDescriptorPool == VK_SUCCESS`\n");
-		exit(EXIT_FAILURE);
-	}
+	ref->descriptor_set_layout = vk_cache_set_layout(ref, ref->vk_cache, &layout_info);
 }
 
 void create_descriptor_sets(struct _application *ref)
 {
-	array layouts;
-	array_init(&layouts, sizeof(VkDescriptorSetLayout));
-	array_resize(&layouts, array_size(&ref->swapc_imgs), false);
-
-	for (int i = 0; i < array_size(&ref->swapc_imgs); i++) {
-		array_append(&layouts, &ref->descriptor_set_layout);
-	}
-
-	VkDescriptorSetAllocateInfo alloc_info = {};
-	alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	alloc_info.descriptorPool = ref->descriptor_pool;
-	alloc_info.descriptorSetCount = (uint32_t) array_size(&ref->swapc_imgs);
-	alloc_info.pSetLayouts = (VkDescriptorSetLayout *) array_data(&layouts);
-
 	array_init(&ref->descriptor_sets, sizeof(VkDescriptorSet));
 	array_resize(&ref->descriptor_sets, array_size(&ref->swapc_imgs), true);
 
-	int res = vkAllocateDescriptorSets(ref->device, &alloc_info, (VkDescriptorSet *) array_data(&ref->descriptor_sets));
-	if (res != VK_SUCCESS) {
-		fprintf(stderr, "ERR: failed to create descriptor sets\n // Assertion: `vkAllocateDescriptorSets == VK_SUCCESS`\n");
-		exit(EXIT_FAILURE);
+	/**
+	 * The sets outlive the swapchain, only their contents are rewritten
+	 * for the new uniform buffers.
+	 */
+
+	for (size_t i = 0; i < array_size(&ref->swapc_imgs); i++) {
+		((VkDescriptorSet *) array_data(&ref->descriptor_sets))[i] = desc_alloc_cached(ref, ref->desc_alloc, ref->descriptor_set_layout, i, NULL);
 	}
 
 	for (size_t i = 0; i < array_size(&ref->swapc_imgs); i++) {
@@ -875,6 +1610,23 @@ void create_descriptor_sets(struct _application *ref)
 	}
 }
 
+/**
+ *	Score a physical device by its type, higher is better.
+ */
+static int rate_physical_device(VkPhysicalDevice phys_device)
+{
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(phys_device, &props);
+
+	switch (props.deviceType) {
+		case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:	return 4;
+		case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:	return 3;
+		case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:	return 2;
+		case VK_PHYSICAL_DEVICE_TYPE_CPU:		return 1;
+		default:					return 0;
+	}
+}
+
 /**
  *	Initialize physical devices to be used.
  */
@@ -906,6 +1658,28 @@ void init_physical_device(struct _application *ref)
 		fprintf(stderr, "ERR: failed to pick a physical device\n // Assertion: `vkEnumeratePhysicalDevices == VK_SUCCESS`\n");
 		exit(EXIT_FAILURE);
 	}
+
+	/**
+	 * Move the preferred device to slot 0, where `PHYSDEV(0)` picks it up.
+	 * Software rasterizers such as lavapipe rank last.
+	 */
+
+	VkPhysicalDevice *devices = (VkPhysicalDevice *) array_data(&ref->physical_devices);
+	int best = 0;
+	int best_score = -1;
+
+	for (uint32_t i = 0; i < dev_count; i++) {
+		int score = rate_physical_device(devices[i]);
+
+		if (score > best_score) {
+			best = i;
+			best_score = score;
+		}
+	}
+
+	VkPhysicalDevice tmp_dev = devices[0];
+	devices[0] = devices[best];
+	devices[best] = tmp_dev;
 }
 
 /**
@@ -933,8 +1707,15 @@ void init_logical_device(struct _application *ref)
 		queue_infos[i] = queue_ci;
 	}
 
+	VkPhysicalDeviceFeatures supp_feat;
+	vkGetPhysicalDeviceFeatures(PHYSDEV(0), &supp_feat);
+
 	VkPhysicalDeviceFeatures deviceFeatures = {};
 	deviceFeatures.samplerAnisotropy = VK_TRUE;
+	deviceFeatures.pipelineStatisticsQuery = supp_feat.pipelineStatisticsQuery;
+	deviceFeatures.drawIndirectFirstInstance = supp_feat.drawIndirectFirstInstance;
+
+	ref->draw_first_instance = supp_feat.drawIndirectFirstInstance;
 
 	VkDeviceCreateInfo device_info = {};
 	device_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -943,8 +1724,67 @@ void init_logical_device(struct _application *ref)
 
 	device_info.pEnabledFeatures = &deviceFeatures;
 
-	device_info.enabledExtensionCount = 1;
-	device_info.ppEnabledExtensionNames = p_extensions;
+	/**
+	 * Headless mode has no surface to present to: a single queue from the
+	 * compute capable family is enough and the swapchain extension is skipped.
+	 */
+
+	const char *extensions[4];
+	uint32_t ext_count = 0;
+
+	if (ref->headless) {
+		queue_infos[0].queueFamilyIndex = indices.compute_family;
+	}
+	else {
+		extensions[ext_count++] = p_extensions[0];
+	}
+
+	bool ext_budget = mem_budget_ext_supported(PHYSDEV(0));
+
+	if (ext_budget) {
+		extensions[ext_count++] = MEM_BUDGET_EXTENSION_NAME;
+	}
+
+	/**
+	 * Bindless textures index a partially bound array updated after bind.
+	 */
+
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexing_features = {};
+	indexing_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+	ref->descriptor_indexing = ref->texture_count > 0 && !ref->no_descriptor_indexing && bindless_ext_supported(PHYSDEV(0));
+
+	if (ref->descriptor_indexing) {
+		extensions[ext_count++] = BINDLESS_EXTENSION_NAME;
+
+		indexing_features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		indexing_features.descriptorBindingPartiallyBound = VK_TRUE;
+		indexing_features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		indexing_features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+
+		device_info.pNext = &indexing_features;
+	}
+
+	/**
+	 * Per barrier stage masks, see barrier.h.
+	 */
+
+	VkPhysicalDeviceSynchronization2FeaturesKHR sync2_features = {};
+	sync2_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+
+	ref->synchronization2 = barrier_sync2_supported(PHYSDEV(0));
+
+	if (ref->synchronization2) {
+		extensions[ext_count++] = BARRIER_SYNC2_EXTENSION_NAME;
+
+		sync2_features.synchronization2 = VK_TRUE;
+		sync2_features.pNext = (void *) device_info.pNext;
+
+		device_info.pNext = &sync2_features;
+	}
+
+	device_info.enabledExtensionCount = ext_count;
+	device_info.ppEnabledExtensionNames = ext_count > 0 ? extensions : NULL;
 
 	if (enable_validation_layers) {
 		device_info.enabledLayerCount = 1;
@@ -954,14 +1794,37 @@ void init_logical_device(struct _application *ref)
 		device_info.enabledLayerCount = 0;
 	}
 
-	res = vkCreateDevice(PHYSDEV(0), &device_info, NULL, &ref->device);
+	res = vkCreateDevice(PHYSDEV(0), &device_info, HOST_ALLOC(DEVICE), &ref->device);
 	if (res != VK_SUCCESS) {
 		fprintf(stderr, "ERR: failed to initialize a logical device\n // Assertion: `vkCreateDevice != VK_SUCCESS`\n");
 		exit(EXIT_FAILURE);
 	}
 
+	if (ref->synchronization2) {
+		ref->cmd_pipeline_barrier2 = (PFN_vkCmdPipelineBarrier2KHR) vkGetDeviceProcAddr(ref->device, "vkCmdPipelineBarrier2KHR");
+		ref->synchronization2 = ref->cmd_pipeline_barrier2 != NULL;
+	}
+
+	ref->mem_budget = malloc(sizeof(mem_budget_t));
+	init_mem_budget(ref, ref->mem_budget, ext_budget);
+
+	if (ref->headless) {
+		vkGetDeviceQueue(ref->device, indices.compute_family, 0, &ref->compute_queue);
+
+		ref->graphics_queue = ref->compute_queue;
+		ref->present_queue = VK_NULL_HANDLE;
+		ref->graphics_queue_family_index = indices.compute_family;
+		ref->compute_queue_family_index = indices.compute_family;
+
+		return;
+	}
+
 	vkGetDeviceQueue(ref->device, indices.graphics_family, 0, &ref->graphics_queue);
 	vkGetDeviceQueue(ref->device, indices.present_family, 0, &ref->present_queue);
+
+	ref->compute_queue = ref->graphics_queue;
+	ref->graphics_queue_family_index = indices.graphics_family;
+	ref->compute_queue_family_index = indices.graphics_family;
 }
 
 
@@ -974,9 +1837,10 @@ void create_command_pool(struct _application *ref)
 
 	VkCommandPoolCreateInfo commandpool_ci = {};
 	commandpool_ci.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-	commandpool_ci.queueFamilyIndex = queue_family_indices.graphics_family;
+	commandpool_ci.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	commandpool_ci.queueFamilyIndex = ref->headless ? queue_family_indices.compute_family : queue_family_indices.graphics_family;
 
-	VkResult res = vkCreateCommandPool(ref->device, &commandpool_ci, NULL, &ref->cmd_pool);
+	VkResult res = vkCreateCommandPool(ref->device, &commandpool_ci, HOST_ALLOC(COMMAND_POOL), &ref->cmd_pool);
 	if (res != VK_SUCCESS) {
 		fprintf(stderr, "ERR: failed to initialize command buffer\n // Assertion: `vkCreateCommandPool != VK_SUCCESS`\n");
 		exit(EXIT_FAILURE);
@@ -988,6 +1852,8 @@ void create_command_pool(struct _application *ref)
  */
 void create_command_buffers(struct _application *ref)
 {
+	ref->cmd_buffers_dirty = false;
+
 	array_init(&ref->cmd_buffers, sizeof(VkCommandBuffer));
 	array_resize(&ref->cmd_buffers, array_size(&ref->swapc_framebuffers), true);
 
@@ -1018,42 +1884,30 @@ void create_command_buffers(struct _application *ref)
 			exit(EXIT_FAILURE);
 		}
 
-		VkOffset2D offset = {0, 0};
-		VkClearValue clear_color;
-
-		VkClearColorValue cc_val = {0.0f, 0.0f, 0.0f, 1.0f};
-
-		clear_color.color = cc_val;
+		/**
+		 * Bind this image's resources and record the compiled frame.
+		 */
 
-		VkClearDepthStencilValue cds_val = {1.0f, 0};
+		rg_set_image(ref->render_graph, ref->rg_backbuffer, arr_get(ref->swapc_imgs, VkImage, i), arr_get(ref->swapc_img_views, VkImageView, i));
 
-		VkClearValue depth_stencil;
-		depth_stencil.depthStencil = cds_val;
-
-		VkClearValue clear_vals[2] = {clear_color, depth_stencil};
-
-		VkRenderPassBeginInfo render_pass_bi = {};
-		render_pass_bi.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		render_pass_bi.renderPass = ref->render_pass;
-		render_pass_bi.framebuffer = arr_get(ref->swapc_framebuffers, VkFramebuffer, i);
-		render_pass_bi.renderArea.offset = offset;
-		render_pass_bi.renderArea.extent = ref->swapc_extent;
+		if (ref->meshlet_cull) {
+			rg_set_buffer(ref->render_graph, ref->rg_cull_indices, ((compute_buffer_t *) array_data(&ref->meshlet_cull->index_buffers))[i].buffer);
+			rg_set_buffer(ref->render_graph, ref->rg_cull_indirect, ((compute_buffer_t *) array_data(&ref->meshlet_cull->indirect_buffers))[i].buffer);
+		}
 
-		render_pass_bi.clearValueCount = 2;
-		render_pass_bi.pClearValues = clear_vals;
+		gpu_timer_reset(ref->gpu_timer, arr_get(ref->cmd_buffers, VkCommandBuffer, i), i);
 
-		vkCmdBeginRenderPass(arr_get(ref->cmd_buffers, VkCommandBuffer, i), &render_pass_bi, VK_SUBPASS_CONTENTS_INLINE);
-		vkCmdBindPipeline(arr_get(ref->cmd_buffers, VkCommandBuffer, i), VK_PIPELINE_BIND_POINT_GRAPHICS, ref->graphics_pipeline);
+		/**
+		 * One pair around the whole frame, culling and pre-pass included,
+		 * for the GPU frame time.
+		 */
 
-		VkBuffer vertex_buffers[] = { ref->vertex_buffer };
-		VkDeviceSize offsets[] = {0}; 
-		vkCmdBindVertexBuffers(arr_get(ref->cmd_buffers, VkCommandBuffer, i), 0, 1, vertex_buffers, offsets);
-		vkCmdBindIndexBuffer(arr_get(ref->cmd_buffers, VkCommandBuffer, i), ref->index_buffer, 0, VK_INDEX_TYPE_UINT16);
+		uint32_t frame_slot = gpu_timer_begin(ref->gpu_timer, arr_get(ref->cmd_buffers, VkCommandBuffer, i), i,
+			gpu_timer_scope(ref->gpu_timer, "frame"), false);
 
-		vkCmdBindDescriptorSets(arr_get(ref->cmd_buffers, VkCommandBuffer, i), VK_PIPELINE_BIND_POINT_GRAPHICS, ref->pipeline_layout, 0, 1, &((VkDescriptorSet *) array_data(&ref->descriptor_sets))[i], 0, NULL);
+		rg_execute(ref, ref->render_graph, arr_get(ref->cmd_buffers, VkCommandBuffer, i), i);
 
-		vkCmdDrawIndexed(arr_get(ref->cmd_buffers, VkCommandBuffer, i), (uint32_t) (sizeof(indices) / sizeof(indices[0])), 1, 0, 0, 0);
-		vkCmdEndRenderPass(arr_get(ref->cmd_buffers, VkCommandBuffer, i));
+		gpu_timer_end(ref->gpu_timer, arr_get(ref->cmd_buffers, VkCommandBuffer, i), i, frame_slot);
 
 		res = vkEndCommandBuffer(arr_get(ref->cmd_buffers, VkCommandBuffer, i));
 		if (res != VK_SUCCESS) {
@@ -1066,95 +1920,53 @@ void create_command_buffers(struct _application *ref)
 }
 
 /**
- *	Initialize image views for images to be accessed in graphics pipeline
+ *	Record the command buffers again, for when what they bind changed but
+ *	the swapchain did not.
  */
-void init_image_views(struct _application *ref)
+void rerecord_command_buffers(struct _application *ref)
 {
+	vkDeviceWaitIdle(ref->device);
 
-	array_init(&ref->swapc_img_views, sizeof(VkImageView));
-	array_resize(&ref->swapc_img_views, array_size(&ref->swapc_imgs), true);
-
-	VkImageView tmp[array_size(&ref->swapc_imgs)];
-
-	for (int i = 0; i < array_size(&ref->swapc_imgs); i++) {
-		VkImageViewCreateInfo ci = {};
-		ci.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-		ci.image = arr_get(ref->swapc_imgs, VkImage, i);
-		ci.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		ci.format = ref->swapc_img_format;
-
-		ci.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-		ci.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-		ci.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-		ci.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-
-		ci.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		ci.subresourceRange.baseMipLevel = 0;
-		ci.subresourceRange.levelCount = 1;
-		ci.subresourceRange.baseArrayLayer = 0;
-		ci.subresourceRange.layerCount = 1;
+	vkFreeCommandBuffers(ref->device, ref->cmd_pool, (uint32_t) array_size(&ref->cmd_buffers), (VkCommandBuffer *) array_data(&ref->cmd_buffers));
+	array_free(&ref->cmd_buffers);
 
-		VkResult res = vkCreateImageView(ref->device, &ci, NULL, &((VkImageView *) array_data(&ref->swapc_img_views))[i]);
-		if (res != VK_SUCCESS) {
-			fprintf(stderr, "ERR: failed to initialize image views\n // Assertion: `vkCreateImageView != VK_SUCCESS`\n");
-			exit(EXIT_FAILURE);
-		}
-	}
+	create_command_buffers(ref);
 }
 
 /**
- *	Create a shader module from a SPIR-V binary file.
+ *	Initialize image views for images to be accessed in graphics pipeline
  */
-void create_shader_from_file(const char *file_path, VkShaderModule *shader, VkDevice dev)
+void init_image_views(struct _application *ref)
 {
-	VkResult res;
-
-	void *code = NULL;
-
-	size_t size = 0;
-	size_t cur = 0;
-
-	FILE *f_in = fopen(file_path, "rb");
-
-	*shader = NULL;
-
-	if (f_in == NULL) {
-		fprintf(stderr, "ERR: failed to read shader file\n // Assertion: `shader_file != NULL`\n");
-		exit(EXIT_FAILURE);
-	}
 
-	fseek(f_in, 0, SEEK_END);
-	size = ftell(f_in);
-	fseek(f_in, 0, SEEK_SET);
-
-	code = malloc(size);
-	if (code == NULL) {
-		fprintf(stderr, "ERR: failed to read shader file\n // Assertion: `malloc != NULL`\n");
-		exit(EXIT_FAILURE);
-	}
-
-	while(cur < size) {
-
-		size_t read = fread(code + cur, 1, size - cur, f_in);
-		if (read == 0) {
-			fprintf(stderr, "ERR: failed to read shader file\n // Assertion: `read != 0`\n");
-			exit(EXIT_FAILURE);
-		}
+	array_init(&ref->swapc_img_views, sizeof(VkImageView));
+	array_resize(&ref->swapc_img_views, array_size(&ref->swapc_imgs), true);
 
-		cur += read;
-	}
+	VkImageView tmp[array_size(&ref->swapc_imgs)];
 
-	VkShaderModuleCreateInfo shader_ci = {};
+	for (int i = 0; i < array_size(&ref->swapc_imgs); i++) {
+		VkImageViewCreateInfo ci = {};
+		ci.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		ci.image = arr_get(ref->swapc_imgs, VkImage, i);
+		ci.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		ci.format = ref->swapc_img_format;
 
-	shader_ci.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	shader_ci.codeSize = size;
-	shader_ci.pCode = code;
+		ci.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+		ci.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+		ci.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+		ci.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
 
+		ci.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		ci.subresourceRange.baseMipLevel = 0;
+		ci.subresourceRange.levelCount = 1;
+		ci.subresourceRange.baseArrayLayer = 0;
+		ci.subresourceRange.layerCount = 1;
 
-	res = vkCreateShaderModule(dev, &shader_ci, NULL, shader);
-	if (res != VK_SUCCESS) {
-		fprintf(stderr, "ERR: failed to initialize image views\n // Assertion: `vkCreateImageView != VK_SUCCESS`\n");
-		exit(EXIT_FAILURE);
+		VkResult res = vkCreateImageView(ref->device, &ci, HOST_ALLOC(IMAGE_VIEW), &((VkImageView *) array_data(&ref->swapc_img_views))[i]);
+		if (res != VK_SUCCESS) {
+			fprintf(stderr, "ERR: failed to initialize image views\n // Assertion: `vkCreateImageView != VK_SUCCESS`\n");
+			exit(EXIT_FAILURE);
+		}
 	}
 }
 
@@ -1163,8 +1975,6 @@ void create_shader_from_file(const char *file_path, VkShaderModule *shader, VkDe
  */
 void create_renderpass(struct _application *ref)
 {
-	VkResult res;
-
 	VkAttachmentDescription color_attachment = {};
 	color_attachment.format = ref->swapc_img_format;
 	color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -1172,13 +1982,18 @@ void create_renderpass(struct _application *ref)
 	color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 	color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	color_attachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	color_attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
 	VkAttachmentReference color_attachment_ref = {};
 	color_attachment_ref.attachment = 0;
 	color_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+	/**
+	 * Depth is a transient of the render graph, lazily allocated: it is
+	 * cleared on load and never stored, so it can stay in tile memory.
+	 */
+
 	VkAttachmentDescription depth_attachment = {};
 	depth_attachment.format = find_depth_format(ref);
 	depth_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -1186,7 +2001,7 @@ void create_renderpass(struct _application *ref)
 	depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	depth_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	depth_attachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 	depth_attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
 	VkAttachmentReference depth_attachment_ref = {};
@@ -1199,13 +2014,10 @@ void create_renderpass(struct _application *ref)
 	subpass.pColorAttachments = &color_attachment_ref;
 	subpass.pDepthStencilAttachment = &depth_attachment_ref;
 
-	VkSubpassDependency dependency = {};
-	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-	dependency.dstSubpass = 0;
-	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.srcAccessMask = 0;
-	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	/**
+	 * Layout transitions and the wait for the acquired image are barriers
+	 * the render graph places around the pass, see `create_render_graph()`.
+	 */
 
 	VkAttachmentDescription attachments[2] = {color_attachment, depth_attachment};
 
@@ -1215,14 +2027,15 @@ void create_renderpass(struct _application *ref)
 	render_pass_ci.pAttachments = attachments;
 	render_pass_ci.subpassCount = 1;
 	render_pass_ci.pSubpasses = &subpass;
-	render_pass_ci.dependencyCount = 1;
-	render_pass_ci.pDependencies = &dependency;
+	render_pass_ci.dependencyCount = 0;
+	render_pass_ci.pDependencies = NULL;
 
-	res = vkCreateRenderPass(ref->device, &render_pass_ci, NULL, &ref->render_pass);
-	if (res != VK_SUCCESS) {
-		fprintf(stderr, "ERR: failed to initialize render pass\n // Assertion: `vkCreateImageView != VK_SUCCESS`\n");
-		exit(EXIT_FAILURE);
-	}
+	/**
+	 * Unchanged formats on swapchain recreation get back the render pass
+	 * `cleanup_swapchain()` released, the pipelines stay compatible.
+	 */
+
+	ref->render_pass = vk_cache_render_pass(ref, ref->vk_cache, &render_pass_ci);
 }
 
 uint32_t find_memory_type(struct _application *ref, uint32_t type_filter, VkMemoryPropertyFlags properties)
@@ -1239,6 +2052,28 @@ uint32_t find_memory_type(struct _application *ref, uint32_t type_filter, VkMemo
 	return VK_NULL_HANDLE;
 }
 
+/**
+ *	Memory type for images created with `VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT`:
+ *	lazily allocated when the device has such a type, tile based GPUs then
+ *	never commit memory for attachments that stay in tile memory, device
+ *	local otherwise.
+ */
+uint32_t find_transient_memory_type(struct _application *ref, uint32_t type_filter)
+{
+	VkMemoryPropertyFlags lazy = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+
+	VkPhysicalDeviceMemoryProperties mem_props;
+	vkGetPhysicalDeviceMemoryProperties(PHYSDEV(0), &mem_props);
+
+	for (uint32_t i = 0; i < mem_props.memoryTypeCount; i++) {
+		if ((type_filter & (1 << i)) && (mem_props.memoryTypes[i].propertyFlags & lazy) == lazy) {
+			return i;
+		}
+	}
+
+	return find_memory_type(ref, type_filter, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
 
 /*
  *	Utility function for beginning command buffer record.
@@ -1282,88 +2117,42 @@ void end_single_time_commands(struct _application *ref, VkCommandBuffer command_
 }
 
 /*
- *	Transition image's layout from old param to new
- *	and seup `PipelineStageFlag`s
+ *	Transition image's layout from old param to new, waiting for the
+ *	typical use of each layout (see `barrier_layout_state()`). Records and
+ *	submits its own command buffer, batch barriers into an existing one
+ *	with barrier.h instead.
  */
 void transition_image_layout(struct _application *ref, VkImage image, VkFormat format, VkImageLayout old_layout, VkImageLayout new_layout)
 {
-	VkCommandBuffer command_buffer = begin_single_time_commands(ref);
-
-	VkImageMemoryBarrier barrier = {};
-	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-	barrier.oldLayout = old_layout;
-	barrier.newLayout = new_layout;
+	VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
 
-	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-	barrier.image = image;
-	
-	if (new_layout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
-		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+	if (new_layout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL || new_layout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL) {
+		aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
 
 		if (has_stencil_component(format)) {
-			barrier.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
-		}
-		else {
-			barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			aspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
 		}
 	}
 
-	barrier.subresourceRange.baseMipLevel = 0;
-	barrier.subresourceRange.levelCount = 1;
-	barrier.subresourceRange.baseArrayLayer = 0;
-	barrier.subresourceRange.layerCount = 1;
-
-	VkPipelineStageFlags src_stage;
-	VkPipelineStageFlags dst_stage;
-
-	if (old_layout == VK_IMAGE_LAYOUT_UNDEFINED && new_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-		barrier.srcAccessMask = 0;
-		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	VkCommandBuffer command_buffer = begin_single_time_commands(ref);
 
-		src_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-		dst_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-	}
-	else if (old_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && new_layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barrier_batch_t batch;
+	init_barrier_batch(&batch);
 
-		src_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-		dst_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-	}
-	else if (old_layout == VK_IMAGE_LAYOUT_UNDEFINED && new_layout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
-		barrier.srcAccessMask = 0;
-		barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	barrier_image_layout(&batch, image, aspect, old_layout, new_layout);
+	barrier_flush(ref, &batch, command_buffer);
 
-		src_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-		dst_stage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-	}
-	else {
-		fprintf(stderr, "Err: Unsupported layout transition\n");
-		exit(EXIT_FAILURE);
-	}
+	destroy_barrier_batch(&batch);
 
-	vkCmdPipelineBarrier(
-		command_buffer,
-		src_stage, dst_stage,
-		0,
-		0, NULL,
-		0, NULL,
-		1, &barrier
-	);
-	
 	end_single_time_commands(ref, command_buffer);
-
 }
 
 /*
- *	Copy `VkBuffer` of image data to a `VkImage`
+ *	Record the copy of a tightly packed `VkBuffer` into mip 0 of a `VkImage`
+ *	in TRANSFER_DST_OPTIMAL layout.
  */
-void copy_buffer_to_image(struct _application *ref, VkBuffer buffer, VkImage image, uint32_t x, uint32_t y)
+void cmd_copy_buffer_to_image(VkCommandBuffer command_buffer, VkBuffer buffer, VkImage image, uint32_t x, uint32_t y)
 {
-	VkCommandBuffer command_buffer = begin_single_time_commands(ref);
-
 	VkBufferImageCopy region = {};
 	region.bufferOffset = 0;
 	region.bufferRowLength = 0;
@@ -1381,6 +2170,16 @@ void copy_buffer_to_image(struct _application *ref, VkBuffer buffer, VkImage ima
 	region.imageExtent = ext;
 
 	vkCmdCopyBufferToImage(command_buffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+}
+
+/*
+ *	Copy `VkBuffer` of image data to a `VkImage`
+ */
+void copy_buffer_to_image(struct _application *ref, VkBuffer buffer, VkImage image, uint32_t x, uint32_t y)
+{
+	VkCommandBuffer command_buffer = begin_single_time_commands(ref);
+
+	cmd_copy_buffer_to_image(command_buffer, buffer, image, x, y);
 
 	end_single_time_commands(ref, command_buffer);
 }
@@ -1413,7 +2212,7 @@ void create_buffer(struct _application *ref, VkDeviceSize size, VkBufferUsageFla
 	buffer_info.usage = usage;
 	buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-	res = vkCreateBuffer(ref->device, &buffer_info, NULL, buffer);
+	res = vkCreateBuffer(ref->device, &buffer_info, HOST_ALLOC(BUFFER), buffer);
 	if (res != VK_SUCCESS) {
 		fprintf(stderr, "ERR: failed to create buffer\n // Assertion: `vkCreateBuffer != VK_SUCCESS`\n");
 		exit(EXIT_FAILURE);
@@ -1427,7 +2226,7 @@ void create_buffer(struct _application *ref, VkDeviceSize size, VkBufferUsageFla
 	alloc_info.allocationSize = mem_req.size;
 	alloc_info.memoryTypeIndex = find_memory_type(ref, mem_req.memoryTypeBits, props);
 
-	res = vkAllocateMemory(ref->device, &alloc_info, NULL, buffer_mem);
+	res = allocate_with_fallback(ref, &alloc_info, mem_req.memoryTypeBits, props, buffer_mem);
 	if (res != VK_SUCCESS) {
 		fprintf(stderr, "ERR: failed to allocate buffer memory\n // Assertion: `vkAllocateMemory != VK_SUCCESS`\n");
 		exit(EXIT_FAILURE);
@@ -1436,12 +2235,86 @@ void create_buffer(struct _application *ref, VkDeviceSize size, VkBufferUsageFla
 	vkBindBufferMemory(ref->device, *buffer, *buffer_mem, 0);
 }
 
+/**
+ *	Load `ref->model_path` into `ref->mesh`, or fall back to the built-in
+ *	quads. Loaded models are optimized, and the vertex format is picked
+ *	here as the graphics pipeline depends on it.
+ */
+void load_mesh(struct _application *ref)
+{
+	ref->mesh = malloc(sizeof(mesh_t));
+	init_mesh(ref->mesh);
+
+	if (!ref->model_path) {
+		mesh_add(ref->mesh, "quads", vertices, sizeof(vertices) / sizeof(vertices[0]), indices, sizeof(indices) / sizeof(indices[0]));
+	}
+	else {
+		if (!mesh_load(ref->mesh, ref->model_path) || array_size(&ref->mesh->submeshes) == 0) {
+			fprintf(stderr, "ERR: failed to load model `%s`\n // Assertion: `mesh_load() == true`\n", ref->model_path);
+			exit(EXIT_FAILURE);
+		}
+
+		printf("Loaded `%s`: %d submeshes, %d vertices, %d triangles\n", ref->model_path,
+			array_size(&ref->mesh->submeshes), array_size(&ref->mesh->vertices), array_size(&ref->mesh->indices) / 3);
+
+		mesh_optimize(ref->mesh);
+		mesh_generate_lods(ref->mesh);
+	}
+
+	if (!ref->full_vertices && mesh_can_pack(ref->mesh)) {
+		ref->vertex_format = VERTEX_FORMAT_PACKED;
+	}
+
+	printf("Vertex format: %s, %zu bytes per vertex\n", ref->vertex_format == VERTEX_FORMAT_PACKED ? "packed" : "full",
+		ref->vertex_format == VERTEX_FORMAT_PACKED ? sizeof(packed_vertex_t) : sizeof(vertex_t));
+}
+
 /*
  *	Create vertex buffer to be sent to GPU memory
  */
-void create_vertex_buffer(struct _application *ref)
+handle_t create_vertex_buffer(struct _application *ref)
 {
-	VkDeviceSize buffer_size = sizeof(vertices);
+	bool packed = ref->vertex_format == VERTEX_FORMAT_PACKED;
+
+	VkDeviceSize buffer_size = (packed ? sizeof(packed_vertex_t) : sizeof(vertex_t)) * array_size(&ref->mesh->vertices);
+
+	VkBuffer staging_buffer;
+	VkDeviceMemory staging_buffer_memory;
+	create_buffer(ref, buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &staging_buffer, &staging_buffer_memory);
+
+	void *data;
+	vkMapMemory(ref->device, staging_buffer_memory, 0, buffer_size, 0, &data);
+
+	if (packed) {
+		mesh_pack_vertices(ref->mesh, (packed_vertex_t *) data);
+	}
+	else {
+		memcpy(data, array_data(&ref->mesh->vertices), (size_t) buffer_size);
+	}
+
+	vkUnmapMemory(ref->device, staging_buffer_memory);
+
+	handle_t vertex_buffer = resource_create_buffer(ref, ref->resources, buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	copy_buffer(ref, staging_buffer, resource_buffer(ref->resources, vertex_buffer), buffer_size);
+
+	vkDestroyBuffer(ref->device, staging_buffer, HOST_ALLOC(BUFFER));
+	mem_budget_free(ref, staging_buffer_memory);
+
+	return vertex_buffer;
+}
+
+/**
+ *	Positions of the vertex buffer on their own, for the depth pre-pass: 8
+ *	byte snorm16 positions when packed, 12 byte floats otherwise. Indices
+ *	address both buffers the same.
+ */
+handle_t create_position_buffer(struct _application *ref)
+{
+	bool packed = ref->vertex_format == VERTEX_FORMAT_PACKED;
+	uint32_t vertex_count = (uint32_t) array_size(&ref->mesh->vertices);
+
+	VkDeviceSize buffer_size = (packed ? sizeof(int16_t) * 4 : sizeof(vec3)) * vertex_count;
 
 	VkBuffer staging_buffer;
 	VkDeviceMemory staging_buffer_memory;
@@ -1449,14 +2322,35 @@ void create_vertex_buffer(struct _application *ref)
 
 	void *data;
 	vkMapMemory(ref->device, staging_buffer_memory, 0, buffer_size, 0, &data);
-	memcpy(data, vertices, (size_t) buffer_size);
+
+	if (packed) {
+		packed_vertex_t *packed_vertices = malloc(sizeof(packed_vertex_t) * vertex_count);
+		mesh_pack_vertices(ref->mesh, packed_vertices);
+
+		for (uint32_t i = 0; i < vertex_count; i++) {
+			memcpy((int16_t *) data + i * 4, packed_vertices[i].pos, sizeof(int16_t) * 4);
+		}
+
+		free(packed_vertices);
+	}
+	else {
+		const vertex_t *vertices = (const vertex_t *) array_data(&ref->mesh->vertices);
+
+		for (uint32_t i = 0; i < vertex_count; i++) {
+			memcpy((float *) data + i * 3, vertices[i].pos, sizeof(vec3));
+		}
+	}
+
 	vkUnmapMemory(ref->device, staging_buffer_memory);
 
-	create_buffer(ref, buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &ref->vertex_buffer, &ref->vertex_buffer_memory);
-	copy_buffer(ref, staging_buffer, ref->vertex_buffer, buffer_size);
+	handle_t position_buffer = resource_create_buffer(ref, ref->resources, buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	copy_buffer(ref, staging_buffer, resource_buffer(ref->resources, position_buffer), buffer_size);
+
+	vkDestroyBuffer(ref->device, staging_buffer, HOST_ALLOC(BUFFER));
+	mem_budget_free(ref, staging_buffer_memory);
 
-	vkDestroyBuffer(ref->device, staging_buffer, NULL);
-	vkFreeMemory(ref->device, staging_buffer_memory, NULL);
+	return position_buffer;
 }
 
 /*
@@ -1481,14 +2375,63 @@ void create_uniform_buffers(struct _application *ref)
 			&((VkDeviceMemory *) array_data(&ref->uniform_buffers_memory))[i]
 		);
 	}
+
+	VkDeviceSize draws_size = sizeof(VkDrawIndexedIndirectCommand) * array_size(&ref->mesh->submeshes) * ref->mesh->lod_count;
+
+	array_init(&ref->lod_draw_buffers, sizeof(VkBuffer));
+	array_resize(&ref->lod_draw_buffers, array_size(&ref->swapc_imgs), true);
+
+	array_init(&ref->lod_draw_buffers_memory, sizeof(VkDeviceMemory));
+	array_resize(&ref->lod_draw_buffers_memory, array_size(&ref->swapc_imgs), true);
+
+	for (size_t i = 0; i < array_size(&ref->swapc_imgs); i++) {
+		create_buffer(
+			ref,
+			draws_size,
+			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&((VkBuffer *) array_data(&ref->lod_draw_buffers))[i],
+			&((VkDeviceMemory *) array_data(&ref->lod_draw_buffers_memory))[i]
+		);
+	}
+
+	/**
+	 * Instance matrices, followed by the instance texture ids, are rewritten
+	 * every frame, keep them mapped.
+	 */
+
+	VkDeviceSize instances_size = (sizeof(mat4) + sizeof(uint32_t)) * ref->instance_count;
+
+	array_init(&ref->instance_buffers, sizeof(VkBuffer));
+	array_resize(&ref->instance_buffers, array_size(&ref->swapc_imgs), true);
+
+	array_init(&ref->instance_buffers_memory, sizeof(VkDeviceMemory));
+	array_resize(&ref->instance_buffers_memory, array_size(&ref->swapc_imgs), true);
+
+	array_init(&ref->instance_mapped, sizeof(void *));
+	array_resize(&ref->instance_mapped, array_size(&ref->swapc_imgs), true);
+
+	for (size_t i = 0; i < array_size(&ref->swapc_imgs); i++) {
+		create_buffer(
+			ref,
+			instances_size,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&((VkBuffer *) array_data(&ref->instance_buffers))[i],
+			&((VkDeviceMemory *) array_data(&ref->instance_buffers_memory))[i]
+		);
+
+		vkMapMemory(ref->device, ((VkDeviceMemory *) array_data(&ref->instance_buffers_memory))[i], 0, VK_WHOLE_SIZE, 0, &((void **) array_data(&ref->instance_mapped))[i]);
+	}
 }
 
 /*
  *	Create uniform buffers to be used in runtime.
  */
-void create_index_buffer(struct _application *ref)
+handle_t create_index_buffer(struct _application *ref)
 {
-	VkDeviceSize buffer_size = sizeof(indices);
+	bool short_indices = mesh_index_type(ref->mesh) == VK_INDEX_TYPE_UINT16;
+	uint32_t index_count = (uint32_t) array_size(&ref->mesh->indices);
+
+	VkDeviceSize buffer_size = (VkDeviceSize) index_count * (short_indices ? sizeof(uint16_t) : sizeof(uint32_t));
 
 	VkBuffer staging_buffer;
 	VkDeviceMemory staging_buffer_memory;
@@ -1496,30 +2439,97 @@ void create_index_buffer(struct _application *ref)
 
 	void *data;
 	vkMapMemory(ref->device, staging_buffer_memory, 0, buffer_size, 0, &data);
-	memcpy(data, indices, (size_t) buffer_size);
+
+	/**
+	 * Indices are relative to their submesh, narrowing them is lossless
+	 * whenever `mesh_index_type()` allows it.
+	 */
+
+	if (short_indices) {
+		const uint32_t *src = (const uint32_t *) array_data(&ref->mesh->indices);
+
+		for (uint32_t i = 0; i < index_count; i++) {
+			((uint16_t *) data)[i] = (uint16_t) src[i];
+		}
+	}
+	else {
+		memcpy(data, array_data(&ref->mesh->indices), (size_t) buffer_size);
+	}
+
 	vkUnmapMemory(ref->device, staging_buffer_memory);
 
-	create_buffer(ref, buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &ref->index_buffer, &ref->index_buffer_memory);
+	handle_t index_buffer = resource_create_buffer(ref, ref->resources, buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-	copy_buffer(ref, staging_buffer, ref->index_buffer, buffer_size);
+	copy_buffer(ref, staging_buffer, resource_buffer(ref->resources, index_buffer), buffer_size);
 
-	vkDestroyBuffer(ref->device, staging_buffer, NULL);
-	vkFreeMemory(ref->device, staging_buffer_memory, NULL);
+	vkDestroyBuffer(ref->device, staging_buffer, HOST_ALLOC(BUFFER));
+	mem_budget_free(ref, staging_buffer_memory);
 
+	return index_buffer;
 }
 
 /**
- *	Create the needed graphics pipeline stuff.
+ *	Bindless textures sample from set 1 with their own fragment shader.
  */
-void create_graphics_pipeline(struct _application *ref)
+static const char *scene_frag_path(struct _application *ref)
 {
-	VkResult res;
+	if (ref->bindless) {
+		return ref->bindless->mode == BINDLESS_DESCRIPTOR_INDEXING ? SHADER_PATH("hellotriangle_bindless.frag", "frag_bindless.spv") :
+			SHADER_PATH("hellotriangle_array.frag", "frag_array.spv");
+	}
+
+	return SHADER_PATH("hellotriangle.frag", "frag.spv");
+}
 
+/**
+ *	Everything the scene pipelines are built from, captured on the main
+ *	thread by `get_scene_pipeline_state()`. Also the key state of the
+ *	scene variants.
+ */
+typedef struct _scene_pipeline_state_t
+{
+	VkRenderPass render_pass;
+	VkPipelineLayout layout;
 	VkShaderModule vert;
 	VkShaderModule frag;
+	VkShaderModule depth_vert;
+	VkExtent2D extent;
+	int32_t vertex_format;
+	uint32_t depth_prepass;
+}
+scene_pipeline_state_t;
+
+static void get_scene_pipeline_state(struct _application *ref, scene_pipeline_state_t *state)
+{
+	memset(state, 0, sizeof(scene_pipeline_state_t));
+
+	state->render_pass = ref->render_pass;
+	state->layout = ref->pipeline_layout;
+	state->vert = shader_cache_get(ref, ref->shaders, SHADER_PATH("hellotriangle.vert", "vert.spv"));
+	state->frag = shader_cache_get(ref, ref->shaders, scene_frag_path(ref));
+	state->extent = ref->swapc_extent;
+	state->vertex_format = ref->vertex_format;
+	state->depth_prepass = ref->depth_prepass;
+
+	if (ref->depth_prepass) {
+		state->depth_vert = shader_cache_get(ref, ref->shaders, SHADER_PATH("depth_prepass.vert", "depth_vert.spv"));
+	}
+}
 
-	create_shader_from_file("shaders/vert.spv", &vert, ref->device);
-	create_shader_from_file("shaders/frag.spv", &frag, ref->device);
+/**
+ *	Build the scene pipeline, its fragment shader specialized by
+ *	`frag_spec` (NULL keeps the defaults), and the depth pre-pass pipeline
+ *	when `depth_pipeline` is given. Also runs on the variant cache workers:
+ *	reads nothing of `ref` but the device, the rest comes from `state`.
+ */
+static void build_scene_pipelines(struct _application *ref, const scene_pipeline_state_t *state, const VkSpecializationInfo *frag_spec,
+	VkPipeline *pipeline, VkPipeline *depth_pipeline)
+{
+	VkResult res;
+
+	VkShaderModule vert = state->vert;
+	VkShaderModule frag = state->frag;
 
 	VkPipelineShaderStageCreateInfo vert_shader_stage_ci = {};
 
@@ -1534,13 +2544,15 @@ void create_graphics_pipeline(struct _application *ref)
 	frag_shader_stage_ci.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
 	frag_shader_stage_ci.module = frag;
 	frag_shader_stage_ci.pName = "main";
+	frag_shader_stage_ci.pSpecializationInfo = frag_spec;
 
 	VkPipelineShaderStageCreateInfo shader_stages[] = {vert_shader_stage_ci, frag_shader_stage_ci};
 
 	VkPipelineVertexInputStateCreateInfo vert_input_info = {};
 
-	VkVertexInputBindingDescription bind_desc = get_binding_description();
-	array attrib_desc = get_attribute_description();
+	VkVertexInputBindingDescription bind_desc[3];
+	get_binding_descriptions(state->vertex_format, bind_desc);
+	array attrib_desc = get_attribute_description(state->vertex_format);
 
 	VkVertexInputAttributeDescription attr_tmp[array_size(&attrib_desc)];
 	for (int i = 0; i < array_size(&attrib_desc); i++) {
@@ -1548,9 +2560,9 @@ void create_graphics_pipeline(struct _application *ref)
 	}
 
 	vert_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vert_input_info.vertexBindingDescriptionCount = 1;
+	vert_input_info.vertexBindingDescriptionCount = 3;
 	vert_input_info.vertexAttributeDescriptionCount = (uint32_t) array_size(&attrib_desc);
-	vert_input_info.pVertexBindingDescriptions = &bind_desc;
+	vert_input_info.pVertexBindingDescriptions = bind_desc;
 	vert_input_info.pVertexAttributeDescriptions = attr_tmp;
 
 	VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
@@ -1562,8 +2574,8 @@ void create_graphics_pipeline(struct _application *ref)
 	VkViewport viewport = {};
 	viewport.x = 0.0f;
 	viewport.y = 0.0f;
-	viewport.width = (float) ref->swapc_extent.width;
-	viewport.height = (float) ref->swapc_extent.height;
+	viewport.width = (float) state->extent.width;
+	viewport.height = (float) state->extent.height;
 	viewport.minDepth = 0.0f;
 	viewport.maxDepth = 1.0f;
 
@@ -1571,7 +2583,7 @@ void create_graphics_pipeline(struct _application *ref)
 
 	VkRect2D scissor = {};
 	scissor.offset = offset;
-	scissor.extent = ref->swapc_extent;
+	scissor.extent = state->extent;
 
 	VkPipelineViewportStateCreateInfo viewport_state = {};
 
@@ -1631,17 +2643,6 @@ void create_graphics_pipeline(struct _application *ref)
 	color_blending.blendConstants[2] = 0.0f;
 	color_blending.blendConstants[3] = 0.0f;
 
-	VkPipelineLayoutCreateInfo pipeline_layout_ci = {};
-	pipeline_layout_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipeline_layout_ci.setLayoutCount = 1;
-	pipeline_layout_ci.pSetLayouts = &ref->descriptor_set_layout;
-
-	res = vkCreatePipelineLayout(ref->device, &pipeline_layout_ci, NULL, &ref->pipeline_layout);
-	if (res != VK_SUCCESS) {
-		fprintf(stderr, "ERR: failed to initialize fixed pipeline layout\n // Assertion: `vkCreatePipelineLayout != VK_SUCCESS`\n");
-		exit(EXIT_FAILURE);
-	}
-
 	VkPipelineDepthStencilStateCreateInfo depth_stencil = {};
 	depth_stencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
 	depth_stencil.depthTestEnable = VK_TRUE;
@@ -1649,6 +2650,16 @@ void create_graphics_pipeline(struct _application *ref)
 
 	depth_stencil.depthCompareOp = VK_COMPARE_OP_LESS;
 
+	/**
+	 * After a depth pre-pass only the nearest fragment of each pixel passes,
+	 * depth is already final.
+	 */
+
+	if (state->depth_prepass) {
+		depth_stencil.depthWriteEnable = VK_FALSE;
+		depth_stencil.depthCompareOp = VK_COMPARE_OP_EQUAL;
+	}
+
 	depth_stencil.depthBoundsTestEnable = VK_FALSE;
 	depth_stencil.minDepthBounds = 0.0f;
 	depth_stencil.maxDepthBounds = 1.0f;
@@ -1670,21 +2681,116 @@ void create_graphics_pipeline(struct _application *ref)
 	pipeline_ci.pColorBlendState = &color_blending;
 	pipeline_ci.pDynamicState = NULL;
 
-	pipeline_ci.layout = ref->pipeline_layout;
-	pipeline_ci.renderPass = ref->render_pass;
+	pipeline_ci.layout = state->layout;
+	pipeline_ci.renderPass = state->render_pass;
 	pipeline_ci.subpass = 0;
 
 	pipeline_ci.basePipelineHandle = VK_NULL_HANDLE;
 	pipeline_ci.basePipelineIndex = -1;
 
-	res = vkCreateGraphicsPipelines(ref->device, VK_NULL_HANDLE, 1, &pipeline_ci, NULL, &ref->graphics_pipeline);
+	res = vkCreateGraphicsPipelines(ref->device, VK_NULL_HANDLE, 1, &pipeline_ci, HOST_ALLOC(PIPELINE), pipeline);
 	if (res != VK_SUCCESS) {
 		fprintf(stderr, "ERR: failed to initialize graphics pipeline\n // Assertion: `vkCreateGraphicsPipelines != VK_SUCCESS`\n");
 		exit(EXIT_FAILURE);
 	}
 
-	vkDestroyShaderModule(ref->device, vert, NULL);
-	vkDestroyShaderModule(ref->device, frag, NULL);
+	/**
+	 * The depth pre-pass pipeline shares the rest of the state: vertex stage
+	 * only, fed the position stream and the instance matrices, color writes
+	 * masked off. Both vertex shaders compute an invariant `gl_Position`
+	 * so the EQUAL test matches.
+	 */
+
+	if (depth_pipeline) {
+		VkPipelineShaderStageCreateInfo depth_stage = vert_shader_stage_ci;
+		depth_stage.module = state->depth_vert;
+
+		VkVertexInputBindingDescription depth_bindings[2] = {bind_desc[0], bind_desc[1]};
+		depth_bindings[0].stride = state->vertex_format == VERTEX_FORMAT_PACKED ? sizeof(int16_t) * 4 : sizeof(vec3);
+
+		VkVertexInputAttributeDescription depth_attribs[5] = {attr_tmp[0], attr_tmp[3], attr_tmp[4], attr_tmp[5], attr_tmp[6]};
+		depth_attribs[0].offset = 0;
+
+		VkPipelineVertexInputStateCreateInfo depth_input = vert_input_info;
+		depth_input.vertexBindingDescriptionCount = 2;
+		depth_input.pVertexBindingDescriptions = depth_bindings;
+		depth_input.vertexAttributeDescriptionCount = 5;
+		depth_input.pVertexAttributeDescriptions = depth_attribs;
+
+		VkPipelineColorBlendAttachmentState depth_blend_state = color_blend_attach_state;
+		depth_blend_state.colorWriteMask = 0;
+
+		VkPipelineColorBlendStateCreateInfo depth_blending = color_blending;
+		depth_blending.pAttachments = &depth_blend_state;
+
+		VkPipelineDepthStencilStateCreateInfo depth_write = depth_stencil;
+		depth_write.depthWriteEnable = VK_TRUE;
+		depth_write.depthCompareOp = VK_COMPARE_OP_LESS;
+
+		VkGraphicsPipelineCreateInfo depth_ci = pipeline_ci;
+		depth_ci.stageCount = 1;
+		depth_ci.pStages = &depth_stage;
+		depth_ci.pVertexInputState = &depth_input;
+		depth_ci.pColorBlendState = &depth_blending;
+		depth_ci.pDepthStencilState = &depth_write;
+
+		res = vkCreateGraphicsPipelines(ref->device, VK_NULL_HANDLE, 1, &depth_ci, HOST_ALLOC(PIPELINE), depth_pipeline);
+		if (res != VK_SUCCESS) {
+			fprintf(stderr, "ERR: failed to initialize depth pre-pass pipeline\n // Assertion: `vkCreateGraphicsPipelines != VK_SUCCESS`\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+static VkPipeline build_scene_variant(struct _application *ref, const void *state, const VkSpecializationInfo *spec)
+{
+	VkPipeline pipeline;
+	build_scene_pipelines(ref, (const scene_pipeline_state_t *) state, spec, &pipeline, NULL);
+
+	return pipeline;
+}
+
+/**
+ *	Create the needed graphics pipeline stuff.
+ */
+void create_graphics_pipeline(struct _application *ref)
+{
+	VkPipelineLayoutCreateInfo pipeline_layout_ci = {};
+	pipeline_layout_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	VkDescriptorSetLayout set_layouts[2] = { ref->descriptor_set_layout, ref->bindless ? ref->bindless->layout : VK_NULL_HANDLE };
+
+	pipeline_layout_ci.setLayoutCount = ref->bindless ? 2 : 1;
+	pipeline_layout_ci.pSetLayouts = set_layouts;
+
+	VkResult res = vkCreatePipelineLayout(ref->device, &pipeline_layout_ci, HOST_ALLOC(PIPELINE_LAYOUT), &ref->pipeline_layout);
+	if (res != VK_SUCCESS) {
+		fprintf(stderr, "ERR: failed to initialize fixed pipeline layout\n // Assertion: `vkCreatePipelineLayout != VK_SUCCESS`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	scene_pipeline_state_t state;
+	get_scene_pipeline_state(ref, &state);
+
+	build_scene_pipelines(ref, &state, NULL, &ref->graphics_pipeline, ref->depth_prepass ? &ref->depth_prepass_pipeline : NULL);
+
+	/**
+	 * Any other debug view specializes the fragment shader, the driver
+	 * strips the views not taken. The variant builds in the background
+	 * while the unspecialized pipeline draws, headless runs wait for it so
+	 * every captured frame shows the view.
+	 */
+
+	ref->scene_variant = VARIANT_NONE;
+
+	if (ref->debug_view != DEBUG_VIEW_SHADED) {
+		uint32_t constants[1] = { ref->debug_view };
+
+		ref->scene_variant = variant_cache_request(ref->variants, scene_frag_path(ref), build_scene_variant, &state, sizeof(state), constants, 1);
+
+		if (ref->headless) {
+			variant_cache_wait(ref->variants);
+		}
+	}
 }
 
 /**
@@ -1699,7 +2805,7 @@ void create_framebuffers(struct _application *ref)
 
 	for (int i = 0; i < array_size(&ref->swapc_img_views); i++) {
 
-		VkImageView views[2] = {arr_get(ref->swapc_img_views, VkImageView, i), ref->depth_image_view};
+		VkImageView views[2] = {arr_get(ref->swapc_img_views, VkImageView, i), rg_image_view(ref->render_graph, ref->rg_depth)};
 
 		VkFramebufferCreateInfo framebuffer_ci = {};
 		framebuffer_ci.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
@@ -1710,7 +2816,7 @@ void create_framebuffers(struct _application *ref)
 		framebuffer_ci.height = ref->swapc_extent.height;
 		framebuffer_ci.layers = 1;
 
-		VkResult res = vkCreateFramebuffer(ref->device, &framebuffer_ci, NULL, &(((VkFramebuffer *) array_data(&ref->swapc_framebuffers))[i]));
+		VkResult res = vkCreateFramebuffer(ref->device, &framebuffer_ci, HOST_ALLOC(FRAMEBUFFER), &(((VkFramebuffer *) array_data(&ref->swapc_framebuffers))[i]));
 		if (res != VK_SUCCESS) {
 			fprintf(stderr, "ERR: failed to initialize framebuffer\n // Assertion: `vkCreateFramebuffer != VK_SUCCESS`\n");
 			exit(EXIT_FAILURE);
@@ -1726,19 +2832,45 @@ void cleanup(struct _application *ref)
 {
 	cleanup_swapchain(ref);
 
-	vkDestroySampler(ref->device, ref->texture_sampler, NULL);
-	vkDestroyImageView(ref->device, ref->texture_image_view, NULL);
+	variant_cache_report(ref->variants);
+	destroy_variant_cache(ref, ref->variants);
+	free(ref->variants);
+	ref->variants = NULL;
+
+	vk_cache_release_sampler(ref->vk_cache, ref->texture_sampler);
 
-	vkDestroyImage(ref->device, ref->texture_image, NULL);
-	vkFreeMemory(ref->device, ref->texture_image_memory, NULL);
+	if (ref->bindless) {
+		destroy_bindless(ref, ref->bindless);
+		free(ref->bindless);
+		ref->bindless = NULL;
+	}
+
+	residency_report(ref->residency);
+	destroy_residency(ref, ref->residency);
+	free(ref->residency);
+	ref->residency = NULL;
+
+	vk_cache_release_set_layout(ref->vk_cache, ref->descriptor_set_layout);
+
+	resource_destroy_mesh(ref, ref->resources, ref->scene_mesh);
+	resource_destroy_material(ref->resources, ref->scene_material);
 
-	vkDestroyDescriptorSetLayout(ref->device, ref->descriptor_set_layout, NULL);
+	if (ref->meshlet_cull) {
+		destroy_meshlet_cull(ref, ref->meshlet_cull);
+		free(ref->meshlet_cull);
+		ref->meshlet_cull = NULL;
+	}
+
+	free_mesh(ref->mesh);
+	free(ref->mesh);
+	ref->mesh = NULL;
 
-	vkDestroyBuffer(ref->device, ref->index_buffer, NULL);
-	vkFreeMemory(ref->device, ref->index_buffer_memory, NULL);
+	destroy_transforms(ref->transforms);
+	free(ref->transforms);
+	ref->transforms = NULL;
 
-	vkDestroyBuffer(ref->device, ref->vertex_buffer, NULL);
-	vkFreeMemory(ref->device, ref->vertex_buffer_memory, NULL);
+	free(ref->instance_lods);
+	free(ref->instance_order);
 
 	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
 
@@ -1746,21 +2878,52 @@ void cleanup(struct _application *ref)
 		VkSemaphore rendr = arr_get(ref->render_finished_semaphore, VkSemaphore, i);
 		VkFence fence = arr_get(ref->in_flight_fences, VkFence, i);
 
-		vkDestroySemaphore(ref->device, img, NULL);
-		vkDestroySemaphore(ref->device, rendr, NULL);
-		vkDestroyFence(ref->device, fence, NULL);
+		vkDestroySemaphore(ref->device, img, HOST_ALLOC(SYNC));
+		vkDestroySemaphore(ref->device, rendr, HOST_ALLOC(SYNC));
+		vkDestroyFence(ref->device, fence, HOST_ALLOC(SYNC));
 	}
 
-	vkDestroyCommandPool(ref->device, ref->cmd_pool, NULL);
+	destroy_gpu_timer(ref, ref->gpu_timer);
+	free(ref->gpu_timer);
+
+	desc_alloc_report(ref->desc_alloc);
+	destroy_desc_alloc(ref, ref->desc_alloc);
+	free(ref->desc_alloc);
+	ref->desc_alloc = NULL;
+
+	vkDestroyCommandPool(ref->device, ref->cmd_pool, HOST_ALLOC(COMMAND_POOL));
 
-	vkDestroyDevice(ref->device, NULL);
+	shader_cache_report(ref->shaders);
+	destroy_shader_cache(ref, ref->shaders);
+	free(ref->shaders);
+	ref->shaders = NULL;
+
+	resources_report(ref->resources);
+	destroy_resources(ref, ref->resources);
+	free(ref->resources);
+	ref->resources = NULL;
+
+	vk_cache_report(ref->vk_cache);
+	destroy_vk_cache(ref, ref->vk_cache);
+	free(ref->vk_cache);
+	ref->vk_cache = NULL;
+
+	mem_budget_report(ref->mem_budget);
+	destroy_mem_budget(ref->mem_budget);
+	free(ref->mem_budget);
+	ref->mem_budget = NULL;
+
+	vkDestroyDevice(ref->device, HOST_ALLOC(DEVICE));
 
 	if (enable_validation_layers) {
-		destroy_debug_utils_messenger_EXT(ref->vk_instance, ref->debug_messenger, NULL);
+		destroy_debug_utils_messenger_EXT(ref->vk_instance, ref->debug_messenger, HOST_ALLOC(DEBUG));
  	}
 	
-	vkDestroySurfaceKHR(ref->vk_instance, ref->surface, NULL);
-	vkDestroyInstance(ref->vk_instance, NULL);
+	if (!ref->headless) {
+		vkDestroySurfaceKHR(ref->vk_instance, ref->surface, HOST_ALLOC(SURFACE));
+	}
+
+	vkDestroyInstance(ref->vk_instance, HOST_ALLOC(INSTANCE));
 
 	array_free(&ref->queue_family_properties);
 	array_free(&ref->instance_ext_names);
@@ -1777,6 +2940,10 @@ void cleanup(struct _application *ref)
 	array_free(&ref->in_flight_fences);
 	array_free(&ref->imgs_in_flight);
 
-	glfwDestroyWindow(ref->window);
-	glfwTerminate();
+	if (!ref->headless) {
+		glfwDestroyWindow(ref->window);
+		glfwTerminate();
+	}
+
+	host_alloc_report(false);
 }
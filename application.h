@@ -3,6 +3,7 @@
 
 #include "lib/array.h"
 #include "lib/memutil.h"
+#include "lib/handle_pool.h"
 #include "stdbool.h"
 #include "sys/time.h"
 
@@ -11,6 +12,8 @@
 #include <vulkan/vulkan.h>
 #include <GLFW/glfw3.h>
 
+#include "host_alloc.h"
+
 #define PHYSDEV(index)	arr_get(ref->physical_devices, VkPhysicalDevice, index)
 
 typedef struct vertex_t
@@ -29,12 +32,25 @@ typedef struct ubo_t
 }
 ubo_t;
 
-static VkVertexInputBindingDescription get_binding_description();
+static void get_binding_descriptions(int vertex_format, VkVertexInputBindingDescription *binding_descriptions);
+
+/**
+ *	What the scene's fragment shader outputs, its `DEBUG_VIEW`
+ *	specialization constant.
+ */
+typedef enum _debug_view_t
+{
+	DEBUG_VIEW_SHADED,
+	DEBUG_VIEW_TEX_COORDS,
+	DEBUG_VIEW_VERTEX_COLOR
+}
+debug_view_t;
 
 typedef struct _queue_family_indices_t
 {
 	uint32_t graphics_family;
 	uint32_t present_family;
+	uint32_t compute_family;
 }
 queue_family_indices_t;
 
@@ -63,7 +79,6 @@ struct _application
 
 	struct timeval start_tv;
 
-	VkDescriptorPool descriptor_pool;
 	VkDescriptorSetLayout descriptor_set_layout;
 	VkPipelineLayout pipeline_layout;
 
@@ -75,23 +90,16 @@ struct _application
 
 	VkQueue graphics_queue;
 	VkQueue present_queue;
+	VkQueue compute_queue;
 
-	VkImage depth_image;
-	VkDeviceMemory depth_image_memory;
-	VkImageView depth_image_view;
-
-	VkBuffer vertex_buffer;
 	VkBuffer uniform_buffer;
-	VkBuffer index_buffer;
 
 	VkSampler texture_sampler;
 	VkImageView texture_image_view;
 	VkImage texture_image;
 	VkDeviceMemory texture_image_memory;
 
-	VkDeviceMemory vertex_buffer_memory;
 	VkDeviceMemory uniform_buffer_memory;
-	VkDeviceMemory index_buffer_memory;
 
 	VkFormat swapc_img_format;
 	VkExtent2D swapc_extent;
@@ -125,23 +133,205 @@ struct _application
 	array uniform_buffers;
 	array uniform_buffers_memory;
 
+	/**
+	 * Per swapchain image `VkDrawIndexedIndirectCommand` of every submesh,
+	 * rewritten each frame with the selected level of detail.
+	 */
+
+	array lod_draw_buffers;
+	array lod_draw_buffers_memory;
+
+	/**
+	 * Per swapchain image world matrices of the instances, persistently
+	 * mapped, sorted by level of detail in `update_lod_draws()`. Only
+	 * rewritten once the image's fence in `imgs_in_flight` has signaled.
+	 */
+
+	array instance_buffers;
+	array instance_buffers_memory;
+	array instance_mapped;
+
+	/**
+	 * Per swapchain image sets, cached in `desc_alloc` (see desc_alloc.h)
+	 * under the image index so they survive swapchain recreation.
+	 */
+
+	struct _desc_alloc_t *desc_alloc;
 	array descriptor_sets;
 
+	/**
+	 * Frame render graph, see render_graph.h. Rebuilt with the swapchain,
+	 * it owns the depth buffer. `rg_*` are its resources bound per
+	 * swapchain image.
+	 */
+
+	struct _render_graph_t *render_graph;
+	uint32_t rg_backbuffer;
+	uint32_t rg_depth;
+	uint32_t rg_cull_indices;
+	uint32_t rg_cull_indirect;
+
+	/**
+	 * Shader modules by path, see shader_cache.h.
+	 */
+
+	struct _shader_cache_t *shaders;
+
+	/**
+	 * Shared samplers, set layouts and render passes, see vk_cache.h.
+	 */
+
+	struct _vk_cache_t *vk_cache;
+
 	uint32_t queue_family_count;
 	uint32_t swapchain_img_count;
 
 	unsigned int queue_family_index;
 	unsigned int graphics_queue_family_index;
 	unsigned int present_queue_family_index;
+	unsigned int compute_queue_family_index;
 
 	bool framebuffer_resized;
+
+	/**
+	 * Per swapchain image GPU timestamps, see gpu_timer.h.
+	 */
+
+	struct _gpu_timer_t *gpu_timer;
+
+	/**
+	 * Frame timing histograms, live while `main_loop()` runs.
+	 */
+
+	struct _frame_stats_t *frame_stats;
+
+	/**
+	 * Device memory accounting and texture residency, see mem_budget.h and
+	 * residency.h. `texture_id` is the residency handle behind `texture_*`,
+	 * `fallback_texture_id` a pinned 1x1 texture bound in place of evicted
+	 * ones.
+	 */
+
+	struct _mem_budget_t *mem_budget;
+	struct _residency_t *residency;
+	uint32_t texture_id;
+	uint32_t fallback_texture_id;
+
+	/**
+	 * Set when descriptors the recorded command buffers bind were rewritten,
+	 * `draw_frame()` records them again before the next submit.
+	 */
+
+	bool cmd_buffers_dirty;
+
+	/**
+	 * Scene geometry, see mesh.h. Loaded from `model_path` when set.
+	 */
+
+	struct _mesh_t *mesh;
+	const char *model_path;
+
+	/**
+	 * Buffers, images, meshes and materials behind handles, see
+	 * resources.h. `scene_mesh` holds the vertex, position and index
+	 * buffers of `mesh`, `scene_material` its texture.
+	 */
+
+	struct _resources_t *resources;
+	handle_t scene_mesh;
+	handle_t scene_material;
+
+	/**
+	 * `vertex_format_t` of the vertex buffer, packed unless the mesh does
+	 * not fit it or `full_vertices` is set.
+	 */
+
+	int vertex_format;
+	bool full_vertices;
+
+	/**
+	 * Cluster culling of large models, see meshlet.h. NULL when the model
+	 * is small, `no_meshlets` is set or the device can not run it.
+	 */
+
+	struct _meshlet_cull_t *meshlet_cull;
+	bool no_meshlets;
+
+	/**
+	 * Depth pre-pass, `depth_prepass` is set by `--depth-prepass`. The scene
+	 * is first drawn depth only from the `MESH_STREAM_POSITION` buffer, the
+	 * positions of the vertex buffer on their own, then the main pipeline
+	 * shades only the fragments whose depth is EQUAL, without writing
+	 * depth.
+	 */
+
+	bool depth_prepass;
+	VkPipeline depth_prepass_pipeline;
+
+	/**
+	 * Specialized pipelines, see variant_cache.h. `scene_variant` is the
+	 * scene pipeline specialized for `debug_view` (set by `--debug-view`),
+	 * `VARIANT_NONE` for the shaded view, `graphics_pipeline` draws until
+	 * it is ready.
+	 */
+
+	struct _variant_cache_t *variants;
+	debug_view_t debug_view;
+	uint32_t scene_variant;
+
+	/**
+	 * Scene transform hierarchy, see transform.h. Transform 0 is the root,
+	 * the `instance_count` copies of the mesh are its children.
+	 * `draw_first_instance` tells if indirect draws may offset the instance
+	 * buffer, otherwise every instance shares one level of detail.
+	 */
+
+	struct _transforms_t *transforms;
+	uint32_t instance_count;
+	uint32_t *instance_lods;
+	uint32_t *instance_order;
+	bool draw_first_instance;
+
+	/**
+	 * Bindless textures, see bindless.h. Set up when `texture_count` is
+	 * given, instance `i` samples texture `i % texture_count`.
+	 * `descriptor_indexing` tells if the extension was enabled on the
+	 * device, `no_descriptor_indexing` forces the texture array fallback.
+	 */
+
+	struct _bindless_t *bindless;
+	uint32_t texture_count;
+	bool descriptor_indexing;
+	bool no_descriptor_indexing;
+
+	/**
+	 * `VK_KHR_synchronization2` is enabled on the device, barrier batches
+	 * record through `cmd_pipeline_barrier2` (see barrier.h).
+	 */
+
+	bool synchronization2;
+	PFN_vkCmdPipelineBarrier2KHR cmd_pipeline_barrier2;
+
+	/**
+	 * Run without GLFW window, surface or swapchain.
+	 */
+
+	bool headless;
+
+	/**
+	 * Headless rendering: offscreen color images replace the swapchain
+	 * images, `headless_frames` frames are rendered before exiting.
+	 */
+
+	array offscreen_images;
+	uint32_t headless_frames;
 };
 
-void create_depth_resources(struct _application *ref);
+void create_render_graph(struct _application *ref);
 
 void create_texture_sampler(struct _application *ref);
 
-void create_texture_image_view(struct _application *ref);
+void create_texture_image_view(struct _application *ref, VkImage image, VkFormat format, VkImageView *view);
 
 VkCommandBuffer begin_single_time_commands(struct _application *ref);
 
@@ -153,6 +343,8 @@ void transition_image_layout(struct _application *ref, VkImage image, VkFormat f
 
 void copy_buffer_to_image(struct _application *ref, VkBuffer buffer, VkImage image, uint32_t x, uint32_t y);
 
+void cmd_copy_buffer_to_image(VkCommandBuffer command_buffer, VkBuffer buffer, VkImage image, uint32_t x, uint32_t y);
+
 void create_image(struct _application *ref, uint32_t x, uint32_t y, VkFormat format, VkImageTiling tiling, 
 	VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage *img, VkDeviceMemory *mem);
 
@@ -163,8 +355,14 @@ void copy_buffer(struct _application *ref, VkBuffer src_buffer, VkBuffer dst_buf
 
 void create_texture_image(struct _application *ref);
 
+void create_bindless_textures(struct _application *ref);
+
 int check_validation_layer_support();
 
+void update_lod_draws(struct _application *ref, uint32_t current_image, mat4 model, vec3 eye, float proj_scale);
+
+void update_instances(struct _application *ref, uint64_t t);
+
 void update_uniform_buffer(struct _application *ref, uint32_t current_image);
 
 void create_descriptor_set_layout(struct _application *ref);
@@ -173,6 +371,10 @@ void create_descriptor_sets(struct _application *ref);
 
 void query_req_ext(array *arr);
 
+void setup_debug_messenger(struct _application *ref);
+
+void create_instance(struct _application *ref);
+
 void run(struct _application *ref);
 
 void main_loop(struct _application *ref);
@@ -181,6 +383,8 @@ void draw_frame(struct _application *ref);
 
 void create_sync_objects(struct _application *ref);
 
+void reset_image_fences(struct _application *ref);
+
 void init_window(struct _application *ref);
 
 void init_image_views(struct _application *ref);
@@ -207,18 +411,27 @@ void create_command_pool(struct _application *ref);
 
 uint32_t find_memory_type(struct _application *ref, uint32_t type_filter, VkMemoryPropertyFlags properties);
 
-void create_index_buffer(struct _application *ref);
+uint32_t find_transient_memory_type(struct _application *ref, uint32_t type_filter);
+
+void load_mesh(struct _application *ref);
+
+void init_instances(struct _application *ref);
 
-void create_vertex_buffer(struct _application *ref);
+handle_t create_index_buffer(struct _application *ref);
+
+handle_t create_vertex_buffer(struct _application *ref);
+
+handle_t create_position_buffer(struct _application *ref);
 
 void create_uniform_buffers(struct _application *ref);
 
 void create_command_buffers(struct _application *ref);
 
+void rerecord_command_buffers(struct _application *ref);
+
 void cleanup(struct _application *ref);
 
 void create_renderpass(struct _application *ref);
 
-void create_descriptor_pool(struct _application *ref);
 
 #endif
@@ -0,0 +1,246 @@
+#include "barrier.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool barrier_sync2_supported(VkPhysicalDevice phys_device)
+{
+	uint32_t ext_count;
+	vkEnumerateDeviceExtensionProperties(phys_device, NULL, &ext_count, NULL);
+
+	VkExtensionProperties available_ext[ext_count];
+	vkEnumerateDeviceExtensionProperties(phys_device, NULL, &ext_count, available_ext);
+
+	bool found = false;
+
+	for (uint32_t i = 0; i < ext_count; i++) {
+		if (strcmp(available_ext[i].extensionName, BARRIER_SYNC2_EXTENSION_NAME) == 0) {
+			found = true;
+		}
+	}
+
+	if (!found) {
+		return false;
+	}
+
+	VkPhysicalDeviceSynchronization2FeaturesKHR sync2_features = {};
+	sync2_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+
+	VkPhysicalDeviceFeatures2 features = {};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &sync2_features;
+
+	vkGetPhysicalDeviceFeatures2(phys_device, &features);
+
+	return sync2_features.synchronization2;
+}
+
+void init_barrier_batch(barrier_batch_t *batch)
+{
+	memset(batch, 0, sizeof(barrier_batch_t));
+
+	array_init(&batch->images, sizeof(VkImageMemoryBarrier2KHR));
+	array_init(&batch->buffers, sizeof(VkBufferMemoryBarrier2KHR));
+}
+
+void destroy_barrier_batch(barrier_batch_t *batch)
+{
+	array_free(&batch->images);
+	array_free(&batch->buffers);
+}
+
+/**
+ *	Stages and access of the typical use of an image in `layout`, for
+ *	transitions whose neighbouring use is not known any better.
+ */
+void barrier_layout_state(VkImageLayout layout, VkPipelineStageFlags *stages, VkAccessFlags *access)
+{
+	switch (layout) {
+	case VK_IMAGE_LAYOUT_UNDEFINED:
+		*stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		*access = 0;
+		break;
+	case VK_IMAGE_LAYOUT_PREINITIALIZED:
+		*stages = VK_PIPELINE_STAGE_HOST_BIT;
+		*access = VK_ACCESS_HOST_WRITE_BIT;
+		break;
+	case VK_IMAGE_LAYOUT_GENERAL:
+		*stages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		*access = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+		break;
+	case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+		*stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		*access = VK_ACCESS_TRANSFER_READ_BIT;
+		break;
+	case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+		*stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		*access = VK_ACCESS_TRANSFER_WRITE_BIT;
+		break;
+	case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+		*stages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		*access = VK_ACCESS_SHADER_READ_BIT;
+		break;
+	case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+		*stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		*access = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		break;
+	case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+		*stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		*access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		break;
+	case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:
+		*stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		*access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+		break;
+	case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
+		*stages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		*access = 0;
+		break;
+	default:
+		fprintf(stderr, "ERR: unsupported layout transition\n // Assertion: `layout` has a known use\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+/**
+ *	Queue a barrier on all mips and layers of `image`. A zero stage mask
+ *	stands for no stage: nothing to wait for, or nothing waiting.
+ */
+void barrier_image(barrier_batch_t *batch, VkImage image, VkImageAspectFlags aspect, VkPipelineStageFlags src_stages, VkAccessFlags src_access,
+	VkImageLayout old_layout, VkPipelineStageFlags dst_stages, VkAccessFlags dst_access, VkImageLayout new_layout)
+{
+	VkImageMemoryBarrier2KHR barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+	barrier.srcStageMask = src_stages;
+	barrier.srcAccessMask = src_access;
+	barrier.dstStageMask = dst_stages;
+	barrier.dstAccessMask = dst_access;
+	barrier.oldLayout = old_layout;
+	barrier.newLayout = new_layout;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = aspect;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+
+	array_append(&batch->images, &barrier);
+}
+
+/**
+ *	Transition between the typical uses of two layouts, see
+ *	`barrier_layout_state()`.
+ */
+void barrier_image_layout(barrier_batch_t *batch, VkImage image, VkImageAspectFlags aspect, VkImageLayout old_layout, VkImageLayout new_layout)
+{
+	VkPipelineStageFlags src_stages, dst_stages;
+	VkAccessFlags src_access, dst_access;
+
+	barrier_layout_state(old_layout, &src_stages, &src_access);
+	barrier_layout_state(new_layout, &dst_stages, &dst_access);
+
+	barrier_image(batch, image, aspect, src_stages, src_access & BARRIER_WRITE_ACCESS, old_layout, dst_stages, dst_access, new_layout);
+}
+
+void barrier_buffer(barrier_batch_t *batch, VkBuffer buffer, VkPipelineStageFlags src_stages, VkAccessFlags src_access,
+	VkPipelineStageFlags dst_stages, VkAccessFlags dst_access)
+{
+	VkBufferMemoryBarrier2KHR barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR;
+	barrier.srcStageMask = src_stages;
+	barrier.srcAccessMask = src_access;
+	barrier.dstStageMask = dst_stages;
+	barrier.dstAccessMask = dst_access;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = buffer;
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+
+	array_append(&batch->buffers, &barrier);
+}
+
+/**
+ *	Record every queued barrier with a single command and empty the batch.
+ */
+void barrier_flush(struct _application *ref, barrier_batch_t *batch, VkCommandBuffer cmd)
+{
+	uint32_t image_count = array_size(&batch->images);
+	uint32_t buffer_count = array_size(&batch->buffers);
+
+	if (image_count + buffer_count == 0) {
+		return;
+	}
+
+	batch->flushes++;
+	batch->barriers += image_count + buffer_count;
+
+	if (ref->synchronization2) {
+		VkDependencyInfoKHR dependency = {};
+		dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR;
+		dependency.imageMemoryBarrierCount = image_count;
+		dependency.pImageMemoryBarriers = image_count ? (VkImageMemoryBarrier2KHR *) array_data(&batch->images) : NULL;
+		dependency.bufferMemoryBarrierCount = buffer_count;
+		dependency.pBufferMemoryBarriers = buffer_count ? (VkBufferMemoryBarrier2KHR *) array_data(&batch->buffers) : NULL;
+
+		ref->cmd_pipeline_barrier2(cmd, &dependency);
+	}
+	else {
+
+		/**
+		 * Without per barrier stages the batch waits on the union of its
+		 * source stages. Legacy masks have no "no stage", use the ends
+		 * of the pipeline instead.
+		 */
+
+		VkPipelineStageFlags src_stages = 0;
+		VkPipelineStageFlags dst_stages = 0;
+
+		VkImageMemoryBarrier image_barriers[image_count + 1];
+		VkBufferMemoryBarrier buffer_barriers[buffer_count + 1];
+
+		for (uint32_t i = 0; i < image_count; i++) {
+			VkImageMemoryBarrier2KHR *barrier = &((VkImageMemoryBarrier2KHR *) array_data(&batch->images))[i];
+
+			memset(&image_barriers[i], 0, sizeof(VkImageMemoryBarrier));
+			image_barriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			image_barriers[i].srcAccessMask = (VkAccessFlags) barrier->srcAccessMask;
+			image_barriers[i].dstAccessMask = (VkAccessFlags) barrier->dstAccessMask;
+			image_barriers[i].oldLayout = barrier->oldLayout;
+			image_barriers[i].newLayout = barrier->newLayout;
+			image_barriers[i].srcQueueFamilyIndex = barrier->srcQueueFamilyIndex;
+			image_barriers[i].dstQueueFamilyIndex = barrier->dstQueueFamilyIndex;
+			image_barriers[i].image = barrier->image;
+			image_barriers[i].subresourceRange = barrier->subresourceRange;
+
+			src_stages |= (VkPipelineStageFlags) barrier->srcStageMask;
+			dst_stages |= (VkPipelineStageFlags) barrier->dstStageMask;
+		}
+
+		for (uint32_t i = 0; i < buffer_count; i++) {
+			VkBufferMemoryBarrier2KHR *barrier = &((VkBufferMemoryBarrier2KHR *) array_data(&batch->buffers))[i];
+
+			memset(&buffer_barriers[i], 0, sizeof(VkBufferMemoryBarrier));
+			buffer_barriers[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			buffer_barriers[i].srcAccessMask = (VkAccessFlags) barrier->srcAccessMask;
+			buffer_barriers[i].dstAccessMask = (VkAccessFlags) barrier->dstAccessMask;
+			buffer_barriers[i].srcQueueFamilyIndex = barrier->srcQueueFamilyIndex;
+			buffer_barriers[i].dstQueueFamilyIndex = barrier->dstQueueFamilyIndex;
+			buffer_barriers[i].buffer = barrier->buffer;
+			buffer_barriers[i].offset = barrier->offset;
+			buffer_barriers[i].size = barrier->size;
+
+			src_stages |= (VkPipelineStageFlags) barrier->srcStageMask;
+			dst_stages |= (VkPipelineStageFlags) barrier->dstStageMask;
+		}
+
+		vkCmdPipelineBarrier(cmd, src_stages ? src_stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dst_stages ? dst_stages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0, 0, NULL, buffer_count, buffer_count ? buffer_barriers : NULL, image_count, image_count ? image_barriers : NULL);
+	}
+
+	batch->images.size = 0;
+	batch->buffers.size = 0;
+}
@@ -0,0 +1,49 @@
+#ifndef _BARRIER_H_
+#define _BARRIER_H_
+
+#include "application.h"
+
+#define BARRIER_SYNC2_EXTENSION_NAME "VK_KHR_synchronization2"
+
+/**
+ *	Access bits that make a barrier's source a write, only those need to be
+ *	made available.
+ */
+#define BARRIER_WRITE_ACCESS (VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | \
+	VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT)
+
+/**
+ *	Image and buffer barriers collected for one flush. Every barrier keeps
+ *	its own stage and access masks: with `VK_KHR_synchronization2` they are
+ *	recorded as they are by `vkCmdPipelineBarrier2KHR`, otherwise the stage
+ *	masks of the batch are merged into a single `vkCmdPipelineBarrier()`.
+ */
+typedef struct _barrier_batch_t
+{
+	array images;
+	array buffers;
+
+	uint32_t flushes;
+	uint32_t barriers;
+}
+barrier_batch_t;
+
+bool barrier_sync2_supported(VkPhysicalDevice phys_device);
+
+void init_barrier_batch(barrier_batch_t *batch);
+
+void destroy_barrier_batch(barrier_batch_t *batch);
+
+void barrier_layout_state(VkImageLayout layout, VkPipelineStageFlags *stages, VkAccessFlags *access);
+
+void barrier_image(barrier_batch_t *batch, VkImage image, VkImageAspectFlags aspect, VkPipelineStageFlags src_stages, VkAccessFlags src_access,
+	VkImageLayout old_layout, VkPipelineStageFlags dst_stages, VkAccessFlags dst_access, VkImageLayout new_layout);
+
+void barrier_image_layout(barrier_batch_t *batch, VkImage image, VkImageAspectFlags aspect, VkImageLayout old_layout, VkImageLayout new_layout);
+
+void barrier_buffer(barrier_batch_t *batch, VkBuffer buffer, VkPipelineStageFlags src_stages, VkAccessFlags src_access,
+	VkPipelineStageFlags dst_stages, VkAccessFlags dst_access);
+
+void barrier_flush(struct _application *ref, barrier_batch_t *batch, VkCommandBuffer cmd);
+
+#endif
@@ -0,0 +1,445 @@
+#include "bindless.h"
+#include "residency.h"
+#include "mem_budget.h"
+#include "barrier.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEXEL_SIZE 4
+#define LAYER_BYTES ((size_t) BINDLESS_LAYER_SIZE * BINDLESS_LAYER_SIZE * TEXEL_SIZE)
+
+/**
+ *	Check the device for `VK_EXT_descriptor_indexing` with non uniform
+ *	indexing, partially bound and update after bind sampled images, and
+ *	limits that fit the whole texture array.
+ */
+bool bindless_ext_supported(VkPhysicalDevice phys_device)
+{
+	uint32_t ext_count;
+	vkEnumerateDeviceExtensionProperties(phys_device, NULL, &ext_count, NULL);
+
+	VkExtensionProperties available_ext[ext_count];
+	vkEnumerateDeviceExtensionProperties(phys_device, NULL, &ext_count, available_ext);
+
+	bool found = false;
+
+	for (uint32_t i = 0; i < ext_count; i++) {
+		if (strcmp(available_ext[i].extensionName, BINDLESS_EXTENSION_NAME) == 0) {
+			found = true;
+		}
+	}
+
+	if (!found) {
+		return false;
+	}
+
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexing_features = {};
+	indexing_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+	VkPhysicalDeviceFeatures2 features = {};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &indexing_features;
+
+	vkGetPhysicalDeviceFeatures2(phys_device, &features);
+
+	VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexing_props = {};
+	indexing_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+
+	VkPhysicalDeviceProperties2 props = {};
+	props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	props.pNext = &indexing_props;
+
+	vkGetPhysicalDeviceProperties2(phys_device, &props);
+
+	return indexing_features.shaderSampledImageArrayNonUniformIndexing
+		&& indexing_features.descriptorBindingPartiallyBound
+		&& indexing_features.descriptorBindingSampledImageUpdateAfterBind
+		&& indexing_features.descriptorBindingUpdateUnusedWhilePending
+		&& indexing_props.maxPerStageDescriptorUpdateAfterBindSamplers >= BINDLESS_MAX_TEXTURES
+		&& indexing_props.maxPerStageDescriptorUpdateAfterBindSampledImages >= BINDLESS_MAX_TEXTURES
+		&& indexing_props.maxDescriptorSetUpdateAfterBindSamplers >= BINDLESS_MAX_TEXTURES
+		&& indexing_props.maxDescriptorSetUpdateAfterBindSampledImages >= BINDLESS_MAX_TEXTURES
+		&& indexing_props.maxPerStageUpdateAfterBindResources > BINDLESS_MAX_TEXTURES;
+}
+
+/**
+ *	Point `slot` at its texture, or at slot 0 while the texture is evicted.
+ *	Slot 0 is pinned, the application's fallback texture only stands in
+ *	should it still lack a view.
+ */
+static void write_slot(struct _application *ref, bindless_t *bindless, uint32_t slot)
+{
+	const uint32_t *ids = (const uint32_t *) array_data(&bindless->texture_ids);
+	resident_texture_t *tex = residency_get(ref, ids[slot]);
+
+	if (tex->view == VK_NULL_HANDLE && slot != 0) {
+		tex = residency_get(ref, ids[0]);
+	}
+
+	if (tex->view == VK_NULL_HANDLE) {
+		tex = residency_get(ref, ref->fallback_texture_id);
+	}
+
+	VkDescriptorImageInfo image_info = {};
+	image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	image_info.imageView = tex->view;
+	image_info.sampler = ref->texture_sampler;
+
+	VkWriteDescriptorSet descriptor_write = {};
+	descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptor_write.dstSet = bindless->set;
+	descriptor_write.dstBinding = 0;
+	descriptor_write.dstArrayElement = slot;
+	descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	descriptor_write.descriptorCount = 1;
+	descriptor_write.pImageInfo = &image_info;
+
+	vkUpdateDescriptorSets(ref->device, 1, &descriptor_write, 0, NULL);
+}
+
+/**
+ *	Residency callback, `user` is the slot. Slots borrowing slot 0 while
+ *	evicted are not tracked, they pick up their own texture once restored.
+ */
+static void bindless_texture_changed(struct _application *ref, uint32_t id, void *user)
+{
+	bindless_t *bindless = ref->bindless;
+	uint32_t slot = (uint32_t) (uintptr_t) user;
+
+	if (bindless == NULL || slot >= (uint32_t) array_size(&bindless->texture_ids)) {
+		return;
+	}
+
+	write_slot(ref, bindless, slot);
+}
+
+/**
+ *	Create the set layout, pool and set. Call before the graphics pipeline,
+ *	`descriptor_indexing` only when the extension and its features were
+ *	enabled on `ref->device`.
+ */
+void init_bindless(struct _application *ref, bindless_t *bindless, bool descriptor_indexing)
+{
+	memset(bindless, 0, sizeof(bindless_t));
+
+	bindless->mode = descriptor_indexing ? BINDLESS_DESCRIPTOR_INDEXING : BINDLESS_TEXTURE_ARRAY;
+
+	array_init(&bindless->texture_ids, sizeof(uint32_t));
+	array_init(&bindless->layers, sizeof(uint8_t *));
+
+	if (bindless->mode == BINDLESS_DESCRIPTOR_INDEXING) {
+		bindless->capacity = BINDLESS_MAX_TEXTURES;
+	}
+	else {
+		VkPhysicalDeviceProperties props;
+		vkGetPhysicalDeviceProperties(PHYSDEV(0), &props);
+
+		bindless->capacity = props.limits.maxImageArrayLayers < BINDLESS_MAX_TEXTURES ? props.limits.maxImageArrayLayers : BINDLESS_MAX_TEXTURES;
+	}
+
+	uint32_t descriptor_count = bindless->mode == BINDLESS_DESCRIPTOR_INDEXING ? BINDLESS_MAX_TEXTURES : 1;
+
+	VkDescriptorSetLayoutBinding binding = {};
+	binding.binding = 0;
+	binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	binding.descriptorCount = descriptor_count;
+	binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	binding.pImmutableSamplers = NULL;
+
+	VkDescriptorBindingFlagsEXT binding_flags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT
+		| VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT
+		| VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfoEXT flags_info = {};
+	flags_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+	flags_info.bindingCount = 1;
+	flags_info.pBindingFlags = &binding_flags;
+
+	VkDescriptorSetLayoutCreateInfo layout_info = {};
+	layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layout_info.bindingCount = 1;
+	layout_info.pBindings = &binding;
+
+	if (bindless->mode == BINDLESS_DESCRIPTOR_INDEXING) {
+		layout_info.pNext = &flags_info;
+		layout_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+	}
+
+	VkResult res = vkCreateDescriptorSetLayout(ref->device, &layout_info, HOST_ALLOC(DESCRIPTOR), &bindless->layout);
+	if (res != VK_SUCCESS) {
+		fprintf(stderr, "ERR: failed to create bindless descriptor set layout\n // Assertion: `vkCreateDescriptorSetLayout == VK_SUCCESS`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	VkDescriptorPoolSize pool_size = {};
+	pool_size.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	pool_size.descriptorCount = descriptor_count;
+
+	VkDescriptorPoolCreateInfo pool_info = {};
+	pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	pool_info.poolSizeCount = 1;
+	pool_info.pPoolSizes = &pool_size;
+	pool_info.maxSets = 1;
+
+	if (bindless->mode == BINDLESS_DESCRIPTOR_INDEXING) {
+		pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+	}
+
+	res = vkCreateDescriptorPool(ref->device, &pool_info, HOST_ALLOC(DESCRIPTOR), &bindless->pool);
+	if (res != VK_SUCCESS) {
+		fprintf(stderr, "ERR: failed to create bindless descriptor pool\n // Assertion: `vkCreateDescriptorPool == VK_SUCCESS`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	VkDescriptorSetAllocateInfo alloc_info = {};
+	alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	alloc_info.descriptorPool = bindless->pool;
+	alloc_info.descriptorSetCount = 1;
+	alloc_info.pSetLayouts = &bindless->layout;
+
+	res = vkAllocateDescriptorSets(ref->device, &alloc_info, &bindless->set);
+	if (res != VK_SUCCESS) {
+		fprintf(stderr, "ERR: failed to allocate bindless descriptor set\n // Assertion: `vkAllocateDescriptorSets == VK_SUCCESS`\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+/**
+ *	The residency textures are released with the residency manager.
+ */
+void destroy_bindless(struct _application *ref, bindless_t *bindless)
+{
+	for (int i = 0; i < array_size(&bindless->layers); i++) {
+		free(((uint8_t **) array_data(&bindless->layers))[i]);
+	}
+
+	if (bindless->array_image != VK_NULL_HANDLE) {
+		vkDestroyImageView(ref->device, bindless->array_view, HOST_ALLOC(IMAGE_VIEW));
+		vkDestroyImage(ref->device, bindless->array_image, HOST_ALLOC(IMAGE));
+		mem_budget_free(ref, bindless->array_memory);
+	}
+
+	vkDestroyDescriptorPool(ref->device, bindless->pool, HOST_ALLOC(DESCRIPTOR));
+	vkDestroyDescriptorSetLayout(ref->device, bindless->layout, HOST_ALLOC(DESCRIPTOR));
+
+	array_free(&bindless->texture_ids);
+	array_free(&bindless->layers);
+}
+
+/**
+ *	Bilinear resample of `pixels` to a `BINDLESS_LAYER_SIZE` square layer.
+ */
+static uint8_t *resample_layer(const uint8_t *pixels, uint32_t width, uint32_t height)
+{
+	uint8_t *layer = malloc(LAYER_BYTES);
+
+	if (!layer) {
+		fprintf(stderr, "ERR: failed to allocate texture layer\n // Assertion: `malloc() != NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (uint32_t y = 0; y < BINDLESS_LAYER_SIZE; y++) {
+		float fy = ((y + 0.5f) * height / BINDLESS_LAYER_SIZE) - 0.5f;
+		fy = fy > 0.0f ? fy : 0.0f;
+
+		uint32_t y0 = (uint32_t) fy < height - 1 ? (uint32_t) fy : height - 1;
+		uint32_t y1 = y0 + 1 < height ? y0 + 1 : y0;
+		float ty = fy - (float) y0;
+
+		for (uint32_t x = 0; x < BINDLESS_LAYER_SIZE; x++) {
+			float fx = ((x + 0.5f) * width / BINDLESS_LAYER_SIZE) - 0.5f;
+			fx = fx > 0.0f ? fx : 0.0f;
+
+			uint32_t x0 = (uint32_t) fx < width - 1 ? (uint32_t) fx : width - 1;
+			uint32_t x1 = x0 + 1 < width ? x0 + 1 : x0;
+			float tx = fx - (float) x0;
+
+			for (uint32_t c = 0; c < TEXEL_SIZE; c++) {
+				float top = pixels[(y0 * width + x0) * TEXEL_SIZE + c] * (1.0f - tx) + pixels[(y0 * width + x1) * TEXEL_SIZE + c] * tx;
+				float bottom = pixels[(y1 * width + x0) * TEXEL_SIZE + c] * (1.0f - tx) + pixels[(y1 * width + x1) * TEXEL_SIZE + c] * tx;
+
+				layer[(y * BINDLESS_LAYER_SIZE + x) * TEXEL_SIZE + c] = (uint8_t) (top * (1.0f - ty) + bottom * ty + 0.5f);
+			}
+		}
+	}
+
+	return layer;
+}
+
+/**
+ *	Add an RGBA8 sRGB texture and return its index for the shaders. Past
+ *	`capacity` the texture is dropped and the last index returned.
+ */
+uint32_t bindless_add_texture(struct _application *ref, bindless_t *bindless, const uint8_t *pixels, uint32_t width, uint32_t height)
+{
+	if (bindless->count == bindless->capacity) {
+		fprintf(stderr, "WARN: bindless texture capacity of %u reached, texture dropped\n", bindless->capacity);
+		return bindless->count - 1;
+	}
+
+	uint32_t slot = bindless->count++;
+
+	if (bindless->mode == BINDLESS_DESCRIPTOR_INDEXING) {
+		uint32_t id = residency_register_texture(ref, pixels, width, height, VK_FORMAT_R8G8B8A8_SRGB,
+			bindless_texture_changed, (void *) (uintptr_t) slot);
+
+		/**
+		 * The callback ran during registration, before the id was stored.
+		 * Evicted slots borrow slot 0, it has to stay resident.
+		 */
+
+		array_append(&bindless->texture_ids, &id);
+
+		if (slot == 0) {
+			residency_pin(ref, id);
+		}
+
+		write_slot(ref, bindless, slot);
+	}
+	else {
+		uint8_t *layer = resample_layer(pixels, width, height);
+		array_append(&bindless->layers, &layer);
+	}
+
+	return slot;
+}
+
+/**
+ *	Texture array fallback: upload every layer into one image with a single
+ *	copy and point the set at it. Nothing to do with descriptor indexing.
+ */
+void bindless_finalize(struct _application *ref, bindless_t *bindless)
+{
+	if (bindless->mode != BINDLESS_TEXTURE_ARRAY || bindless->count == 0) {
+		return;
+	}
+
+	uint32_t layer_count = bindless->count;
+	VkDeviceSize size = (VkDeviceSize) LAYER_BYTES * layer_count;
+
+	VkBuffer staging_buffer;
+	VkDeviceMemory staging_buffer_memory;
+
+	create_buffer(ref, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &staging_buffer, &staging_buffer_memory);
+
+	uint8_t *data;
+	vkMapMemory(ref->device, staging_buffer_memory, 0, size, 0, (void **) &data);
+
+	for (uint32_t i = 0; i < layer_count; i++) {
+		uint8_t *layer = ((uint8_t **) array_data(&bindless->layers))[i];
+
+		memcpy(data + LAYER_BYTES * i, layer, LAYER_BYTES);
+		free(layer);
+	}
+
+	vkUnmapMemory(ref->device, staging_buffer_memory);
+	bindless->layers.size = 0;
+
+	VkImageCreateInfo image_info = {};
+	image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	image_info.imageType = VK_IMAGE_TYPE_2D;
+	image_info.extent.width = BINDLESS_LAYER_SIZE;
+	image_info.extent.height = BINDLESS_LAYER_SIZE;
+	image_info.extent.depth = 1;
+	image_info.mipLevels = 1;
+	image_info.arrayLayers = layer_count;
+	image_info.format = VK_FORMAT_R8G8B8A8_SRGB;
+	image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	image_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+
+	VkResult res = vkCreateImage(ref->device, &image_info, HOST_ALLOC(IMAGE), &bindless->array_image);
+	if (res != VK_SUCCESS) {
+		fprintf(stderr, "ERR: failed to create texture array\n // Assertion: `vkCreateImage() == VK_SUCCESS`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	VkMemoryRequirements mem_req;
+	vkGetImageMemoryRequirements(ref->device, bindless->array_image, &mem_req);
+
+	VkMemoryAllocateInfo alloc_info = {};
+	alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	alloc_info.allocationSize = mem_req.size;
+	alloc_info.memoryTypeIndex = find_memory_type(ref, mem_req.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	res = mem_budget_allocate(ref, &alloc_info, &bindless->array_memory);
+	if (res != VK_SUCCESS) {
+		fprintf(stderr, "ERR: failed to allocate texture array memory\n // Assertion: `vkAllocateMemory() == VK_SUCCESS`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	vkBindImageMemory(ref->device, bindless->array_image, bindless->array_memory, 0);
+
+	/**
+	 * All layers move through the transfer in one command buffer.
+	 */
+
+	VkCommandBuffer command_buffer = begin_single_time_commands(ref);
+
+	barrier_batch_t batch;
+	init_barrier_batch(&batch);
+
+	barrier_image_layout(&batch, bindless->array_image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	barrier_flush(ref, &batch, command_buffer);
+
+	VkBufferImageCopy region = {};
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.layerCount = layer_count;
+	region.imageExtent = (VkExtent3D) {BINDLESS_LAYER_SIZE, BINDLESS_LAYER_SIZE, 1};
+
+	vkCmdCopyBufferToImage(command_buffer, staging_buffer, bindless->array_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+	barrier_image_layout(&batch, bindless->array_image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	barrier_flush(ref, &batch, command_buffer);
+
+	destroy_barrier_batch(&batch);
+
+	end_single_time_commands(ref, command_buffer);
+
+	vkDestroyBuffer(ref->device, staging_buffer, HOST_ALLOC(BUFFER));
+	mem_budget_free(ref, staging_buffer_memory);
+
+	VkImageViewCreateInfo view_info = {};
+	view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	view_info.image = bindless->array_image;
+	view_info.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+	view_info.format = VK_FORMAT_R8G8B8A8_SRGB;
+	view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	view_info.subresourceRange.levelCount = 1;
+	view_info.subresourceRange.layerCount = layer_count;
+
+	res = vkCreateImageView(ref->device, &view_info, HOST_ALLOC(IMAGE_VIEW), &bindless->array_view);
+	if (res != VK_SUCCESS) {
+		fprintf(stderr, "ERR: failed to create texture array view\n // Assertion: `vkCreateImageView() == VK_SUCCESS`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	VkDescriptorImageInfo descriptor_image = {};
+	descriptor_image.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	descriptor_image.imageView = bindless->array_view;
+	descriptor_image.sampler = ref->texture_sampler;
+
+	VkWriteDescriptorSet descriptor_write = {};
+	descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptor_write.dstSet = bindless->set;
+	descriptor_write.dstBinding = 0;
+	descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	descriptor_write.descriptorCount = 1;
+	descriptor_write.pImageInfo = &descriptor_image;
+
+	vkUpdateDescriptorSets(ref->device, 1, &descriptor_write, 0, NULL);
+}
+
+/**
+ *	Keep every texture of the set from aging out of residency.
+ */
+void bindless_touch(struct _application *ref, bindless_t *bindless)
+{
+	for (int i = 0; i < array_size(&bindless->texture_ids); i++) {
+		residency_touch(ref, ((uint32_t *) array_data(&bindless->texture_ids))[i]);
+	}
+}
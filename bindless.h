@@ -0,0 +1,78 @@
+#ifndef _BINDLESS_H_
+#define _BINDLESS_H_
+
+#include "application.h"
+
+/**
+ *	Size of the sampled image array, fixed in shaders/hellotriangle_bindless.frag.
+ *	Devices whose update after bind limits are lower use the texture array.
+ */
+#define BINDLESS_MAX_TEXTURES 4096
+
+/**
+ *	Layer size of the texture array fallback, textures are resampled to it.
+ */
+#define BINDLESS_LAYER_SIZE 128
+
+#define BINDLESS_EXTENSION_NAME "VK_EXT_descriptor_indexing"
+
+typedef enum _bindless_mode_t
+{
+	BINDLESS_DESCRIPTOR_INDEXING,
+	BINDLESS_TEXTURE_ARRAY
+}
+bindless_mode_t;
+
+/**
+ *	Every texture of the scene behind one descriptor set, bound once as set
+ *	1 and indexed by the per instance texture id.
+ *
+ *	With `VK_EXT_descriptor_indexing` the set holds a partially bound, update
+ *	after bind array of `BINDLESS_MAX_TEXTURES` combined image samplers, one
+ *	residency managed texture per slot, rewritten in place when residency
+ *	rebuilds or evicts it. Without it the textures are resampled into the
+ *	layers of a single 2D array image, which is built once by
+ *	`bindless_finalize()`.
+ */
+typedef struct _bindless_t
+{
+	bindless_mode_t mode;
+
+	VkDescriptorSetLayout layout;
+	VkDescriptorPool pool;
+	VkDescriptorSet set;
+
+	uint32_t count;
+	uint32_t capacity;
+
+	/**
+	 * Descriptor indexing: residency id of each slot.
+	 */
+
+	array texture_ids;
+
+	/**
+	 * Texture array: host copy of the layers until `bindless_finalize()`.
+	 */
+
+	array layers;
+
+	VkImage array_image;
+	VkDeviceMemory array_memory;
+	VkImageView array_view;
+}
+bindless_t;
+
+bool bindless_ext_supported(VkPhysicalDevice phys_device);
+
+void init_bindless(struct _application *ref, bindless_t *bindless, bool descriptor_indexing);
+
+void destroy_bindless(struct _application *ref, bindless_t *bindless);
+
+uint32_t bindless_add_texture(struct _application *ref, bindless_t *bindless, const uint8_t *pixels, uint32_t width, uint32_t height);
+
+void bindless_finalize(struct _application *ref, bindless_t *bindless);
+
+void bindless_touch(struct _application *ref, bindless_t *bindless);
+
+#endif
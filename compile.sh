@@ -1,2 +1,11 @@
 glslc shaders/hellotriangle.vert -o shaders/vert.spv
+glslc shaders/depth_prepass.vert -o shaders/depth_vert.spv
 glslc shaders/hellotriangle.frag -o shaders/frag.spv
+glslc shaders/hellotriangle_bindless.frag -o shaders/frag_bindless.spv
+glslc shaders/hellotriangle_array.frag -o shaders/frag_array.spv
+glslc --target-env=vulkan1.1 shaders/reduce.comp -o shaders/reduce.spv
+glslc --target-env=vulkan1.1 shaders/scan.comp -o shaders/scan.spv
+glslc --target-env=vulkan1.1 shaders/compact.comp -o shaders/compact.spv
+glslc --target-env=vulkan1.1 shaders/radix_hist.comp -o shaders/radix_hist.spv
+glslc --target-env=vulkan1.1 shaders/radix_scatter.comp -o shaders/radix_scatter.spv
+glslc shaders/meshlet_cull.comp -o shaders/meshlet_cull.spv
@@ -0,0 +1,560 @@
+#include "compute.h"
+#include "validations.h"
+#include "mem_budget.h"
+#include "shader_cache.h"
+#include "vk_cache.h"
+
+#include <string.h>
+
+/**
+ *	Probe for a Vulkan 1.1 device exposing a compute queue without touching
+ *	any application state. Used to decide between GPU and CPU backends.
+ */
+bool compute_device_available()
+{
+	VkApplicationInfo app_info = {};
+	app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+	app_info.pApplicationName = "parallax-probe";
+	app_info.apiVersion = VK_API_VERSION_1_1;
+
+	VkInstanceCreateInfo instance_ci = {};
+	instance_ci.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+	instance_ci.pApplicationInfo = &app_info;
+
+	VkInstance instance;
+	if (vkCreateInstance(&instance_ci, HOST_ALLOC(INSTANCE), &instance) != VK_SUCCESS) {
+		return false;
+	}
+
+	uint32_t dev_count = 0;
+	vkEnumeratePhysicalDevices(instance, &dev_count, NULL);
+
+	VkPhysicalDevice devices[dev_count > 0 ? dev_count : 1];
+	vkEnumeratePhysicalDevices(instance, &dev_count, devices);
+
+	bool found = false;
+
+	for (uint32_t i = 0; i < dev_count && !found; i++) {
+		VkPhysicalDeviceProperties props;
+		vkGetPhysicalDeviceProperties(devices[i], &props);
+
+		queue_family_indices_t indices = query_queue_families(devices[i], VK_NULL_HANDLE);
+
+		found = props.apiVersion >= VK_API_VERSION_1_1 && indices.compute_family != UINT32_MAX;
+	}
+
+	vkDestroyInstance(instance, HOST_ALLOC(INSTANCE));
+
+	return found;
+}
+
+/**
+ *	Bootstrap Vulkan for batch compute jobs only: no GLFW window,
+ *	no surface and no swapchain. Any device exposing a compute queue works,
+ *	eg. Mesa lavapipe on build boxes.
+ */
+void init_compute_headless(struct _application *ref)
+{
+	ref->headless = true;
+	ref->surface = VK_NULL_HANDLE;
+	ref->window = NULL;
+
+	gettimeofday(&ref->start_tv, NULL);
+
+	create_instance(ref);
+	setup_debug_messenger(ref);
+
+	init_physical_device(ref);
+
+	queue_family_indices_t indices = query_queue_families(PHYSDEV(0), VK_NULL_HANDLE);
+	if (indices.compute_family == UINT32_MAX) {
+		fprintf(stderr, "ERR: no compute capable queue family\n // Assertion: `compute_family != UINT32_MAX`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	init_logical_device(ref);
+	create_command_pool(ref);
+
+	ref->shaders = malloc(sizeof(shader_cache_t));
+	init_shader_cache(ref->shaders);
+
+	ref->vk_cache = malloc(sizeof(vk_cache_t));
+	init_vk_cache(ref->vk_cache);
+}
+
+/**
+ *	Destroy the objects created by `init_compute_headless()`.
+ */
+void cleanup_compute_headless(struct _application *ref)
+{
+	vkDeviceWaitIdle(ref->device);
+
+	vkDestroyCommandPool(ref->device, ref->cmd_pool, HOST_ALLOC(COMMAND_POOL));
+
+	destroy_shader_cache(ref, ref->shaders);
+	free(ref->shaders);
+	ref->shaders = NULL;
+
+	destroy_vk_cache(ref, ref->vk_cache);
+	free(ref->vk_cache);
+	ref->vk_cache = NULL;
+
+	destroy_mem_budget(ref->mem_budget);
+	free(ref->mem_budget);
+	ref->mem_budget = NULL;
+
+	vkDestroyDevice(ref->device, HOST_ALLOC(DEVICE));
+
+	if (ref->debug_messenger != VK_NULL_HANDLE) {
+		destroy_debug_utils_messenger_EXT(ref->vk_instance, ref->debug_messenger, HOST_ALLOC(DEBUG));
+	}
+
+	vkDestroyInstance(ref->vk_instance, HOST_ALLOC(INSTANCE));
+
+	array_free(&ref->physical_devices);
+}
+
+/**
+ *	Create a compute pipeline from a shader (see `SHADER_PATH()`). The descriptor set layout
+ *	is built from `bindings`, and `set_count` descriptor sets are allocated
+ *	up front so the same pipeline can be dispatched over several inputs.
+ */
+void create_compute_pipeline(struct _application *ref, const char *shader_path, const compute_binding_t *bindings, uint32_t binding_count,
+	uint32_t push_constant_size, uint32_t set_count, const VkSpecializationInfo *spec_info, compute_pipeline_t *pipeline)
+{
+	VkResult res;
+
+	if (binding_count > COMPUTE_MAX_BINDINGS) {
+		fprintf(stderr, "ERR: too many compute bindings\n // Assertion: `binding_count <= COMPUTE_MAX_BINDINGS`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	memcpy(pipeline->bindings, bindings, sizeof(compute_binding_t) * binding_count);
+	/**
+	 * Name the pipeline after its shader, eg. `shaders/scan.spv` -> `scan`.
+	 */
+
+	const char *base = strrchr(shader_path, '/') ? strrchr(shader_path, '/') + 1 : shader_path;
+	size_t name_len = strcspn(base, ".");
+
+	snprintf(pipeline->name, sizeof(pipeline->name), "%.*s", (int) name_len, base);
+
+	pipeline->binding_count = binding_count;
+	pipeline->push_constant_size = push_constant_size;
+
+	/**
+	 * Descriptor set layout & pool.
+	 */
+
+	VkDescriptorSetLayoutBinding layout_bindings[COMPUTE_MAX_BINDINGS] = {};
+	VkDescriptorPoolSize pool_sizes[COMPUTE_MAX_BINDINGS] = {};
+
+	for (uint32_t i = 0; i < binding_count; i++) {
+		layout_bindings[i].binding = bindings[i].binding;
+		layout_bindings[i].descriptorType = bindings[i].type;
+		layout_bindings[i].descriptorCount = 1;
+		layout_bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		layout_bindings[i].pImmutableSamplers = NULL;
+
+		pool_sizes[i].type = bindings[i].type;
+		pool_sizes[i].descriptorCount = set_count;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layout_info = {};
+	layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layout_info.bindingCount = binding_count;
+	layout_info.pBindings = layout_bindings;
+
+	/**
+	 * Kernels binding the same buffers share one layout.
+	 */
+
+	pipeline->set_layout = vk_cache_set_layout(ref, ref->vk_cache, &layout_info);
+
+	VkDescriptorPoolCreateInfo pool_info = {};
+	pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	pool_info.poolSizeCount = binding_count;
+	pool_info.pPoolSizes = pool_sizes;
+	pool_info.maxSets = set_count;
+
+	res = vkCreateDescriptorPool(ref->device, &pool_info, HOST_ALLOC(DESCRIPTOR), &pipeline->descriptor_pool);
+	if (res != VK_SUCCESS) {
+		fprintf(stderr, "ERR: failed to create compute descriptor pool\n // Assertion: `vkCreateDescriptorPool == VK_SUCCESS`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	VkDescriptorSetLayout layouts[set_count];
+	for (uint32_t i = 0; i < set_count; i++) {
+		layouts[i] = pipeline->set_layout;
+	}
+
+	VkDescriptorSetAllocateInfo alloc_info = {};
+	alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	alloc_info.descriptorPool = pipeline->descriptor_pool;
+	alloc_info.descriptorSetCount = set_count;
+	alloc_info.pSetLayouts = layouts;
+
+	array_init(&pipeline->descriptor_sets, sizeof(VkDescriptorSet));
+	array_resize(&pipeline->descriptor_sets, set_count, true);
+
+	res = vkAllocateDescriptorSets(ref->device, &alloc_info, (VkDescriptorSet *) array_data(&pipeline->descriptor_sets));
+	if (res != VK_SUCCESS) {
+		fprintf(stderr, "ERR: failed to allocate compute descriptor sets\n // Assertion: `vkAllocateDescriptorSets == VK_SUCCESS`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/**
+	 * Pipeline layout & pipeline.
+	 */
+
+	VkPushConstantRange push_range = {};
+	push_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	push_range.offset = 0;
+	push_range.size = push_constant_size;
+
+	VkPipelineLayoutCreateInfo pipeline_layout_ci = {};
+	pipeline_layout_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipeline_layout_ci.setLayoutCount = 1;
+	pipeline_layout_ci.pSetLayouts = &pipeline->set_layout;
+	pipeline_layout_ci.pushConstantRangeCount = push_constant_size > 0 ? 1 : 0;
+	pipeline_layout_ci.pPushConstantRanges = push_constant_size > 0 ? &push_range : NULL;
+
+	res = vkCreatePipelineLayout(ref->device, &pipeline_layout_ci, HOST_ALLOC(PIPELINE_LAYOUT), &pipeline->layout);
+	if (res != VK_SUCCESS) {
+		fprintf(stderr, "ERR: failed to create compute pipeline layout\n // Assertion: `vkCreatePipelineLayout == VK_SUCCESS`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	VkShaderModule comp = shader_cache_get(ref, ref->shaders, shader_path);
+
+	VkPipelineShaderStageCreateInfo stage_ci = {};
+	stage_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stage_ci.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	stage_ci.module = comp;
+	stage_ci.pName = "main";
+	stage_ci.pSpecializationInfo = spec_info;
+
+	VkComputePipelineCreateInfo pipeline_ci = {};
+	pipeline_ci.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipeline_ci.stage = stage_ci;
+	pipeline_ci.layout = pipeline->layout;
+	pipeline_ci.basePipelineHandle = VK_NULL_HANDLE;
+	pipeline_ci.basePipelineIndex = -1;
+
+	res = vkCreateComputePipelines(ref->device, VK_NULL_HANDLE, 1, &pipeline_ci, HOST_ALLOC(PIPELINE), &pipeline->pipeline);
+	if (res != VK_SUCCESS) {
+		fprintf(stderr, "ERR: failed to create compute pipeline\n // Assertion: `vkCreateComputePipelines == VK_SUCCESS`\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+void destroy_compute_pipeline(struct _application *ref, compute_pipeline_t *pipeline)
+{
+	vkDestroyPipeline(ref->device, pipeline->pipeline, HOST_ALLOC(PIPELINE));
+	vkDestroyPipelineLayout(ref->device, pipeline->layout, HOST_ALLOC(PIPELINE_LAYOUT));
+	vkDestroyDescriptorPool(ref->device, pipeline->descriptor_pool, HOST_ALLOC(DESCRIPTOR));
+	vk_cache_release_set_layout(ref->vk_cache, pipeline->set_layout);
+
+	array_free(&pipeline->descriptor_sets);
+}
+
+/**
+ *	Point `binding` of descriptor set `set_index` at a buffer range.
+ */
+void compute_bind_buffer(struct _application *ref, compute_pipeline_t *pipeline, uint32_t set_index, uint32_t binding,
+	VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+	VkDescriptorType type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+	for (uint32_t i = 0; i < pipeline->binding_count; i++) {
+		if (pipeline->bindings[i].binding == binding) {
+			type = pipeline->bindings[i].type;
+		}
+	}
+
+	VkDescriptorBufferInfo buffer_info = {};
+	buffer_info.buffer = buffer;
+	buffer_info.offset = offset;
+	buffer_info.range = range;
+
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = ((VkDescriptorSet *) array_data(&pipeline->descriptor_sets))[set_index];
+	write.dstBinding = binding;
+	write.dstArrayElement = 0;
+	write.descriptorType = type;
+	write.descriptorCount = 1;
+	write.pBufferInfo = &buffer_info;
+
+	vkUpdateDescriptorSets(ref->device, 1, &write, 0, NULL);
+}
+
+/**
+ *	Create a storage buffer through `create_buffer()`. Device local buffers
+ *	are filled through `compute_upload()`, host visible ones stay mapped.
+ */
+void create_compute_buffer(struct _application *ref, VkDeviceSize size, VkBufferUsageFlags usage, bool host_visible, compute_buffer_t *buf)
+{
+	VkBufferUsageFlags buffer_usage = usage | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+	VkMemoryPropertyFlags props = host_visible
+		? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+		: VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+	create_buffer(ref, size, buffer_usage, props, &buf->buffer, &buf->memory);
+
+	buf->size = size;
+	buf->mapped = NULL;
+
+	if (host_visible) {
+		vkMapMemory(ref->device, buf->memory, 0, size, 0, &buf->mapped);
+	}
+}
+
+void destroy_compute_buffer(struct _application *ref, compute_buffer_t *buf)
+{
+	if (buf->mapped) {
+		vkUnmapMemory(ref->device, buf->memory);
+	}
+
+	vkDestroyBuffer(ref->device, buf->buffer, HOST_ALLOC(BUFFER));
+	mem_budget_free(ref, buf->memory);
+
+	buf->buffer = VK_NULL_HANDLE;
+	buf->memory = VK_NULL_HANDLE;
+	buf->mapped = NULL;
+}
+
+/**
+ *	Copy host data into a compute buffer, staging it when the buffer
+ *	is not host visible.
+ */
+void compute_upload(struct _application *ref, compute_buffer_t *buf, const void *data, VkDeviceSize size)
+{
+	if (buf->mapped) {
+		memcpy(buf->mapped, data, (size_t) size);
+		return;
+	}
+
+	VkBuffer staging_buffer;
+	VkDeviceMemory staging_buffer_memory;
+	create_buffer(ref, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &staging_buffer, &staging_buffer_memory);
+
+	void *mapped;
+	vkMapMemory(ref->device, staging_buffer_memory, 0, size, 0, &mapped);
+	memcpy(mapped, data, (size_t) size);
+	vkUnmapMemory(ref->device, staging_buffer_memory);
+
+	copy_buffer(ref, staging_buffer, buf->buffer, size);
+
+	vkDestroyBuffer(ref->device, staging_buffer, HOST_ALLOC(BUFFER));
+	mem_budget_free(ref, staging_buffer_memory);
+}
+
+/**
+ *	Start recording a job. The command buffer and fence are created on first
+ *	use and recycled afterwards, so a job can be re-recorded every frame.
+ */
+void compute_job_begin(struct _application *ref, compute_job_t *job)
+{
+	VkResult res;
+
+	if (job->cmd_buffer == VK_NULL_HANDLE) {
+		VkCommandBufferAllocateInfo alloc_info = {};
+		alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		alloc_info.commandPool = ref->cmd_pool;
+		alloc_info.commandBufferCount = 1;
+
+		res = vkAllocateCommandBuffers(ref->device, &alloc_info, &job->cmd_buffer);
+		if (res != VK_SUCCESS) {
+			fprintf(stderr, "ERR: failed to allocate compute command buffer\n // Assertion: `vkAllocateCommandBuffers == VK_SUCCESS`\n");
+			exit(EXIT_FAILURE);
+		}
+
+		VkFenceCreateInfo fence_ci = {};
+		fence_ci.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+		res = vkCreateFence(ref->device, &fence_ci, HOST_ALLOC(SYNC), &job->fence);
+		if (res != VK_SUCCESS) {
+			fprintf(stderr, "ERR: failed to create compute fence\n // Assertion: `vkCreateFence == VK_SUCCESS`\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	else {
+		compute_job_wait(ref, job);
+
+		vkResetFences(ref->device, 1, &job->fence);
+		vkResetCommandBuffer(job->cmd_buffer, 0);
+	}
+
+	job->submitted = false;
+
+	VkCommandBufferBeginInfo begin_info = {};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	vkBeginCommandBuffer(job->cmd_buffer, &begin_info);
+
+	if (job->timer) {
+		gpu_timer_reset(job->timer, job->cmd_buffer, 0);
+	}
+}
+
+/**
+ *	Record a dispatch followed by a barrier making its writes visible to
+ *	later dispatches and transfers in the same job.
+ */
+void compute_cmd_dispatch(struct _application *ref, compute_job_t *job, compute_pipeline_t *pipeline, uint32_t set_index,
+	const void *push_data, uint32_t x, uint32_t y, uint32_t z)
+{
+	VkDescriptorSet set = ((VkDescriptorSet *) array_data(&pipeline->descriptor_sets))[set_index];
+
+	vkCmdBindPipeline(job->cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->pipeline);
+	vkCmdBindDescriptorSets(job->cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->layout, 0, 1, &set, 0, NULL);
+
+	if (pipeline->push_constant_size > 0 && push_data != NULL) {
+		vkCmdPushConstants(job->cmd_buffer, pipeline->layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, pipeline->push_constant_size, push_data);
+	}
+
+	uint32_t timer_slot = GPU_TIMER_NO_SLOT;
+
+	if (job->timer) {
+		timer_slot = gpu_timer_begin(job->timer, job->cmd_buffer, 0, gpu_timer_scope(job->timer, pipeline->name), false);
+	}
+
+	vkCmdDispatch(job->cmd_buffer, x, y, z);
+
+	if (job->timer) {
+		gpu_timer_end(job->timer, job->cmd_buffer, 0, timer_slot);
+	}
+
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+
+	vkCmdPipelineBarrier(
+		job->cmd_buffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0,
+		1, &barrier,
+		0, NULL,
+		0, NULL
+	);
+}
+
+/**
+ *	Record a fill of the whole buffer with a 32-bit value, eg. to clear counters.
+ */
+void compute_cmd_fill(struct _application *ref, compute_job_t *job, compute_buffer_t *buf, uint32_t value)
+{
+	vkCmdFillBuffer(job->cmd_buffer, buf->buffer, 0, VK_WHOLE_SIZE, value);
+
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(
+		job->cmd_buffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0,
+		1, &barrier,
+		0, NULL,
+		0, NULL
+	);
+}
+
+/**
+ *	Record a copy of `src` into the host visible `dst`. The data can be read
+ *	through `dst->mapped` once `compute_job_poll()` returns true.
+ */
+void compute_cmd_readback(struct _application *ref, compute_job_t *job, compute_buffer_t *src, compute_buffer_t *dst, VkDeviceSize size)
+{
+	VkBufferCopy copy_region = {};
+	copy_region.size = size;
+	vkCmdCopyBuffer(job->cmd_buffer, src->buffer, dst->buffer, 1, &copy_region);
+
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+	vkCmdPipelineBarrier(
+		job->cmd_buffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+		0,
+		1, &barrier,
+		0, NULL,
+		0, NULL
+	);
+}
+
+/**
+ *	End recording and submit the job without waiting on it.
+ */
+void compute_job_submit(struct _application *ref, compute_job_t *job)
+{
+	VkResult res = vkEndCommandBuffer(job->cmd_buffer);
+	if (res != VK_SUCCESS) {
+		fprintf(stderr, "ERR: failed to record compute command buffer\n // Assertion: `vkEndCommandBuffer == VK_SUCCESS`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	VkSubmitInfo submit_info = {};
+	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.commandBufferCount = 1;
+	submit_info.pCommandBuffers = &job->cmd_buffer;
+
+	res = vkQueueSubmit(ref->compute_queue, 1, &submit_info, job->fence);
+	if (res != VK_SUCCESS) {
+		fprintf(stderr, "ERR: failed to submit compute job\n // Assertion: `vkQueueSubmit == VK_SUCCESS`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	job->submitted = true;
+
+	if (job->timer) {
+		gpu_timer_submitted(job->timer, 0);
+	}
+}
+
+/**
+ *	Non blocking check for job completion.
+ */
+bool compute_job_poll(struct _application *ref, compute_job_t *job)
+{
+	if (!job->submitted) {
+		return false;
+	}
+
+	return vkGetFenceStatus(ref->device, job->fence) == VK_SUCCESS;
+}
+
+void compute_job_wait(struct _application *ref, compute_job_t *job)
+{
+	if (job->submitted) {
+		vkWaitForFences(ref->device, 1, &job->fence, VK_TRUE, UINT64_MAX);
+
+		if (job->timer) {
+			gpu_timer_collect(ref, job->timer, 0);
+		}
+	}
+}
+
+void destroy_compute_job(struct _application *ref, compute_job_t *job)
+{
+	if (job->cmd_buffer == VK_NULL_HANDLE) {
+		return;
+	}
+
+	compute_job_wait(ref, job);
+
+	vkFreeCommandBuffers(ref->device, ref->cmd_pool, 1, &job->cmd_buffer);
+	vkDestroyFence(ref->device, job->fence, HOST_ALLOC(SYNC));
+
+	job->cmd_buffer = VK_NULL_HANDLE;
+	job->fence = VK_NULL_HANDLE;
+	job->submitted = false;
+}
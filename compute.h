@@ -0,0 +1,108 @@
+#ifndef _COMPUTE_H_
+#define _COMPUTE_H_
+
+#include "application.h"
+#include "gpu_timer.h"
+
+#define COMPUTE_MAX_BINDINGS 16
+
+/**
+ *	Description of a single descriptor binding used by a compute shader.
+ */
+typedef struct _compute_binding_t
+{
+	uint32_t binding;
+	VkDescriptorType type;
+}
+compute_binding_t;
+
+/**
+ *	A compute pipeline together with its descriptor layout and a fixed
+ *	amount of descriptor sets allocated from a private pool.
+ */
+typedef struct _compute_pipeline_t
+{
+	char name[32];
+
+	VkDescriptorSetLayout set_layout;
+	VkPipelineLayout layout;
+	VkPipeline pipeline;
+
+	VkDescriptorPool descriptor_pool;
+	array descriptor_sets;
+
+	uint32_t binding_count;
+	compute_binding_t bindings[COMPUTE_MAX_BINDINGS];
+
+	uint32_t push_constant_size;
+}
+compute_pipeline_t;
+
+/**
+ *	Storage buffer used as compute input / output. Host visible buffers stay
+ *	persistently mapped in `mapped`.
+ */
+typedef struct _compute_buffer_t
+{
+	VkBuffer buffer;
+	VkDeviceMemory memory;
+	VkDeviceSize size;
+
+	void *mapped;
+}
+compute_buffer_t;
+
+/**
+ *	A recorded batch of dispatches and copies, submitted once and
+ *	signalling `fence` on completion. When `timer` is set, every dispatch is
+ *	timed under its pipeline's name in pool 0 of the timer.
+ */
+typedef struct _compute_job_t
+{
+	VkCommandBuffer cmd_buffer;
+	VkFence fence;
+
+	gpu_timer_t *timer;
+
+	bool submitted;
+}
+compute_job_t;
+
+bool compute_device_available();
+
+void init_compute_headless(struct _application *ref);
+
+void cleanup_compute_headless(struct _application *ref);
+
+void create_compute_pipeline(struct _application *ref, const char *shader_path, const compute_binding_t *bindings, uint32_t binding_count,
+	uint32_t push_constant_size, uint32_t set_count, const VkSpecializationInfo *spec_info, compute_pipeline_t *pipeline);
+
+void destroy_compute_pipeline(struct _application *ref, compute_pipeline_t *pipeline);
+
+void compute_bind_buffer(struct _application *ref, compute_pipeline_t *pipeline, uint32_t set_index, uint32_t binding,
+	VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+
+void create_compute_buffer(struct _application *ref, VkDeviceSize size, VkBufferUsageFlags usage, bool host_visible, compute_buffer_t *buf);
+
+void destroy_compute_buffer(struct _application *ref, compute_buffer_t *buf);
+
+void compute_upload(struct _application *ref, compute_buffer_t *buf, const void *data, VkDeviceSize size);
+
+void compute_job_begin(struct _application *ref, compute_job_t *job);
+
+void compute_cmd_dispatch(struct _application *ref, compute_job_t *job, compute_pipeline_t *pipeline, uint32_t set_index,
+	const void *push_data, uint32_t x, uint32_t y, uint32_t z);
+
+void compute_cmd_fill(struct _application *ref, compute_job_t *job, compute_buffer_t *buf, uint32_t value);
+
+void compute_cmd_readback(struct _application *ref, compute_job_t *job, compute_buffer_t *src, compute_buffer_t *dst, VkDeviceSize size);
+
+void compute_job_submit(struct _application *ref, compute_job_t *job);
+
+bool compute_job_poll(struct _application *ref, compute_job_t *job);
+
+void compute_job_wait(struct _application *ref, compute_job_t *job);
+
+void destroy_compute_job(struct _application *ref, compute_job_t *job);
+
+#endif
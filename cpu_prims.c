@@ -0,0 +1,615 @@
+#include "cpu_prims.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CPU_PRIMS_X86
+#endif
+
+#define CPU_RADIX 256
+#define CPU_MIN_CHUNK 16384
+
+/**
+ *	Per chunk kernels, selected once in `init_cpu_prims()`.
+ */
+
+typedef uint32_t (*reduce_kernel_fn)(const uint32_t *in, uint32_t n, prim_reduce_op_t op);
+typedef uint32_t (*scan_kernel_fn)(const uint32_t *in, uint32_t *out, uint32_t n, uint32_t carry, bool inclusive);
+typedef uint32_t (*count_kernel_fn)(const uint32_t *flags, uint32_t n);
+
+static reduce_kernel_fn reduce_kernel;
+static scan_kernel_fn scan_kernel;
+static count_kernel_fn count_kernel;
+
+static inline uint32_t combine(uint32_t a, uint32_t b, prim_reduce_op_t op)
+{
+	if (op == PRIM_REDUCE_MIN) {
+		return a < b ? a : b;
+	}
+
+	if (op == PRIM_REDUCE_MAX) {
+		return a > b ? a : b;
+	}
+
+	return a + b;
+}
+
+static inline uint32_t identity(prim_reduce_op_t op)
+{
+	return op == PRIM_REDUCE_MIN ? UINT32_MAX : 0;
+}
+
+/**
+ *	Scalar fallbacks.
+ */
+
+static uint32_t reduce_scalar(const uint32_t *in, uint32_t n, prim_reduce_op_t op)
+{
+	uint32_t acc = identity(op);
+
+	for (uint32_t i = 0; i < n; i++) {
+		acc = combine(acc, in[i], op);
+	}
+
+	return acc;
+}
+
+static uint32_t scan_scalar(const uint32_t *in, uint32_t *out, uint32_t n, uint32_t carry, bool inclusive)
+{
+	for (uint32_t i = 0; i < n; i++) {
+		uint32_t v = in[i];
+
+		if (inclusive) {
+			carry += v;
+			out[i] = carry;
+		}
+		else {
+			out[i] = carry;
+			carry += v;
+		}
+	}
+
+	return carry;
+}
+
+static uint32_t count_scalar(const uint32_t *flags, uint32_t n)
+{
+	uint32_t kept = 0;
+
+	for (uint32_t i = 0; i < n; i++) {
+		kept += flags[i] != 0;
+	}
+
+	return kept;
+}
+
+#ifdef CPU_PRIMS_X86
+
+/**
+ *	SSE4.1 kernels.
+ */
+
+__attribute__((target("sse4.1")))
+static uint32_t reduce_sse41(const uint32_t *in, uint32_t n, prim_reduce_op_t op)
+{
+	__m128i acc = _mm_set1_epi32((int) identity(op));
+	uint32_t i = 0;
+
+	switch (op) {
+	case PRIM_REDUCE_MIN:
+		for (; i + 4 <= n; i += 4) {
+			acc = _mm_min_epu32(acc, _mm_loadu_si128((const __m128i *) (in + i)));
+		}
+		break;
+	case PRIM_REDUCE_MAX:
+		for (; i + 4 <= n; i += 4) {
+			acc = _mm_max_epu32(acc, _mm_loadu_si128((const __m128i *) (in + i)));
+		}
+		break;
+	default:
+		for (; i + 4 <= n; i += 4) {
+			acc = _mm_add_epi32(acc, _mm_loadu_si128((const __m128i *) (in + i)));
+		}
+		break;
+	}
+
+	uint32_t lanes[4];
+	_mm_storeu_si128((__m128i *) lanes, acc);
+
+	uint32_t res = reduce_scalar(in + i, n - i, op);
+	for (int l = 0; l < 4; l++) {
+		res = combine(res, lanes[l], op);
+	}
+
+	return res;
+}
+
+__attribute__((target("sse4.1")))
+static uint32_t scan_sse41(const uint32_t *in, uint32_t *out, uint32_t n, uint32_t carry, bool inclusive)
+{
+	__m128i c = _mm_set1_epi32((int) carry);
+	uint32_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i *) (in + i));
+
+		__m128i x = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+		x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+		x = _mm_add_epi32(x, c);
+
+		_mm_storeu_si128((__m128i *) (out + i), inclusive ? x : _mm_sub_epi32(x, v));
+
+		c = _mm_shuffle_epi32(x, 0xff);
+	}
+
+	carry = (uint32_t) _mm_cvtsi128_si32(c);
+
+	return scan_scalar(in + i, out + i, n - i, carry, inclusive);
+}
+
+__attribute__((target("sse4.1,popcnt")))
+static uint32_t count_sse41(const uint32_t *flags, uint32_t n)
+{
+	const __m128i zero = _mm_setzero_si128();
+	uint32_t kept = 0;
+	uint32_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		__m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *) (flags + i)), zero);
+		kept += 4 - _mm_popcnt_u32((uint32_t) _mm_movemask_ps(_mm_castsi128_ps(eq)));
+	}
+
+	return kept + count_scalar(flags + i, n - i);
+}
+
+/**
+ *	AVX2 kernels.
+ */
+
+__attribute__((target("avx2")))
+static uint32_t reduce_avx2(const uint32_t *in, uint32_t n, prim_reduce_op_t op)
+{
+	__m256i acc = _mm256_set1_epi32((int) identity(op));
+	uint32_t i = 0;
+
+	switch (op) {
+	case PRIM_REDUCE_MIN:
+		for (; i + 8 <= n; i += 8) {
+			acc = _mm256_min_epu32(acc, _mm256_loadu_si256((const __m256i *) (in + i)));
+		}
+		break;
+	case PRIM_REDUCE_MAX:
+		for (; i + 8 <= n; i += 8) {
+			acc = _mm256_max_epu32(acc, _mm256_loadu_si256((const __m256i *) (in + i)));
+		}
+		break;
+	default:
+		for (; i + 8 <= n; i += 8) {
+			acc = _mm256_add_epi32(acc, _mm256_loadu_si256((const __m256i *) (in + i)));
+		}
+		break;
+	}
+
+	uint32_t lanes[8];
+	_mm256_storeu_si256((__m256i *) lanes, acc);
+
+	uint32_t res = reduce_scalar(in + i, n - i, op);
+	for (int l = 0; l < 8; l++) {
+		res = combine(res, lanes[l], op);
+	}
+
+	return res;
+}
+
+__attribute__((target("avx2")))
+static uint32_t scan_avx2(const uint32_t *in, uint32_t *out, uint32_t n, uint32_t carry, bool inclusive)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i idx3 = _mm256_set1_epi32(3);
+	const __m256i idx7 = _mm256_set1_epi32(7);
+
+	__m256i c = _mm256_set1_epi32((int) carry);
+	uint32_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		__m256i v = _mm256_loadu_si256((const __m256i *) (in + i));
+
+		/**
+		 * Scan both 128-bit lanes, then carry the low lane total into the high lane.
+		 */
+
+		__m256i x = _mm256_add_epi32(v, _mm256_slli_si256(v, 4));
+		x = _mm256_add_epi32(x, _mm256_slli_si256(x, 8));
+		x = _mm256_add_epi32(x, _mm256_blend_epi32(zero, _mm256_permutevar8x32_epi32(x, idx3), 0xf0));
+		x = _mm256_add_epi32(x, c);
+
+		_mm256_storeu_si256((__m256i *) (out + i), inclusive ? x : _mm256_sub_epi32(x, v));
+
+		c = _mm256_permutevar8x32_epi32(x, idx7);
+	}
+
+	carry = (uint32_t) _mm_cvtsi128_si32(_mm256_castsi256_si128(c));
+
+	return scan_scalar(in + i, out + i, n - i, carry, inclusive);
+}
+
+__attribute__((target("avx2,popcnt")))
+static uint32_t count_avx2(const uint32_t *flags, uint32_t n)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	uint32_t kept = 0;
+	uint32_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		__m256i eq = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *) (flags + i)), zero);
+		kept += 8 - _mm_popcnt_u32((uint32_t) _mm256_movemask_ps(_mm256_castsi256_ps(eq)));
+	}
+
+	return kept + count_scalar(flags + i, n - i);
+}
+
+#endif
+
+void init_cpu_prims(cpu_prims_t *prims, int threads)
+{
+	memset(prims, 0, sizeof(cpu_prims_t));
+
+	tpool_init(&prims->pool, threads);
+
+	reduce_kernel = reduce_scalar;
+	scan_kernel = scan_scalar;
+	count_kernel = count_scalar;
+
+#ifdef CPU_PRIMS_X86
+	__builtin_cpu_init();
+
+	prims->sse41 = __builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("popcnt");
+	prims->avx2 = prims->sse41 && __builtin_cpu_supports("avx2");
+
+	if (prims->avx2) {
+		reduce_kernel = reduce_avx2;
+		scan_kernel = scan_avx2;
+		count_kernel = count_avx2;
+	}
+	else if (prims->sse41) {
+		reduce_kernel = reduce_sse41;
+		scan_kernel = scan_sse41;
+		count_kernel = count_sse41;
+	}
+#endif
+}
+
+void destroy_cpu_prims(cpu_prims_t *prims)
+{
+	tpool_free(&prims->pool);
+
+	free(prims->scratch);
+	free(prims->chunk_data);
+
+	prims->scratch = NULL;
+	prims->chunk_data = NULL;
+}
+
+static uint32_t *reserve(uint32_t **ptr, size_t *size, size_t count)
+{
+	if (*size < count) {
+		free(*ptr);
+
+		*ptr = malloc(sizeof(uint32_t) * count);
+		*size = count;
+
+		if (*ptr == NULL) {
+			fprintf(stderr, "ERR: failed to allocate CPU primitive scratch\n // Assertion: `malloc != NULL`\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	return *ptr;
+}
+
+/**
+ *	One chunk per thread, small inputs stay on the calling thread.
+ */
+static uint32_t chunk_count(cpu_prims_t *prims, uint32_t count)
+{
+	uint32_t chunks = count / CPU_MIN_CHUNK;
+	uint32_t threads = (uint32_t) tpool_size(&prims->pool);
+
+	if (chunks > threads) {
+		chunks = threads;
+	}
+
+	return chunks > 0 ? chunks : 1;
+}
+
+static inline uint32_t chunk_begin(uint32_t count, uint32_t chunks, uint32_t chunk)
+{
+	return (uint32_t) (((uint64_t) count * chunk) / chunks);
+}
+
+/**
+ *	Reduce.
+ */
+
+typedef struct _reduce_ctx_t
+{
+	const uint32_t *in;
+	uint32_t count;
+	uint32_t chunks;
+	prim_reduce_op_t op;
+	uint32_t *partials;
+}
+reduce_ctx_t;
+
+static void reduce_task(void *arg, int chunk)
+{
+	reduce_ctx_t *ctx = arg;
+
+	uint32_t begin = chunk_begin(ctx->count, ctx->chunks, chunk);
+	uint32_t end = chunk_begin(ctx->count, ctx->chunks, chunk + 1);
+
+	ctx->partials[chunk] = reduce_kernel(ctx->in + begin, end - begin, ctx->op);
+}
+
+uint32_t cpu_reduce_u32(cpu_prims_t *prims, const uint32_t *in, uint32_t count, prim_reduce_op_t op)
+{
+	reduce_ctx_t ctx = {in, count, chunk_count(prims, count), op, NULL};
+	ctx.partials = reserve(&prims->chunk_data, &prims->chunk_data_size, ctx.chunks);
+
+	tpool_parallel_for(&prims->pool, (int) ctx.chunks, reduce_task, &ctx);
+
+	uint32_t res = identity(op);
+	for (uint32_t c = 0; c < ctx.chunks; c++) {
+		res = combine(res, ctx.partials[c], op);
+	}
+
+	return res;
+}
+
+/**
+ *	Scan: reduce every chunk, scan the chunk sums, then scan every chunk
+ *	again seeded with its prefix.
+ */
+
+typedef struct _scan_ctx_t
+{
+	const uint32_t *in;
+	uint32_t *out;
+	uint32_t count;
+	uint32_t chunks;
+	bool inclusive;
+	uint32_t *partials;
+}
+scan_ctx_t;
+
+static void scan_reduce_task(void *arg, int chunk)
+{
+	scan_ctx_t *ctx = arg;
+
+	uint32_t begin = chunk_begin(ctx->count, ctx->chunks, chunk);
+	uint32_t end = chunk_begin(ctx->count, ctx->chunks, chunk + 1);
+
+	ctx->partials[chunk] = reduce_kernel(ctx->in + begin, end - begin, PRIM_REDUCE_ADD);
+}
+
+static void scan_task(void *arg, int chunk)
+{
+	scan_ctx_t *ctx = arg;
+
+	uint32_t begin = chunk_begin(ctx->count, ctx->chunks, chunk);
+	uint32_t end = chunk_begin(ctx->count, ctx->chunks, chunk + 1);
+
+	scan_kernel(ctx->in + begin, ctx->out + begin, end - begin, ctx->partials[chunk], ctx->inclusive);
+}
+
+void cpu_scan_u32(cpu_prims_t *prims, const uint32_t *in, uint32_t *out, uint32_t count, bool inclusive)
+{
+	scan_ctx_t ctx = {in, out, count, chunk_count(prims, count), inclusive, NULL};
+	ctx.partials = reserve(&prims->chunk_data, &prims->chunk_data_size, ctx.chunks);
+
+	if (ctx.chunks > 1) {
+		tpool_parallel_for(&prims->pool, (int) ctx.chunks, scan_reduce_task, &ctx);
+	}
+
+	scan_scalar(ctx.partials, ctx.partials, ctx.chunks, 0, false);
+
+	tpool_parallel_for(&prims->pool, (int) ctx.chunks, scan_task, &ctx);
+}
+
+/**
+ *	Compaction: count kept elements per chunk, scan the counts, then every
+ *	chunk writes its survivors from its own output offset.
+ */
+
+typedef struct _compact_ctx_t
+{
+	const uint32_t *values;
+	const uint32_t *flags;
+	uint32_t *out;
+	uint32_t count;
+	uint32_t chunks;
+	uint32_t *offsets;
+}
+compact_ctx_t;
+
+static void compact_count_task(void *arg, int chunk)
+{
+	compact_ctx_t *ctx = arg;
+
+	uint32_t begin = chunk_begin(ctx->count, ctx->chunks, chunk);
+	uint32_t end = chunk_begin(ctx->count, ctx->chunks, chunk + 1);
+
+	ctx->offsets[chunk] = count_kernel(ctx->flags + begin, end - begin);
+}
+
+static void compact_scatter_task(void *arg, int chunk)
+{
+	compact_ctx_t *ctx = arg;
+
+	uint32_t begin = chunk_begin(ctx->count, ctx->chunks, chunk);
+	uint32_t end = chunk_begin(ctx->count, ctx->chunks, chunk + 1);
+	uint32_t pos = ctx->offsets[chunk];
+
+	for (uint32_t i = begin; i < end; i++) {
+		if (ctx->flags[i] != 0) {
+			ctx->out[pos++] = ctx->values[i];
+		}
+	}
+}
+
+uint32_t cpu_compact_u32(cpu_prims_t *prims, const uint32_t *values, const uint32_t *flags, uint32_t *out, uint32_t count)
+{
+	compact_ctx_t ctx = {values, flags, out, count, chunk_count(prims, count), NULL};
+	ctx.offsets = reserve(&prims->chunk_data, &prims->chunk_data_size, ctx.chunks);
+
+	tpool_parallel_for(&prims->pool, (int) ctx.chunks, compact_count_task, &ctx);
+
+	uint32_t kept = scan_scalar(ctx.offsets, ctx.offsets, ctx.chunks, 0, false);
+
+	tpool_parallel_for(&prims->pool, (int) ctx.chunks, compact_scatter_task, &ctx);
+
+	return kept;
+}
+
+/**
+ *	Radix sort: stable LSD, 8 bits per pass. Every chunk builds a digit
+ *	histogram, offsets are laid out digit-major over the chunks and every
+ *	chunk scatters its keys in order. Passes where all keys share the digit
+ *	are skipped.
+ */
+
+typedef struct _radix_ctx_t
+{
+	const uint32_t *src_keys;
+	uint32_t *dst_keys;
+	const uint32_t *src_values;
+	uint32_t *dst_values;
+
+	uint32_t count;
+	uint32_t chunks;
+	uint32_t shift;
+	uint32_t words;
+
+	uint32_t *hist;
+}
+radix_ctx_t;
+
+static inline uint32_t radix_digit(const uint32_t *keys, uint32_t i, uint32_t words, uint32_t shift)
+{
+	if (shift >= 32) {
+		return (keys[i * words + 1] >> (shift - 32)) & (CPU_RADIX - 1);
+	}
+
+	return (keys[i * words] >> shift) & (CPU_RADIX - 1);
+}
+
+static void radix_hist_task(void *arg, int chunk)
+{
+	radix_ctx_t *ctx = arg;
+
+	uint32_t begin = chunk_begin(ctx->count, ctx->chunks, chunk);
+	uint32_t end = chunk_begin(ctx->count, ctx->chunks, chunk + 1);
+
+	uint32_t *hist = ctx->hist + (size_t) chunk * CPU_RADIX;
+	memset(hist, 0, sizeof(uint32_t) * CPU_RADIX);
+
+	for (uint32_t i = begin; i < end; i++) {
+		hist[radix_digit(ctx->src_keys, i, ctx->words, ctx->shift)]++;
+	}
+}
+
+static void radix_scatter_task(void *arg, int chunk)
+{
+	radix_ctx_t *ctx = arg;
+
+	uint32_t begin = chunk_begin(ctx->count, ctx->chunks, chunk);
+	uint32_t end = chunk_begin(ctx->count, ctx->chunks, chunk + 1);
+
+	uint32_t *offsets = ctx->hist + (size_t) chunk * CPU_RADIX;
+
+	for (uint32_t i = begin; i < end; i++) {
+		uint32_t pos = offsets[radix_digit(ctx->src_keys, i, ctx->words, ctx->shift)]++;
+
+		if (ctx->words == 2) {
+			ctx->dst_keys[pos * 2] = ctx->src_keys[i * 2];
+			ctx->dst_keys[pos * 2 + 1] = ctx->src_keys[i * 2 + 1];
+		}
+		else {
+			ctx->dst_keys[pos] = ctx->src_keys[i];
+		}
+
+		if (ctx->dst_values) {
+			ctx->dst_values[pos] = ctx->src_values[i];
+		}
+	}
+}
+
+void cpu_radix_sort(cpu_prims_t *prims, uint32_t *keys, uint32_t *values, uint32_t count, uint32_t key_bits)
+{
+	if (count <= 1) {
+		return;
+	}
+
+	radix_ctx_t ctx = {};
+	ctx.count = count;
+	ctx.chunks = chunk_count(prims, count);
+	ctx.words = key_bits / 32;
+	ctx.hist = reserve(&prims->chunk_data, &prims->chunk_data_size, (size_t) ctx.chunks * CPU_RADIX);
+
+	size_t key_size = (size_t) count * ctx.words;
+	uint32_t *scratch = reserve(&prims->scratch, &prims->scratch_size, key_size + (values ? count : 0));
+
+	uint32_t *buf_keys[2] = {keys, scratch};
+	uint32_t *buf_values[2] = {values, values ? scratch + key_size : NULL};
+	int cur = 0;
+
+	for (uint32_t shift = 0; shift < key_bits; shift += 8) {
+		ctx.shift = shift;
+		ctx.src_keys = buf_keys[cur];
+		ctx.src_values = buf_values[cur];
+		ctx.dst_keys = buf_keys[cur ^ 1];
+		ctx.dst_values = buf_values[cur ^ 1];
+
+		tpool_parallel_for(&prims->pool, (int) ctx.chunks, radix_hist_task, &ctx);
+
+		/**
+		 * Digit-major exclusive scan over the per chunk histograms.
+		 */
+
+		uint32_t running = 0;
+		bool trivial = false;
+
+		for (uint32_t d = 0; d < CPU_RADIX; d++) {
+			uint32_t digit_total = 0;
+
+			for (uint32_t c = 0; c < ctx.chunks; c++) {
+				uint32_t n = ctx.hist[c * CPU_RADIX + d];
+				ctx.hist[c * CPU_RADIX + d] = running;
+				running += n;
+				digit_total += n;
+			}
+
+			if (digit_total == count) {
+				trivial = true;
+			}
+		}
+
+		if (trivial) {
+			continue;
+		}
+
+		tpool_parallel_for(&prims->pool, (int) ctx.chunks, radix_scatter_task, &ctx);
+		cur ^= 1;
+	}
+
+	if (cur != 0) {
+		memcpy(keys, buf_keys[1], sizeof(uint32_t) * key_size);
+
+		if (values) {
+			memcpy(values, buf_values[1], sizeof(uint32_t) * count);
+		}
+	}
+}
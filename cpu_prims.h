@@ -0,0 +1,41 @@
+#ifndef _CPU_PRIMS_H_
+#define _CPU_PRIMS_H_
+
+#include "prims.h"
+#include "lib/tpool.h"
+
+#include <stddef.h>
+
+/**
+ *	CPU reference implementation of the primitives. Work is split into one
+ *	chunk per thread, each chunk processed with AVX2 / SSE4.1 kernels when the
+ *	running CPU supports them and scalar code otherwise.
+ */
+typedef struct _cpu_prims_t
+{
+	tpool pool;
+
+	bool avx2;
+	bool sse41;
+
+	uint32_t *scratch;
+	size_t scratch_size;
+
+	uint32_t *chunk_data;
+	size_t chunk_data_size;
+}
+cpu_prims_t;
+
+void init_cpu_prims(cpu_prims_t *prims, int threads);
+
+void destroy_cpu_prims(cpu_prims_t *prims);
+
+uint32_t cpu_reduce_u32(cpu_prims_t *prims, const uint32_t *in, uint32_t count, prim_reduce_op_t op);
+
+void cpu_scan_u32(cpu_prims_t *prims, const uint32_t *in, uint32_t *out, uint32_t count, bool inclusive);
+
+uint32_t cpu_compact_u32(cpu_prims_t *prims, const uint32_t *values, const uint32_t *flags, uint32_t *out, uint32_t count);
+
+void cpu_radix_sort(cpu_prims_t *prims, uint32_t *keys, uint32_t *values, uint32_t count, uint32_t key_bits);
+
+#endif
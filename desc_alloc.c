@@ -0,0 +1,145 @@
+#include "desc_alloc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ *	Descriptors of each type per set in a pool.
+ */
+static const VkDescriptorPoolSize pool_ratios[] = {
+	{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2},
+	{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4},
+	{VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 2},
+	{VK_DESCRIPTOR_TYPE_SAMPLER, 1},
+	{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4},
+	{VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1}
+};
+
+#define POOL_RATIO_COUNT (sizeof(pool_ratios) / sizeof(pool_ratios[0]))
+
+static VkDescriptorPool create_pool(struct _application *ref, desc_alloc_t *alloc)
+{
+	VkDescriptorPoolSize sizes[POOL_RATIO_COUNT];
+
+	for (uint32_t i = 0; i < POOL_RATIO_COUNT; i++) {
+		sizes[i].type = pool_ratios[i].type;
+		sizes[i].descriptorCount = pool_ratios[i].descriptorCount * DESC_ALLOC_POOL_SETS;
+	}
+
+	VkDescriptorPoolCreateInfo pool_info = {};
+	pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	pool_info.poolSizeCount = POOL_RATIO_COUNT;
+	pool_info.pPoolSizes = sizes;
+	pool_info.maxSets = DESC_ALLOC_POOL_SETS;
+
+	VkDescriptorPool pool;
+
+	VkResult res = vkCreateDescriptorPool(ref->device, &pool_info, HOST_ALLOC(DESCRIPTOR), &pool);
+	if (res != VK_SUCCESS) {
+		fprintf(stderr, "ERR: failed to create descriptor pool\n // Assertion: `vkCreateDescriptorPool == VK_SUCCESS`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	alloc->pool_count++;
+
+	return pool;
+}
+
+static void init_pool_list(desc_pool_list_t *list)
+{
+	array_init(&list->pools, sizeof(VkDescriptorPool));
+	list->current = 0;
+}
+
+static void destroy_pool_list(struct _application *ref, desc_pool_list_t *list)
+{
+	for (int i = 0; i < array_size(&list->pools); i++) {
+		vkDestroyDescriptorPool(ref->device, ((VkDescriptorPool *) array_data(&list->pools))[i], HOST_ALLOC(DESCRIPTOR));
+	}
+
+	array_free(&list->pools);
+}
+
+/**
+ *	Allocate from the list's current pool, moving on to the next (or a new)
+ *	pool when it runs out.
+ */
+static VkDescriptorSet allocate_from(struct _application *ref, desc_alloc_t *alloc, desc_pool_list_t *list, VkDescriptorSetLayout layout)
+{
+	for (;;) {
+		bool fresh = false;
+
+		if (list->current == (uint32_t) array_size(&list->pools)) {
+			VkDescriptorPool pool = create_pool(ref, alloc);
+			array_append(&list->pools, &pool);
+			fresh = true;
+		}
+
+		VkDescriptorSetAllocateInfo alloc_info = {};
+		alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		alloc_info.descriptorPool = ((VkDescriptorPool *) array_data(&list->pools))[list->current];
+		alloc_info.descriptorSetCount = 1;
+		alloc_info.pSetLayouts = &layout;
+
+		VkDescriptorSet set;
+		VkResult res = vkAllocateDescriptorSets(ref->device, &alloc_info, &set);
+
+		if (res == VK_SUCCESS) {
+			return set;
+		}
+
+		if ((res != VK_ERROR_OUT_OF_POOL_MEMORY && res != VK_ERROR_FRAGMENTED_POOL) || fresh) {
+			fprintf(stderr, "ERR: failed to allocate descriptor set\n // Assertion: `vkAllocateDescriptorSets == VK_SUCCESS`\n");
+			exit(EXIT_FAILURE);
+		}
+
+		list->current++;
+	}
+}
+
+void init_desc_alloc(struct _application *ref, desc_alloc_t *alloc)
+{
+	memset(alloc, 0, sizeof(desc_alloc_t));
+
+	init_pool_list(&alloc->pools);
+	hashmap_init(&alloc->cache, sizeof(desc_cache_key_t), sizeof(VkDescriptorSet));
+}
+
+void destroy_desc_alloc(struct _application *ref, desc_alloc_t *alloc)
+{
+	destroy_pool_list(ref, &alloc->pools);
+
+	hashmap_free(&alloc->cache);
+}
+
+/**
+ *	Set for (`layout`, `key`), allocated on first use. `created`
+ *	(optional) is set when the set is new and has to be written.
+ */
+VkDescriptorSet desc_alloc_cached(struct _application *ref, desc_alloc_t *alloc, VkDescriptorSetLayout layout, uint64_t key, bool *created)
+{
+	desc_cache_key_t cache_key = {};
+	cache_key.layout = layout;
+	cache_key.key = key;
+
+	VkDescriptorSet *cached = hashmap_get(&alloc->cache, &cache_key);
+
+	if (created) {
+		*created = cached == NULL;
+	}
+
+	if (cached) {
+		return *cached;
+	}
+
+	VkDescriptorSet set = allocate_from(ref, alloc, &alloc->pools, layout);
+	hashmap_put(&alloc->cache, &cache_key, &set);
+
+	return set;
+}
+
+void desc_alloc_report(const desc_alloc_t *alloc)
+{
+	printf("Descriptor sets: %u cached, %u pools\n", hashmap_size((hashmap *) &alloc->cache), alloc->pool_count);
+}
@@ -0,0 +1,66 @@
+#ifndef _DESC_ALLOC_H_
+#define _DESC_ALLOC_H_
+
+#include "application.h"
+#include "lib/hashmap.h"
+
+/**
+ *	Sets per descriptor pool, each pool holds a few descriptors of every
+ *	common type per set (see `pool_ratios` in desc_alloc.c).
+ */
+#define DESC_ALLOC_POOL_SETS 128
+
+typedef struct _desc_pool_list_t
+{
+	array pools;
+
+	/**
+	 * Pool allocations are served from, the ones before it are full.
+	 */
+
+	uint32_t current;
+}
+desc_pool_list_t;
+
+/**
+ *	Key of a cached set, hashed as bytes (no padding).
+ */
+typedef struct _desc_cache_key_t
+{
+	VkDescriptorSetLayout layout;
+	uint64_t key;
+}
+desc_cache_key_t;
+
+/**
+ *	Descriptor set allocator. Sets are cached by layout and a caller chosen
+ *	key, and stay valid until `destroy_desc_alloc()`. `cache` maps
+ *	`desc_cache_key_t` to the set.
+ *
+ *	Pools are allocated without FREE_DESCRIPTOR_SET, a full pool moves
+ *	allocation on to the next one, created on demand, so the list never
+ *	runs out and only grows to the peak set count.
+ *
+ *	Not frame scoped: command buffers are recorded once per swapchain
+ *	image and bind the cached sets of that image, nothing records per
+ *	frame in flight that could bind a set reset with the frame's fence.
+ *	Per-frame pool lists belong here once draws are recorded every frame.
+ */
+typedef struct _desc_alloc_t
+{
+	desc_pool_list_t pools;
+	hashmap cache;
+
+	uint32_t pool_count;
+}
+desc_alloc_t;
+
+void init_desc_alloc(struct _application *ref, desc_alloc_t *alloc);
+
+void destroy_desc_alloc(struct _application *ref, desc_alloc_t *alloc);
+
+VkDescriptorSet desc_alloc_cached(struct _application *ref, desc_alloc_t *alloc, VkDescriptorSetLayout layout, uint64_t key, bool *created);
+
+void desc_alloc_report(const desc_alloc_t *alloc);
+
+#endif
@@ -0,0 +1,123 @@
+#include "frame_stats.h"
+#include "profiler.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const char *stat_names[FRAME_STAT_COUNT] = {"cpu_frame", "gpu_frame", "acquire", "fence_wait", "present"};
+
+void init_frame_stats(frame_stats_t *stats)
+{
+	for (int i = 0; i < FRAME_STAT_COUNT; i++) {
+		histogram_reset(&stats->window[i]);
+		histogram_reset(&stats->total[i]);
+	}
+
+	stats->frame_start_ns = 0;
+	stats->frames = 0;
+
+	gettimeofday(&stats->last_summary, NULL);
+}
+
+/**
+ *	Mark the start of a frame. The CPU frame time is the interval between
+ *	two frame starts, ie. what ends up on screen, waits included.
+ */
+void frame_stats_begin_frame(frame_stats_t *stats)
+{
+	uint64_t now = profiler_now_ns();
+
+	if (stats->frame_start_ns != 0) {
+		frame_stats_record(stats, FRAME_STAT_CPU_FRAME, now - stats->frame_start_ns);
+	}
+
+	stats->frame_start_ns = now;
+	stats->frames++;
+}
+
+void frame_stats_record(frame_stats_t *stats, frame_stat_t stat, uint64_t ns)
+{
+	histogram_record(&stats->window[stat], ns);
+	histogram_record(&stats->total[stat], ns);
+}
+
+uint64_t frame_stats_percentile(frame_stats_t *stats, frame_stat_t stat, double percentile, bool window)
+{
+	return histogram_percentile(window ? &stats->window[stat] : &stats->total[stat], percentile);
+}
+
+uint64_t frame_stats_max(frame_stats_t *stats, frame_stat_t stat, bool window)
+{
+	return window ? stats->window[stat].max : stats->total[stat].max;
+}
+
+/**
+ *	Print one line with p50 / p95 / p99 / max of every timing recorded since
+ *	the previous line, at most once every `interval_s` seconds.
+ */
+void frame_stats_summary(frame_stats_t *stats, double interval_s)
+{
+	struct timeval now;
+	gettimeofday(&now, NULL);
+
+	double elapsed = (now.tv_sec - stats->last_summary.tv_sec) + (now.tv_usec - stats->last_summary.tv_usec) * 1e-6;
+
+	if (elapsed < interval_s) {
+		return;
+	}
+
+	stats->last_summary = now;
+
+	printf("frames: %.1f fps", stats->window[FRAME_STAT_CPU_FRAME].total / elapsed);
+
+	for (int i = 0; i < FRAME_STAT_COUNT; i++) {
+		histogram *h = &stats->window[i];
+
+		if (h->total == 0) {
+			continue;
+		}
+
+		printf(" | %s p50 %.2f p95 %.2f p99 %.2f max %.2f ms", stat_names[i],
+			histogram_percentile(h, 50.0) * 1e-6, histogram_percentile(h, 95.0) * 1e-6,
+			histogram_percentile(h, 99.0) * 1e-6, h->max * 1e-6);
+
+		histogram_reset(h);
+	}
+
+	printf("\n");
+}
+
+/**
+ *	Write the whole-run statistics, in milliseconds.
+ */
+bool frame_stats_write_json(frame_stats_t *stats, const char *path)
+{
+	FILE *f = fopen(path, "w");
+
+	if (f == NULL) {
+		fprintf(stderr, "ERR: failed to open frame stats report `%s`\n", path);
+		return false;
+	}
+
+	fprintf(f, "{\n\t\"frames\": %llu", (unsigned long long) stats->frames);
+
+	for (int i = 0; i < FRAME_STAT_COUNT; i++) {
+		histogram *h = &stats->total[i];
+
+		fprintf(f, ",\n\t\"%s\": {\"samples\": %llu", stat_names[i], (unsigned long long) h->total);
+
+		if (h->total > 0) {
+			fprintf(f, ", \"min\": %.4f, \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"p999\": %.4f, \"max\": %.4f",
+				h->min * 1e-6, histogram_mean(h) * 1e-6, histogram_percentile(h, 50.0) * 1e-6,
+				histogram_percentile(h, 95.0) * 1e-6, histogram_percentile(h, 99.0) * 1e-6,
+				histogram_percentile(h, 99.9) * 1e-6, h->max * 1e-6);
+		}
+
+		fprintf(f, "}");
+	}
+
+	fprintf(f, "\n}\n");
+	fclose(f);
+
+	return true;
+}
@@ -0,0 +1,53 @@
+#ifndef _FRAME_STATS_H_
+#define _FRAME_STATS_H_
+
+#include "lib/histogram.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+#define FRAME_STATS_REPORT_PATH "frame_stats.json"
+
+typedef enum _frame_stat_t
+{
+	FRAME_STAT_CPU_FRAME = 0,
+	FRAME_STAT_GPU_FRAME = 1,
+	FRAME_STAT_ACQUIRE = 2,
+	FRAME_STAT_FENCE_WAIT = 3,
+	FRAME_STAT_PRESENT = 4,
+	FRAME_STAT_COUNT
+}
+frame_stat_t;
+
+/**
+ *	Frame timings in nanoseconds. `window` covers the time since the last
+ *	summary line and is cleared after printing it, `total` covers the run.
+ */
+typedef struct _frame_stats_t
+{
+	histogram window[FRAME_STAT_COUNT];
+	histogram total[FRAME_STAT_COUNT];
+
+	uint64_t frame_start_ns;
+	uint64_t frames;
+
+	struct timeval last_summary;
+}
+frame_stats_t;
+
+void init_frame_stats(frame_stats_t *stats);
+
+void frame_stats_begin_frame(frame_stats_t *stats);
+
+void frame_stats_record(frame_stats_t *stats, frame_stat_t stat, uint64_t ns);
+
+uint64_t frame_stats_percentile(frame_stats_t *stats, frame_stat_t stat, double percentile, bool window);
+
+uint64_t frame_stats_max(frame_stats_t *stats, frame_stat_t stat, bool window);
+
+void frame_stats_summary(frame_stats_t *stats, double interval_s);
+
+bool frame_stats_write_json(frame_stats_t *stats, const char *path);
+
+#endif
@@ -0,0 +1,553 @@
+#include "gpu_prims.h"
+#include "shader_cache.h"
+
+#include <string.h>
+
+#define PRIM_RADIX 256
+#define PRIM_SCAN_SETS 3
+
+enum
+{
+	SCAN_SET_USER = 0,
+	SCAN_SET_COMPACT = 1,
+	SCAN_SET_RADIX = 2
+};
+
+typedef struct _scan_push_t
+{
+	uint32_t count;
+	uint32_t inclusive;
+	uint32_t flags_only;
+}
+scan_push_t;
+
+typedef struct _radix_push_t
+{
+	uint32_t count;
+	uint32_t shift;
+	uint32_t key_words;
+	uint32_t num_tiles;
+	uint32_t has_values;
+}
+radix_push_t;
+
+/**
+ *	Query subgroup support. Vulkan 1.1 with arithmetic and ballot operations
+ *	in compute shaders is required by the primitive shaders.
+ */
+static bool query_subgroup_props(struct _application *ref, VkPhysicalDeviceSubgroupProperties *subgroup_props, VkPhysicalDeviceProperties *dev_props)
+{
+	vkGetPhysicalDeviceProperties(PHYSDEV(0), dev_props);
+
+	if (dev_props->apiVersion < VK_API_VERSION_1_1) {
+		return false;
+	}
+
+	subgroup_props->sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+	subgroup_props->pNext = NULL;
+
+	VkPhysicalDeviceProperties2 props2 = {};
+	props2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	props2.pNext = subgroup_props;
+
+	vkGetPhysicalDeviceProperties2(PHYSDEV(0), &props2);
+
+	VkSubgroupFeatureFlags required = VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_ARITHMETIC_BIT | VK_SUBGROUP_FEATURE_BALLOT_BIT;
+
+	return (subgroup_props->supportedStages & VK_SHADER_STAGE_COMPUTE_BIT)
+		&& (subgroup_props->supportedOperations & required) == required;
+}
+
+/**
+ *	Grow a scratch buffer to at least `size` bytes. Contents are not preserved.
+ */
+static void reserve_buffer(struct _application *ref, compute_buffer_t *buf, VkDeviceSize size, bool host_visible)
+{
+	if (buf->buffer != VK_NULL_HANDLE && buf->size >= size) {
+		return;
+	}
+
+	VkDeviceSize new_size = buf->size * 2 > size ? buf->size * 2 : size;
+
+	if (buf->buffer != VK_NULL_HANDLE) {
+		destroy_compute_buffer(ref, buf);
+	}
+
+	create_compute_buffer(ref, new_size, 0, host_visible, buf);
+}
+
+static uint32_t tile_count(gpu_prims_t *prims, uint32_t count)
+{
+	uint32_t tile = prims->workgroup_size * prims->items_per_thread;
+	return (count + tile - 1) / tile;
+}
+
+void init_gpu_prims(struct _application *ref, gpu_prims_t *prims)
+{
+	memset(prims, 0, sizeof(gpu_prims_t));
+
+	VkPhysicalDeviceSubgroupProperties subgroup_props = {};
+	VkPhysicalDeviceProperties dev_props = {};
+
+	if (!query_subgroup_props(ref, &subgroup_props, &dev_props)) {
+		fprintf(stderr, "WARN: device lacks subgroup arithmetic / ballot support in compute, GPU primitives disabled\n");
+		return;
+	}
+
+	/**
+	 * Eight subgroups per workgroup, kept within [64, 256] invocations and the
+	 * device limits. The shaders reserve room for at most 64 subgroup partials.
+	 */
+
+	uint32_t sg = subgroup_props.subgroupSize;
+	uint32_t wg = sg * 8;
+
+	if (wg < 64) {
+		wg = 64;
+	}
+
+	if (wg > 256) {
+		wg = 256;
+	}
+
+	if (wg > dev_props.limits.maxComputeWorkGroupSize[0]) {
+		wg = dev_props.limits.maxComputeWorkGroupSize[0];
+	}
+
+	if (wg > dev_props.limits.maxComputeWorkGroupInvocations) {
+		wg = dev_props.limits.maxComputeWorkGroupInvocations;
+	}
+
+	wg -= wg % sg;
+
+	prims->supported = true;
+	prims->subgroup_size = sg;
+	prims->workgroup_size = wg;
+	prims->items_per_thread = 4;
+
+	uint32_t spec_data[2] = {prims->workgroup_size, prims->items_per_thread};
+
+	VkSpecializationMapEntry spec_entries[2] = {};
+	spec_entries[0].constantID = 0;
+	spec_entries[0].offset = 0;
+	spec_entries[0].size = sizeof(uint32_t);
+	spec_entries[1].constantID = 1;
+	spec_entries[1].offset = sizeof(uint32_t);
+	spec_entries[1].size = sizeof(uint32_t);
+
+	VkSpecializationInfo spec_info = {};
+	spec_info.mapEntryCount = 2;
+	spec_info.pMapEntries = spec_entries;
+	spec_info.dataSize = sizeof(spec_data);
+	spec_info.pData = spec_data;
+
+	compute_binding_t storage[5] = {
+		{0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER},
+		{1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER},
+		{2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER},
+		{3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER},
+		{4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER}
+	};
+
+	create_compute_pipeline(ref, SHADER_PATH("reduce.comp", "reduce.spv"), storage, 2, sizeof(uint32_t) * 2, 1, &spec_info, &prims->reduce);
+	create_compute_pipeline(ref, SHADER_PATH("scan.comp", "scan.spv"), storage, 3, sizeof(scan_push_t), PRIM_SCAN_SETS, &spec_info, &prims->scan);
+	create_compute_pipeline(ref, SHADER_PATH("compact.comp", "compact.spv"), storage, 5, sizeof(uint32_t), 1, &spec_info, &prims->compact);
+	create_compute_pipeline(ref, SHADER_PATH("radix_hist.comp", "radix_hist.spv"), storage, 2, sizeof(uint32_t) * 4, 2, &spec_info, &prims->radix_hist);
+	create_compute_pipeline(ref, SHADER_PATH("radix_scatter.comp", "radix_scatter.spv"), storage, 5, sizeof(radix_push_t), 2, &spec_info, &prims->radix_scatter);
+
+	create_compute_buffer(ref, sizeof(uint32_t), 0, false, &prims->result);
+	create_compute_buffer(ref, sizeof(uint32_t), 0, true, &prims->readback);
+
+	printf("gpu_prims: subgroup %u, workgroup %u, %u items / invocation\n", prims->subgroup_size, prims->workgroup_size, prims->items_per_thread);
+}
+
+void destroy_gpu_prims(struct _application *ref, gpu_prims_t *prims)
+{
+	if (!prims->supported) {
+		return;
+	}
+
+	destroy_compute_job(ref, &prims->job);
+
+	destroy_compute_pipeline(ref, &prims->reduce);
+	destroy_compute_pipeline(ref, &prims->scan);
+	destroy_compute_pipeline(ref, &prims->compact);
+	destroy_compute_pipeline(ref, &prims->radix_hist);
+	destroy_compute_pipeline(ref, &prims->radix_scatter);
+
+	compute_buffer_t *buffers[] = {
+		&prims->tile_state, &prims->hist, &prims->scratch_keys, &prims->scratch_values,
+		&prims->scratch_offsets, &prims->result, &prims->readback
+	};
+
+	for (size_t i = 0; i < sizeof(buffers) / sizeof(buffers[0]); i++) {
+		if (buffers[i]->buffer != VK_NULL_HANDLE) {
+			destroy_compute_buffer(ref, buffers[i]);
+		}
+	}
+
+	prims->supported = false;
+}
+
+/**
+ *	Bind the scan pipeline for a (possibly in-place) scan of `count` elements.
+ *	Must be called before recording, `prims->tile_state` sized for the largest
+ *	scan in the job.
+ */
+static void bind_scan(struct _application *ref, gpu_prims_t *prims, uint32_t set_index, VkBuffer in, VkBuffer out)
+{
+	compute_bind_buffer(ref, &prims->scan, set_index, 0, in, 0, VK_WHOLE_SIZE);
+	compute_bind_buffer(ref, &prims->scan, set_index, 1, out, 0, VK_WHOLE_SIZE);
+	compute_bind_buffer(ref, &prims->scan, set_index, 2, prims->tile_state.buffer, 0, VK_WHOLE_SIZE);
+}
+
+static void record_scan(struct _application *ref, gpu_prims_t *prims, uint32_t set_index, uint32_t count, bool inclusive, bool flags_only)
+{
+	scan_push_t push = {count, inclusive ? 1 : 0, flags_only ? 1 : 0};
+
+	compute_cmd_fill(ref, &prims->job, &prims->tile_state, 0);
+	compute_cmd_dispatch(ref, &prims->job, &prims->scan, set_index, &push, tile_count(prims, count), 1, 1);
+}
+
+static void reserve_tile_state(struct _application *ref, gpu_prims_t *prims, uint32_t count)
+{
+	reserve_buffer(ref, &prims->tile_state, sizeof(uint32_t) * (1 + 3 * (VkDeviceSize) tile_count(prims, count)), false);
+}
+
+uint32_t gpu_reduce_u32(struct _application *ref, gpu_prims_t *prims, compute_buffer_t *in, uint32_t count, prim_reduce_op_t op)
+{
+	uint32_t push[2] = {count, (uint32_t) op};
+	uint32_t identity = op == PRIM_REDUCE_MIN ? UINT32_MAX : 0;
+
+	compute_bind_buffer(ref, &prims->reduce, 0, 0, in->buffer, 0, VK_WHOLE_SIZE);
+	compute_bind_buffer(ref, &prims->reduce, 0, 1, prims->result.buffer, 0, VK_WHOLE_SIZE);
+
+	compute_job_begin(ref, &prims->job);
+	compute_cmd_fill(ref, &prims->job, &prims->result, identity);
+
+	if (count > 0) {
+		compute_cmd_dispatch(ref, &prims->job, &prims->reduce, 0, push, tile_count(prims, count), 1, 1);
+	}
+
+	compute_cmd_readback(ref, &prims->job, &prims->result, &prims->readback, sizeof(uint32_t));
+	compute_job_submit(ref, &prims->job);
+	compute_job_wait(ref, &prims->job);
+
+	return *(uint32_t *) prims->readback.mapped;
+}
+
+void gpu_scan_u32(struct _application *ref, gpu_prims_t *prims, compute_buffer_t *in, compute_buffer_t *out, uint32_t count, bool inclusive)
+{
+	if (count == 0) {
+		return;
+	}
+
+	reserve_tile_state(ref, prims, count);
+	bind_scan(ref, prims, SCAN_SET_USER, in->buffer, out->buffer);
+
+	compute_job_begin(ref, &prims->job);
+	record_scan(ref, prims, SCAN_SET_USER, count, inclusive, false);
+	compute_job_submit(ref, &prims->job);
+	compute_job_wait(ref, &prims->job);
+}
+
+/**
+ *	Copy every `values[i]` with a non zero `flags[i]` to the front of `out`,
+ *	preserving order. Returns the amount of elements kept.
+ */
+uint32_t gpu_compact_u32(struct _application *ref, gpu_prims_t *prims, compute_buffer_t *values, compute_buffer_t *flags,
+	compute_buffer_t *out, uint32_t count)
+{
+	if (count == 0) {
+		return 0;
+	}
+
+	reserve_tile_state(ref, prims, count);
+	reserve_buffer(ref, &prims->scratch_offsets, sizeof(uint32_t) * (VkDeviceSize) count, false);
+
+	bind_scan(ref, prims, SCAN_SET_COMPACT, flags->buffer, prims->scratch_offsets.buffer);
+
+	compute_bind_buffer(ref, &prims->compact, 0, 0, values->buffer, 0, VK_WHOLE_SIZE);
+	compute_bind_buffer(ref, &prims->compact, 0, 1, flags->buffer, 0, VK_WHOLE_SIZE);
+	compute_bind_buffer(ref, &prims->compact, 0, 2, prims->scratch_offsets.buffer, 0, VK_WHOLE_SIZE);
+	compute_bind_buffer(ref, &prims->compact, 0, 3, out->buffer, 0, VK_WHOLE_SIZE);
+	compute_bind_buffer(ref, &prims->compact, 0, 4, prims->result.buffer, 0, VK_WHOLE_SIZE);
+
+	compute_job_begin(ref, &prims->job);
+	record_scan(ref, prims, SCAN_SET_COMPACT, count, false, true);
+	compute_cmd_dispatch(ref, &prims->job, &prims->compact, 0, &count, tile_count(prims, count), 1, 1);
+	compute_cmd_readback(ref, &prims->job, &prims->result, &prims->readback, sizeof(uint32_t));
+	compute_job_submit(ref, &prims->job);
+	compute_job_wait(ref, &prims->job);
+
+	return *(uint32_t *) prims->readback.mapped;
+}
+
+/**
+ *	Stable LSD radix sort, 8 bits per pass. `key_bits` is 32 or 64, 64-bit keys
+ *	are stored as (low, high) word pairs. `values` is optional (NULL) and holds
+ *	one 32-bit payload per key. The sorted data ends up in the input buffers.
+ */
+void gpu_radix_sort(struct _application *ref, gpu_prims_t *prims, compute_buffer_t *keys, compute_buffer_t *values,
+	uint32_t count, uint32_t key_bits)
+{
+	if (count <= 1) {
+		return;
+	}
+
+	uint32_t key_words = key_bits / 32;
+	uint32_t passes = key_bits / 8;
+	uint32_t num_tiles = tile_count(prims, count);
+	uint32_t hist_count = PRIM_RADIX * num_tiles;
+
+	reserve_tile_state(ref, prims, hist_count);
+	reserve_buffer(ref, &prims->hist, sizeof(uint32_t) * (VkDeviceSize) hist_count, false);
+	reserve_buffer(ref, &prims->scratch_keys, sizeof(uint32_t) * (VkDeviceSize) count * key_words, false);
+
+	if (values) {
+		reserve_buffer(ref, &prims->scratch_values, sizeof(uint32_t) * (VkDeviceSize) count, false);
+	}
+
+	bind_scan(ref, prims, SCAN_SET_RADIX, prims->hist.buffer, prims->hist.buffer);
+
+	for (uint32_t parity = 0; parity < 2; parity++) {
+		compute_buffer_t *src_keys = parity == 0 ? keys : &prims->scratch_keys;
+		compute_buffer_t *dst_keys = parity == 0 ? &prims->scratch_keys : keys;
+		compute_buffer_t *src_values = values ? (parity == 0 ? values : &prims->scratch_values) : src_keys;
+		compute_buffer_t *dst_values = values ? (parity == 0 ? &prims->scratch_values : values) : dst_keys;
+
+		compute_bind_buffer(ref, &prims->radix_hist, parity, 0, src_keys->buffer, 0, VK_WHOLE_SIZE);
+		compute_bind_buffer(ref, &prims->radix_hist, parity, 1, prims->hist.buffer, 0, VK_WHOLE_SIZE);
+
+		compute_bind_buffer(ref, &prims->radix_scatter, parity, 0, src_keys->buffer, 0, VK_WHOLE_SIZE);
+		compute_bind_buffer(ref, &prims->radix_scatter, parity, 1, dst_keys->buffer, 0, VK_WHOLE_SIZE);
+		compute_bind_buffer(ref, &prims->radix_scatter, parity, 2, src_values->buffer, 0, VK_WHOLE_SIZE);
+		compute_bind_buffer(ref, &prims->radix_scatter, parity, 3, dst_values->buffer, 0, VK_WHOLE_SIZE);
+		compute_bind_buffer(ref, &prims->radix_scatter, parity, 4, prims->hist.buffer, 0, VK_WHOLE_SIZE);
+	}
+
+	compute_job_begin(ref, &prims->job);
+
+	for (uint32_t pass = 0; pass < passes; pass++) {
+		radix_push_t push = {count, pass * 8, key_words, num_tiles, values ? 1 : 0};
+
+		compute_cmd_dispatch(ref, &prims->job, &prims->radix_hist, pass % 2, &push, num_tiles, 1, 1);
+		record_scan(ref, prims, SCAN_SET_RADIX, hist_count, false, false);
+		compute_cmd_dispatch(ref, &prims->job, &prims->radix_scatter, pass % 2, &push, num_tiles, 1, 1);
+	}
+
+	compute_job_submit(ref, &prims->job);
+	compute_job_wait(ref, &prims->job);
+}
+
+/**
+ *	Benchmarks & CPU reference checks.
+ */
+
+typedef struct _sort_ref_t
+{
+	uint64_t key;
+	uint32_t index;
+}
+sort_ref_t;
+
+static int cmp_sort_ref(const void *a, const void *b)
+{
+	const sort_ref_t *x = a;
+	const sort_ref_t *y = b;
+
+	if (x->key != y->key) {
+		return x->key < y->key ? -1 : 1;
+	}
+
+	return x->index < y->index ? -1 : (x->index > y->index);
+}
+
+static void bench_report(const char *name, uint32_t n, double seconds, int iterations, bool ok)
+{
+	printf("%-12s n=%-9u %10.2f Melem/s  %s\n", name, n, (n * (double) iterations) / seconds * 1e-6, ok ? "ok" : "MISMATCH");
+}
+
+/**
+ *	Run every primitive over sizes from 1K to 16M elements, check the
+ *	results against a CPU reference and print throughput in elements per second.
+ */
+void bench_gpu_prims(struct _application *ref)
+{
+	gpu_prims_t prims;
+	init_gpu_prims(ref, &prims);
+
+	if (!prims.supported) {
+		return;
+	}
+
+	/**
+	 * Per dispatch GPU time, averaged over the submissions of each size.
+	 */
+
+	gpu_timer_t timer;
+	init_gpu_timer(ref, &timer, ref->compute_queue_family_index, 1, false);
+	prims.job.timer = &timer;
+
+	uint64_t seed = 0x9e3779b97f4a7c15ull;
+
+	for (uint32_t n = 1 << 10; n <= (1 << 24); n <<= 2) {
+
+		int iterations = n >= (1 << 20) ? 5 : 20;
+
+		uint32_t *data = malloc(sizeof(uint32_t) * n * 2);
+		uint32_t *flags = malloc(sizeof(uint32_t) * n);
+		uint32_t *expected = malloc(sizeof(uint32_t) * n * 2);
+		sort_ref_t *sorted = malloc(sizeof(sort_ref_t) * n);
+
+		for (uint32_t i = 0; i < n * 2; i++) {
+			data[i] = bench_rand(&seed);
+		}
+
+		for (uint32_t i = 0; i < n; i++) {
+			flags[i] = data[i] & 1;
+		}
+
+		compute_buffer_t in = {}, out = {}, flag_buf = {}, values = {}, host = {};
+		create_compute_buffer(ref, sizeof(uint32_t) * n * 2, 0, false, &in);
+		create_compute_buffer(ref, sizeof(uint32_t) * n, 0, false, &out);
+		create_compute_buffer(ref, sizeof(uint32_t) * n, 0, false, &flag_buf);
+		create_compute_buffer(ref, sizeof(uint32_t) * n, 0, false, &values);
+		create_compute_buffer(ref, sizeof(uint32_t) * n * 2, 0, true, &host);
+
+		compute_upload(ref, &in, data, sizeof(uint32_t) * n);
+		compute_upload(ref, &flag_buf, flags, sizeof(uint32_t) * n);
+
+		/**
+		 * Reduce.
+		 */
+
+		uint32_t sum = 0;
+		for (uint32_t i = 0; i < n; i++) {
+			sum += data[i];
+		}
+
+		uint32_t got = 0;
+		double t0 = now_seconds();
+		for (int it = 0; it < iterations; it++) {
+			got = gpu_reduce_u32(ref, &prims, &in, n, PRIM_REDUCE_ADD);
+		}
+		bench_report("reduce", n, now_seconds() - t0, iterations, got == sum);
+
+		/**
+		 * Exclusive scan.
+		 */
+
+		uint32_t running = 0;
+		for (uint32_t i = 0; i < n; i++) {
+			expected[i] = running;
+			running += data[i];
+		}
+
+		t0 = now_seconds();
+		for (int it = 0; it < iterations; it++) {
+			gpu_scan_u32(ref, &prims, &in, &out, n, false);
+		}
+		double elapsed = now_seconds() - t0;
+
+		compute_job_begin(ref, &prims.job);
+		compute_cmd_readback(ref, &prims.job, &out, &host, sizeof(uint32_t) * n);
+		compute_job_submit(ref, &prims.job);
+		compute_job_wait(ref, &prims.job);
+
+		bench_report("scan", n, elapsed, iterations, memcmp(host.mapped, expected, sizeof(uint32_t) * n) == 0);
+
+		/**
+		 * Stream compaction.
+		 */
+
+		uint32_t kept = 0;
+		for (uint32_t i = 0; i < n; i++) {
+			if (flags[i]) {
+				expected[kept++] = data[i];
+			}
+		}
+
+		got = 0;
+		t0 = now_seconds();
+		for (int it = 0; it < iterations; it++) {
+			got = gpu_compact_u32(ref, &prims, &in, &flag_buf, &out, n);
+		}
+		elapsed = now_seconds() - t0;
+
+		compute_job_begin(ref, &prims.job);
+		compute_cmd_readback(ref, &prims.job, &out, &host, sizeof(uint32_t) * n);
+		compute_job_submit(ref, &prims.job);
+		compute_job_wait(ref, &prims.job);
+
+		bench_report("compact", n, elapsed, iterations, got == kept && memcmp(host.mapped, expected, sizeof(uint32_t) * kept) == 0);
+
+		/**
+		 * Key-value radix sort, 32 and 64-bit keys.
+		 */
+
+		for (uint32_t key_bits = 32; key_bits <= 64; key_bits += 32) {
+			uint32_t words = key_bits / 32;
+
+			for (uint32_t i = 0; i < n; i++) {
+				sorted[i].key = words == 2 ? ((uint64_t) data[i * 2 + 1] << 32) | data[i * 2] : data[i];
+				sorted[i].index = i;
+				flags[i] = i;
+			}
+
+			qsort(sorted, n, sizeof(sort_ref_t), cmp_sort_ref);
+
+			for (uint32_t i = 0; i < n; i++) {
+				expected[i * words] = (uint32_t) sorted[i].key;
+				if (words == 2) {
+					expected[i * words + 1] = (uint32_t) (sorted[i].key >> 32);
+				}
+			}
+
+			elapsed = 0.0;
+
+			for (int it = 0; it < iterations; it++) {
+				compute_upload(ref, &in, data, sizeof(uint32_t) * n * words);
+				compute_upload(ref, &values, flags, sizeof(uint32_t) * n);
+
+				t0 = now_seconds();
+				gpu_radix_sort(ref, &prims, &in, &values, n, key_bits);
+				elapsed += now_seconds() - t0;
+			}
+
+			compute_job_begin(ref, &prims.job);
+			compute_cmd_readback(ref, &prims.job, &in, &host, sizeof(uint32_t) * n * words);
+			compute_job_submit(ref, &prims.job);
+			compute_job_wait(ref, &prims.job);
+
+			bool ok = memcmp(host.mapped, expected, sizeof(uint32_t) * n * words) == 0;
+
+			compute_job_begin(ref, &prims.job);
+			compute_cmd_readback(ref, &prims.job, &values, &host, sizeof(uint32_t) * n);
+			compute_job_submit(ref, &prims.job);
+			compute_job_wait(ref, &prims.job);
+
+			for (uint32_t i = 0; i < n && ok; i++) {
+				ok = ((uint32_t *) host.mapped)[i] == sorted[i].index;
+			}
+
+			bench_report(key_bits == 32 ? "sort32 kv" : "sort64 kv", n, elapsed, iterations, ok);
+		}
+
+		destroy_compute_buffer(ref, &in);
+		destroy_compute_buffer(ref, &out);
+		destroy_compute_buffer(ref, &flag_buf);
+		destroy_compute_buffer(ref, &values);
+		destroy_compute_buffer(ref, &host);
+
+		free(data);
+		free(flags);
+		free(expected);
+		free(sorted);
+
+		gpu_timer_log(&timer, 0.0);
+	}
+
+	destroy_gpu_prims(ref, &prims);
+	destroy_gpu_timer(ref, &timer);
+}
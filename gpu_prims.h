@@ -0,0 +1,54 @@
+#ifndef _GPU_PRIMS_H_
+#define _GPU_PRIMS_H_
+
+#include "compute.h"
+#include "prims.h"
+
+/**
+ *	Data-parallel primitives on top of the compute module.
+ *	Workgroup size and items per thread are picked from
+ *	`VkPhysicalDeviceSubgroupProperties` and baked in as specialization constants.
+ */
+typedef struct _gpu_prims_t
+{
+	bool supported;
+
+	uint32_t subgroup_size;
+	uint32_t workgroup_size;
+	uint32_t items_per_thread;
+
+	compute_pipeline_t reduce;
+	compute_pipeline_t scan;
+	compute_pipeline_t compact;
+	compute_pipeline_t radix_hist;
+	compute_pipeline_t radix_scatter;
+
+	compute_buffer_t tile_state;
+	compute_buffer_t hist;
+	compute_buffer_t scratch_keys;
+	compute_buffer_t scratch_values;
+	compute_buffer_t scratch_offsets;
+	compute_buffer_t result;
+	compute_buffer_t readback;
+
+	compute_job_t job;
+}
+gpu_prims_t;
+
+void init_gpu_prims(struct _application *ref, gpu_prims_t *prims);
+
+void destroy_gpu_prims(struct _application *ref, gpu_prims_t *prims);
+
+uint32_t gpu_reduce_u32(struct _application *ref, gpu_prims_t *prims, compute_buffer_t *in, uint32_t count, prim_reduce_op_t op);
+
+void gpu_scan_u32(struct _application *ref, gpu_prims_t *prims, compute_buffer_t *in, compute_buffer_t *out, uint32_t count, bool inclusive);
+
+uint32_t gpu_compact_u32(struct _application *ref, gpu_prims_t *prims, compute_buffer_t *values, compute_buffer_t *flags,
+	compute_buffer_t *out, uint32_t count);
+
+void gpu_radix_sort(struct _application *ref, gpu_prims_t *prims, compute_buffer_t *keys, compute_buffer_t *values,
+	uint32_t count, uint32_t key_bits);
+
+void bench_gpu_prims(struct _application *ref);
+
+#endif
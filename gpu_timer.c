@@ -0,0 +1,392 @@
+#include "gpu_timer.h"
+#include "profiler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define POOL(timer, index) (&((gpu_timer_pool_t *) array_data(&(timer)->pools))[index])
+
+/**
+ *	Map device ticks to the profiler clock: write a single timestamp and take
+ *	the CPU time halfway through the submission. Precision is bound by the
+ *	submit latency, which is enough to line up passes in a trace.
+ */
+static void calibrate_gpu_timer(struct _application *ref, gpu_timer_t *timer)
+{
+	gpu_timer_pool_t *pool = POOL(timer, 0);
+
+	VkCommandBuffer cmd = begin_single_time_commands(ref);
+	vkCmdResetQueryPool(cmd, pool->timestamps, 0, 1);
+	vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, pool->timestamps, 0);
+
+	uint64_t before = profiler_now_ns();
+	end_single_time_commands(ref, cmd);
+	uint64_t after = profiler_now_ns();
+
+	uint64_t ticks = 0;
+
+	VkResult res = vkGetQueryPoolResults(ref->device, pool->timestamps, 0, 1, sizeof(ticks), &ticks, sizeof(ticks),
+		VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+
+	if (res != VK_SUCCESS) {
+		return;
+	}
+
+	timer->calibrated = true;
+	timer->cpu_offset_ns = (int64_t) (before + (after - before) / 2) - (int64_t) ((ticks & timer->valid_mask) * timer->period_ns);
+}
+
+/**
+ *	Create `pool_count` query pools for command buffers submitted to
+ *	`queue_family`. Timestamps need a non-zero `timestampValidBits` on that
+ *	family; without it every call below is a no-op.
+ */
+void init_gpu_timer(struct _application *ref, gpu_timer_t *timer, uint32_t queue_family, uint32_t pool_count, bool pipeline_stats)
+{
+	VkResult res;
+
+	memset(timer, 0, sizeof(gpu_timer_t));
+	gettimeofday(&timer->last_log, NULL);
+
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(PHYSDEV(0), &props);
+
+	uint32_t family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(PHYSDEV(0), &family_count, NULL);
+
+	VkQueueFamilyProperties families[family_count];
+	vkGetPhysicalDeviceQueueFamilyProperties(PHYSDEV(0), &family_count, families);
+
+	uint32_t valid_bits = queue_family < family_count ? families[queue_family].timestampValidBits : 0;
+
+	if (valid_bits == 0 || props.limits.timestampPeriod == 0.0f) {
+		fprintf(stderr, "WARN: timestamps not supported on queue family %u, GPU timing disabled\n", queue_family);
+		return;
+	}
+
+	VkPhysicalDeviceFeatures features;
+	vkGetPhysicalDeviceFeatures(PHYSDEV(0), &features);
+
+	timer->supported = true;
+	timer->pipeline_stats = pipeline_stats && features.pipelineStatisticsQuery;
+	timer->period_ns = props.limits.timestampPeriod;
+	timer->valid_mask = valid_bits >= 64 ? UINT64_MAX : (1ull << valid_bits) - 1;
+
+	array_init(&timer->pools, sizeof(gpu_timer_pool_t));
+	array_resize(&timer->pools, pool_count, true);
+	memset(array_data(&timer->pools), 0, sizeof(gpu_timer_pool_t) * pool_count);
+
+	for (uint32_t i = 0; i < pool_count; i++) {
+		gpu_timer_pool_t *pool = POOL(timer, i);
+
+		VkQueryPoolCreateInfo query_ci = {};
+		query_ci.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		query_ci.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		query_ci.queryCount = GPU_TIMER_MAX_SLOTS * 2;
+
+		res = vkCreateQueryPool(ref->device, &query_ci, HOST_ALLOC(QUERY_POOL), &pool->timestamps);
+		if (res != VK_SUCCESS) {
+			fprintf(stderr, "ERR: failed to create timestamp query pool\n // Assertion: `vkCreateQueryPool == VK_SUCCESS`\n");
+			exit(EXIT_FAILURE);
+		}
+
+		if (!timer->pipeline_stats) {
+			continue;
+		}
+
+		query_ci.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+		query_ci.queryCount = GPU_TIMER_MAX_STATS_SLOTS;
+		query_ci.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT
+			| VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+		res = vkCreateQueryPool(ref->device, &query_ci, HOST_ALLOC(QUERY_POOL), &pool->statistics);
+		if (res != VK_SUCCESS) {
+			fprintf(stderr, "ERR: failed to create pipeline statistics query pool\n // Assertion: `vkCreateQueryPool == VK_SUCCESS`\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (profiler_active && pool_count > 0) {
+		calibrate_gpu_timer(ref, timer);
+	}
+}
+
+void destroy_gpu_timer(struct _application *ref, gpu_timer_t *timer)
+{
+	if (!timer->supported) {
+		return;
+	}
+
+	for (int i = 0; i < array_size(&timer->pools); i++) {
+		gpu_timer_pool_t *pool = POOL(timer, i);
+
+		vkDestroyQueryPool(ref->device, pool->timestamps, HOST_ALLOC(QUERY_POOL));
+
+		if (pool->statistics != VK_NULL_HANDLE) {
+			vkDestroyQueryPool(ref->device, pool->statistics, HOST_ALLOC(QUERY_POOL));
+		}
+	}
+
+	array_free(&timer->pools);
+	timer->supported = false;
+}
+
+/**
+ *	Look up a scope by name, registering it on first use.
+ */
+uint32_t gpu_timer_scope(gpu_timer_t *timer, const char *name)
+{
+	for (uint32_t i = 0; i < timer->scope_count; i++) {
+		if (strcmp(timer->scopes[i].name, name) == 0) {
+			return i;
+		}
+	}
+
+	if (timer->scope_count == GPU_TIMER_MAX_SCOPES) {
+		return GPU_TIMER_NO_SLOT;
+	}
+
+	gpu_timer_scope_t *scope = &timer->scopes[timer->scope_count];
+	memset(scope, 0, sizeof(gpu_timer_scope_t));
+	snprintf(scope->name, sizeof(scope->name), "%s", name);
+
+	return timer->scope_count++;
+}
+
+/**
+ *	Record the reset of a pool. Must be recorded outside of a render pass,
+ *	before any `gpu_timer_begin()` into the same command buffer.
+ */
+void gpu_timer_reset(gpu_timer_t *timer, VkCommandBuffer cmd, uint32_t pool_index)
+{
+	if (!timer->supported) {
+		return;
+	}
+
+	gpu_timer_pool_t *pool = POOL(timer, pool_index);
+
+	vkCmdResetQueryPool(cmd, pool->timestamps, 0, GPU_TIMER_MAX_SLOTS * 2);
+
+	if (pool->statistics != VK_NULL_HANDLE) {
+		vkCmdResetQueryPool(cmd, pool->statistics, 0, GPU_TIMER_MAX_STATS_SLOTS);
+	}
+
+	pool->slot_count = 0;
+	pool->stats_count = 0;
+	pool->pending = false;
+}
+
+/**
+ *	Write the begin timestamp of `scope` and optionally start a pipeline
+ *	statistics query (graphics queues only). Returns the slot to hand to
+ *	`gpu_timer_end()`, or `GPU_TIMER_NO_SLOT` when the pool is full.
+ */
+uint32_t gpu_timer_begin(gpu_timer_t *timer, VkCommandBuffer cmd, uint32_t pool_index, uint32_t scope, bool stats)
+{
+	if (!timer->supported || scope == GPU_TIMER_NO_SLOT) {
+		return GPU_TIMER_NO_SLOT;
+	}
+
+	gpu_timer_pool_t *pool = POOL(timer, pool_index);
+
+	if (pool->slot_count == GPU_TIMER_MAX_SLOTS) {
+		return GPU_TIMER_NO_SLOT;
+	}
+
+	uint32_t slot = pool->slot_count++;
+
+	pool->slot_scope[slot] = scope;
+	pool->slot_stats[slot] = GPU_TIMER_NO_SLOT;
+
+	vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, pool->timestamps, slot * 2);
+
+	if (stats && timer->pipeline_stats && pool->stats_count < GPU_TIMER_MAX_STATS_SLOTS) {
+		pool->slot_stats[slot] = pool->stats_count++;
+		vkCmdBeginQuery(cmd, pool->statistics, pool->slot_stats[slot], 0);
+	}
+
+	return slot;
+}
+
+void gpu_timer_end(gpu_timer_t *timer, VkCommandBuffer cmd, uint32_t pool_index, uint32_t slot)
+{
+	if (!timer->supported || slot == GPU_TIMER_NO_SLOT) {
+		return;
+	}
+
+	gpu_timer_pool_t *pool = POOL(timer, pool_index);
+
+	if (pool->slot_stats[slot] != GPU_TIMER_NO_SLOT) {
+		vkCmdEndQuery(cmd, pool->statistics, pool->slot_stats[slot]);
+	}
+
+	vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, pool->timestamps, slot * 2 + 1);
+}
+
+/**
+ *	Mark the command buffer owning the pool as submitted, so its results
+ *	are picked up by the next `gpu_timer_collect()` on that pool.
+ */
+void gpu_timer_submitted(gpu_timer_t *timer, uint32_t pool_index)
+{
+	if (!timer->supported) {
+		return;
+	}
+
+	POOL(timer, pool_index)->pending = true;
+}
+
+/**
+ *	Read back the results of the last submission of a pool. Call it once the
+ *	owning command buffer's fence has signalled, eg. right before recording
+ *	or resubmitting it. Never waits: returns false when results are not
+ *	available yet and leaves the pool pending.
+ */
+bool gpu_timer_collect(struct _application *ref, gpu_timer_t *timer, uint32_t pool_index)
+{
+	if (!timer->supported) {
+		return false;
+	}
+
+	gpu_timer_pool_t *pool = POOL(timer, pool_index);
+
+	if (!pool->pending || pool->slot_count == 0) {
+		return false;
+	}
+
+	/**
+	 * Value / availability pairs per query.
+	 */
+
+	uint64_t ticks[GPU_TIMER_MAX_SLOTS * 2][2];
+
+	VkResult res = vkGetQueryPoolResults(
+		ref->device, pool->timestamps, 0, pool->slot_count * 2, sizeof(ticks), ticks, sizeof(ticks[0]),
+		VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT
+	);
+
+	if (res != VK_SUCCESS && res != VK_NOT_READY) {
+		return false;
+	}
+
+	for (uint32_t i = 0; i < pool->slot_count * 2; i++) {
+		if (ticks[i][1] == 0) {
+			return false;
+		}
+	}
+
+	uint64_t stats[GPU_TIMER_MAX_STATS_SLOTS][3] = {};
+
+	if (pool->stats_count > 0) {
+		res = vkGetQueryPoolResults(
+			ref->device, pool->statistics, 0, pool->stats_count, sizeof(stats), stats, sizeof(stats[0]),
+			VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT
+		);
+
+		if (res != VK_SUCCESS) {
+			return false;
+		}
+	}
+
+	/**
+	 * Sum slots per scope, then fold the per-submission totals into the
+	 * running averages.
+	 */
+
+	double total_ms[GPU_TIMER_MAX_SCOPES] = {};
+	bool seen[GPU_TIMER_MAX_SCOPES] = {};
+
+	for (uint32_t i = 0; i < pool->slot_count; i++) {
+		gpu_timer_scope_t *scope = &timer->scopes[pool->slot_scope[i]];
+
+		uint64_t begin = ticks[i * 2][0] & timer->valid_mask;
+		uint64_t end = ticks[i * 2 + 1][0] & timer->valid_mask;
+		uint64_t delta = (end - begin) & timer->valid_mask;
+
+		if (!seen[pool->slot_scope[i]]) {
+			scope->last_begin = begin;
+			scope->vertex_invocations = 0;
+			scope->fragment_invocations = 0;
+		}
+
+		scope->last_end = end;
+
+		total_ms[pool->slot_scope[i]] += delta * timer->period_ns * 1e-6;
+
+		if (timer->calibrated) {
+			profiler_gpu_zone(scope->name, timer->cpu_offset_ns + (int64_t) (begin * timer->period_ns),
+				timer->cpu_offset_ns + (int64_t) ((begin + delta) * timer->period_ns));
+		}
+		seen[pool->slot_scope[i]] = true;
+
+		if (pool->slot_stats[i] != GPU_TIMER_NO_SLOT) {
+			scope->vertex_invocations += stats[pool->slot_stats[i]][0];
+			scope->fragment_invocations += stats[pool->slot_stats[i]][1];
+		}
+	}
+
+	for (uint32_t i = 0; i < timer->scope_count; i++) {
+		if (seen[i]) {
+			timer->scopes[i].last_ms = total_ms[i];
+			timer->scopes[i].sum_ms += total_ms[i];
+			timer->scopes[i].samples++;
+		}
+	}
+
+	pool->pending = false;
+
+	return true;
+}
+
+const gpu_timer_scope_t *gpu_timer_get(gpu_timer_t *timer, const char *name)
+{
+	for (uint32_t i = 0; i < timer->scope_count; i++) {
+		if (strcmp(timer->scopes[i].name, name) == 0) {
+			return &timer->scopes[i];
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ *	Print the average GPU time per scope since the previous log line, at
+ *	most once every `interval_s` seconds. Pass 0 to print unconditionally.
+ */
+void gpu_timer_log(gpu_timer_t *timer, double interval_s)
+{
+	if (!timer->supported) {
+		return;
+	}
+
+	struct timeval now;
+	gettimeofday(&now, NULL);
+
+	double elapsed = (now.tv_sec - timer->last_log.tv_sec) + (now.tv_usec - timer->last_log.tv_usec) * 1e-6;
+
+	if (elapsed < interval_s) {
+		return;
+	}
+
+	timer->last_log = now;
+
+	for (uint32_t i = 0; i < timer->scope_count; i++) {
+		gpu_timer_scope_t *scope = &timer->scopes[i];
+
+		if (scope->samples == 0) {
+			continue;
+		}
+
+		if (scope->vertex_invocations > 0 || scope->fragment_invocations > 0) {
+			printf("gpu: %-16s %8.3f ms (%u samples, vs %llu, fs %llu)\n", scope->name, scope->sum_ms / scope->samples, scope->samples,
+				(unsigned long long) scope->vertex_invocations, (unsigned long long) scope->fragment_invocations);
+		}
+		else {
+			printf("gpu: %-16s %8.3f ms (%u samples)\n", scope->name, scope->sum_ms / scope->samples, scope->samples);
+		}
+
+		scope->sum_ms = 0.0;
+		scope->samples = 0;
+	}
+}
@@ -0,0 +1,105 @@
+#ifndef _GPU_TIMER_H_
+#define _GPU_TIMER_H_
+
+#include "application.h"
+
+#define GPU_TIMER_MAX_SCOPES 16
+#define GPU_TIMER_MAX_SLOTS 64
+#define GPU_TIMER_MAX_STATS_SLOTS 8
+
+#define GPU_TIMER_NO_SLOT UINT32_MAX
+
+/**
+ *	Accumulated GPU cost of one named scope, eg. a render pass or a compute
+ *	pipeline. A scope recorded several times in one command buffer sums up.
+ */
+typedef struct _gpu_timer_scope_t
+{
+	char name[32];
+
+	double last_ms;
+	double sum_ms;
+	uint32_t samples;
+
+	uint64_t vertex_invocations;
+	uint64_t fragment_invocations;
+
+	/**
+	 * Raw device ticks of the last sample, for trace export.
+	 */
+
+	uint64_t last_begin;
+	uint64_t last_end;
+}
+gpu_timer_scope_t;
+
+/**
+ *	Queries written by one command buffer. A slot is a begin / end timestamp
+ *	pair tagged with its scope.
+ */
+typedef struct _gpu_timer_pool_t
+{
+	VkQueryPool timestamps;
+	VkQueryPool statistics;
+
+	uint32_t slot_count;
+	uint32_t slot_scope[GPU_TIMER_MAX_SLOTS];
+	uint32_t slot_stats[GPU_TIMER_MAX_SLOTS];
+
+	uint32_t stats_count;
+
+	bool pending;
+}
+gpu_timer_pool_t;
+
+/**
+ *	Timestamp and pipeline statistics queries, one pool per command buffer
+ *	that is in flight at once (eg. per swapchain image). Results are read
+ *	back without waiting, only once the pool's command buffer has completed.
+ */
+typedef struct _gpu_timer_t
+{
+	bool supported;
+	bool pipeline_stats;
+
+	double period_ns;
+	uint64_t valid_mask;
+
+	/**
+	 * Device tick 0 expressed in the profiler's CPU timebase, set when the
+	 * profiler is recording so GPU zones land next to CPU ones.
+	 */
+
+	bool calibrated;
+	int64_t cpu_offset_ns;
+
+	array pools;
+
+	uint32_t scope_count;
+	gpu_timer_scope_t scopes[GPU_TIMER_MAX_SCOPES];
+
+	struct timeval last_log;
+}
+gpu_timer_t;
+
+void init_gpu_timer(struct _application *ref, gpu_timer_t *timer, uint32_t queue_family, uint32_t pool_count, bool pipeline_stats);
+
+void destroy_gpu_timer(struct _application *ref, gpu_timer_t *timer);
+
+uint32_t gpu_timer_scope(gpu_timer_t *timer, const char *name);
+
+void gpu_timer_reset(gpu_timer_t *timer, VkCommandBuffer cmd, uint32_t pool_index);
+
+uint32_t gpu_timer_begin(gpu_timer_t *timer, VkCommandBuffer cmd, uint32_t pool_index, uint32_t scope, bool stats);
+
+void gpu_timer_end(gpu_timer_t *timer, VkCommandBuffer cmd, uint32_t pool_index, uint32_t slot);
+
+void gpu_timer_submitted(gpu_timer_t *timer, uint32_t pool_index);
+
+bool gpu_timer_collect(struct _application *ref, gpu_timer_t *timer, uint32_t pool_index);
+
+const gpu_timer_scope_t *gpu_timer_get(gpu_timer_t *timer, const char *name);
+
+void gpu_timer_log(gpu_timer_t *timer, double interval_s);
+
+#endif
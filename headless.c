@@ -0,0 +1,195 @@
+#include "headless.h"
+#include "gpu_timer.h"
+#include "profiler.h"
+#include "mem_budget.h"
+#include "residency.h"
+#include "bindless.h"
+#include "vk_cache.h"
+#include "resources.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+extern const int MAX_FRAMES_IN_FLIGHT;
+extern size_t current_frame;
+
+/**
+ *	Create offscreen color images standing in for the swapchain images, one
+ *	per frame in flight. They land in `swapc_imgs` so image views,
+ *	framebuffers, uniform buffers and command buffers are built unchanged.
+ */
+void init_offscreen_targets(struct _application *ref)
+{
+	uint32_t img_count = (uint32_t) MAX_FRAMES_IN_FLIGHT;
+
+	ref->swapc_img_format = HEADLESS_COLOR_FORMAT;
+	ref->swapc_extent.width = ref->width;
+	ref->swapc_extent.height = ref->height;
+
+	array_init(&ref->swapc_imgs, sizeof(VkImage));
+	array_resize(&ref->swapc_imgs, img_count, true);
+
+	array_init(&ref->offscreen_images, sizeof(handle_t));
+	array_resize(&ref->offscreen_images, img_count, true);
+
+	for (uint32_t i = 0; i < img_count; i++) {
+		handle_t image = resource_create_image(
+			ref,
+			ref->resources,
+			ref->width,
+			ref->height,
+			HEADLESS_COLOR_FORMAT,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+		);
+
+		((handle_t *) array_data(&ref->offscreen_images))[i] = image;
+		((VkImage *) array_data(&ref->swapc_imgs))[i] = resource_image(ref->resources, image);
+	}
+
+	ref->swapchain_img_count = img_count;
+}
+
+/**
+ *	Destroy the images created by `init_offscreen_targets()`.
+ */
+void cleanup_offscreen_targets(struct _application *ref)
+{
+	for (int i = 0; i < array_size(&ref->offscreen_images); i++) {
+		resource_destroy_image(ref, ref->resources, ((handle_t *) array_data(&ref->offscreen_images))[i]);
+	}
+
+	array_free(&ref->offscreen_images);
+}
+
+/**
+ *	Render a frame into the offscreen image owned by the current frame slot.
+ *	Without a swapchain there is nothing to acquire or present, so the frame
+ *	fence is the only synchronization needed.
+ */
+void draw_frame_headless(struct _application *ref)
+{
+	VkFence fence = ((VkFence *) array_data(&ref->in_flight_fences))[current_frame];
+	uint32_t img_index = (uint32_t) current_frame;
+
+	PROFILE_ZONE("draw_frame");
+
+	vkWaitForFences(ref->device, 1, &fence, VK_TRUE, UINT64_MAX);
+	gpu_timer_collect(ref, ref->gpu_timer, img_index);
+
+	vk_cache_frame(ref, ref->vk_cache);
+
+	residency_touch(ref, ref->texture_id);
+
+	if (ref->bindless) {
+		bindless_touch(ref, ref->bindless);
+	}
+
+	mem_budget_frame(ref);
+
+	if (ref->cmd_buffers_dirty) {
+		rerecord_command_buffers(ref);
+	}
+
+	update_uniform_buffer(ref, img_index);
+
+	VkSubmitInfo submit_info = {};
+	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.commandBufferCount = 1;
+	submit_info.pCommandBuffers = &((VkCommandBuffer *) array_data(&ref->cmd_buffers))[img_index];
+
+	vkResetFences(ref->device, 1, &fence);
+
+	VkResult res = vkQueueSubmit(ref->graphics_queue, 1, &submit_info, fence);
+	if (res != VK_SUCCESS) {
+		fprintf(stderr, "ERR: failed to submit queue \n // Assertion: `vkQueueSubmit() != VK_SUCCESS`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	gpu_timer_submitted(ref->gpu_timer, img_index);
+
+	current_frame = (current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
+}
+
+static double now_ms()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+	double x = *(const double *) a;
+	double y = *(const double *) b;
+
+	return (x > y) - (x < y);
+}
+
+/**
+ *	Render `headless_frames` frames and report min / mean / p99 frame time.
+ *	A frame time is the interval between two consecutive frame submissions,
+ *	which in steady state is bound by the GPU finishing the frame
+ *	`MAX_FRAMES_IN_FLIGHT` submissions earlier. The first frames are warm-up
+ *	(pipeline and driver caches) and are left out of the statistics.
+ *
+ *	Running once with and once without `--depth-prepass` shows what the
+ *	pre-pass saves: the render pass' fragment invocations drop to about one
+ *	per covered pixel, at the cost of the `depth_prepass` scope.
+ */
+void headless_main_loop(struct _application *ref)
+{
+	uint32_t frames = ref->headless_frames > 0 ? ref->headless_frames : 1;
+	uint32_t warmup = frames / 10 < 10 ? frames / 10 : 10;
+
+	double *frame_ms = malloc(sizeof(double) * frames);
+
+	host_alloc_frame_loop(true);
+
+	double last = now_ms();
+
+	for (uint32_t i = 0; i < frames; i++) {
+		draw_frame_headless(ref);
+
+		double now = now_ms();
+		frame_ms[i] = now - last;
+		last = now;
+	}
+
+	vkDeviceWaitIdle(ref->device);
+
+	host_alloc_frame_loop(false);
+
+	uint32_t count = frames - warmup;
+	double *samples = frame_ms + warmup;
+
+	double sum = 0.0;
+
+	for (uint32_t i = 0; i < count; i++) {
+		sum += samples[i];
+	}
+
+	qsort(samples, count, sizeof(double), compare_double);
+
+	uint32_t p99 = (uint32_t) ((count - 1) * 0.99);
+
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(PHYSDEV(0), &props);
+
+	printf("headless: %s, %ux%u, %u frames (%u warm-up)%s\n", props.deviceName, ref->width, ref->height, frames, warmup,
+		ref->depth_prepass ? ", depth pre-pass" : "");
+	printf("frame time: min %.3f ms, mean %.3f ms, p99 %.3f ms, max %.3f ms\n",
+		samples[0], sum / count, samples[p99], samples[count - 1]);
+
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		gpu_timer_collect(ref, ref->gpu_timer, i);
+	}
+
+	gpu_timer_log(ref->gpu_timer, 0.0);
+	host_alloc_report(true);
+
+	free(frame_ms);
+}
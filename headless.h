@@ -0,0 +1,16 @@
+#ifndef _HEADLESS_H_
+#define _HEADLESS_H_
+
+#include "application.h"
+
+#define HEADLESS_COLOR_FORMAT VK_FORMAT_R8G8B8A8_UNORM
+
+void init_offscreen_targets(struct _application *ref);
+
+void cleanup_offscreen_targets(struct _application *ref);
+
+void draw_frame_headless(struct _application *ref);
+
+void headless_main_loop(struct _application *ref);
+
+#endif
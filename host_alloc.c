@@ -0,0 +1,302 @@
+#include "host_alloc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ *	Every block starts with a header right before the returned pointer, so
+ *	frees and reallocations can be accounted without a lookup.
+ */
+typedef struct _host_alloc_header_t
+{
+	void *base;
+	size_t size;
+
+	uint8_t scope;
+	uint8_t tag;
+	bool arena;
+}
+host_alloc_header_t;
+
+/**
+ *	Per thread bump arena for VK_SYSTEM_ALLOCATION_SCOPE_COMMAND blocks,
+ *	which never outlive the Vulkan call that made them. It rewinds once all
+ *	its blocks are freed.
+ */
+typedef struct _host_alloc_arena_t
+{
+	char *buffer;
+	size_t offset;
+	uint32_t live;
+}
+host_alloc_arena_t;
+
+static bool command_arena_enabled = false;
+static __thread host_alloc_arena_t arena = {NULL, 0, 0};
+
+host_alloc_stats_t host_alloc_stats = {};
+
+static const char *scope_names[HOST_ALLOC_SCOPE_COUNT] = {"command", "object", "cache", "device", "instance"};
+
+static const char *tag_names[HOST_ALLOC_TAG_COUNT] = {
+	"instance", "device", "surface", "swapchain", "debug", "memory", "buffer", "image", "image_view", "sampler",
+	"shader", "pipeline", "pipeline_layout", "descriptor", "render_pass", "framebuffer", "command_pool", "sync", "query_pool"
+};
+
+static void counter_add(host_alloc_counter_t *counter, size_t size)
+{
+	uint64_t bytes = __atomic_add_fetch(&counter->bytes, size, __ATOMIC_RELAXED);
+	uint64_t peak = __atomic_load_n(&counter->peak_bytes, __ATOMIC_RELAXED);
+
+	while (bytes > peak && !__atomic_compare_exchange_n(&counter->peak_bytes, &peak, bytes, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+	__atomic_add_fetch(&counter->live, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&counter->allocations, 1, __ATOMIC_RELAXED);
+}
+
+static void counter_sub(host_alloc_counter_t *counter, size_t size)
+{
+	__atomic_sub_fetch(&counter->bytes, size, __ATOMIC_RELAXED);
+	__atomic_sub_fetch(&counter->live, 1, __ATOMIC_RELAXED);
+}
+
+static void account_alloc(uint32_t scope, uint32_t tag, size_t size)
+{
+	counter_add(&host_alloc_stats.scopes[scope], size);
+	counter_add(&host_alloc_stats.tags[tag], size);
+
+	if (host_alloc_stats.frame_loop) {
+		__atomic_add_fetch(&host_alloc_stats.frame_loop_allocations, 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&host_alloc_stats.frame_loop_bytes, size, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&host_alloc_stats.frame_loop_by_scope[scope], 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&host_alloc_stats.frame_loop_by_tag[tag], 1, __ATOMIC_RELAXED);
+	}
+}
+
+static void *arena_alloc(size_t size, size_t alignment)
+{
+	if (arena.buffer == NULL) {
+		arena.buffer = malloc(HOST_ALLOC_ARENA_SIZE);
+
+		if (arena.buffer == NULL) {
+			return NULL;
+		}
+	}
+
+	uintptr_t start = (uintptr_t) arena.buffer + arena.offset + sizeof(host_alloc_header_t);
+	uintptr_t user = (start + alignment - 1) & ~((uintptr_t) alignment - 1);
+
+	if (user + size > (uintptr_t) arena.buffer + HOST_ALLOC_ARENA_SIZE) {
+		return NULL;
+	}
+
+	arena.offset = user + size - (uintptr_t) arena.buffer;
+	arena.live++;
+
+	return (void *) user;
+}
+
+static VKAPI_ATTR void *VKAPI_CALL host_allocation(void *user_data, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	uint32_t tag = (uint32_t) (uintptr_t) user_data;
+
+	if (alignment < _Alignof(host_alloc_header_t)) {
+		alignment = _Alignof(host_alloc_header_t);
+	}
+
+	void *ptr = NULL;
+	bool from_arena = false;
+
+	if (command_arena_enabled && scope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND) {
+		ptr = arena_alloc(size, alignment);
+		from_arena = ptr != NULL;
+
+		__atomic_add_fetch(from_arena ? &host_alloc_stats.arena_allocations : &host_alloc_stats.arena_fallbacks, 1, __ATOMIC_RELAXED);
+	}
+
+	void *base = NULL;
+
+	if (!from_arena) {
+		size_t offset = (sizeof(host_alloc_header_t) + alignment - 1) & ~(alignment - 1);
+
+		if (posix_memalign(&base, alignment < sizeof(void *) ? sizeof(void *) : alignment, offset + size) != 0) {
+			return NULL;
+		}
+
+		ptr = (char *) base + offset;
+	}
+
+	host_alloc_header_t *header = (host_alloc_header_t *) ptr - 1;
+	header->base = base;
+	header->size = size;
+	header->scope = (uint8_t) scope;
+	header->tag = (uint8_t) tag;
+	header->arena = from_arena;
+
+	account_alloc(scope, tag, size);
+
+	return ptr;
+}
+
+static VKAPI_ATTR void VKAPI_CALL host_free(void *user_data, void *ptr)
+{
+	if (ptr == NULL) {
+		return;
+	}
+
+	host_alloc_header_t *header = (host_alloc_header_t *) ptr - 1;
+
+	counter_sub(&host_alloc_stats.scopes[header->scope], header->size);
+	counter_sub(&host_alloc_stats.tags[header->tag], header->size);
+
+	if (header->arena) {
+		if (--arena.live == 0) {
+			arena.offset = 0;
+		}
+
+		return;
+	}
+
+	free(header->base);
+}
+
+static VKAPI_ATTR void *VKAPI_CALL host_reallocation(void *user_data, void *original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	if (original == NULL) {
+		return host_allocation(user_data, size, alignment, scope);
+	}
+
+	if (size == 0) {
+		host_free(user_data, original);
+		return NULL;
+	}
+
+	void *ptr = host_allocation(user_data, size, alignment, scope);
+
+	if (ptr == NULL) {
+		return NULL;
+	}
+
+	host_alloc_header_t *header = (host_alloc_header_t *) original - 1;
+	memcpy(ptr, original, header->size < size ? header->size : size);
+
+	host_free(user_data, original);
+
+	return ptr;
+}
+
+/**
+ *	Driver side allocations we do not own, only accounted.
+ */
+static VKAPI_ATTR void VKAPI_CALL host_internal_allocation(void *user_data, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope)
+{
+	__atomic_add_fetch(&host_alloc_stats.scopes[scope].internal_bytes, size, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&host_alloc_stats.tags[(uintptr_t) user_data].internal_bytes, size, __ATOMIC_RELAXED);
+}
+
+static VKAPI_ATTR void VKAPI_CALL host_internal_free(void *user_data, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope)
+{
+	__atomic_sub_fetch(&host_alloc_stats.scopes[scope].internal_bytes, size, __ATOMIC_RELAXED);
+	__atomic_sub_fetch(&host_alloc_stats.tags[(uintptr_t) user_data].internal_bytes, size, __ATOMIC_RELAXED);
+}
+
+#define HOST_ALLOC_ENTRY(tag) \
+	[tag] = {(void *) (uintptr_t) tag, host_allocation, host_reallocation, host_free, host_internal_allocation, host_internal_free}
+
+VkAllocationCallbacks host_alloc_callbacks[HOST_ALLOC_TAG_COUNT] = {
+	HOST_ALLOC_ENTRY(HOST_ALLOC_TAG_INSTANCE),
+	HOST_ALLOC_ENTRY(HOST_ALLOC_TAG_DEVICE),
+	HOST_ALLOC_ENTRY(HOST_ALLOC_TAG_SURFACE),
+	HOST_ALLOC_ENTRY(HOST_ALLOC_TAG_SWAPCHAIN),
+	HOST_ALLOC_ENTRY(HOST_ALLOC_TAG_DEBUG),
+	HOST_ALLOC_ENTRY(HOST_ALLOC_TAG_MEMORY),
+	HOST_ALLOC_ENTRY(HOST_ALLOC_TAG_BUFFER),
+	HOST_ALLOC_ENTRY(HOST_ALLOC_TAG_IMAGE),
+	HOST_ALLOC_ENTRY(HOST_ALLOC_TAG_IMAGE_VIEW),
+	HOST_ALLOC_ENTRY(HOST_ALLOC_TAG_SAMPLER),
+	HOST_ALLOC_ENTRY(HOST_ALLOC_TAG_SHADER),
+	HOST_ALLOC_ENTRY(HOST_ALLOC_TAG_PIPELINE),
+	HOST_ALLOC_ENTRY(HOST_ALLOC_TAG_PIPELINE_LAYOUT),
+	HOST_ALLOC_ENTRY(HOST_ALLOC_TAG_DESCRIPTOR),
+	HOST_ALLOC_ENTRY(HOST_ALLOC_TAG_RENDER_PASS),
+	HOST_ALLOC_ENTRY(HOST_ALLOC_TAG_FRAMEBUFFER),
+	HOST_ALLOC_ENTRY(HOST_ALLOC_TAG_COMMAND_POOL),
+	HOST_ALLOC_ENTRY(HOST_ALLOC_TAG_SYNC),
+	HOST_ALLOC_ENTRY(HOST_ALLOC_TAG_QUERY_POOL)
+};
+
+/**
+ *	The callbacks work without this call, it only picks whether command
+ *	scope allocations come from the per thread arena.
+ */
+void init_host_alloc(bool command_arena)
+{
+	command_arena_enabled = command_arena;
+}
+
+/**
+ *	Flag the steady state frame loop: every allocation made until the flag
+ *	is cleared is counted separately and shows up in `host_alloc_report()`.
+ */
+void host_alloc_frame_loop(bool active)
+{
+	host_alloc_stats.frame_loop = active;
+}
+
+static void print_counter(const char *name, host_alloc_counter_t *counter, uint64_t frame_loop)
+{
+	if (counter->allocations == 0 && counter->internal_bytes == 0) {
+		return;
+	}
+
+	printf("  %-16s %10llu B live (%llu blocks), peak %10llu B, %8llu allocs, %8llu in frame loop, %llu B internal\n", name,
+		(unsigned long long) counter->bytes, (unsigned long long) counter->live, (unsigned long long) counter->peak_bytes,
+		(unsigned long long) counter->allocations, (unsigned long long) frame_loop, (unsigned long long) counter->internal_bytes);
+}
+
+/**
+ *	Print host allocations made during the frame loop and, unless
+ *	`frame_loop_only`, live / peak bytes per scope and per object type.
+ */
+void host_alloc_report(bool frame_loop_only)
+{
+	host_alloc_stats_t *stats = &host_alloc_stats;
+
+	if (stats->frame_loop_allocations > 0) {
+		printf("host alloc: %llu allocations, %llu B during the frame loop:",
+			(unsigned long long) stats->frame_loop_allocations, (unsigned long long) stats->frame_loop_bytes);
+
+		for (int i = 0; i < HOST_ALLOC_TAG_COUNT; i++) {
+			if (stats->frame_loop_by_tag[i] > 0) {
+				printf(" %s %llu", tag_names[i], (unsigned long long) stats->frame_loop_by_tag[i]);
+			}
+		}
+
+		printf("\n");
+	}
+	else {
+		printf("host alloc: no allocations during the frame loop\n");
+	}
+
+	if (frame_loop_only) {
+		return;
+	}
+
+	printf("host alloc by scope:\n");
+
+	for (int i = 0; i < HOST_ALLOC_SCOPE_COUNT; i++) {
+		print_counter(scope_names[i], &stats->scopes[i], stats->frame_loop_by_scope[i]);
+	}
+
+	printf("host alloc by object type:\n");
+
+	for (int i = 0; i < HOST_ALLOC_TAG_COUNT; i++) {
+		print_counter(tag_names[i], &stats->tags[i], stats->frame_loop_by_tag[i]);
+	}
+
+	if (command_arena_enabled) {
+		printf("host alloc: %llu command scope allocations from the arena, %llu fell back to the heap\n",
+			(unsigned long long) stats->arena_allocations, (unsigned long long) stats->arena_fallbacks);
+	}
+}
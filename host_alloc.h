@@ -0,0 +1,92 @@
+#ifndef _HOST_ALLOC_H_
+#define _HOST_ALLOC_H_
+
+#include <vulkan/vulkan.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define HOST_ALLOC_SCOPE_COUNT (VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1)
+
+#define HOST_ALLOC_ARENA_SIZE (256 * 1024)
+
+/**
+ *	Object type a create / destroy call is accounted to, passed to the
+ *	callbacks through `pUserData`.
+ */
+typedef enum _host_alloc_tag_t
+{
+	HOST_ALLOC_TAG_INSTANCE = 0,
+	HOST_ALLOC_TAG_DEVICE,
+	HOST_ALLOC_TAG_SURFACE,
+	HOST_ALLOC_TAG_SWAPCHAIN,
+	HOST_ALLOC_TAG_DEBUG,
+	HOST_ALLOC_TAG_MEMORY,
+	HOST_ALLOC_TAG_BUFFER,
+	HOST_ALLOC_TAG_IMAGE,
+	HOST_ALLOC_TAG_IMAGE_VIEW,
+	HOST_ALLOC_TAG_SAMPLER,
+	HOST_ALLOC_TAG_SHADER,
+	HOST_ALLOC_TAG_PIPELINE,
+	HOST_ALLOC_TAG_PIPELINE_LAYOUT,
+	HOST_ALLOC_TAG_DESCRIPTOR,
+	HOST_ALLOC_TAG_RENDER_PASS,
+	HOST_ALLOC_TAG_FRAMEBUFFER,
+	HOST_ALLOC_TAG_COMMAND_POOL,
+	HOST_ALLOC_TAG_SYNC,
+	HOST_ALLOC_TAG_QUERY_POOL,
+	HOST_ALLOC_TAG_COUNT
+}
+host_alloc_tag_t;
+
+/**
+ *	Byte and call counters, updated atomically as drivers may allocate from
+ *	any thread.
+ */
+typedef struct _host_alloc_counter_t
+{
+	uint64_t bytes;
+	uint64_t peak_bytes;
+	uint64_t live;
+	uint64_t allocations;
+	uint64_t internal_bytes;
+}
+host_alloc_counter_t;
+
+typedef struct _host_alloc_stats_t
+{
+	host_alloc_counter_t scopes[HOST_ALLOC_SCOPE_COUNT];
+	host_alloc_counter_t tags[HOST_ALLOC_TAG_COUNT];
+
+	/**
+	 * Allocations made while `frame_loop` is set, ie. in steady state.
+	 */
+
+	bool frame_loop;
+	uint64_t frame_loop_allocations;
+	uint64_t frame_loop_bytes;
+	uint64_t frame_loop_by_scope[HOST_ALLOC_SCOPE_COUNT];
+	uint64_t frame_loop_by_tag[HOST_ALLOC_TAG_COUNT];
+
+	uint64_t arena_allocations;
+	uint64_t arena_fallbacks;
+}
+host_alloc_stats_t;
+
+extern VkAllocationCallbacks host_alloc_callbacks[HOST_ALLOC_TAG_COUNT];
+
+extern host_alloc_stats_t host_alloc_stats;
+
+/**
+ *	Allocator to pass to a create call and its matching destroy call, eg.
+ *	`vkCreateBuffer(dev, &ci, HOST_ALLOC(BUFFER), &buffer)`.
+ */
+#define HOST_ALLOC(tag) (&host_alloc_callbacks[HOST_ALLOC_TAG_##tag])
+
+void init_host_alloc(bool command_arena);
+
+void host_alloc_frame_loop(bool active);
+
+void host_alloc_report(bool frame_loop_only);
+
+#endif
@@ -58,6 +58,14 @@ void *array_get(array *ref, int index)
 	return 0;
 }
 
+void array_remove(array *ref, int index)
+{
+	if (index >= 0 && index < ref->size) {
+		memmove(&ref->data[ref->member_size * index], &ref->data[ref->member_size * (index + 1)], ref->member_size * (ref->size - index - 1));
+		ref->size--;
+	}
+}
+
 char* array_data(array *ref)
 {
 	return ref->data;
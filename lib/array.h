@@ -91,6 +91,14 @@ void array_set(array *ref, int index, void *data);
  */
 void * array_get(array *ref, int index);
 
+/**
+ * @brief      Remove data at an index, shifting the following members down.
+ *
+ * @param      ref       Reference to the associated array struct.
+ * @param[in]  index     Index of data to remove.
+ */
+void array_remove(array *ref, int index);
+
 char *array_data(array *ref);
 
 /**
@@ -0,0 +1,138 @@
+#include "handle_pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GENERATION_MASK ((1u << HANDLE_GENERATION_BITS) - 1)
+#define ALLOCATED 0x8000
+
+static void grow(handle_pool *ref, uint32_t capacity)
+{
+	uint16_t *generations = realloc(ref->generations, sizeof(uint16_t) * capacity);
+	uint32_t *free_slots = malloc(sizeof(uint32_t) * capacity);
+
+	if (generations == NULL || free_slots == NULL) {
+		fprintf(stderr, "ERR: failed to allocate handle pool\n // Assertion: `malloc != NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/**
+	 * Unwrap the ring to the start of the larger one.
+	 */
+
+	for (uint32_t i = 0; i < ref->free_count; i++) {
+		free_slots[i] = ref->free_slots[(ref->free_head + i) % ref->capacity];
+	}
+
+	free(ref->free_slots);
+
+	ref->generations = generations;
+	ref->free_slots = free_slots;
+	ref->free_head = 0;
+	ref->capacity = capacity;
+}
+
+void handle_pool_init(handle_pool *ref)
+{
+	memset(ref, 0, sizeof(handle_pool));
+
+	grow(ref, HANDLE_POOL_INIT_CAPACITY);
+}
+
+handle_t handle_pool_alloc(handle_pool *ref)
+{
+	uint32_t index;
+
+	if (ref->free_count > HANDLE_POOL_MIN_FREE || (ref->free_count > 0 && ref->used == HANDLE_MAX_SLOTS)) {
+		index = ref->free_slots[ref->free_head];
+
+		ref->free_head = (ref->free_head + 1) % ref->capacity;
+		ref->free_count--;
+	}
+	else {
+		if (ref->used == HANDLE_MAX_SLOTS) {
+			fprintf(stderr, "ERR: handle pool exhausted\n // Assertion: `used < HANDLE_MAX_SLOTS`\n");
+			exit(EXIT_FAILURE);
+		}
+
+		if (ref->used == ref->capacity) {
+			grow(ref, ref->capacity * 2);
+		}
+
+		index = ref->used++;
+		ref->generations[index] = 1;
+	}
+
+	ref->generations[index] |= ALLOCATED;
+	ref->count++;
+
+	return ((uint32_t) (ref->generations[index] & GENERATION_MASK) << HANDLE_INDEX_BITS) | index;
+}
+
+bool handle_pool_release(handle_pool *ref, handle_t handle)
+{
+	if (!handle_pool_valid(ref, handle)) {
+		return false;
+	}
+
+	uint32_t index = handle_index(handle);
+	uint32_t generation = ref->generations[index] & GENERATION_MASK;
+
+	/**
+	 * Skip 0 on wrap around, it would make HANDLE_NULL valid for slot 0.
+	 */
+
+	generation = generation == GENERATION_MASK ? 1 : generation + 1;
+
+	ref->generations[index] = (uint16_t) generation;
+	ref->free_slots[(ref->free_head + ref->free_count) % ref->capacity] = index;
+	ref->free_count++;
+	ref->count--;
+
+	return true;
+}
+
+bool handle_pool_valid(const handle_pool *ref, handle_t handle)
+{
+	uint32_t index = handle_index(handle);
+
+	return index < ref->used && ref->generations[index] == (ALLOCATED | (handle >> HANDLE_INDEX_BITS));
+}
+
+bool handle_pool_next(const handle_pool *ref, uint32_t *it, handle_t *handle)
+{
+	for (; *it < ref->used; (*it)++) {
+		uint16_t generation = ref->generations[*it];
+
+		if ((generation & ALLOCATED) == 0) {
+			continue;
+		}
+
+		*handle = ((uint32_t) (generation & GENERATION_MASK) << HANDLE_INDEX_BITS) | *it;
+
+		(*it)++;
+
+		return true;
+	}
+
+	return false;
+}
+
+uint32_t handle_pool_capacity(const handle_pool *ref)
+{
+	return ref->capacity;
+}
+
+uint32_t handle_pool_count(const handle_pool *ref)
+{
+	return ref->count;
+}
+
+void handle_pool_free(handle_pool *ref)
+{
+	free(ref->generations);
+	free(ref->free_slots);
+
+	memset(ref, 0, sizeof(handle_pool));
+}
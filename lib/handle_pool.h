@@ -0,0 +1,141 @@
+#ifndef _HANDLE_POOL_H_
+#define _HANDLE_POOL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * A handle is a slot index in the low bits and the slot's generation in the
+ * high bits. Generations start at 1, so HANDLE_NULL is never valid.
+ */
+#define HANDLE_INDEX_BITS 20
+#define HANDLE_GENERATION_BITS 12
+
+#define HANDLE_MAX_SLOTS (1u << HANDLE_INDEX_BITS)
+#define HANDLE_NULL 0u
+
+/**
+ * Released slots rest in a FIFO until this many are free, a slot's
+ * generation then wraps only after HANDLE_POOL_MIN_FREE * 4095 releases.
+ */
+#define HANDLE_POOL_MIN_FREE 64
+
+#define HANDLE_POOL_INIT_CAPACITY 64
+
+typedef uint32_t handle_t;
+
+typedef struct _handle_pool handle_pool;
+
+/**
+ * @brief      Generational slot allocator. Hands out 32 bit handles to
+ *             slots of parallel (SoA) arrays its owner keeps: allocate,
+ *             release and validate in O(1). A released slot gets a new
+ *             generation, handles to its previous occupant stop validating.
+ */
+struct _handle_pool
+{
+	/**
+	 * Per slot: generation in the low HANDLE_GENERATION_BITS, top bit set
+	 * while the slot is allocated.
+	 */
+	uint16_t *generations;
+
+	/**
+	 * Ring of free slot indices.
+	 */
+	uint32_t *free_slots;
+	uint32_t free_head;
+	uint32_t free_count;
+
+	uint32_t capacity;
+	uint32_t used;
+	uint32_t count;
+};
+
+/**
+ * @brief      Get the slot index of a handle, for the owner's arrays.
+ *
+ * @param[in]  handle    The handle.
+ *
+ * @return     index
+ */
+static inline uint32_t handle_index(handle_t handle)
+{
+	return handle & (HANDLE_MAX_SLOTS - 1);
+}
+
+/**
+ * @brief      Initialize an empty pool.
+ *
+ * @param      ref       Reference to the associated handle_pool struct.
+ */
+void handle_pool_init(handle_pool *ref);
+
+/**
+ * @brief      Allocate a slot. May grow the pool, the owner's arrays must
+ *             then grow to handle_pool_capacity().
+ *
+ * @param      ref       Reference to the associated handle_pool struct.
+ *
+ * @return     Handle to the slot.
+ */
+handle_t handle_pool_alloc(handle_pool *ref);
+
+/**
+ * @brief      Release the slot of a handle.
+ *
+ * @param      ref       Reference to the associated handle_pool struct.
+ * @param[in]  handle    The handle.
+ *
+ * @return     false if the handle was stale or HANDLE_NULL.
+ */
+bool handle_pool_release(handle_pool *ref, handle_t handle);
+
+/**
+ * @brief      Check a handle refers to an allocated slot of this
+ *             generation.
+ *
+ * @param      ref       Reference to the associated handle_pool struct.
+ * @param[in]  handle    The handle.
+ *
+ * @return     true if valid.
+ */
+bool handle_pool_valid(const handle_pool *ref, handle_t handle);
+
+/**
+ * @brief      Iterate the allocated slots, in index order.
+ *
+ * @param      ref       Reference to the associated handle_pool struct.
+ * @param      it        Iterator, 0 before the first call.
+ * @param      handle    Set to the slot's handle.
+ *
+ * @return     false once every slot has been visited.
+ */
+bool handle_pool_next(const handle_pool *ref, uint32_t *it, handle_t *handle);
+
+/**
+ * @brief      Get the amount of slots the owner's arrays must hold.
+ *
+ * @param      ref       Reference to the associated handle_pool struct.
+ *
+ * @return     capacity
+ */
+uint32_t handle_pool_capacity(const handle_pool *ref);
+
+/**
+ * @brief      Get the amount of allocated slots.
+ *
+ * @param      ref       Reference to the associated handle_pool struct.
+ *
+ * @return     count
+ */
+uint32_t handle_pool_count(const handle_pool *ref);
+
+/**
+ * @brief      Free the memory allocated to the pool.
+ *
+ * @param      ref       Reference to the associated handle_pool struct.
+ */
+void handle_pool_free(handle_pool *ref);
+
+#endif
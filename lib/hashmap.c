@@ -0,0 +1,400 @@
+#include "hashmap.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define HASHMAP_SSE2
+#endif
+
+/**
+ *	Control bytes, full slots hold the low 7 bits of their hash. Both free
+ *	states have the high bit set.
+ */
+#define CTRL_EMPTY 0x80
+#define CTRL_DELETED 0xfe
+
+#define SLOT(ref, i) ((ref)->slots + (size_t) (i) * (ref)->slot_size)
+
+static inline uint64_t rotl64(uint64_t x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+uint64_t hashmap_hash(const void *data, size_t size, uint64_t seed)
+{
+	const uint8_t *bytes = data;
+	uint64_t h = seed ^ (size * 0x87c37b91114253d5ull);
+
+	for (; size >= 8; size -= 8, bytes += 8) {
+		uint64_t word;
+		memcpy(&word, bytes, 8);
+
+		h = rotl64(h ^ (word * 0x87c37b91114253d5ull), 31) * 0x4cf5ad432745937full;
+	}
+
+	if (size > 0) {
+		uint64_t word = 0;
+		memcpy(&word, bytes, size);
+
+		h = rotl64(h ^ (word * 0x87c37b91114253d5ull), 31) * 0x4cf5ad432745937full;
+	}
+
+	/**
+	 * Finalizer of MurmurHash3, every input bit reaches the 7 control bits
+	 * and the group index.
+	 */
+
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdull;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ull;
+	h ^= h >> 33;
+
+	return h;
+}
+
+/**
+ *	Bit i set for every control byte of the group equal to `byte`.
+ */
+static inline uint32_t match_byte(const uint8_t *group, uint8_t byte)
+{
+#ifdef HASHMAP_SSE2
+	__m128i ctrl = _mm_load_si128((const __m128i *) group);
+
+	return (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char) byte)));
+#else
+	uint32_t mask = 0;
+
+	for (int i = 0; i < HASHMAP_GROUP; i++) {
+		mask |= (uint32_t) (group[i] == byte) << i;
+	}
+
+	return mask;
+#endif
+}
+
+/**
+ *	Bit i set for every empty or deleted slot of the group.
+ */
+static inline uint32_t match_free(const uint8_t *group)
+{
+#ifdef HASHMAP_SSE2
+	return (uint32_t) _mm_movemask_epi8(_mm_load_si128((const __m128i *) group));
+#else
+	uint32_t mask = 0;
+
+	for (int i = 0; i < HASHMAP_GROUP; i++) {
+		mask |= (uint32_t) (group[i] >> 7) << i;
+	}
+
+	return mask;
+#endif
+}
+
+static void allocate(hashmap *ref, uint32_t capacity)
+{
+	ref->capacity = capacity;
+	ref->size = 0;
+	ref->deleted = 0;
+
+	ref->ctrl = aligned_alloc(HASHMAP_GROUP, capacity);
+	ref->slots = malloc(ref->slot_size * capacity);
+
+	if (ref->ctrl == NULL || ref->slots == NULL) {
+		fprintf(stderr, "ERR: failed to allocate hashmap\n // Assertion: `malloc != NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	memset(ref->ctrl, CTRL_EMPTY, capacity);
+}
+
+/**
+ *	Groups are visited in triangular steps, with a power of two amount of
+ *	groups every group is reached once.
+ */
+static int64_t find(hashmap *ref, const void *key, uint64_t hash)
+{
+	uint32_t groups_mask = ref->capacity / HASHMAP_GROUP - 1;
+	uint32_t g = (uint32_t) (hash >> 7) & groups_mask;
+	uint8_t h2 = (uint8_t) (hash & 0x7f);
+
+	for (uint32_t step = 1; step <= groups_mask + 1; step++) {
+		const uint8_t *group = ref->ctrl + (size_t) g * HASHMAP_GROUP;
+
+		for (uint32_t match = match_byte(group, h2); match; match &= match - 1) {
+			uint32_t slot = g * HASHMAP_GROUP + (uint32_t) __builtin_ctz(match);
+
+			if (memcmp(SLOT(ref, slot), key, ref->key_size) == 0) {
+				return slot;
+			}
+		}
+
+		/**
+		 * The key would have been inserted into this group's empty slot.
+		 */
+
+		if (match_byte(group, CTRL_EMPTY)) {
+			return -1;
+		}
+
+		g = (g + step) & groups_mask;
+	}
+
+	return -1;
+}
+
+static uint32_t find_free(hashmap *ref, uint64_t hash)
+{
+	uint32_t groups_mask = ref->capacity / HASHMAP_GROUP - 1;
+	uint32_t g = (uint32_t) (hash >> 7) & groups_mask;
+
+	for (uint32_t step = 1; ; step++) {
+		uint32_t free_slots = match_free(ref->ctrl + (size_t) g * HASHMAP_GROUP);
+
+		if (free_slots) {
+			return g * HASHMAP_GROUP + (uint32_t) __builtin_ctz(free_slots);
+		}
+
+		g = (g + step) & groups_mask;
+	}
+}
+
+/**
+ *	Reinsert every entry into `capacity` slots, dropping the deleted ones.
+ */
+static void rehash(hashmap *ref, uint32_t capacity)
+{
+	hashmap old = *ref;
+
+	allocate(ref, capacity);
+
+	for (uint32_t i = 0; i < old.capacity; i++) {
+		if (old.ctrl[i] & 0x80) {
+			continue;
+		}
+
+		uint64_t hash = hashmap_hash(SLOT(&old, i), ref->key_size, HASHMAP_HASH_SEED);
+		uint32_t slot = find_free(ref, hash);
+
+		ref->ctrl[slot] = (uint8_t) (hash & 0x7f);
+		memcpy(SLOT(ref, slot), SLOT(&old, i), ref->slot_size);
+		ref->size++;
+	}
+
+	free(old.ctrl);
+	free(old.slots);
+}
+
+void hashmap_init(hashmap *ref, size_t key_size, size_t value_size)
+{
+	ref->key_size = key_size;
+	ref->value_size = value_size;
+
+	/**
+	 * Values and slots start 8 byte aligned whatever the key size.
+	 */
+
+	ref->value_offset = (key_size + 7) & ~(size_t) 7;
+	ref->slot_size = (ref->value_offset + value_size + 7) & ~(size_t) 7;
+
+	allocate(ref, HASHMAP_GROUP);
+}
+
+void *hashmap_get(hashmap *ref, const void *key)
+{
+	int64_t slot = find(ref, key, hashmap_hash(key, ref->key_size, HASHMAP_HASH_SEED));
+
+	return slot < 0 ? NULL : SLOT(ref, slot) + ref->value_offset;
+}
+
+void *hashmap_put(hashmap *ref, const void *key, const void *value)
+{
+	uint64_t hash = hashmap_hash(key, ref->key_size, HASHMAP_HASH_SEED);
+	int64_t slot = find(ref, key, hash);
+
+	if (slot < 0) {
+
+		/**
+		 * At 7/8 occupancy, counting deleted slots: double when the live
+		 * entries need it, otherwise only purge the deleted ones.
+		 */
+
+		if ((uint64_t) (ref->size + ref->deleted + 1) * 8 > (uint64_t) ref->capacity * 7) {
+			rehash(ref, (uint64_t) (ref->size + 1) * 16 > (uint64_t) ref->capacity * 7 ? ref->capacity * 2 : ref->capacity);
+		}
+
+		slot = find_free(ref, hash);
+
+		if (ref->ctrl[slot] == CTRL_DELETED) {
+			ref->deleted--;
+		}
+
+		ref->ctrl[slot] = (uint8_t) (hash & 0x7f);
+		memcpy(SLOT(ref, slot), key, ref->key_size);
+		memset(SLOT(ref, slot) + ref->value_offset, 0, ref->value_size);
+		ref->size++;
+	}
+
+	if (value) {
+		memcpy(SLOT(ref, slot) + ref->value_offset, value, ref->value_size);
+	}
+
+	return SLOT(ref, slot) + ref->value_offset;
+}
+
+bool hashmap_remove(hashmap *ref, const void *key)
+{
+	int64_t slot = find(ref, key, hashmap_hash(key, ref->key_size, HASHMAP_HASH_SEED));
+
+	if (slot < 0) {
+		return false;
+	}
+
+	/**
+	 * A group that still has an empty slot never made a probe move on, the
+	 * slot can become empty again. Otherwise later keys of the sequence may
+	 * sit past it and it has to stay a tombstone.
+	 */
+
+	if (match_byte(ref->ctrl + (size_t) (slot / HASHMAP_GROUP) * HASHMAP_GROUP, CTRL_EMPTY)) {
+		ref->ctrl[slot] = CTRL_EMPTY;
+	}
+	else {
+		ref->ctrl[slot] = CTRL_DELETED;
+		ref->deleted++;
+	}
+
+	ref->size--;
+
+	return true;
+}
+
+bool hashmap_next(hashmap *ref, uint32_t *it, void **key, void **value)
+{
+	for (; *it < ref->capacity; (*it)++) {
+		if (ref->ctrl[*it] & 0x80) {
+			continue;
+		}
+
+		*key = SLOT(ref, *it);
+		*value = SLOT(ref, *it) + ref->value_offset;
+
+		(*it)++;
+
+		return true;
+	}
+
+	return false;
+}
+
+uint32_t hashmap_size(hashmap *ref)
+{
+	return ref->size;
+}
+
+void hashmap_clear(hashmap *ref)
+{
+	memset(ref->ctrl, CTRL_EMPTY, ref->capacity);
+
+	ref->size = 0;
+	ref->deleted = 0;
+}
+
+void hashmap_free(hashmap *ref)
+{
+	free(ref->ctrl);
+	free(ref->slots);
+
+	ref->ctrl = NULL;
+	ref->slots = NULL;
+	ref->capacity = 0;
+	ref->size = 0;
+}
+
+typedef struct _bench_key_t
+{
+	uint64_t a;
+	uint64_t b;
+}
+bench_key_t;
+
+static double bench_seconds()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+void hashmap_bench()
+{
+	printf("%-8s %18s %18s\n", "keys", "linear Mlookup/s", "hashmap Mlookup/s");
+
+	uint64_t seed = 0x9e3779b97f4a7c15ull;
+
+	for (uint32_t n = 4; n <= 16384; n *= 4) {
+		bench_key_t *keys = malloc(sizeof(bench_key_t) * n);
+
+		hashmap map;
+		hashmap_init(&map, sizeof(bench_key_t), sizeof(uint32_t));
+
+		for (uint32_t i = 0; i < n; i++) {
+			seed ^= seed << 13;
+			seed ^= seed >> 7;
+			seed ^= seed << 17;
+
+			keys[i].a = seed;
+			keys[i].b = i;
+
+			hashmap_put(&map, &keys[i], &i);
+		}
+
+		/**
+		 * The linear search costs n / 2 compares a lookup, fewer lookups
+		 * keep the large sizes short.
+		 */
+
+		uint32_t lookups = 1 << 20;
+		uint32_t linear_lookups = n <= 64 ? lookups : (1u << 26) / n;
+		uint64_t checksum[2] = {0, 0};
+
+		double t0 = bench_seconds();
+
+		for (uint32_t l = 0; l < linear_lookups; l++) {
+			const bench_key_t *key = &keys[(l * 2654435761u) % n];
+
+			for (uint32_t i = 0; i < n; i++) {
+				if (memcmp(&keys[i], key, sizeof(bench_key_t)) == 0) {
+					checksum[0] += i;
+					break;
+				}
+			}
+		}
+
+		double t1 = bench_seconds();
+
+		for (uint32_t l = 0; l < lookups; l++) {
+			const bench_key_t *key = &keys[(l * 2654435761u) % n];
+
+			checksum[1] += *(uint32_t *) hashmap_get(&map, key);
+		}
+
+		double t2 = bench_seconds();
+
+		/**
+		 * Same key sequence, the linear sums are a prefix of the map's
+		 * when fewer lookups ran.
+		 */
+
+		const char *status = linear_lookups == lookups && checksum[0] != checksum[1] ? "  MISMATCH" : "";
+
+		printf("%-8u %18.1f %18.1f%s\n", n, linear_lookups / (t1 - t0) / 1e6, lookups / (t2 - t1) / 1e6, status);
+
+		hashmap_free(&map);
+		free(keys);
+	}
+}
@@ -0,0 +1,135 @@
+#ifndef _HASHMAP_H_
+#define _HASHMAP_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Slots probed at once, one SSE2 compare of their control bytes.
+ */
+#define HASHMAP_GROUP 16
+
+#define HASHMAP_HASH_SEED 0x9e3779b97f4a7c15ull
+
+typedef struct _hashmap hashmap;
+
+/**
+ * @brief      Open addressing hash map of fixed size keys and values, compared
+ *             and hashed as raw bytes (so padding in struct keys must be
+ *             zeroed). SwissTable layout: one control byte per slot, empty,
+ *             deleted or the low 7 bits of the key's hash, probed a group of
+ *             HASHMAP_GROUP at a time. Keys and values sit next to each other
+ *             in `slots`, a hit touches one control line and one slot.
+ */
+struct _hashmap
+{
+	uint8_t *ctrl;
+	char *slots;
+
+	size_t key_size;
+	size_t value_size;
+	size_t value_offset;
+	size_t slot_size;
+
+	uint32_t capacity;
+	uint32_t size;
+	uint32_t deleted;
+};
+
+/**
+ * @brief      Hash POD data, 8 bytes per multiply.
+ *
+ * @param[in]  data      The data.
+ * @param[in]  size      Size in bytes.
+ * @param[in]  seed      HASHMAP_HASH_SEED, or a previous hash to chain
+ *                       several buffers.
+ *
+ * @return     64 bit hash.
+ */
+uint64_t hashmap_hash(const void *data, size_t size, uint64_t seed);
+
+/**
+ * @brief      Initialize an empty map.
+ *
+ * @param      ref         Reference to the associated hashmap struct.
+ * @param[in]  key_size    Size of a key in bytes.
+ * @param[in]  value_size  Size of a value in bytes, may be 0 for a set.
+ */
+void hashmap_init(hashmap *ref, size_t key_size, size_t value_size);
+
+/**
+ * @brief      Get the value stored under a key.
+ *
+ * @param      ref       Reference to the associated hashmap struct.
+ * @param[in]  key       The key.
+ *
+ * @return     Pointer to the value, valid until the next insertion. NULL if
+ *             the key is not present.
+ */
+void *hashmap_get(hashmap *ref, const void *key);
+
+/**
+ * @brief      Insert or overwrite the value of a key.
+ *
+ * @param      ref       Reference to the associated hashmap struct.
+ * @param[in]  key       The key.
+ * @param[in]  value     The value, NULL leaves a new value zeroed and an
+ *                       existing one untouched.
+ *
+ * @return     Pointer to the stored value, valid until the next insertion.
+ */
+void *hashmap_put(hashmap *ref, const void *key, const void *value);
+
+/**
+ * @brief      Remove a key.
+ *
+ * @param      ref       Reference to the associated hashmap struct.
+ * @param[in]  key       The key.
+ *
+ * @return     true if the key was present.
+ */
+bool hashmap_remove(hashmap *ref, const void *key);
+
+/**
+ * @brief      Iterate the entries, in no particular order.
+ *
+ * @param      ref       Reference to the associated hashmap struct.
+ * @param      it        Iterator, 0 before the first call.
+ * @param      key       Set to the entry's key.
+ * @param      value     Set to the entry's value.
+ *
+ * @return     false once every entry has been visited.
+ */
+bool hashmap_next(hashmap *ref, uint32_t *it, void **key, void **value);
+
+/**
+ * @brief      Get the amount of entries.
+ *
+ * @param      ref       Reference to the associated hashmap struct.
+ *
+ * @return     size
+ */
+uint32_t hashmap_size(hashmap *ref);
+
+/**
+ * @brief      Remove every entry, keeping the memory.
+ *
+ * @param      ref       Reference to the associated hashmap struct.
+ */
+void hashmap_clear(hashmap *ref);
+
+/**
+ * @brief      Free the memory allocated to the map.
+ *
+ * @param      ref       Reference to the associated hashmap struct.
+ */
+void hashmap_free(hashmap *ref);
+
+/**
+ * @brief      Print lookup rates of the map against a linear search of an
+ *             array, over growing amounts of 16 byte keys.
+ */
+void hashmap_bench();
+
+#endif
@@ -0,0 +1,115 @@
+#include "histogram.h"
+
+#include <string.h>
+
+static uint32_t histogram_index(uint64_t value)
+{
+	if (value < 2 * HISTOGRAM_SUB_BUCKETS) {
+		return (uint32_t) value;
+	}
+
+	uint32_t msb = 63 - __builtin_clzll(value);
+
+	if (msb >= HISTOGRAM_MAX_BITS) {
+		return HISTOGRAM_BUCKETS - 1;
+	}
+
+	uint32_t shift = msb - HISTOGRAM_SUB_BITS;
+	uint32_t sub = (uint32_t) (value >> shift) - HISTOGRAM_SUB_BUCKETS;
+
+	return 2 * HISTOGRAM_SUB_BUCKETS + (shift - 1) * HISTOGRAM_SUB_BUCKETS + sub;
+}
+
+/**
+ *	Largest value falling into bucket `index`.
+ */
+static uint64_t histogram_bucket_max(uint32_t index)
+{
+	if (index < 2 * HISTOGRAM_SUB_BUCKETS) {
+		return index;
+	}
+
+	uint32_t shift = (index - 2 * HISTOGRAM_SUB_BUCKETS) / HISTOGRAM_SUB_BUCKETS + 1;
+	uint64_t sub = (index - 2 * HISTOGRAM_SUB_BUCKETS) % HISTOGRAM_SUB_BUCKETS + HISTOGRAM_SUB_BUCKETS;
+
+	return ((sub + 1) << shift) - 1;
+}
+
+void histogram_reset(histogram *ref)
+{
+	memset(ref, 0, sizeof(histogram));
+	ref->min = UINT64_MAX;
+}
+
+void histogram_record(histogram *ref, uint64_t value)
+{
+	ref->counts[histogram_index(value)]++;
+
+	ref->total++;
+	ref->sum += value;
+
+	if (value < ref->min) {
+		ref->min = value;
+	}
+
+	if (value > ref->max) {
+		ref->max = value;
+	}
+}
+
+void histogram_merge(histogram *ref, const histogram *src)
+{
+	if (src->total == 0) {
+		return;
+	}
+
+	for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		ref->counts[i] += src->counts[i];
+	}
+
+	ref->total += src->total;
+	ref->sum += src->sum;
+
+	if (src->min < ref->min) {
+		ref->min = src->min;
+	}
+
+	if (src->max > ref->max) {
+		ref->max = src->max;
+	}
+}
+
+uint64_t histogram_percentile(const histogram *ref, double percentile)
+{
+	if (ref->total == 0) {
+		return 0;
+	}
+
+	uint64_t rank = (uint64_t) (percentile / 100.0 * ref->total + 0.5);
+
+	if (rank < 1) {
+		rank = 1;
+	}
+
+	if (rank >= ref->total) {
+		return ref->max;
+	}
+
+	uint64_t seen = 0;
+
+	for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		seen += ref->counts[i];
+
+		if (seen >= rank) {
+			uint64_t value = histogram_bucket_max(i);
+			return value < ref->max ? value : ref->max;
+		}
+	}
+
+	return ref->max;
+}
+
+double histogram_mean(const histogram *ref)
+{
+	return ref->total > 0 ? (double) ref->sum / ref->total : 0.0;
+}
@@ -0,0 +1,75 @@
+#ifndef _HISTOGRAM_H_
+#define _HISTOGRAM_H_
+
+#include <stdint.h>
+
+/**
+ * Log-linear buckets: values below 2 * HISTOGRAM_SUB_BUCKETS are exact, above
+ * that every power of two is split into HISTOGRAM_SUB_BUCKETS buckets, which
+ * keeps the relative error under 1 / HISTOGRAM_SUB_BUCKETS (~0.8%).
+ */
+#define HISTOGRAM_SUB_BITS 7
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_MAX_BITS 40
+#define HISTOGRAM_BUCKETS ((2 * HISTOGRAM_SUB_BUCKETS) + (HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS) * HISTOGRAM_SUB_BUCKETS)
+
+typedef struct _histogram histogram;
+
+/**
+ * @brief      High dynamic range histogram of unsigned values
+ *             (eg. nanoseconds, up to 2^40).
+ */
+struct _histogram
+{
+	uint32_t counts[HISTOGRAM_BUCKETS];
+
+	uint64_t total;
+	uint64_t sum;
+
+	uint64_t min;
+	uint64_t max;
+};
+
+/**
+ * @brief      Clear all recorded values.
+ *
+ * @param      ref       Reference to the associated histogram struct.
+ */
+void histogram_reset(histogram *ref);
+
+/**
+ * @brief      Record a value, larger values are clamped into the last bucket.
+ *
+ * @param      ref       Reference to the associated histogram struct.
+ * @param[in]  value     The value.
+ */
+void histogram_record(histogram *ref, uint64_t value);
+
+/**
+ * @brief      Add every value recorded in `src` to `ref`.
+ *
+ * @param      ref       Reference to the associated histogram struct.
+ * @param      src       The histogram to merge in.
+ */
+void histogram_merge(histogram *ref, const histogram *src);
+
+/**
+ * @brief      Get the value at a percentile.
+ *
+ * @param      ref         Reference to the associated histogram struct.
+ * @param[in]  percentile  In [0, 100].
+ *
+ * @return     Upper bound of the bucket holding the percentile, 0 when empty.
+ */
+uint64_t histogram_percentile(const histogram *ref, double percentile);
+
+/**
+ * @brief      Get the mean of the recorded values.
+ *
+ * @param      ref       Reference to the associated histogram struct.
+ *
+ * @return     mean, 0 when empty.
+ */
+double histogram_mean(const histogram *ref);
+
+#endif
@@ -0,0 +1,205 @@
+#include "json.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define JSON_MAX_DEPTH 64
+
+static bool json_is_space(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static int json_add(json_token *tokens, int capacity, int count, json_type type, int start, int end)
+{
+	if (!tokens) {
+		return count + 1;
+	}
+
+	if (count >= capacity) {
+		return JSON_ERROR_NOMEM;
+	}
+
+	tokens[count].type = type;
+	tokens[count].start = start;
+	tokens[count].end = end;
+	tokens[count].size = 0;
+
+	return count + 1;
+}
+
+int json_parse(const char *js, size_t len, json_token *tokens, int capacity)
+{
+	int count = 0;
+
+	/**
+	 * Open containers, their token index (or -1 while only counting).
+	 */
+	int stack[JSON_MAX_DEPTH];
+	int depth = 0;
+
+	/**
+	 * Set after an object key, the value that follows is not a new member.
+	 */
+	bool after_key = false;
+
+	for (size_t pos = 0; pos < len; pos++) {
+		char c = js[pos];
+
+		if (json_is_space(c) || c == ',') {
+			continue;
+		}
+
+		if (c == ':') {
+			after_key = true;
+			continue;
+		}
+
+		if (c == '}' || c == ']') {
+			if (depth == 0) {
+				return JSON_ERROR_INVALID;
+			}
+
+			depth--;
+
+			if (tokens && stack[depth] >= 0) {
+				tokens[stack[depth]].end = (int) pos + 1;
+			}
+
+			after_key = false;
+			continue;
+		}
+
+		if (depth > 0 && !after_key && tokens && stack[depth - 1] >= 0) {
+			tokens[stack[depth - 1]].size++;
+		}
+
+		after_key = false;
+
+		if (c == '{' || c == '[') {
+			if (depth == JSON_MAX_DEPTH) {
+				return JSON_ERROR_INVALID;
+			}
+
+			int res = json_add(tokens, capacity, count, c == '{' ? JSON_OBJECT : JSON_ARRAY, (int) pos, -1);
+			if (res < 0) {
+				return res;
+			}
+
+			stack[depth++] = tokens ? count : -1;
+			count = res;
+			continue;
+		}
+
+		if (c == '"') {
+			size_t start = ++pos;
+
+			while (pos < len && js[pos] != '"') {
+				if (js[pos] == '\\') {
+					pos++;
+				}
+
+				pos++;
+			}
+
+			if (pos >= len) {
+				return JSON_ERROR_PARTIAL;
+			}
+
+			count = json_add(tokens, capacity, count, JSON_STRING, (int) start, (int) pos);
+			if (count < 0) {
+				return count;
+			}
+
+			continue;
+		}
+
+		size_t start = pos;
+
+		while (pos < len && !json_is_space(js[pos]) && js[pos] != ',' && js[pos] != ']' && js[pos] != '}' && js[pos] != ':') {
+			pos++;
+		}
+
+		count = json_add(tokens, capacity, count, JSON_PRIMITIVE, (int) start, (int) pos);
+		if (count < 0) {
+			return count;
+		}
+
+		pos--;
+	}
+
+	return depth == 0 ? count : JSON_ERROR_PARTIAL;
+}
+
+int json_skip(const json_token *tokens, int count, int index)
+{
+	int end = tokens[index].end;
+
+	index++;
+
+	while (index < count && tokens[index].start < end) {
+		index++;
+	}
+
+	return index;
+}
+
+int json_object_get(const char *js, const json_token *tokens, int count, int index, const char *key)
+{
+	if (index < 0 || tokens[index].type != JSON_OBJECT) {
+		return -1;
+	}
+
+	int i = index + 1;
+
+	for (int member = 0; member < tokens[index].size && i + 1 < count; member++) {
+		if (json_eq(js, &tokens[i], key)) {
+			return i + 1;
+		}
+
+		i = json_skip(tokens, count, i + 1);
+	}
+
+	return -1;
+}
+
+int json_array_get(const json_token *tokens, int count, int index, int n)
+{
+	if (index < 0 || tokens[index].type != JSON_ARRAY || n < 0 || n >= tokens[index].size) {
+		return -1;
+	}
+
+	int i = index + 1;
+
+	while (n-- > 0) {
+		i = json_skip(tokens, count, i);
+	}
+
+	return i;
+}
+
+bool json_eq(const char *js, const json_token *token, const char *str)
+{
+	size_t len = strlen(str);
+
+	return token->type == JSON_STRING && (size_t) (token->end - token->start) == len && strncmp(js + token->start, str, len) == 0;
+}
+
+double json_number(const char *js, const json_token *tokens, int index, double fallback)
+{
+	if (index < 0 || tokens[index].type != JSON_PRIMITIVE) {
+		return fallback;
+	}
+
+	char buf[64];
+	int len = tokens[index].end - tokens[index].start;
+
+	if (len <= 0 || len >= (int) sizeof(buf)) {
+		return fallback;
+	}
+
+	memcpy(buf, js + tokens[index].start, (size_t) len);
+	buf[len] = '\0';
+
+	return strtod(buf, NULL);
+}
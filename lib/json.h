@@ -0,0 +1,86 @@
+#ifndef _JSON_H_
+#define _JSON_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * Flat, non-allocating JSON tokenizer. Tokens are produced in document
+ * order, a container is followed by its whole subtree; strings point into
+ * the source, without their quotes and with escapes left as they are.
+ */
+typedef enum _json_type
+{
+	JSON_UNDEFINED = 0,
+	JSON_OBJECT,
+	JSON_ARRAY,
+	JSON_STRING,
+	JSON_PRIMITIVE
+}
+json_type;
+
+typedef struct _json_token json_token;
+
+/**
+ * @brief      Token, a range of the source text.
+ */
+struct _json_token
+{
+	json_type type;
+
+	int start;
+	int end;
+
+	/**
+	 * Members of an object (key / value pairs count once) or an array.
+	 */
+	int size;
+};
+
+#define JSON_ERROR_INVALID -1
+#define JSON_ERROR_PARTIAL -2
+#define JSON_ERROR_NOMEM -3
+
+/**
+ * @brief      Tokenize a document.
+ *
+ * @param      js        The source text.
+ * @param[in]  len       Length of the source.
+ * @param      tokens    Token storage, NULL to only count the tokens.
+ * @param[in]  capacity  Amount of tokens `tokens` can hold.
+ *
+ * @return     Amount of tokens, or one of the JSON_ERROR_* codes.
+ */
+int json_parse(const char *js, size_t len, json_token *tokens, int capacity);
+
+/**
+ * @brief      Index of the token following `index` and its whole subtree.
+ */
+int json_skip(const json_token *tokens, int count, int index);
+
+/**
+ * @brief      Value of `key` in the object at `index`.
+ *
+ * @return     Token index of the value, -1 if the key is missing.
+ */
+int json_object_get(const char *js, const json_token *tokens, int count, int index, const char *key);
+
+/**
+ * @brief      Element `n` of the array at `index`.
+ *
+ * @return     Token index of the element, -1 if out of range.
+ */
+int json_array_get(const json_token *tokens, int count, int index, int n);
+
+/**
+ * @brief      Compare a string token with `str`.
+ */
+bool json_eq(const char *js, const json_token *token, const char *str);
+
+/**
+ * @brief      Numeric value of a primitive token, `fallback` for a missing
+ *             (negative) index.
+ */
+double json_number(const char *js, const json_token *tokens, int index, double fallback);
+
+#endif
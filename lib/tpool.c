@@ -0,0 +1,157 @@
+#include "tpool.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ *	Claim and run indices of the current parallel for until none are left.
+ */
+static void tpool_drain(tpool *ref)
+{
+	int i;
+
+	while ((i = __atomic_fetch_add(&ref->next, 1, __ATOMIC_ACQ_REL)) < ref->count) {
+
+		ref->fn(ref->ctx, i);
+
+		if (__atomic_sub_fetch(&ref->pending, 1, __ATOMIC_ACQ_REL) == 0) {
+			pthread_mutex_lock(&ref->lock);
+			pthread_cond_broadcast(&ref->done_cond);
+			pthread_mutex_unlock(&ref->lock);
+		}
+	}
+}
+
+static void *tpool_worker(void *arg)
+{
+	tpool *ref = arg;
+	uint64_t seen = 0;
+
+	pthread_mutex_lock(&ref->lock);
+
+	for (;;) {
+		while (!ref->shutdown && ref->generation == seen) {
+			pthread_cond_wait(&ref->work_cond, &ref->lock);
+		}
+
+		if (ref->shutdown) {
+			break;
+		}
+
+		seen = ref->generation;
+		ref->active++;
+
+		pthread_mutex_unlock(&ref->lock);
+		tpool_drain(ref);
+		pthread_mutex_lock(&ref->lock);
+
+		if (--ref->active == 0) {
+			pthread_cond_broadcast(&ref->done_cond);
+		}
+	}
+
+	pthread_mutex_unlock(&ref->lock);
+
+	return NULL;
+}
+
+void tpool_init(tpool *ref, int threads)
+{
+	if (threads <= 0) {
+		threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	}
+
+	/**
+	 * The calling thread takes part in every parallel for.
+	 */
+
+	ref->thread_count = threads > 1 ? threads - 1 : 0;
+	ref->threads = malloc(sizeof(pthread_t) * (ref->thread_count > 0 ? ref->thread_count : 1));
+
+	pthread_mutex_init(&ref->lock, NULL);
+	pthread_cond_init(&ref->work_cond, NULL);
+	pthread_cond_init(&ref->done_cond, NULL);
+
+	ref->fn = NULL;
+	ref->ctx = NULL;
+	ref->count = 0;
+	ref->next = 0;
+	ref->pending = 0;
+	ref->active = 0;
+	ref->generation = 0;
+	ref->shutdown = false;
+
+	for (int i = 0; i < ref->thread_count; i++) {
+		pthread_create(&ref->threads[i], NULL, tpool_worker, ref);
+	}
+}
+
+void tpool_parallel_for(tpool *ref, int count, tpool_fn fn, void *ctx)
+{
+	if (count <= 0) {
+		return;
+	}
+
+	if (ref->thread_count == 0 || count == 1) {
+		for (int i = 0; i < count; i++) {
+			fn(ctx, i);
+		}
+
+		return;
+	}
+
+	pthread_mutex_lock(&ref->lock);
+
+	while (ref->active > 0) {
+		pthread_cond_wait(&ref->done_cond, &ref->lock);
+	}
+
+	ref->fn = fn;
+	ref->ctx = ctx;
+	ref->count = count;
+	ref->pending = count;
+	__atomic_store_n(&ref->next, 0, __ATOMIC_RELEASE);
+
+	ref->generation++;
+	pthread_cond_broadcast(&ref->work_cond);
+
+	pthread_mutex_unlock(&ref->lock);
+
+	tpool_drain(ref);
+
+	/**
+	 * Wait for stragglers too, so no worker is left inside `tpool_drain()`
+	 * when the next parallel for resets the counters.
+	 */
+
+	pthread_mutex_lock(&ref->lock);
+
+	while (__atomic_load_n(&ref->pending, __ATOMIC_ACQUIRE) > 0 || ref->active > 0) {
+		pthread_cond_wait(&ref->done_cond, &ref->lock);
+	}
+
+	pthread_mutex_unlock(&ref->lock);
+}
+
+int tpool_size(tpool *ref)
+{
+	return ref->thread_count + 1;
+}
+
+void tpool_free(tpool *ref)
+{
+	pthread_mutex_lock(&ref->lock);
+	ref->shutdown = true;
+	pthread_cond_broadcast(&ref->work_cond);
+	pthread_mutex_unlock(&ref->lock);
+
+	for (int i = 0; i < ref->thread_count; i++) {
+		pthread_join(ref->threads[i], NULL);
+	}
+
+	free(ref->threads);
+
+	pthread_mutex_destroy(&ref->lock);
+	pthread_cond_destroy(&ref->work_cond);
+	pthread_cond_destroy(&ref->done_cond);
+}
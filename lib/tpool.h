@@ -0,0 +1,74 @@
+#ifndef _TPOOL_H_
+#define _TPOOL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/**
+ * @brief      Task callback, invoked once per index of a parallel for.
+ */
+typedef void (*tpool_fn)(void *ctx, int index);
+
+typedef struct _tpool tpool;
+
+/**
+ * @brief      Fixed size pool of worker threads.
+ */
+struct _tpool
+{
+	pthread_t *threads;
+	int thread_count;
+
+	pthread_mutex_t lock;
+	pthread_cond_t work_cond;
+	pthread_cond_t done_cond;
+
+	tpool_fn fn;
+	void *ctx;
+
+	int count;
+	int next;
+	int pending;
+	int active;
+
+	uint64_t generation;
+	bool shutdown;
+};
+
+/**
+ * @brief      Spawn the worker threads.
+ *
+ * @param      ref       Reference to the associated pool struct.
+ * @param[in]  threads   Amount of workers, 0 for one per online CPU.
+ */
+void tpool_init(tpool *ref, int threads);
+
+/**
+ * @brief      Run `fn(ctx, i)` for every i in [0, count) across the workers
+ *             and the calling thread. Returns when all calls have finished.
+ *
+ * @param      ref       Reference to the associated pool struct.
+ * @param[in]  count     Amount of indices.
+ * @param[in]  fn        The callback.
+ * @param      ctx       User pointer passed to the callback.
+ */
+void tpool_parallel_for(tpool *ref, int count, tpool_fn fn, void *ctx);
+
+/**
+ * @brief      Get the amount of threads taking part in a parallel for.
+ *
+ * @param      ref       Reference to the associated pool struct.
+ *
+ * @return     Workers + the calling thread.
+ */
+int tpool_size(tpool *ref);
+
+/**
+ * @brief      Join the workers and free the pool.
+ *
+ * @param      ref       Reference to the associated pool struct.
+ */
+void tpool_free(tpool *ref);
+
+#endif
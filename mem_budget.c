@@ -0,0 +1,293 @@
+#include "mem_budget.h"
+#include "residency.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MiB(bytes) ((double) (bytes) / (1024.0 * 1024.0))
+
+/**
+ *	Check the device for `VK_EXT_memory_budget`. Without it budgets fall back
+ *	to a fixed share of each heap.
+ */
+bool mem_budget_ext_supported(VkPhysicalDevice phys_device)
+{
+	uint32_t ext_count;
+	vkEnumerateDeviceExtensionProperties(phys_device, NULL, &ext_count, NULL);
+
+	VkExtensionProperties available_ext[ext_count];
+	vkEnumerateDeviceExtensionProperties(phys_device, NULL, &ext_count, available_ext);
+
+	for (uint32_t i = 0; i < ext_count; i++) {
+		if (strcmp(available_ext[i].extensionName, MEM_BUDGET_EXTENSION_NAME) == 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ *	Set up heap bookkeeping for `PHYSDEV(0)`. `ext_budget` must only be set
+ *	when the extension was enabled on `ref->device`.
+ */
+void init_mem_budget(struct _application *ref, mem_budget_t *budget, bool ext_budget)
+{
+	memset(budget, 0, sizeof(mem_budget_t));
+
+	VkPhysicalDeviceMemoryProperties mem_props;
+	vkGetPhysicalDeviceMemoryProperties(PHYSDEV(0), &mem_props);
+
+	budget->ext_budget = ext_budget;
+	budget->heap_count = mem_props.memoryHeapCount;
+	budget->type_count = mem_props.memoryTypeCount;
+
+	for (uint32_t i = 0; i < mem_props.memoryHeapCount; i++) {
+		budget->heaps[i].flags = mem_props.memoryHeaps[i].flags;
+		budget->heaps[i].size = mem_props.memoryHeaps[i].size;
+	}
+
+	for (uint32_t i = 0; i < mem_props.memoryTypeCount; i++) {
+		budget->type_heap[i] = mem_props.memoryTypes[i].heapIndex;
+	}
+
+	array_init(&budget->allocations, sizeof(mem_allocation_t));
+
+	mem_budget_query(ref, budget);
+}
+
+void destroy_mem_budget(mem_budget_t *budget)
+{
+	if (array_size(&budget->allocations) > 0) {
+		fprintf(stderr, "WARN: %zu device memory allocations still alive\n", (size_t) array_size(&budget->allocations));
+	}
+
+	array_free(&budget->allocations);
+}
+
+/**
+ *	Refresh per heap budget and usage. The driver's usage covers every
+ *	allocation of the process, including the ones we do not track.
+ */
+void mem_budget_query(struct _application *ref, mem_budget_t *budget)
+{
+	budget->last_query = budget->frame;
+
+	if (budget->ext_budget) {
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_props = {};
+		budget_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+		VkPhysicalDeviceMemoryProperties2 mem_props = {};
+		mem_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		mem_props.pNext = &budget_props;
+
+		vkGetPhysicalDeviceMemoryProperties2(PHYSDEV(0), &mem_props);
+
+		for (uint32_t i = 0; i < budget->heap_count; i++) {
+			budget->heaps[i].budget = budget_props.heapBudget[i];
+			budget->heaps[i].usage = budget_props.heapUsage[i];
+			budget->heaps[i].tracked_at_query = budget->heaps[i].tracked;
+		}
+
+		return;
+	}
+
+	for (uint32_t i = 0; i < budget->heap_count; i++) {
+		budget->heaps[i].budget = (VkDeviceSize) (budget->heaps[i].size * MEM_BUDGET_FALLBACK_FRACTION);
+		budget->heaps[i].usage = budget->heaps[i].tracked;
+		budget->heaps[i].tracked_at_query = budget->heaps[i].tracked;
+	}
+}
+
+/**
+ *	Best estimate of the heap's current usage: the last driver figure
+ *	adjusted by what we allocated or freed since.
+ */
+VkDeviceSize mem_budget_usage(const mem_budget_t *budget, uint32_t heap)
+{
+	const mem_heap_t *h = &budget->heaps[heap];
+
+	int64_t usage = (int64_t) h->usage + (int64_t) h->tracked - (int64_t) h->tracked_at_query;
+
+	if (usage < (int64_t) h->tracked) {
+		usage = (int64_t) h->tracked;
+	}
+
+	return (VkDeviceSize) usage;
+}
+
+/**
+ *	Heap a tracked allocation lives in, UINT32_MAX if `mem` is unknown.
+ */
+uint32_t mem_budget_heap(struct _application *ref, VkDeviceMemory mem)
+{
+	if (!ref->mem_budget) {
+		return UINT32_MAX;
+	}
+
+	mem_allocation_t *allocs = (mem_allocation_t *) array_data(&ref->mem_budget->allocations);
+
+	for (int i = 0; i < array_size(&ref->mem_budget->allocations); i++) {
+		if (allocs[i].memory == mem) {
+			return allocs[i].heap;
+		}
+	}
+
+	return UINT32_MAX;
+}
+
+/**
+ *	Find a memory type accepted by `type_filter` that lives in another,
+ *	non device local heap than `failed_type`, ie. system memory the GPU can
+ *	still read over the bus. Returns UINT32_MAX when there is none.
+ */
+uint32_t mem_budget_fallback_type(struct _application *ref, uint32_t type_filter, uint32_t failed_type)
+{
+	VkPhysicalDeviceMemoryProperties mem_props;
+	vkGetPhysicalDeviceMemoryProperties(PHYSDEV(0), &mem_props);
+
+	uint32_t failed_heap = mem_props.memoryTypes[failed_type].heapIndex;
+
+	for (uint32_t i = 0; i < mem_props.memoryTypeCount; i++) {
+		uint32_t heap = mem_props.memoryTypes[i].heapIndex;
+
+		if (!(type_filter & (1 << i)) || heap == failed_heap) {
+			continue;
+		}
+
+		if (!(mem_props.memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)) {
+			return i;
+		}
+	}
+
+	return UINT32_MAX;
+}
+
+static void track_allocation(mem_budget_t *budget, VkDeviceMemory mem, VkDeviceSize size, uint32_t heap)
+{
+	mem_allocation_t entry = { mem, size, heap };
+	array_append(&budget->allocations, &entry);
+
+	mem_heap_t *h = &budget->heaps[heap];
+	h->tracked += size;
+	h->allocations++;
+
+	if (h->tracked > h->peak) {
+		h->peak = h->tracked;
+	}
+}
+
+/**
+ *	`vkAllocateMemory()` with budget tracking. An allocation that would take
+ *	its heap past the high watermark makes the residency manager evict first,
+ *	and an out of memory failure is retried as long as eviction frees
+ *	something. The result is returned, never fatal here.
+ */
+VkResult mem_budget_allocate(struct _application *ref, const VkMemoryAllocateInfo *alloc_info, VkDeviceMemory *mem)
+{
+	mem_budget_t *budget = ref->mem_budget;
+
+	if (!budget) {
+		return vkAllocateMemory(ref->device, alloc_info, HOST_ALLOC(MEMORY), mem);
+	}
+
+	uint32_t heap = budget->type_heap[alloc_info->memoryTypeIndex];
+	VkDeviceSize size = alloc_info->allocationSize;
+
+	VkDeviceSize usage = mem_budget_usage(budget, heap);
+	VkDeviceSize high = (VkDeviceSize) (budget->heaps[heap].budget * MEM_BUDGET_HIGH_WATERMARK);
+	VkDeviceSize low = (VkDeviceSize) (budget->heaps[heap].budget * MEM_BUDGET_LOW_WATERMARK);
+
+	if (ref->residency && usage + size > high) {
+		residency_evict(ref, heap, usage + size - low);
+	}
+
+	VkResult res = vkAllocateMemory(ref->device, alloc_info, HOST_ALLOC(MEMORY), mem);
+
+	while ((res == VK_ERROR_OUT_OF_DEVICE_MEMORY || res == VK_ERROR_OUT_OF_HOST_MEMORY) && ref->residency) {
+		if (residency_evict(ref, heap, size) == 0) {
+			break;
+		}
+
+		res = vkAllocateMemory(ref->device, alloc_info, HOST_ALLOC(MEMORY), mem);
+
+		if (res == VK_SUCCESS) {
+			budget->recovered_allocations++;
+		}
+	}
+
+	if (res == VK_SUCCESS) {
+		track_allocation(budget, *mem, size, heap);
+	}
+
+	return res;
+}
+
+/**
+ *	`vkFreeMemory()` for memory from `mem_budget_allocate()`.
+ */
+void mem_budget_free(struct _application *ref, VkDeviceMemory mem)
+{
+	mem_budget_t *budget = ref->mem_budget;
+
+	if (budget && mem != VK_NULL_HANDLE) {
+		mem_allocation_t *allocs = (mem_allocation_t *) array_data(&budget->allocations);
+		size_t count = array_size(&budget->allocations);
+
+		for (size_t i = 0; i < count; i++) {
+			if (allocs[i].memory != mem) {
+				continue;
+			}
+
+			budget->heaps[allocs[i].heap].tracked -= allocs[i].size;
+
+			array_remove(&budget->allocations, (int) i);
+			break;
+		}
+	}
+
+	vkFreeMemory(ref->device, mem, HOST_ALLOC(MEMORY));
+}
+
+/**
+ *	Once per frame, after the frame's fence: advance the LRU clock, refresh
+ *	the driver budget now and then and let the residency manager restore
+ *	what fits again.
+ */
+void mem_budget_frame(struct _application *ref)
+{
+	mem_budget_t *budget = ref->mem_budget;
+
+	if (!budget) {
+		return;
+	}
+
+	budget->frame++;
+
+	if (budget->frame - budget->last_query >= MEM_BUDGET_QUERY_INTERVAL) {
+		mem_budget_query(ref, budget);
+	}
+
+	if (ref->residency) {
+		residency_update(ref);
+	}
+}
+
+void mem_budget_report(const mem_budget_t *budget)
+{
+	printf("Device memory (%s):\n", budget->ext_budget ? "VK_EXT_memory_budget" : "heap size fallback");
+
+	for (uint32_t i = 0; i < budget->heap_count; i++) {
+		const mem_heap_t *h = &budget->heaps[i];
+
+		printf("  heap %u%s: %9.1f MiB used of %9.1f MiB budget (%9.1f MiB heap), tracked %8.1f MiB, peak %8.1f MiB, %u allocations\n",
+			i, (h->flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? " [device]" : "         ",
+			MiB(mem_budget_usage(budget, i)), MiB(h->budget), MiB(h->size), MiB(h->tracked), MiB(h->peak), h->allocations);
+	}
+
+	if (budget->recovered_allocations || budget->fallback_allocations) {
+		printf("  %u allocations recovered by eviction, %u placed in a fallback heap\n",
+			budget->recovered_allocations, budget->fallback_allocations);
+	}
+}
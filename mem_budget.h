@@ -0,0 +1,107 @@
+#ifndef _MEM_BUDGET_H_
+#define _MEM_BUDGET_H_
+
+#include "application.h"
+
+/**
+ *	Share of a heap treated as the budget when `VK_EXT_memory_budget` is not
+ *	supported by the device.
+ */
+#define MEM_BUDGET_FALLBACK_FRACTION 0.8
+
+/**
+ *	An allocation taking a heap past `HIGH` of its budget first has the
+ *	residency manager evict down to `LOW`. Restores only happen while the
+ *	heap stays under `LOW`, so the two do not fight each other.
+ */
+#define MEM_BUDGET_HIGH_WATERMARK 0.9
+#define MEM_BUDGET_LOW_WATERMARK 0.75
+
+/**
+ *	Frames between two driver budget queries.
+ */
+#define MEM_BUDGET_QUERY_INTERVAL 60
+
+#define MEM_BUDGET_EXTENSION_NAME "VK_EXT_memory_budget"
+
+typedef struct _mem_heap_t
+{
+	VkMemoryHeapFlags flags;
+	VkDeviceSize size;
+
+	/**
+	 * `budget` and `usage` come from the driver at the last query (or the
+	 * fallback fraction and our own count), `tracked` is what went through
+	 * `mem_budget_allocate()` and is always current.
+	 */
+
+	VkDeviceSize budget;
+	VkDeviceSize usage;
+	VkDeviceSize tracked;
+	VkDeviceSize tracked_at_query;
+
+	VkDeviceSize peak;
+	uint32_t allocations;
+}
+mem_heap_t;
+
+typedef struct _mem_allocation_t
+{
+	VkDeviceMemory memory;
+	VkDeviceSize size;
+	uint32_t heap;
+}
+mem_allocation_t;
+
+/**
+ *	Per heap view of device memory, fed by `create_buffer()` and
+ *	`create_image()`.
+ */
+typedef struct _mem_budget_t
+{
+	bool ext_budget;
+
+	uint32_t heap_count;
+	mem_heap_t heaps[VK_MAX_MEMORY_HEAPS];
+
+	uint32_t type_count;
+	uint32_t type_heap[VK_MAX_MEMORY_TYPES];
+
+	array allocations;
+
+	uint64_t frame;
+	uint64_t last_query;
+
+	/**
+	 * Allocations that only succeeded after eviction, or that were placed
+	 * outside of the requested heap.
+	 */
+
+	uint32_t recovered_allocations;
+	uint32_t fallback_allocations;
+}
+mem_budget_t;
+
+bool mem_budget_ext_supported(VkPhysicalDevice phys_device);
+
+void init_mem_budget(struct _application *ref, mem_budget_t *budget, bool ext_budget);
+
+void destroy_mem_budget(mem_budget_t *budget);
+
+void mem_budget_query(struct _application *ref, mem_budget_t *budget);
+
+VkDeviceSize mem_budget_usage(const mem_budget_t *budget, uint32_t heap);
+
+uint32_t mem_budget_heap(struct _application *ref, VkDeviceMemory mem);
+
+uint32_t mem_budget_fallback_type(struct _application *ref, uint32_t type_filter, uint32_t failed_type);
+
+VkResult mem_budget_allocate(struct _application *ref, const VkMemoryAllocateInfo *alloc_info, VkDeviceMemory *mem);
+
+void mem_budget_free(struct _application *ref, VkDeviceMemory mem);
+
+void mem_budget_frame(struct _application *ref);
+
+void mem_budget_report(const mem_budget_t *budget);
+
+#endif
@@ -0,0 +1,1097 @@
+#include "mesh.h"
+#include "profiler.h"
+#include "lib/json.h"
+
+#include <fcntl.h>
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define GLB_MAGIC 0x46546C67
+#define GLB_CHUNK_JSON 0x4E4F534A
+#define GLB_CHUNK_BIN 0x004E4942
+
+#define GLTF_MODE_TRIANGLES 4
+
+#define GLTF_BYTE 5120
+#define GLTF_UNSIGNED_BYTE 5121
+#define GLTF_SHORT 5122
+#define GLTF_UNSIGNED_SHORT 5123
+#define GLTF_UNSIGNED_INT 5125
+#define GLTF_FLOAT 5126
+
+typedef struct _mapped_file_t
+{
+	const char *data;
+	size_t size;
+}
+mapped_file_t;
+
+/**
+ *	Map a whole file read only. The loaders walk it once from front to back,
+ *	so the kernel is told to read ahead.
+ */
+static bool map_file(const char *path, mapped_file_t *file)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "WARN: failed to open `%s`\n", path);
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		fprintf(stderr, "WARN: `%s` is empty\n", path);
+		close(fd);
+		return false;
+	}
+
+	void *data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (data == MAP_FAILED) {
+		fprintf(stderr, "WARN: failed to map `%s`\n", path);
+		return false;
+	}
+
+	madvise(data, (size_t) st.st_size, MADV_SEQUENTIAL);
+
+	file->data = data;
+	file->size = (size_t) st.st_size;
+
+	return true;
+}
+
+static void unmap_file(mapped_file_t *file)
+{
+	munmap((void *) file->data, file->size);
+}
+
+static void reserve(array *arr, size_t extra)
+{
+	size_t needed = (size_t) array_size(arr) + extra;
+
+	if ((size_t) arr->capacity < needed) {
+		array_resize(arr, (int) needed, false);
+	}
+}
+
+static void grow_bounds(mesh_t *mesh, const float *pos)
+{
+	for (int i = 0; i < 3; i++) {
+		mesh->min[i] = pos[i] < mesh->min[i] ? pos[i] : mesh->min[i];
+		mesh->max[i] = pos[i] > mesh->max[i] ? pos[i] : mesh->max[i];
+	}
+}
+
+/**
+ *	Open a submesh at the current end of the vertex and index arrays.
+ */
+static void begin_submesh(mesh_t *mesh, const char *name, size_t name_len)
+{
+	submesh_t submesh = {};
+
+	if (name_len >= MESH_NAME_SIZE) {
+		name_len = MESH_NAME_SIZE - 1;
+	}
+
+	memcpy(submesh.name, name, name_len);
+
+	submesh.first_index = (uint32_t) array_size(&mesh->indices);
+	submesh.vertex_offset = (int32_t) array_size(&mesh->vertices);
+
+	array_append(&mesh->submeshes, &submesh);
+}
+
+/**
+ *	Close the last submesh, dropping it if nothing was added.
+ */
+static void end_submesh(mesh_t *mesh)
+{
+	int last = array_size(&mesh->submeshes) - 1;
+	submesh_t *submesh = &((submesh_t *) array_data(&mesh->submeshes))[last];
+
+	submesh->index_count = (uint32_t) array_size(&mesh->indices) - submesh->first_index;
+	submesh->vertex_count = (uint32_t) array_size(&mesh->vertices) - (uint32_t) submesh->vertex_offset;
+
+	submesh->lod_count = 1;
+	submesh->lods[0].first_index = submesh->first_index;
+	submesh->lods[0].index_count = submesh->index_count;
+	submesh->lods[0].error = 0.0f;
+
+	mesh->lod_count = 1;
+
+	if (submesh->index_count == 0) {
+		array_remove(&mesh->submeshes, last);
+	}
+}
+
+static const char *base_name(const char *path, size_t *len)
+{
+	const char *name = strrchr(path, '/');
+	name = name ? name + 1 : path;
+
+	const char *dot = strrchr(name, '.');
+	*len = dot ? (size_t) (dot - name) : strlen(name);
+
+	return name;
+}
+
+void init_mesh(mesh_t *mesh)
+{
+	memset(mesh, 0, sizeof(mesh_t));
+
+	array_init(&mesh->vertices, sizeof(vertex_t));
+	array_init(&mesh->indices, sizeof(uint32_t));
+	array_init(&mesh->submeshes, sizeof(submesh_t));
+
+	for (int i = 0; i < 3; i++) {
+		mesh->min[i] = FLT_MAX;
+		mesh->max[i] = -FLT_MAX;
+	}
+}
+
+void free_mesh(mesh_t *mesh)
+{
+	array_free(&mesh->vertices);
+	array_free(&mesh->indices);
+	array_free(&mesh->submeshes);
+}
+
+/**
+ *	Append already indexed geometry as a new submesh.
+ */
+void mesh_add(mesh_t *mesh, const char *name, const vertex_t *vertices, uint32_t vertex_count, const uint32_t *indices, uint32_t index_count)
+{
+	begin_submesh(mesh, name, strlen(name));
+
+	reserve(&mesh->vertices, vertex_count);
+	reserve(&mesh->indices, index_count);
+
+	for (uint32_t i = 0; i < vertex_count; i++) {
+		array_append(&mesh->vertices, (void *) &vertices[i]);
+		grow_bounds(mesh, vertices[i].pos);
+	}
+
+	for (uint32_t i = 0; i < index_count; i++) {
+		array_append(&mesh->indices, (void *) &indices[i]);
+	}
+
+	end_submesh(mesh);
+}
+
+/**
+ *	16 bit indices when every submesh fits, indices being relative to the
+ *	submesh's vertex offset.
+ */
+VkIndexType mesh_index_type(mesh_t *mesh)
+{
+	submesh_t *submeshes = (submesh_t *) array_data(&mesh->submeshes);
+
+	for (int i = 0; i < array_size(&mesh->submeshes); i++) {
+		if (submeshes[i].vertex_count > UINT16_MAX + 1) {
+			return VK_INDEX_TYPE_UINT32;
+		}
+	}
+
+	return VK_INDEX_TYPE_UINT16;
+}
+
+bool mesh_load(mesh_t *mesh, const char *path)
+{
+	const char *ext = strrchr(path, '.');
+
+	if (ext && strcasecmp(ext, ".obj") == 0) {
+		return mesh_load_obj(mesh, path);
+	}
+
+	if (ext && strcasecmp(ext, ".glb") == 0) {
+		return mesh_load_glb(mesh, path);
+	}
+
+	fprintf(stderr, "WARN: unsupported model format `%s`, expected .obj or .glb\n", path);
+	return false;
+}
+
+/**
+ *	// BEGIN // OBJ
+ */
+
+/**
+ *	Open addressing table from an OBJ corner (position and texcoord index)
+ *	to the vertex emitted for it. Slots of older submeshes are told apart by
+ *	`gen`, so moving on to the next submesh does not clear the table.
+ */
+typedef struct _vertex_slot_t
+{
+	uint64_t key;
+	uint32_t index;
+	uint32_t gen;
+}
+vertex_slot_t;
+
+typedef struct _vertex_table_t
+{
+	vertex_slot_t *slots;
+	uint32_t capacity;
+	uint32_t count;
+	uint32_t gen;
+}
+vertex_table_t;
+
+static uint32_t slot_of(uint64_t key, uint32_t capacity)
+{
+	return (uint32_t) ((key * 0x9E3779B97F4A7C15ull) >> 32) & (capacity - 1);
+}
+
+static void table_init(vertex_table_t *table, uint32_t expected)
+{
+	table->capacity = 16;
+
+	while (table->capacity < expected * 2) {
+		table->capacity *= 2;
+	}
+
+	table->slots = calloc(table->capacity, sizeof(vertex_slot_t));
+	table->count = 0;
+	table->gen = 1;
+}
+
+static void table_next_gen(vertex_table_t *table)
+{
+	table->gen++;
+	table->count = 0;
+}
+
+static void table_grow(vertex_table_t *table)
+{
+	vertex_slot_t *old = table->slots;
+	uint32_t old_capacity = table->capacity;
+
+	table->capacity *= 2;
+	table->slots = calloc(table->capacity, sizeof(vertex_slot_t));
+
+	for (uint32_t i = 0; i < old_capacity; i++) {
+		if (old[i].gen != table->gen) {
+			continue;
+		}
+
+		uint32_t slot = slot_of(old[i].key, table->capacity);
+
+		while (table->slots[slot].gen == table->gen) {
+			slot = (slot + 1) & (table->capacity - 1);
+		}
+
+		table->slots[slot] = old[i];
+	}
+
+	free(old);
+}
+
+/**
+ *	Find `key`, or claim a slot for it and return false.
+ */
+static bool table_find(vertex_table_t *table, uint64_t key, uint32_t **index)
+{
+	if (table->count * 2 >= table->capacity) {
+		table_grow(table);
+	}
+
+	uint32_t slot = slot_of(key, table->capacity);
+
+	while (table->slots[slot].gen == table->gen) {
+		if (table->slots[slot].key == key) {
+			*index = &table->slots[slot].index;
+			return true;
+		}
+
+		slot = (slot + 1) & (table->capacity - 1);
+	}
+
+	table->slots[slot].key = key;
+	table->slots[slot].gen = table->gen;
+	table->count++;
+
+	*index = &table->slots[slot].index;
+
+	return false;
+}
+
+static const char *skip_space(const char *p, const char *end)
+{
+	while (p < end && (*p == ' ' || *p == '\t')) {
+		p++;
+	}
+
+	return p;
+}
+
+static const char *next_line(const char *p, const char *end)
+{
+	const char *nl = memchr(p, '\n', (size_t) (end - p));
+
+	return nl ? nl + 1 : end;
+}
+
+static bool at_line_end(const char *p, const char *end)
+{
+	return p >= end || *p == '\n' || *p == '\r' || *p == '#';
+}
+
+static const double pow10_table[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+	1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/**
+ *	Decimal float without locale or `strtof()` overhead. Exact for the up to
+ *	18 significant digits exporters write, which is all a float can hold.
+ */
+static float parse_float(const char **pp, const char *end)
+{
+	const char *p = skip_space(*pp, end);
+
+	bool neg = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		neg = *p == '-';
+		p++;
+	}
+
+	uint64_t mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+
+	while (p < end && *p >= '0' && *p <= '9') {
+		if (digits < 18) {
+			mantissa = mantissa * 10 + (uint64_t) (*p - '0');
+			digits += mantissa > 0;
+		}
+		else {
+			exponent++;
+		}
+
+		p++;
+	}
+
+	if (p < end && *p == '.') {
+		p++;
+
+		while (p < end && *p >= '0' && *p <= '9') {
+			if (digits < 18) {
+				mantissa = mantissa * 10 + (uint64_t) (*p - '0');
+				digits += mantissa > 0;
+				exponent--;
+			}
+
+			p++;
+		}
+	}
+
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		p++;
+
+		bool exp_neg = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			exp_neg = *p == '-';
+			p++;
+		}
+
+		int e = 0;
+		while (p < end && *p >= '0' && *p <= '9') {
+			e = e < 10000 ? e * 10 + (*p - '0') : e;
+			p++;
+		}
+
+		exponent += exp_neg ? -e : e;
+	}
+
+	double value = (double) mantissa;
+
+	if (exponent < 0) {
+		value = exponent >= -22 ? value / pow10_table[-exponent] : value * pow(10.0, exponent);
+	}
+	else if (exponent > 0) {
+		value = exponent <= 22 ? value * pow10_table[exponent] : value * pow(10.0, exponent);
+	}
+
+	*pp = p;
+
+	return (float) (neg ? -value : value);
+}
+
+static bool parse_int(const char **pp, const char *end, int64_t *value)
+{
+	const char *p = *pp;
+
+	bool neg = false;
+	if (p < end && *p == '-') {
+		neg = true;
+		p++;
+	}
+
+	if (p >= end || *p < '0' || *p > '9') {
+		return false;
+	}
+
+	int64_t v = 0;
+	while (p < end && *p >= '0' && *p <= '9') {
+		v = v * 10 + (*p - '0');
+		p++;
+	}
+
+	*value = neg ? -v : v;
+	*pp = p;
+
+	return true;
+}
+
+typedef struct _obj_counts_t
+{
+	uint32_t positions;
+	uint32_t texcoords;
+	uint32_t corners;
+	uint32_t triangles;
+}
+obj_counts_t;
+
+/**
+ *	First pass: count elements so the second one never reallocates.
+ */
+static void obj_count(const char *p, const char *end, obj_counts_t *counts)
+{
+	memset(counts, 0, sizeof(obj_counts_t));
+
+	while (p < end) {
+		p = skip_space(p, end);
+
+		if (end - p > 2 && p[0] == 'v') {
+			counts->positions += p[1] == ' ' || p[1] == '\t';
+			counts->texcoords += p[1] == 't';
+		}
+		else if (end - p > 2 && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+			uint32_t groups = 0;
+
+			p++;
+
+			for (;;) {
+				p = skip_space(p, end);
+
+				if (at_line_end(p, end)) {
+					break;
+				}
+
+				groups++;
+
+				while (p < end && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r') {
+					p++;
+				}
+			}
+
+			if (groups >= 3) {
+				counts->corners += groups;
+				counts->triangles += groups - 2;
+			}
+		}
+
+		p = next_line(p, end);
+	}
+}
+
+/**
+ *	Load a Wavefront OBJ. Positions (optionally followed by an RGB vertex
+ *	color), texture coordinates and faces are read, polygons are fanned into
+ *	triangles. Every `o` / `g` starts a submesh, within which identical
+ *	position / texcoord corners share a vertex. Normals and materials are not
+ *	used by the renderer and are skipped.
+ */
+bool mesh_load_obj(mesh_t *mesh, const char *path)
+{
+	PROFILE_ZONE("mesh_load_obj");
+
+	mapped_file_t file;
+	if (!map_file(path, &file)) {
+		return false;
+	}
+
+	const char *p = file.data;
+	const char *end = file.data + file.size;
+
+	obj_counts_t counts;
+	obj_count(p, end, &counts);
+
+	float *positions = malloc(((size_t) counts.positions * 6 + 1) * sizeof(float));
+	float *texcoords = malloc(((size_t) counts.texcoords * 2 + 1) * sizeof(float));
+
+	uint32_t position_count = 0;
+	uint32_t texcoord_count = 0;
+
+	vertex_table_t table;
+	table_init(&table, counts.positions);
+
+	reserve(&mesh->vertices, counts.corners);
+	reserve(&mesh->indices, (size_t) counts.triangles * 3);
+
+	uint32_t first_vertex = (uint32_t) array_size(&mesh->vertices);
+	bool ok = true;
+
+	size_t name_len;
+	const char *name = base_name(path, &name_len);
+	begin_submesh(mesh, name, name_len);
+
+	while (p < end && ok) {
+		p = skip_space(p, end);
+
+		if (end - p < 2) {
+			break;
+		}
+
+		if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+			p++;
+
+			float *v = &positions[position_count * 6];
+
+			v[0] = parse_float(&p, end);
+			v[1] = parse_float(&p, end);
+			v[2] = parse_float(&p, end);
+
+			p = skip_space(p, end);
+
+			if (!at_line_end(p, end)) {
+				v[3] = parse_float(&p, end);
+				v[4] = parse_float(&p, end);
+				v[5] = parse_float(&p, end);
+			}
+			else {
+				v[3] = v[4] = v[5] = 1.0f;
+			}
+
+			position_count++;
+		}
+		else if (p[0] == 'v' && p[1] == 't') {
+			p += 2;
+
+			texcoords[texcoord_count * 2 + 0] = parse_float(&p, end);
+			texcoords[texcoord_count * 2 + 1] = parse_float(&p, end);
+
+			texcoord_count++;
+		}
+		else if ((p[0] == 'o' || p[0] == 'g') && (p[1] == ' ' || p[1] == '\t')) {
+			const char *start = skip_space(p + 1, end);
+			const char *stop = start;
+
+			while (!at_line_end(stop, end)) {
+				stop++;
+			}
+
+			while (stop > start && (stop[-1] == ' ' || stop[-1] == '\t')) {
+				stop--;
+			}
+
+			end_submesh(mesh);
+			begin_submesh(mesh, start, (size_t) (stop - start));
+			table_next_gen(&table);
+		}
+		else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+			p++;
+
+			submesh_t *submesh = &((submesh_t *) array_data(&mesh->submeshes))[array_size(&mesh->submeshes) - 1];
+
+			uint32_t corner = 0;
+			uint32_t first = 0;
+			uint32_t prev = 0;
+
+			for (;;) {
+				p = skip_space(p, end);
+
+				if (at_line_end(p, end)) {
+					break;
+				}
+
+				int64_t v = 0;
+				int64_t vt = 0;
+				int64_t vn = 0;
+
+				if (!parse_int(&p, end, &v)) {
+					ok = false;
+					break;
+				}
+
+				if (p < end && *p == '/') {
+					p++;
+
+					if (p < end && *p != '/') {
+						parse_int(&p, end, &vt);
+					}
+
+					if (p < end && *p == '/') {
+						p++;
+						parse_int(&p, end, &vn);
+					}
+				}
+
+				v = v < 0 ? position_count + v + 1 : v;
+				vt = vt < 0 ? texcoord_count + vt + 1 : vt;
+
+				if (v < 1 || v > position_count || vt < 0 || vt > texcoord_count) {
+					ok = false;
+					break;
+				}
+
+				uint64_t key = ((uint64_t) v << 32) | (uint64_t) vt;
+				uint32_t *index;
+
+				if (!table_find(&table, key, &index)) {
+					const float *pos = &positions[(v - 1) * 6];
+
+					vertex_t vertex = {};
+					memcpy(vertex.pos, pos, sizeof(vec3));
+					memcpy(vertex.color, pos + 3, sizeof(vec3));
+
+					if (vt > 0) {
+						vertex.tex_coord[0] = texcoords[(vt - 1) * 2 + 0];
+						vertex.tex_coord[1] = 1.0f - texcoords[(vt - 1) * 2 + 1];
+					}
+
+					*index = (uint32_t) array_size(&mesh->vertices) - (uint32_t) submesh->vertex_offset;
+					array_append(&mesh->vertices, &vertex);
+				}
+
+				if (corner == 0) {
+					first = *index;
+				}
+				else if (corner >= 2) {
+					array_append(&mesh->indices, &first);
+					array_append(&mesh->indices, &prev);
+					array_append(&mesh->indices, index);
+				}
+
+				prev = *index;
+				corner++;
+			}
+		}
+
+		p = next_line(p, end);
+	}
+
+	end_submesh(mesh);
+
+	if (!ok) {
+		fprintf(stderr, "WARN: malformed face in `%s` at byte %zu\n", path, (size_t) (p - file.data));
+	}
+
+	uint32_t vertex_count = (uint32_t) array_size(&mesh->vertices) - first_vertex;
+	vertex_t *vertices = &((vertex_t *) array_data(&mesh->vertices))[first_vertex];
+
+	for (uint32_t i = 0; i < vertex_count; i++) {
+		grow_bounds(mesh, vertices[i].pos);
+	}
+
+	mesh->y_up = true;
+
+	free(table.slots);
+	free(positions);
+	free(texcoords);
+	unmap_file(&file);
+
+	return ok;
+}
+
+/**
+ *	Write the mesh back as OBJ, one `o` per submesh, keeping vertex and
+ *	triangle order so that an optimized mesh loads optimized.
+ */
+bool mesh_write_obj(mesh_t *mesh, const char *path)
+{
+	FILE *file = fopen(path, "w");
+	if (!file) {
+		fprintf(stderr, "WARN: failed to open `%s` for writing\n", path);
+		return false;
+	}
+
+	const vertex_t *vertices = (const vertex_t *) array_data(&mesh->vertices);
+	const uint32_t *indices = (const uint32_t *) array_data(&mesh->indices);
+	const submesh_t *submeshes = (const submesh_t *) array_data(&mesh->submeshes);
+
+	for (int i = 0; i < array_size(&mesh->vertices); i++) {
+		const vertex_t *v = &vertices[i];
+
+		if (v->color[0] == 1.0f && v->color[1] == 1.0f && v->color[2] == 1.0f) {
+			fprintf(file, "v %.9g %.9g %.9g\n", v->pos[0], v->pos[1], v->pos[2]);
+		}
+		else {
+			fprintf(file, "v %.9g %.9g %.9g %.6g %.6g %.6g\n", v->pos[0], v->pos[1], v->pos[2], v->color[0], v->color[1], v->color[2]);
+		}
+	}
+
+	for (int i = 0; i < array_size(&mesh->vertices); i++) {
+		fprintf(file, "vt %.9g %.9g\n", vertices[i].tex_coord[0], 1.0f - vertices[i].tex_coord[1]);
+	}
+
+	for (int s = 0; s < array_size(&mesh->submeshes); s++) {
+		fprintf(file, "o %s\n", submeshes[s].name);
+
+		for (uint32_t i = 0; i < submeshes[s].index_count; i += 3) {
+			const uint32_t *tri = &indices[submeshes[s].first_index + i];
+			uint32_t base = (uint32_t) submeshes[s].vertex_offset + 1;
+
+			fprintf(file, "f %u/%u %u/%u %u/%u\n", tri[0] + base, tri[0] + base, tri[1] + base, tri[1] + base, tri[2] + base, tri[2] + base);
+		}
+	}
+
+	bool ok = !ferror(file);
+	fclose(file);
+
+	return ok;
+}
+
+/**
+ *	// END // OBJ
+ */
+
+/**
+ *	// BEGIN // glTF
+ */
+
+typedef struct _glb_accessor_t
+{
+	const uint8_t *data;
+
+	uint32_t count;
+	uint32_t stride;
+
+	uint32_t component_type;
+	uint32_t components;
+	bool normalized;
+}
+glb_accessor_t;
+
+typedef struct _gltf_doc_t
+{
+	const char *js;
+	json_token *tokens;
+	int count;
+
+	const uint8_t *bin;
+	size_t bin_size;
+}
+gltf_doc_t;
+
+static uint32_t component_size(uint32_t type)
+{
+	switch (type) {
+		case GLTF_BYTE:
+		case GLTF_UNSIGNED_BYTE:
+			return 1;
+		case GLTF_SHORT:
+		case GLTF_UNSIGNED_SHORT:
+			return 2;
+		case GLTF_UNSIGNED_INT:
+		case GLTF_FLOAT:
+			return 4;
+	}
+
+	return 0;
+}
+
+static uint32_t component_count(const char *js, const json_token *token)
+{
+	if (json_eq(js, token, "SCALAR")) return 1;
+	if (json_eq(js, token, "VEC2")) return 2;
+	if (json_eq(js, token, "VEC3")) return 3;
+	if (json_eq(js, token, "VEC4")) return 4;
+
+	return 0;
+}
+
+/**
+ *	Resolve accessor `index` to a strided view into the binary chunk.
+ *	Accessors without a buffer view, sparse ones and external buffers are not
+ *	supported.
+ */
+static bool glb_accessor(const gltf_doc_t *doc, int index, glb_accessor_t *acc)
+{
+	int accessors = json_object_get(doc->js, doc->tokens, doc->count, 0, "accessors");
+	int accessor = json_array_get(doc->tokens, doc->count, accessors, index);
+
+	int type = json_object_get(doc->js, doc->tokens, doc->count, accessor, "type");
+	int view_index = (int) json_number(doc->js, doc->tokens, json_object_get(doc->js, doc->tokens, doc->count, accessor, "bufferView"), -1);
+
+	if (accessor < 0 || type < 0 || view_index < 0 || json_object_get(doc->js, doc->tokens, doc->count, accessor, "sparse") >= 0) {
+		return false;
+	}
+
+	int views = json_object_get(doc->js, doc->tokens, doc->count, 0, "bufferViews");
+	int view = json_array_get(doc->tokens, doc->count, views, view_index);
+
+	if (view < 0 || json_number(doc->js, doc->tokens, json_object_get(doc->js, doc->tokens, doc->count, view, "buffer"), 0) != 0) {
+		return false;
+	}
+
+	size_t view_offset = (size_t) json_number(doc->js, doc->tokens, json_object_get(doc->js, doc->tokens, doc->count, view, "byteOffset"), 0);
+	size_t view_length = (size_t) json_number(doc->js, doc->tokens, json_object_get(doc->js, doc->tokens, doc->count, view, "byteLength"), 0);
+	uint32_t view_stride = (uint32_t) json_number(doc->js, doc->tokens, json_object_get(doc->js, doc->tokens, doc->count, view, "byteStride"), 0);
+
+	size_t offset = (size_t) json_number(doc->js, doc->tokens, json_object_get(doc->js, doc->tokens, doc->count, accessor, "byteOffset"), 0);
+
+	acc->count = (uint32_t) json_number(doc->js, doc->tokens, json_object_get(doc->js, doc->tokens, doc->count, accessor, "count"), 0);
+	acc->component_type = (uint32_t) json_number(doc->js, doc->tokens, json_object_get(doc->js, doc->tokens, doc->count, accessor, "componentType"), 0);
+	acc->components = component_count(doc->js, &doc->tokens[type]);
+
+	int normalized = json_object_get(doc->js, doc->tokens, doc->count, accessor, "normalized");
+	acc->normalized = normalized >= 0 && doc->js[doc->tokens[normalized].start] == 't';
+
+	uint32_t element_size = component_size(acc->component_type) * acc->components;
+	acc->stride = view_stride ? view_stride : element_size;
+
+	if (element_size == 0 || acc->count == 0) {
+		return false;
+	}
+
+	size_t last = offset + (size_t) acc->stride * (acc->count - 1) + element_size;
+
+	if (last > view_length || view_offset + view_length > doc->bin_size) {
+		return false;
+	}
+
+	acc->data = doc->bin + view_offset + offset;
+
+	return true;
+}
+
+static float glb_read(const glb_accessor_t *acc, uint32_t element, uint32_t component)
+{
+	const uint8_t *p = acc->data + (size_t) element * acc->stride + component * component_size(acc->component_type);
+
+	switch (acc->component_type) {
+		case GLTF_FLOAT: {
+			float v;
+			memcpy(&v, p, sizeof(v));
+			return v;
+		}
+		case GLTF_UNSIGNED_BYTE:
+			return acc->normalized ? *p / 255.0f : *p;
+		case GLTF_BYTE: {
+			int8_t v = (int8_t) *p;
+			return acc->normalized ? fmaxf(v / 127.0f, -1.0f) : v;
+		}
+		case GLTF_UNSIGNED_SHORT: {
+			uint16_t v;
+			memcpy(&v, p, sizeof(v));
+			return acc->normalized ? v / 65535.0f : v;
+		}
+		case GLTF_SHORT: {
+			int16_t v;
+			memcpy(&v, p, sizeof(v));
+			return acc->normalized ? fmaxf(v / 32767.0f, -1.0f) : v;
+		}
+	}
+
+	return 0.0f;
+}
+
+static uint32_t glb_read_index(const glb_accessor_t *acc, uint32_t element)
+{
+	const uint8_t *p = acc->data + (size_t) element * acc->stride;
+
+	switch (acc->component_type) {
+		case GLTF_UNSIGNED_BYTE:
+			return *p;
+		case GLTF_UNSIGNED_SHORT: {
+			uint16_t v;
+			memcpy(&v, p, sizeof(v));
+			return v;
+		}
+		case GLTF_UNSIGNED_INT: {
+			uint32_t v;
+			memcpy(&v, p, sizeof(v));
+			return v;
+		}
+	}
+
+	return UINT32_MAX;
+}
+
+/**
+ *	Append one triangle list primitive as a submesh.
+ */
+static bool glb_add_primitive(mesh_t *mesh, const gltf_doc_t *doc, int primitive, const char *name, size_t name_len)
+{
+	int mode = (int) json_number(doc->js, doc->tokens, json_object_get(doc->js, doc->tokens, doc->count, primitive, "mode"), GLTF_MODE_TRIANGLES);
+
+	if (mode != GLTF_MODE_TRIANGLES) {
+		fprintf(stderr, "WARN: skipping `%.*s`, only triangle lists are supported\n", (int) name_len, name);
+		return true;
+	}
+
+	int attributes = json_object_get(doc->js, doc->tokens, doc->count, primitive, "attributes");
+
+	int position_index = (int) json_number(doc->js, doc->tokens, json_object_get(doc->js, doc->tokens, doc->count, attributes, "POSITION"), -1);
+	int texcoord_index = (int) json_number(doc->js, doc->tokens, json_object_get(doc->js, doc->tokens, doc->count, attributes, "TEXCOORD_0"), -1);
+	int color_index = (int) json_number(doc->js, doc->tokens, json_object_get(doc->js, doc->tokens, doc->count, attributes, "COLOR_0"), -1);
+	int indices_index = (int) json_number(doc->js, doc->tokens, json_object_get(doc->js, doc->tokens, doc->count, primitive, "indices"), -1);
+
+	glb_accessor_t positions;
+	glb_accessor_t texcoords = {};
+	glb_accessor_t colors = {};
+	glb_accessor_t indices = {};
+
+	if (!glb_accessor(doc, position_index, &positions) || positions.components != 3) {
+		return false;
+	}
+
+	if (texcoord_index >= 0 && (!glb_accessor(doc, texcoord_index, &texcoords) || texcoords.count != positions.count)) {
+		return false;
+	}
+
+	if (color_index >= 0 && (!glb_accessor(doc, color_index, &colors) || colors.count != positions.count || colors.components < 3)) {
+		return false;
+	}
+
+	if (indices_index >= 0 && !glb_accessor(doc, indices_index, &indices)) {
+		return false;
+	}
+
+	uint32_t index_count = indices_index >= 0 ? indices.count : positions.count;
+
+	begin_submesh(mesh, name, name_len);
+
+	reserve(&mesh->vertices, positions.count);
+	reserve(&mesh->indices, index_count);
+
+	for (uint32_t i = 0; i < positions.count; i++) {
+		vertex_t vertex = {};
+
+		for (uint32_t c = 0; c < 3; c++) {
+			vertex.pos[c] = glb_read(&positions, i, c);
+			vertex.color[c] = color_index >= 0 ? glb_read(&colors, i, c) : 1.0f;
+		}
+
+		if (texcoord_index >= 0) {
+			vertex.tex_coord[0] = glb_read(&texcoords, i, 0);
+			vertex.tex_coord[1] = glb_read(&texcoords, i, 1);
+		}
+
+		grow_bounds(mesh, vertex.pos);
+		array_append(&mesh->vertices, &vertex);
+	}
+
+	for (uint32_t i = 0; i < index_count; i++) {
+		uint32_t index = indices_index >= 0 ? glb_read_index(&indices, i) : i;
+
+		if (index >= positions.count) {
+			end_submesh(mesh);
+			return false;
+		}
+
+		array_append(&mesh->indices, &index);
+	}
+
+	end_submesh(mesh);
+
+	return true;
+}
+
+/**
+ *	Load every mesh primitive of a binary glTF 2.0 file, in the coordinates
+ *	they are stored in: node transforms are not applied. The vertex data is
+ *	read straight from the mapped binary chunk.
+ */
+bool mesh_load_glb(mesh_t *mesh, const char *path)
+{
+	PROFILE_ZONE("mesh_load_glb");
+
+	mapped_file_t file;
+	if (!map_file(path, &file)) {
+		return false;
+	}
+
+	const uint8_t *data = (const uint8_t *) file.data;
+	uint32_t header[5];
+
+	if (file.size < sizeof(header)) {
+		fprintf(stderr, "WARN: `%s` is not a binary glTF file\n", path);
+		unmap_file(&file);
+		return false;
+	}
+
+	memcpy(header, data, sizeof(header));
+
+	if (header[0] != GLB_MAGIC || header[1] != 2 || header[4] != GLB_CHUNK_JSON || 20 + (size_t) header[3] > file.size) {
+		fprintf(stderr, "WARN: `%s` is not a binary glTF 2.0 file\n", path);
+		unmap_file(&file);
+		return false;
+	}
+
+	gltf_doc_t doc = {};
+	doc.js = (const char *) data + 20;
+
+	size_t json_len = header[3];
+	size_t bin_offset = 20 + json_len;
+
+	if (bin_offset + 8 <= file.size) {
+		uint32_t chunk[2];
+		memcpy(chunk, data + bin_offset, sizeof(chunk));
+
+		if (chunk[1] == GLB_CHUNK_BIN && bin_offset + 8 + chunk[0] <= file.size) {
+			doc.bin = data + bin_offset + 8;
+			doc.bin_size = chunk[0];
+		}
+	}
+
+	doc.count = json_parse(doc.js, json_len, NULL, 0);
+
+	if (doc.count <= 0) {
+		fprintf(stderr, "WARN: invalid JSON chunk in `%s`\n", path);
+		unmap_file(&file);
+		return false;
+	}
+
+	doc.tokens = malloc(sizeof(json_token) * doc.count);
+	json_parse(doc.js, json_len, doc.tokens, doc.count);
+
+	int meshes = json_object_get(doc.js, doc.tokens, doc.count, 0, "meshes");
+	int mesh_count = meshes >= 0 ? doc.tokens[meshes].size : 0;
+
+	bool ok = true;
+
+	for (int m = 0; m < mesh_count && ok; m++) {
+		int gltf_mesh = json_array_get(doc.tokens, doc.count, meshes, m);
+		int name_token = json_object_get(doc.js, doc.tokens, doc.count, gltf_mesh, "name");
+		int primitives = json_object_get(doc.js, doc.tokens, doc.count, gltf_mesh, "primitives");
+		int primitive_count = primitives >= 0 ? doc.tokens[primitives].size : 0;
+
+		for (int p = 0; p < primitive_count && ok; p++) {
+			char name[MESH_NAME_SIZE];
+
+			if (name_token >= 0) {
+				snprintf(name, sizeof(name), "%.*s.%d", doc.tokens[name_token].end - doc.tokens[name_token].start, doc.js + doc.tokens[name_token].start, p);
+			}
+			else {
+				snprintf(name, sizeof(name), "mesh%d.%d", m, p);
+			}
+
+			ok = glb_add_primitive(mesh, &doc, json_array_get(doc.tokens, doc.count, primitives, p), name, strlen(name));
+
+			if (!ok) {
+				fprintf(stderr, "WARN: unsupported or corrupt primitive `%s` in `%s`\n", name, path);
+			}
+		}
+	}
+
+	mesh->y_up = true;
+
+	free(doc.tokens);
+	unmap_file(&file);
+
+	return ok;
+}
+
+/**
+ *	// END // glTF
+ */
@@ -0,0 +1,90 @@
+#ifndef _MESH_H_
+#define _MESH_H_
+
+#include "application.h"
+
+#define MESH_NAME_SIZE 64
+#define MESH_MAX_LODS 8
+
+/**
+ *	One level of detail of a submesh, a range of the shared index buffer
+ *	over the submesh's vertices. `error` is the simplification error in
+ *	mesh units, 0 for the source geometry.
+ */
+typedef struct _mesh_lod_t
+{
+	uint32_t first_index;
+	uint32_t index_count;
+
+	float error;
+}
+mesh_lod_t;
+
+/**
+ *	A range of the shared index buffer. Indices are relative to
+ *	`vertex_offset`, which is passed as the draw's vertex offset, so each
+ *	submesh only needs 16 bit indices up to 65536 vertices.
+ *	`lods[0]` is the full range, coarser levels follow, see mesh_lod.h.
+ */
+typedef struct _submesh_t
+{
+	char name[MESH_NAME_SIZE];
+
+	uint32_t first_index;
+	uint32_t index_count;
+
+	int32_t vertex_offset;
+	uint32_t vertex_count;
+
+	uint32_t lod_count;
+	mesh_lod_t lods[MESH_MAX_LODS];
+}
+submesh_t;
+
+/**
+ *	Any number of meshes sharing one vertex and one index array, uploaded as
+ *	a single vertex and index buffer.
+ */
+typedef struct _mesh_t
+{
+	array vertices;
+	array indices;
+	array submeshes;
+
+	vec3 min;
+	vec3 max;
+
+	/**
+	 * Source uses +Y as up (glTF, most OBJ exporters), the renderer uses +Z.
+	 */
+
+	bool y_up;
+
+	/**
+	 * Levels shared by all submeshes, `lod_error` being the largest error of
+	 * the level over the submeshes. Submeshes with fewer levels stay on
+	 * their coarsest one.
+	 */
+
+	uint32_t lod_count;
+	float lod_error[MESH_MAX_LODS];
+}
+mesh_t;
+
+void init_mesh(mesh_t *mesh);
+
+void free_mesh(mesh_t *mesh);
+
+void mesh_add(mesh_t *mesh, const char *name, const vertex_t *vertices, uint32_t vertex_count, const uint32_t *indices, uint32_t index_count);
+
+bool mesh_load(mesh_t *mesh, const char *path);
+
+bool mesh_load_obj(mesh_t *mesh, const char *path);
+
+bool mesh_load_glb(mesh_t *mesh, const char *path);
+
+bool mesh_write_obj(mesh_t *mesh, const char *path);
+
+VkIndexType mesh_index_type(mesh_t *mesh);
+
+#endif
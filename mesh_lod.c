@@ -0,0 +1,601 @@
+#include "mesh_lod.h"
+#include "mesh_opt.h"
+#include "profiler.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOD_NO_VERTEX UINT32_MAX
+
+/**
+ *	Collapses whose triangles turn by more than this (cosine) are rejected.
+ */
+#define LOD_FLIP_COS 0.25f
+
+/**
+ *	Symmetric 4x4 error quadric of Garland & Heckbert, `w` being the
+ *	accumulated triangle area so the error averages instead of summing up.
+ */
+typedef struct _quadric_t
+{
+	float a00, a11, a22;
+	float a01, a02, a12;
+	float b0, b1, b2;
+	float c;
+	float w;
+}
+quadric_t;
+
+typedef struct _collapse_t
+{
+	float cost;
+
+	uint32_t from;
+	uint32_t to;
+}
+collapse_t;
+
+static void quadric_from_triangle(quadric_t *q, const float *p0, const float *p1, const float *p2)
+{
+	vec3 e1, e2, n;
+	glm_vec3_sub((float *) p1, (float *) p0, e1);
+	glm_vec3_sub((float *) p2, (float *) p0, e2);
+	glm_vec3_cross(e1, e2, n);
+
+	float area = glm_vec3_norm(n);
+
+	memset(q, 0, sizeof(quadric_t));
+
+	if (area <= 0.0f) {
+		return;
+	}
+
+	glm_vec3_scale(n, 1.0f / area, n);
+
+	float d = -glm_vec3_dot(n, (float *) p0);
+	float w = area * 0.5f;
+
+	q->a00 = w * n[0] * n[0];
+	q->a11 = w * n[1] * n[1];
+	q->a22 = w * n[2] * n[2];
+	q->a01 = w * n[0] * n[1];
+	q->a02 = w * n[0] * n[2];
+	q->a12 = w * n[1] * n[2];
+	q->b0 = w * n[0] * d;
+	q->b1 = w * n[1] * d;
+	q->b2 = w * n[2] * d;
+	q->c = w * d * d;
+	q->w = w;
+}
+
+static void quadric_add(quadric_t *dst, const quadric_t *src)
+{
+	dst->a00 += src->a00;
+	dst->a11 += src->a11;
+	dst->a22 += src->a22;
+	dst->a01 += src->a01;
+	dst->a02 += src->a02;
+	dst->a12 += src->a12;
+	dst->b0 += src->b0;
+	dst->b1 += src->b1;
+	dst->b2 += src->b2;
+	dst->c += src->c;
+	dst->w += src->w;
+}
+
+/**
+ *	Mean squared distance of `p` to the planes accumulated in `q`.
+ */
+static float quadric_error(const quadric_t *q, const float *p)
+{
+	float x = p[0], y = p[1], z = p[2];
+
+	float e = q->a00 * x * x + q->a11 * y * y + q->a22 * z * z
+		+ 2.0f * (q->a01 * x * y + q->a02 * x * z + q->a12 * y * z)
+		+ 2.0f * (q->b0 * x + q->b1 * y + q->b2 * z)
+		+ q->c;
+
+	return q->w > 0.0f ? fabsf(e) / q->w : 0.0f;
+}
+
+static uint32_t hash_u32(uint32_t h)
+{
+	h ^= h >> 16;
+	h *= 0x7feb352du;
+	h ^= h >> 15;
+	h *= 0x846ca68bu;
+	h ^= h >> 16;
+
+	return h;
+}
+
+static uint32_t hash_position(const float *p)
+{
+	uint32_t bits[3];
+	memcpy(bits, p, sizeof(bits));
+
+	return hash_u32(bits[0] ^ hash_u32(bits[1] ^ hash_u32(bits[2])));
+}
+
+static uint32_t table_size_for(uint32_t count)
+{
+	uint32_t size = 16;
+
+	while (size < count * 2) {
+		size *= 2;
+	}
+
+	return size;
+}
+
+/**
+ *	Map every vertex to the first vertex at the same position, so UV and
+ *	color seams do not look like open borders.
+ */
+static void build_position_remap(uint32_t *remap, const vertex_t *vertices, uint32_t vertex_count)
+{
+	uint32_t table_size = table_size_for(vertex_count);
+	uint32_t *table = malloc(sizeof(uint32_t) * table_size);
+	memset(table, 0xff, sizeof(uint32_t) * table_size);
+
+	for (uint32_t i = 0; i < vertex_count; i++) {
+		uint32_t slot = hash_position(vertices[i].pos) & (table_size - 1);
+
+		while (table[slot] != LOD_NO_VERTEX && memcmp(vertices[table[slot]].pos, vertices[i].pos, sizeof(vec3)) != 0) {
+			slot = (slot + 1) & (table_size - 1);
+		}
+
+		if (table[slot] == LOD_NO_VERTEX) {
+			table[slot] = i;
+		}
+
+		remap[i] = table[slot];
+	}
+
+	free(table);
+}
+
+/**
+ *	Lock vertices that must not move: vertices on open borders, where a
+ *	directed edge has no opposite edge, and seam vertices shared by several
+ *	vertex indices, whose attributes would otherwise tear.
+ */
+static void lock_vertices(bool *locked, const uint32_t *remap, const uint32_t *indices, uint32_t index_count, uint32_t vertex_count)
+{
+	for (uint32_t i = 0; i < vertex_count; i++) {
+		locked[i] = remap[i] != i;
+
+		if (remap[i] != i) {
+			locked[remap[i]] = true;
+		}
+	}
+
+	uint32_t table_size = table_size_for(index_count);
+	uint64_t *edges = malloc(sizeof(uint64_t) * table_size);
+	memset(edges, 0xff, sizeof(uint64_t) * table_size);
+
+	for (uint32_t i = 0; i < index_count; i++) {
+		uint32_t a = remap[indices[i]];
+		uint32_t b = remap[indices[i % 3 == 2 ? i - 2 : i + 1]];
+		uint64_t key = ((uint64_t) a << 32) | b;
+
+		uint32_t slot = hash_u32(a ^ hash_u32(b)) & (table_size - 1);
+
+		while (edges[slot] != UINT64_MAX && edges[slot] != key) {
+			slot = (slot + 1) & (table_size - 1);
+		}
+
+		edges[slot] = key;
+	}
+
+	for (uint32_t i = 0; i < index_count; i++) {
+		uint32_t a = remap[indices[i]];
+		uint32_t b = remap[indices[i % 3 == 2 ? i - 2 : i + 1]];
+		uint64_t key = ((uint64_t) b << 32) | a;
+
+		uint32_t slot = hash_u32(b ^ hash_u32(a)) & (table_size - 1);
+
+		while (edges[slot] != UINT64_MAX && edges[slot] != key) {
+			slot = (slot + 1) & (table_size - 1);
+		}
+
+		if (edges[slot] == UINT64_MAX) {
+			locked[indices[i]] = true;
+			locked[indices[i % 3 == 2 ? i - 2 : i + 1]] = true;
+		}
+	}
+
+	for (uint32_t i = 0; i < vertex_count; i++) {
+		locked[i] = locked[i] || locked[remap[i]];
+	}
+
+	free(edges);
+}
+
+static int compare_collapse(const void *a, const void *b)
+{
+	float ca = ((const collapse_t *) a)->cost;
+	float cb = ((const collapse_t *) b)->cost;
+
+	return (ca > cb) - (ca < cb);
+}
+
+/**
+ *	Triangles around `from` must keep their orientation with `from` moved
+ *	onto `to`. Triangles containing both vanish and are skipped.
+ */
+static bool collapse_flips(const float (*positions)[3], const uint32_t *indices, const uint32_t *adjacency,
+	uint32_t adjacency_count, uint32_t from, uint32_t to)
+{
+	for (uint32_t k = 0; k < adjacency_count; k++) {
+		const uint32_t *tri = &indices[adjacency[k] * 3];
+
+		if (tri[0] == to || tri[1] == to || tri[2] == to) {
+			continue;
+		}
+
+		const float *p[3];
+		const float *q[3];
+
+		for (int c = 0; c < 3; c++) {
+			p[c] = positions[tri[c]];
+			q[c] = tri[c] == from ? positions[to] : positions[tri[c]];
+		}
+
+		vec3 e1, e2, before, after;
+
+		glm_vec3_sub((float *) p[1], (float *) p[0], e1);
+		glm_vec3_sub((float *) p[2], (float *) p[0], e2);
+		glm_vec3_cross(e1, e2, before);
+
+		glm_vec3_sub((float *) q[1], (float *) q[0], e1);
+		glm_vec3_sub((float *) q[2], (float *) q[0], e2);
+		glm_vec3_cross(e1, e2, after);
+
+		if (glm_vec3_dot(before, after) < LOD_FLIP_COS * glm_vec3_norm(before) * glm_vec3_norm(after)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ *	Simplify a triangle list by collapsing edges onto existing vertices, so
+ *	the result indexes the same vertex buffer. Collapses are ordered by
+ *	their quadric error and rejected when they would flip a triangle; every
+ *	pass collapses independent edges only, until `target_index_count` or
+ *	`target_error` (mesh units) is reached. Positions are normalized to the
+ *	unit box internally. Returns the index count written to `dst`, which
+ *	may alias `indices`, and the reached error in `result_error`.
+ */
+uint32_t mesh_simplify(uint32_t *dst, const uint32_t *indices, uint32_t index_count, const vertex_t *vertices, uint32_t vertex_count,
+	uint32_t target_index_count, float target_error, float *result_error)
+{
+	PROFILE_ZONE("mesh_simplify");
+
+	*result_error = 0.0f;
+
+	if (dst != indices) {
+		memcpy(dst, indices, sizeof(uint32_t) * index_count);
+	}
+
+	if (index_count <= target_index_count || vertex_count == 0) {
+		return index_count;
+	}
+
+	/**
+	 * Normalized positions, errors scale back by `extent`.
+	 */
+
+	vec3 min = {FLT_MAX, FLT_MAX, FLT_MAX};
+	vec3 max = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+
+	for (uint32_t i = 0; i < vertex_count; i++) {
+		glm_vec3_minv(min, (float *) vertices[i].pos, min);
+		glm_vec3_maxv(max, (float *) vertices[i].pos, max);
+	}
+
+	float extent = fmaxf(max[0] - min[0], fmaxf(max[1] - min[1], max[2] - min[2]));
+	extent = extent > 0.0f ? extent : 1.0f;
+
+	float (*positions)[3] = malloc(sizeof(float[3]) * vertex_count);
+
+	for (uint32_t i = 0; i < vertex_count; i++) {
+		for (int c = 0; c < 3; c++) {
+			positions[i][c] = (vertices[i].pos[c] - min[c]) / extent;
+		}
+	}
+
+	uint32_t *remap = malloc(sizeof(uint32_t) * vertex_count);
+	bool *locked = malloc(sizeof(bool) * vertex_count);
+
+	build_position_remap(remap, vertices, vertex_count);
+	lock_vertices(locked, remap, dst, index_count, vertex_count);
+
+	quadric_t *quadrics = calloc(vertex_count, sizeof(quadric_t));
+
+	for (uint32_t i = 0; i + 2 < index_count; i += 3) {
+		quadric_t q;
+		quadric_from_triangle(&q, positions[dst[i]], positions[dst[i + 1]], positions[dst[i + 2]]);
+
+		for (int c = 0; c < 3; c++) {
+			quadric_add(&quadrics[dst[i + c]], &q);
+		}
+	}
+
+	uint32_t *adjacency_offsets = malloc(sizeof(uint32_t) * (vertex_count + 1));
+	uint32_t *adjacency = malloc(sizeof(uint32_t) * index_count);
+	uint32_t *collapse_remap = malloc(sizeof(uint32_t) * vertex_count);
+	uint8_t *touched = malloc(vertex_count);
+	collapse_t *collapses = malloc(sizeof(collapse_t) * index_count);
+
+	float limit = target_error / extent;
+	float max_error = 0.0f;
+
+	while (index_count > target_index_count) {
+
+		/**
+		 * Triangles around every vertex, for the flip test.
+		 */
+
+		memset(adjacency_offsets, 0, sizeof(uint32_t) * (vertex_count + 1));
+
+		for (uint32_t i = 0; i < index_count; i++) {
+			adjacency_offsets[dst[i] + 1]++;
+		}
+
+		for (uint32_t i = 0; i < vertex_count; i++) {
+			adjacency_offsets[i + 1] += adjacency_offsets[i];
+		}
+
+		for (uint32_t i = 0; i < index_count; i++) {
+			adjacency[adjacency_offsets[dst[i]]++] = i / 3;
+		}
+
+		for (uint32_t i = vertex_count; i > 0; i--) {
+			adjacency_offsets[i] = adjacency_offsets[i - 1];
+		}
+
+		adjacency_offsets[0] = 0;
+
+		/**
+		 * Candidate collapses of unlocked vertices along triangle edges.
+		 */
+
+		uint32_t collapse_count = 0;
+
+		for (uint32_t i = 0; i < index_count; i++) {
+			uint32_t from = dst[i];
+			uint32_t to = dst[i % 3 == 2 ? i - 2 : i + 1];
+
+			if (locked[from] || from == to) {
+				continue;
+			}
+
+			quadric_t q = quadrics[from];
+			quadric_add(&q, &quadrics[to]);
+
+			collapses[collapse_count].cost = quadric_error(&q, positions[to]);
+			collapses[collapse_count].from = from;
+			collapses[collapse_count].to = to;
+			collapse_count++;
+		}
+
+		if (collapse_count == 0) {
+			break;
+		}
+
+		qsort(collapses, collapse_count, sizeof(collapse_t), compare_collapse);
+
+		for (uint32_t i = 0; i < vertex_count; i++) {
+			collapse_remap[i] = i;
+		}
+
+		memset(touched, 0, vertex_count);
+
+		/**
+		 * Every collapse removes about two triangles.
+		 */
+
+		uint32_t goal = (index_count - target_index_count) / 6 + 1;
+		uint32_t applied = 0;
+
+		for (uint32_t c = 0; c < collapse_count && applied < goal; c++) {
+			uint32_t from = collapses[c].from;
+			uint32_t to = collapses[c].to;
+
+			if (sqrtf(collapses[c].cost) > limit) {
+				break;
+			}
+
+			if (touched[from] || touched[to]) {
+				continue;
+			}
+
+			const uint32_t *ring = &adjacency[adjacency_offsets[from]];
+			uint32_t ring_count = adjacency_offsets[from + 1] - adjacency_offsets[from];
+
+			if (collapse_flips((const float (*)[3]) positions, dst, ring, ring_count, from, to)) {
+				continue;
+			}
+
+			/**
+			 * The ring of `from` changes, none of its vertices may collapse
+			 * again before the adjacency is rebuilt.
+			 */
+
+			for (uint32_t k = 0; k < ring_count; k++) {
+				for (int v = 0; v < 3; v++) {
+					touched[dst[ring[k] * 3 + v]] = 1;
+				}
+			}
+
+			collapse_remap[from] = to;
+			quadric_add(&quadrics[to], &quadrics[from]);
+
+			max_error = fmaxf(max_error, collapses[c].cost);
+			applied++;
+		}
+
+		if (applied == 0) {
+			break;
+		}
+
+		/**
+		 * Apply the pass, dropping triangles that degenerated.
+		 */
+
+		uint32_t write = 0;
+
+		for (uint32_t i = 0; i + 2 < index_count; i += 3) {
+			uint32_t a = collapse_remap[dst[i]];
+			uint32_t b = collapse_remap[dst[i + 1]];
+			uint32_t c = collapse_remap[dst[i + 2]];
+
+			if (remap[a] == remap[b] || remap[b] == remap[c] || remap[a] == remap[c]) {
+				continue;
+			}
+
+			dst[write++] = a;
+			dst[write++] = b;
+			dst[write++] = c;
+		}
+
+		index_count = write;
+	}
+
+	*result_error = sqrtf(max_error) * extent;
+
+	free(positions);
+	free(remap);
+	free(locked);
+	free(quadrics);
+	free(adjacency_offsets);
+	free(adjacency);
+	free(collapse_remap);
+	free(touched);
+	free(collapses);
+
+	return index_count;
+}
+
+/**
+ *	Append up to `MESH_MAX_LODS - 1` simplified levels per submesh to the
+ *	shared index buffer. Each level is simplified from the previous one and
+ *	adds its error on top, then gets its own vertex cache pass. Run after
+ *	`mesh_optimize()`, whose vertex reordering would break the levels.
+ */
+void mesh_generate_lods(mesh_t *mesh)
+{
+	PROFILE_ZONE("mesh_generate_lods");
+
+	uint32_t lod_triangles[MESH_MAX_LODS] = {};
+
+	mesh->lod_count = 1;
+	memset(mesh->lod_error, 0, sizeof(mesh->lod_error));
+
+	for (int s = 0; s < array_size(&mesh->submeshes); s++) {
+		submesh_t *submesh = &((submesh_t *) array_data(&mesh->submeshes))[s];
+		const vertex_t *vertices = &((const vertex_t *) array_data(&mesh->vertices))[submesh->vertex_offset];
+
+		uint32_t *lod_indices = malloc(sizeof(uint32_t) * (submesh->index_count > 0 ? submesh->index_count : 1));
+
+		lod_triangles[0] += submesh->index_count / 3;
+
+		while (submesh->lod_count < MESH_MAX_LODS) {
+			mesh_lod_t *prev = &submesh->lods[submesh->lod_count - 1];
+
+			uint32_t target = (uint32_t) (prev->index_count / 3 * MESH_LOD_REDUCTION) * 3;
+
+			if (target / 3 < MESH_LOD_MIN_TRIANGLES) {
+				break;
+			}
+
+			const uint32_t *prev_indices = &((const uint32_t *) array_data(&mesh->indices))[prev->first_index];
+
+			float error = 0.0f;
+			uint32_t count = mesh_simplify(lod_indices, prev_indices, prev->index_count, vertices, submesh->vertex_count, target, FLT_MAX, &error);
+
+			if (count == 0 || count > prev->index_count * (1.0f - MESH_LOD_MIN_GAIN)) {
+				break;
+			}
+
+			mesh_optimize_vertex_cache(lod_indices, count, submesh->vertex_count);
+
+			mesh_lod_t *lod = &submesh->lods[submesh->lod_count];
+			lod->first_index = (uint32_t) array_size(&mesh->indices);
+			lod->index_count = count;
+			lod->error = prev->error + error;
+
+			for (uint32_t i = 0; i < count; i++) {
+				array_append(&mesh->indices, &lod_indices[i]);
+			}
+
+			lod_triangles[submesh->lod_count] += count / 3;
+			submesh->lod_count++;
+		}
+
+		free(lod_indices);
+
+		mesh->lod_count = submesh->lod_count > mesh->lod_count ? submesh->lod_count : mesh->lod_count;
+	}
+
+	/**
+	 * Mesh wide errors, submeshes with fewer levels count with their coarsest.
+	 */
+
+	for (int s = 0; s < array_size(&mesh->submeshes); s++) {
+		const submesh_t *submesh = &((const submesh_t *) array_data(&mesh->submeshes))[s];
+
+		for (uint32_t l = 0; l < mesh->lod_count; l++) {
+			const mesh_lod_t *lod = &submesh->lods[l < submesh->lod_count ? l : submesh->lod_count - 1];
+
+			mesh->lod_error[l] = lod->error > mesh->lod_error[l] ? lod->error : mesh->lod_error[l];
+
+			if (l >= submesh->lod_count) {
+				lod_triangles[l] += lod->index_count / 3;
+			}
+		}
+	}
+
+	for (uint32_t l = 0; l < mesh->lod_count; l++) {
+		printf("LOD %u: %u triangles, error %g\n", l, lod_triangles[l], mesh->lod_error[l]);
+	}
+}
+
+/**
+ *	Projected size of `error` seen from `distance` to the center of a
+ *	bounding sphere of `radius`, in NDC units (2 per viewport height).
+ *	`proj_scale` is `ubo_t.proj[1][1]`, the error is taken at the nearest
+ *	point of the sphere.
+ */
+float mesh_lod_projected_error(float error, float distance, float radius, float proj_scale)
+{
+	float d = distance - radius;
+	d = d > 1e-4f ? d : 1e-4f;
+
+	return error * fabsf(proj_scale) / d;
+}
+
+/**
+ *	Coarsest level whose projected error stays within `threshold` (NDC
+ *	units, ie. pixels * 2 / viewport height). Errors grow with the level.
+ */
+uint32_t mesh_select_lod(const float *errors, uint32_t lod_count, float distance, float radius, float proj_scale, float threshold)
+{
+	uint32_t lod = 0;
+
+	for (uint32_t l = 1; l < lod_count; l++) {
+		if (mesh_lod_projected_error(errors[l], distance, radius, proj_scale) > threshold) {
+			break;
+		}
+
+		lod = l;
+	}
+
+	return lod;
+}
@@ -0,0 +1,33 @@
+#ifndef _MESH_LOD_H_
+#define _MESH_LOD_H_
+
+#include "mesh.h"
+
+/**
+ *	Every level targets this fraction of the previous level's triangles,
+ *	so the chain spans orders of magnitude within a few levels.
+ */
+#define MESH_LOD_REDUCTION 0.25f
+
+/**
+ *	The chain ends below this many triangles, or when a level removes less
+ *	than `MESH_LOD_MIN_GAIN` of the previous one (locked borders and seams).
+ */
+#define MESH_LOD_MIN_TRIANGLES 32
+#define MESH_LOD_MIN_GAIN 0.15f
+
+/**
+ *	Default screen-space error budget, in pixels.
+ */
+#define MESH_LOD_THRESHOLD_PIXELS 1.0f
+
+uint32_t mesh_simplify(uint32_t *dst, const uint32_t *indices, uint32_t index_count, const vertex_t *vertices, uint32_t vertex_count,
+	uint32_t target_index_count, float target_error, float *result_error);
+
+void mesh_generate_lods(mesh_t *mesh);
+
+float mesh_lod_projected_error(float error, float distance, float radius, float proj_scale);
+
+uint32_t mesh_select_lod(const float *errors, uint32_t lod_count, float distance, float radius, float proj_scale, float threshold);
+
+#endif
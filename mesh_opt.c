@@ -0,0 +1,579 @@
+#include "mesh_opt.h"
+#include "profiler.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ *	Scoring constants from Tom Forsyth's "Linear-Speed Vertex Cache
+ *	Optimisation".
+ */
+#define FORSYTH_CACHE_DECAY_POWER 1.5f
+#define FORSYTH_LAST_TRI_SCORE 0.75f
+#define FORSYTH_VALENCE_BOOST_SCALE 2.0f
+#define FORSYTH_VALENCE_BOOST_POWER 0.5f
+#define FORSYTH_MAX_VALENCE 64
+
+static float cache_score_table[MESH_OPT_CACHE_SIZE];
+static float valence_score_table[FORSYTH_MAX_VALENCE];
+static bool score_tables_ready = false;
+
+static void init_score_tables()
+{
+	for (int i = 0; i < MESH_OPT_CACHE_SIZE; i++) {
+		if (i < 3) {
+			cache_score_table[i] = FORSYTH_LAST_TRI_SCORE;
+		}
+		else {
+			cache_score_table[i] = powf(1.0f - (float) (i - 3) / (MESH_OPT_CACHE_SIZE - 3), FORSYTH_CACHE_DECAY_POWER);
+		}
+	}
+
+	for (int i = 1; i < FORSYTH_MAX_VALENCE; i++) {
+		valence_score_table[i] = FORSYTH_VALENCE_BOOST_SCALE * powf((float) i, -FORSYTH_VALENCE_BOOST_POWER);
+	}
+
+	score_tables_ready = true;
+}
+
+static float vertex_score(int cache_pos, uint32_t remaining)
+{
+	if (remaining == 0) {
+		return -1.0f;
+	}
+
+	float score = cache_pos >= 0 ? cache_score_table[cache_pos] : 0.0f;
+
+	if (remaining < FORSYTH_MAX_VALENCE) {
+		score += valence_score_table[remaining];
+	}
+	else {
+		score += FORSYTH_VALENCE_BOOST_SCALE * powf((float) remaining, -FORSYTH_VALENCE_BOOST_POWER);
+	}
+
+	return score;
+}
+
+/**
+ *	Reorder triangles for the post-transform vertex cache. Greedy: always
+ *	emit the triangle with the best score, which rewards vertices recently
+ *	used and vertices with few triangles left, so none get stranded.
+ */
+void mesh_optimize_vertex_cache(uint32_t *indices, uint32_t index_count, uint32_t vertex_count)
+{
+	uint32_t tri_count = index_count / 3;
+
+	if (tri_count == 0) {
+		return;
+	}
+
+	if (!score_tables_ready) {
+		init_score_tables();
+	}
+
+	/**
+	 * Triangles of each vertex, emitted ones are swapped past `remaining`.
+	 */
+
+	uint32_t *offsets = calloc(vertex_count + 1, sizeof(uint32_t));
+	uint32_t *remaining = calloc(vertex_count, sizeof(uint32_t));
+	uint32_t *adjacency = malloc(sizeof(uint32_t) * tri_count * 3);
+
+	for (uint32_t i = 0; i < tri_count * 3; i++) {
+		remaining[indices[i]]++;
+	}
+
+	for (uint32_t v = 0; v < vertex_count; v++) {
+		offsets[v + 1] = offsets[v] + remaining[v];
+		remaining[v] = 0;
+	}
+
+	for (uint32_t i = 0; i < tri_count * 3; i++) {
+		uint32_t v = indices[i];
+		adjacency[offsets[v] + remaining[v]++] = i / 3;
+	}
+
+	int *cache_pos = malloc(sizeof(int) * vertex_count);
+	float *vscore = malloc(sizeof(float) * vertex_count);
+	float *tscore = malloc(sizeof(float) * tri_count);
+	bool *emitted = calloc(tri_count, sizeof(bool));
+	uint32_t *out = malloc(sizeof(uint32_t) * tri_count * 3);
+
+	for (uint32_t v = 0; v < vertex_count; v++) {
+		cache_pos[v] = -1;
+		vscore[v] = vertex_score(-1, remaining[v]);
+	}
+
+	int64_t best = -1;
+	float best_score = -1.0f;
+
+	for (uint32_t t = 0; t < tri_count; t++) {
+		tscore[t] = vscore[indices[t * 3]] + vscore[indices[t * 3 + 1]] + vscore[indices[t * 3 + 2]];
+
+		if (tscore[t] > best_score) {
+			best_score = tscore[t];
+			best = t;
+		}
+	}
+
+	uint32_t cache[MESH_OPT_CACHE_SIZE + 3];
+	uint32_t cache_count = 0;
+
+	uint32_t emitted_count = 0;
+	uint32_t cursor = 0;
+
+	while (best >= 0) {
+		const uint32_t *tri = &indices[best * 3];
+
+		memcpy(&out[emitted_count * 3], tri, sizeof(uint32_t) * 3);
+		emitted[best] = true;
+		emitted_count++;
+
+		for (int k = 0; k < 3; k++) {
+			uint32_t v = tri[k];
+			uint32_t *list = &adjacency[offsets[v]];
+
+			for (uint32_t j = 0; j < remaining[v]; j++) {
+				if (list[j] == (uint32_t) best) {
+					list[j] = list[remaining[v] - 1];
+					remaining[v]--;
+					break;
+				}
+			}
+		}
+
+		/**
+		 * Move the triangle's vertices to the front of the LRU cache, the
+		 * entries pushed past its end are evicted.
+		 */
+
+		uint32_t new_cache[MESH_OPT_CACHE_SIZE + 3];
+		uint32_t new_count = 0;
+
+		for (int k = 0; k < 3; k++) {
+			new_cache[new_count++] = tri[k];
+		}
+
+		for (uint32_t i = 0; i < cache_count; i++) {
+			uint32_t v = cache[i];
+
+			if (v != tri[0] && v != tri[1] && v != tri[2]) {
+				new_cache[new_count++] = v;
+			}
+		}
+
+		for (uint32_t i = MESH_OPT_CACHE_SIZE; i < new_count; i++) {
+			cache_pos[new_cache[i]] = -1;
+			vscore[new_cache[i]] = vertex_score(-1, remaining[new_cache[i]]);
+		}
+
+		cache_count = new_count < MESH_OPT_CACHE_SIZE ? new_count : MESH_OPT_CACHE_SIZE;
+		memcpy(cache, new_cache, sizeof(uint32_t) * cache_count);
+
+		for (uint32_t i = 0; i < cache_count; i++) {
+			cache_pos[cache[i]] = (int) i;
+			vscore[cache[i]] = vertex_score((int) i, remaining[cache[i]]);
+		}
+
+		best = -1;
+		best_score = -1.0f;
+
+		for (uint32_t i = 0; i < cache_count; i++) {
+			uint32_t v = cache[i];
+			const uint32_t *list = &adjacency[offsets[v]];
+
+			for (uint32_t j = 0; j < remaining[v]; j++) {
+				uint32_t t = list[j];
+
+				tscore[t] = vscore[indices[t * 3]] + vscore[indices[t * 3 + 1]] + vscore[indices[t * 3 + 2]];
+
+				if (tscore[t] > best_score) {
+					best_score = tscore[t];
+					best = t;
+				}
+			}
+		}
+
+		/**
+		 * Nothing connected to the cache is left: continue with the next
+		 * triangle not emitted yet.
+		 */
+
+		if (best < 0 && emitted_count < tri_count) {
+			while (emitted[cursor]) {
+				cursor++;
+			}
+
+			best = cursor;
+		}
+	}
+
+	memcpy(indices, out, sizeof(uint32_t) * tri_count * 3);
+
+	free(offsets);
+	free(remaining);
+	free(adjacency);
+	free(cache_pos);
+	free(vscore);
+	free(tscore);
+	free(emitted);
+	free(out);
+}
+
+typedef struct _tri_cluster_t
+{
+	float sort_key;
+
+	uint32_t first;
+	uint32_t count;
+}
+tri_cluster_t;
+
+static int compare_cluster(const void *a, const void *b)
+{
+	float x = ((const tri_cluster_t *) a)->sort_key;
+	float y = ((const tri_cluster_t *) b)->sort_key;
+
+	return (x < y) - (x > y);
+}
+
+/**
+ *	Reorder the clusters of a cache optimized index list so that outward
+ *	facing geometry is drawn first and occludes what lies behind it (Sander
+ *	et al., "Fast Triangle Reordering for Vertex Locality and Reduced
+ *	Overdraw"). Clusters are cut where the FIFO cache starts cold anyway, ie.
+ *	at triangles missing all three vertices, so the cache efficiency is
+ *	barely affected.
+ */
+void mesh_optimize_overdraw(uint32_t *indices, uint32_t index_count, const vertex_t *vertices, uint32_t vertex_count)
+{
+	uint32_t tri_count = index_count / 3;
+
+	if (tri_count < 2) {
+		return;
+	}
+
+	uint32_t *stamp = calloc(vertex_count, sizeof(uint32_t));
+	uint32_t time = MESH_OPT_FIFO_SIZE + 1;
+
+	tri_cluster_t *clusters = malloc(sizeof(tri_cluster_t) * tri_count);
+	uint32_t cluster_count = 0;
+
+	for (uint32_t t = 0; t < tri_count; t++) {
+		uint32_t misses = 0;
+
+		for (int k = 0; k < 3; k++) {
+			uint32_t v = indices[t * 3 + k];
+
+			if (time - stamp[v] >= MESH_OPT_FIFO_SIZE) {
+				stamp[v] = time++;
+				misses++;
+			}
+		}
+
+		if (t == 0 || misses == 3) {
+			clusters[cluster_count].first = t;
+			clusters[cluster_count].count = 0;
+			cluster_count++;
+		}
+
+		clusters[cluster_count - 1].count++;
+	}
+
+	free(stamp);
+
+	if (cluster_count < 2) {
+		free(clusters);
+		return;
+	}
+
+	/**
+	 * Area weighted centroids: of the mesh, and of each cluster together with
+	 * its average normal.
+	 */
+
+	vec3 mesh_centroid = {0.0f, 0.0f, 0.0f};
+	float mesh_area = 0.0f;
+
+	for (uint32_t t = 0; t < tri_count; t++) {
+		const float *a = vertices[indices[t * 3]].pos;
+		const float *b = vertices[indices[t * 3 + 1]].pos;
+		const float *c = vertices[indices[t * 3 + 2]].pos;
+
+		vec3 ab = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+		vec3 ac = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+		vec3 n = {ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2], ab[0] * ac[1] - ab[1] * ac[0]};
+
+		float area = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+		for (int k = 0; k < 3; k++) {
+			mesh_centroid[k] += (a[k] + b[k] + c[k]) / 3.0f * area;
+		}
+
+		mesh_area += area;
+	}
+
+	for (int k = 0; k < 3; k++) {
+		mesh_centroid[k] = mesh_area > 0.0f ? mesh_centroid[k] / mesh_area : 0.0f;
+	}
+
+	for (uint32_t i = 0; i < cluster_count; i++) {
+		vec3 centroid = {0.0f, 0.0f, 0.0f};
+		vec3 normal = {0.0f, 0.0f, 0.0f};
+		float area_sum = 0.0f;
+
+		for (uint32_t t = clusters[i].first; t < clusters[i].first + clusters[i].count; t++) {
+			const float *a = vertices[indices[t * 3]].pos;
+			const float *b = vertices[indices[t * 3 + 1]].pos;
+			const float *c = vertices[indices[t * 3 + 2]].pos;
+
+			vec3 ab = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+			vec3 ac = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+			vec3 n = {ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2], ab[0] * ac[1] - ab[1] * ac[0]};
+
+			float area = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+			for (int k = 0; k < 3; k++) {
+				centroid[k] += (a[k] + b[k] + c[k]) / 3.0f * area;
+				normal[k] += n[k];
+			}
+
+			area_sum += area;
+		}
+
+		float normal_len = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+
+		clusters[i].sort_key = 0.0f;
+
+		if (area_sum > 0.0f && normal_len > 0.0f) {
+			for (int k = 0; k < 3; k++) {
+				clusters[i].sort_key += (centroid[k] / area_sum - mesh_centroid[k]) * normal[k] / normal_len;
+			}
+		}
+	}
+
+	qsort(clusters, cluster_count, sizeof(tri_cluster_t), compare_cluster);
+
+	uint32_t *out = malloc(sizeof(uint32_t) * tri_count * 3);
+	uint32_t written = 0;
+
+	for (uint32_t i = 0; i < cluster_count; i++) {
+		memcpy(&out[written], &indices[clusters[i].first * 3], sizeof(uint32_t) * clusters[i].count * 3);
+		written += clusters[i].count * 3;
+	}
+
+	memcpy(indices, out, sizeof(uint32_t) * tri_count * 3);
+
+	free(out);
+	free(clusters);
+}
+
+/**
+ *	Renumber vertices in order of first use so vertex fetch walks memory
+ *	forward. Unreferenced vertices are moved to the end.
+ */
+void mesh_optimize_vertex_fetch(uint32_t *indices, uint32_t index_count, vertex_t *vertices, uint32_t vertex_count)
+{
+	uint32_t *remap = malloc(sizeof(uint32_t) * vertex_count);
+	memset(remap, 0xff, sizeof(uint32_t) * vertex_count);
+
+	vertex_t *out = malloc(sizeof(vertex_t) * vertex_count);
+	uint32_t next = 0;
+
+	for (uint32_t i = 0; i < index_count; i++) {
+		uint32_t v = indices[i];
+
+		if (remap[v] == UINT32_MAX) {
+			remap[v] = next;
+			out[next++] = vertices[v];
+		}
+
+		indices[i] = remap[v];
+	}
+
+	for (uint32_t v = 0; v < vertex_count; v++) {
+		if (remap[v] == UINT32_MAX) {
+			out[next++] = vertices[v];
+		}
+	}
+
+	memcpy(vertices, out, sizeof(vertex_t) * vertex_count);
+
+	free(out);
+	free(remap);
+}
+
+/**
+ *	Average cache miss ratio, transformed vertices per triangle for a FIFO
+ *	cache of `cache_size` entries. 0.5 is the practical optimum for regular
+ *	grids, 3 means no reuse at all.
+ */
+float mesh_acmr(const uint32_t *indices, uint32_t index_count, uint32_t vertex_count, uint32_t cache_size)
+{
+	if (index_count < 3) {
+		return 0.0f;
+	}
+
+	uint32_t *stamp = calloc(vertex_count, sizeof(uint32_t));
+	uint32_t time = cache_size + 1;
+	uint32_t misses = 0;
+
+	for (uint32_t i = 0; i < index_count; i++) {
+		uint32_t v = indices[i];
+
+		if (time - stamp[v] >= cache_size) {
+			stamp[v] = time++;
+			misses++;
+		}
+	}
+
+	free(stamp);
+
+	return (float) misses / (float) (index_count / 3);
+}
+
+/**
+ *	Run the vertex cache, overdraw and vertex fetch passes over every submesh.
+ */
+void mesh_optimize(mesh_t *mesh)
+{
+	PROFILE_ZONE("mesh_optimize");
+
+	submesh_t *submeshes = (submesh_t *) array_data(&mesh->submeshes);
+	uint32_t *indices = (uint32_t *) array_data(&mesh->indices);
+	vertex_t *vertices = (vertex_t *) array_data(&mesh->vertices);
+
+	double misses_before = 0.0;
+	double misses_after = 0.0;
+	uint32_t triangles = 0;
+
+	for (int i = 0; i < array_size(&mesh->submeshes); i++) {
+		uint32_t *sub_indices = &indices[submeshes[i].first_index];
+		vertex_t *sub_vertices = &vertices[submeshes[i].vertex_offset];
+
+		uint32_t index_count = submeshes[i].index_count;
+		uint32_t vertex_count = submeshes[i].vertex_count;
+
+		misses_before += mesh_acmr(sub_indices, index_count, vertex_count, MESH_OPT_FIFO_SIZE) * (index_count / 3);
+
+		mesh_optimize_vertex_cache(sub_indices, index_count, vertex_count);
+		mesh_optimize_overdraw(sub_indices, index_count, sub_vertices, vertex_count);
+		mesh_optimize_vertex_fetch(sub_indices, index_count, sub_vertices, vertex_count);
+
+		misses_after += mesh_acmr(sub_indices, index_count, vertex_count, MESH_OPT_FIFO_SIZE) * (index_count / 3);
+		triangles += index_count / 3;
+	}
+
+	if (triangles > 0) {
+		printf("Mesh optimized: ACMR %.3f -> %.3f (FIFO %d)\n", misses_before / triangles, misses_after / triangles, MESH_OPT_FIFO_SIZE);
+	}
+}
+
+/**
+ *	// BEGIN // PACKED VERTICES
+ */
+
+static uint16_t float_to_half(float f)
+{
+	uint32_t x;
+	memcpy(&x, &f, sizeof(x));
+
+	uint16_t sign = (uint16_t) ((x >> 16) & 0x8000);
+	uint32_t abs = x & 0x7fffffff;
+
+	if (abs >= 0x7f800000) {
+		return sign | 0x7c00 | (abs > 0x7f800000 ? 0x200 : 0);
+	}
+
+	if (abs >= 0x477ff000) {
+		return sign | 0x7c00;
+	}
+
+	if (abs < 0x38800000) {
+		float v;
+		memcpy(&v, &abs, sizeof(v));
+
+		return sign | (uint16_t) lrintf(v * 16777216.0f);
+	}
+
+	return sign | (uint16_t) ((abs + 0x0fff + ((abs >> 13) & 1) - 0x38000000) >> 13);
+}
+
+/**
+ *	Packed vertices need every texture coordinate within
+ *	`MESH_PACK_MAX_UV`, positions are always representable.
+ */
+bool mesh_can_pack(mesh_t *mesh)
+{
+	const vertex_t *vertices = (const vertex_t *) array_data(&mesh->vertices);
+
+	if (array_size(&mesh->vertices) == 0) {
+		return false;
+	}
+
+	for (int i = 0; i < array_size(&mesh->vertices); i++) {
+		if (fabsf(vertices[i].tex_coord[0]) > MESH_PACK_MAX_UV || fabsf(vertices[i].tex_coord[1]) > MESH_PACK_MAX_UV) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void quantization_box(mesh_t *mesh, vec3 center, vec3 half)
+{
+	for (int k = 0; k < 3; k++) {
+		center[k] = (mesh->min[k] + mesh->max[k]) * 0.5f;
+		half[k] = (mesh->max[k] - mesh->min[k]) * 0.5f;
+		half[k] = half[k] > 1e-20f ? half[k] : 1.0f;
+	}
+}
+
+void mesh_pack_vertices(mesh_t *mesh, packed_vertex_t *dst)
+{
+	const vertex_t *vertices = (const vertex_t *) array_data(&mesh->vertices);
+
+	vec3 center;
+	vec3 half;
+	quantization_box(mesh, center, half);
+
+	for (int i = 0; i < array_size(&mesh->vertices); i++) {
+		const vertex_t *v = &vertices[i];
+
+		for (int k = 0; k < 3; k++) {
+			float q = (v->pos[k] - center[k]) / half[k];
+			q = q < -1.0f ? -1.0f : (q > 1.0f ? 1.0f : q);
+
+			dst[i].pos[k] = (int16_t) lrintf(q * 32767.0f);
+
+			float c = v->color[k] < 0.0f ? 0.0f : (v->color[k] > 1.0f ? 1.0f : v->color[k]);
+			dst[i].color[k] = (uint8_t) lrintf(c * 255.0f);
+		}
+
+		dst[i].pos[3] = 32767;
+		dst[i].color[3] = 255;
+
+		dst[i].tex_coord[0] = float_to_half(v->tex_coord[0]);
+		dst[i].tex_coord[1] = float_to_half(v->tex_coord[1]);
+	}
+}
+
+/**
+ *	Matrix taking packed snorm16 positions back to mesh space, to be
+ *	multiplied into the model matrix.
+ */
+void mesh_dequantize_matrix(mesh_t *mesh, mat4 dest)
+{
+	vec3 center;
+	vec3 half;
+	quantization_box(mesh, center, half);
+
+	glm_translate_make(dest, center);
+	glm_scale(dest, half);
+}
+
+/**
+ *	// END // PACKED VERTICES
+ */
@@ -0,0 +1,56 @@
+#ifndef _MESH_OPT_H_
+#define _MESH_OPT_H_
+
+#include "mesh.h"
+
+/**
+ *	Post-transform cache modelled by the optimizer and by `mesh_acmr()`.
+ *	Optimizing for a LRU of 32 also performs well on FIFO caches of 16 to 32
+ *	entries, which is what current hardware roughly behaves like.
+ */
+#define MESH_OPT_CACHE_SIZE 32
+#define MESH_OPT_FIFO_SIZE 16
+
+/**
+ *	Texture coordinates outside of this range lose too much precision as
+ *	half floats, the mesh stays in full vertices then.
+ */
+#define MESH_PACK_MAX_UV 4.0f
+
+typedef enum _vertex_format_t
+{
+	VERTEX_FORMAT_FULL = 0,
+	VERTEX_FORMAT_PACKED = 1
+}
+vertex_format_t;
+
+/**
+ *	16 byte vertex: snorm16 position relative to the mesh bounds, unorm8 color
+ *	and half float texture coordinates. Same shader inputs as `vertex_t`, the
+ *	position is dequantized by `mesh_dequantize_matrix()`.
+ */
+typedef struct _packed_vertex_t
+{
+	int16_t pos[4];
+	uint8_t color[4];
+	uint16_t tex_coord[2];
+}
+packed_vertex_t;
+
+void mesh_optimize_vertex_cache(uint32_t *indices, uint32_t index_count, uint32_t vertex_count);
+
+void mesh_optimize_overdraw(uint32_t *indices, uint32_t index_count, const vertex_t *vertices, uint32_t vertex_count);
+
+void mesh_optimize_vertex_fetch(uint32_t *indices, uint32_t index_count, vertex_t *vertices, uint32_t vertex_count);
+
+float mesh_acmr(const uint32_t *indices, uint32_t index_count, uint32_t vertex_count, uint32_t cache_size);
+
+void mesh_optimize(mesh_t *mesh);
+
+bool mesh_can_pack(mesh_t *mesh);
+
+void mesh_pack_vertices(mesh_t *mesh, packed_vertex_t *dst);
+
+void mesh_dequantize_matrix(mesh_t *mesh, mat4 dest);
+
+#endif
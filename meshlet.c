@@ -0,0 +1,489 @@
+#include "meshlet.h"
+#include "mesh_opt.h"
+#include "mesh_lod.h"
+#include "profiler.h"
+#include "shader_cache.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MESHLET_NO_VERTEX UINT32_MAX
+
+/**
+ *	`meshlet_cull.comp` view of a meshlet, std430. `triangle_offset` counts
+ *	packed triangles, one uint each, `lod_range` holds `lod_min` in the low
+ *	and `lod_max` in the high 16 bits.
+ */
+typedef struct _gpu_meshlet_t
+{
+	vec4 sphere;
+	vec4 cone;
+
+	uint32_t vertex_offset;
+	uint32_t triangle_offset;
+	uint32_t triangle_count;
+	uint32_t lod_range;
+}
+gpu_meshlet_t;
+
+/**
+ *	`quantize` maps mesh space, where the bounds live, to vertex buffer
+ *	space, so `instance * ubo.model * quantize` takes the bounds to world
+ *	space, `instance` being the first matrix of the instance buffer.
+ *	The level of detail is picked from `mesh_sphere` and `lod_error` the
+ *	way `mesh_select_lod()` does, `lod_threshold` in NDC units. 128 bytes,
+ *	the guaranteed push constant size.
+ */
+typedef struct _meshlet_cull_push_t
+{
+	mat4 quantize;
+	vec4 mesh_sphere;
+	float lod_error[MESH_MAX_LODS];
+
+	uint32_t meshlet_count;
+	uint32_t lod_count;
+	float lod_threshold;
+}
+meshlet_cull_push_t;
+
+static const compute_binding_t meshlet_cull_bindings[] = {
+	{0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER},
+	{1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER},
+	{2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER},
+	{3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER},
+	{4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER},
+	{5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER},
+	{6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER}
+};
+
+void init_meshlets(meshlets_t *meshlets)
+{
+	array_init(&meshlets->meshlets, sizeof(meshlet_t));
+	array_init(&meshlets->bounds, sizeof(meshlet_bounds_t));
+	array_init(&meshlets->vertices, sizeof(uint32_t));
+	array_init(&meshlets->triangles, sizeof(uint8_t));
+}
+
+void free_meshlets(meshlets_t *meshlets)
+{
+	array_free(&meshlets->meshlets);
+	array_free(&meshlets->bounds);
+	array_free(&meshlets->vertices);
+	array_free(&meshlets->triangles);
+}
+
+/**
+ *	Bounding sphere around the box of the meshlet's vertices and the cone
+ *	around its triangle normals. Degenerate triangles do not widen the cone,
+ *	a cone of 90 degrees or more can not face away and gets a cutoff of 1.
+ */
+void meshlet_compute_bounds(mesh_t *mesh, meshlets_t *meshlets, const meshlet_t *meshlet, meshlet_bounds_t *bounds)
+{
+	const vertex_t *vertices = (const vertex_t *) array_data(&mesh->vertices);
+	const uint32_t *meshlet_vertices = &((const uint32_t *) array_data(&meshlets->vertices))[meshlet->vertex_offset];
+	const uint8_t *triangles = &((const uint8_t *) array_data(&meshlets->triangles))[meshlet->triangle_offset];
+
+	vec3 min = {INFINITY, INFINITY, INFINITY};
+	vec3 max = {-INFINITY, -INFINITY, -INFINITY};
+
+	for (uint32_t i = 0; i < meshlet->vertex_count; i++) {
+		glm_vec3_minv(min, (float *) vertices[meshlet_vertices[i]].pos, min);
+		glm_vec3_maxv(max, (float *) vertices[meshlet_vertices[i]].pos, max);
+	}
+
+	glm_vec3_center(min, max, bounds->center);
+	bounds->radius = 0.0f;
+
+	for (uint32_t i = 0; i < meshlet->vertex_count; i++) {
+		float dist = glm_vec3_distance(bounds->center, (float *) vertices[meshlet_vertices[i]].pos);
+		bounds->radius = dist > bounds->radius ? dist : bounds->radius;
+	}
+
+	vec3 normals[MESHLET_MAX_TRIANGLES];
+	uint32_t normal_count = 0;
+
+	vec3 axis = {0.0f, 0.0f, 0.0f};
+
+	for (uint32_t i = 0; i < meshlet->triangle_count; i++) {
+		const float *a = vertices[meshlet_vertices[triangles[i * 3 + 0]]].pos;
+		const float *b = vertices[meshlet_vertices[triangles[i * 3 + 1]]].pos;
+		const float *c = vertices[meshlet_vertices[triangles[i * 3 + 2]]].pos;
+
+		vec3 ab, ac;
+		glm_vec3_sub((float *) b, (float *) a, ab);
+		glm_vec3_sub((float *) c, (float *) a, ac);
+		glm_vec3_cross(ab, ac, normals[normal_count]);
+
+		float area = glm_vec3_norm(normals[normal_count]);
+
+		if (area <= 0.0f) {
+			continue;
+		}
+
+		glm_vec3_scale(normals[normal_count], 1.0f / area, normals[normal_count]);
+		glm_vec3_add(axis, normals[normal_count], axis);
+
+		normal_count++;
+	}
+
+	float axis_length = glm_vec3_norm(axis);
+
+	if (normal_count == 0 || axis_length < 1e-6f) {
+		glm_vec3_zero(bounds->cone_axis);
+		bounds->cone_cutoff = 1.0f;
+
+		return;
+	}
+
+	glm_vec3_scale(axis, 1.0f / axis_length, bounds->cone_axis);
+
+	float min_dot = 1.0f;
+
+	for (uint32_t i = 0; i < normal_count; i++) {
+		float d = glm_vec3_dot(bounds->cone_axis, normals[i]);
+		min_dot = d < min_dot ? d : min_dot;
+	}
+
+	/**
+	 * All normals lie within acos(min_dot) of the axis, the cluster faces
+	 * away once the view direction is within 90 degrees minus that, ie. its
+	 * cosine exceeds sin(acos(min_dot)).
+	 */
+
+	bounds->cone_cutoff = min_dot <= 0.0f ? 1.0f : sqrtf(1.0f - min_dot * min_dot);
+}
+
+static void meshlet_flush(mesh_t *mesh, meshlets_t *meshlets, meshlet_t *meshlet, uint32_t *local, int32_t vertex_offset)
+{
+	if (meshlet->triangle_count == 0) {
+		return;
+	}
+
+	meshlet_bounds_t bounds;
+	meshlet_compute_bounds(mesh, meshlets, meshlet, &bounds);
+
+	array_append(&meshlets->meshlets, meshlet);
+	array_append(&meshlets->bounds, &bounds);
+
+	const uint32_t *meshlet_vertices = &((const uint32_t *) array_data(&meshlets->vertices))[meshlet->vertex_offset];
+
+	for (uint32_t i = 0; i < meshlet->vertex_count; i++) {
+		local[meshlet_vertices[i] - vertex_offset] = MESHLET_NO_VERTEX;
+	}
+
+	meshlet->vertex_offset += meshlet->vertex_count;
+	meshlet->triangle_offset += meshlet->triangle_count * 3;
+	meshlet->vertex_count = 0;
+	meshlet->triangle_count = 0;
+}
+
+/**
+ *	Split every level of every submesh into meshlets of at most
+ *	`MESHLET_MAX_VERTICES` vertices and `MESHLET_MAX_TRIANGLES` triangles.
+ *	Triangles are taken in index order, which after `mesh_optimize()` is
+ *	vertex cache order and therefore already spatially coherent, a new
+ *	meshlet starts whenever the next triangle does not fit. Degenerate
+ *	triangles are dropped.
+ */
+void meshlet_build(mesh_t *mesh, meshlets_t *meshlets)
+{
+	PROFILE_ZONE("meshlet_build");
+
+	const submesh_t *submeshes = (const submesh_t *) array_data(&mesh->submeshes);
+	const uint32_t *indices = (const uint32_t *) array_data(&mesh->indices);
+
+	uint32_t max_vertex_count = 0;
+
+	for (int s = 0; s < array_size(&mesh->submeshes); s++) {
+		max_vertex_count = submeshes[s].vertex_count > max_vertex_count ? submeshes[s].vertex_count : max_vertex_count;
+	}
+
+	/**
+	 * Worst case is one meshlet vertex per index, reserved up front.
+	 */
+
+	array_resize(&meshlets->vertices, array_size(&mesh->indices) > 0 ? array_size(&mesh->indices) : 1, false);
+	array_resize(&meshlets->triangles, array_size(&mesh->indices) > 0 ? array_size(&mesh->indices) : 1, false);
+
+	uint32_t *local = malloc(sizeof(uint32_t) * (max_vertex_count > 0 ? max_vertex_count : 1));
+	memset(local, 0xff, sizeof(uint32_t) * max_vertex_count);
+
+	meshlet_t meshlet = {};
+
+	for (int s = 0; s < array_size(&mesh->submeshes); s++) {
+		for (uint32_t l = 0; l < submeshes[s].lod_count; l++) {
+			const uint32_t *sub_indices = &indices[submeshes[s].lods[l].first_index];
+
+			meshlet.lod_min = l;
+			meshlet.lod_max = l + 1 == submeshes[s].lod_count ? MESH_MAX_LODS - 1 : l;
+
+			for (uint32_t i = 0; i + 2 < submeshes[s].lods[l].index_count; i += 3) {
+				uint32_t a = sub_indices[i + 0];
+				uint32_t b = sub_indices[i + 1];
+				uint32_t c = sub_indices[i + 2];
+
+				if (a == b || b == c || a == c) {
+					continue;
+				}
+
+				uint32_t new_vertices = (local[a] == MESHLET_NO_VERTEX) + (local[b] == MESHLET_NO_VERTEX) + (local[c] == MESHLET_NO_VERTEX);
+
+				if (meshlet.vertex_count + new_vertices > MESHLET_MAX_VERTICES || meshlet.triangle_count == MESHLET_MAX_TRIANGLES) {
+					meshlet_flush(mesh, meshlets, &meshlet, local, submeshes[s].vertex_offset);
+				}
+
+				uint32_t corners[3] = {a, b, c};
+
+				for (int k = 0; k < 3; k++) {
+					if (local[corners[k]] == MESHLET_NO_VERTEX) {
+						uint32_t vertex = (uint32_t) submeshes[s].vertex_offset + corners[k];
+
+						local[corners[k]] = meshlet.vertex_count++;
+						array_append(&meshlets->vertices, &vertex);
+					}
+
+					uint8_t local_index = (uint8_t) local[corners[k]];
+					array_append(&meshlets->triangles, &local_index);
+				}
+
+				meshlet.triangle_count++;
+			}
+
+			meshlet_flush(mesh, meshlets, &meshlet, local, submeshes[s].vertex_offset);
+		}
+	}
+
+	free(local);
+
+	if (array_size(&meshlets->meshlets) > 0) {
+		printf("Meshlets: %d clusters, %.1f vertices / %.1f triangles average\n", array_size(&meshlets->meshlets),
+			(float) array_size(&meshlets->vertices) / array_size(&meshlets->meshlets),
+			(float) array_size(&meshlets->triangles) / 3.0f / array_size(&meshlets->meshlets));
+	}
+}
+
+/**
+ *	// BEGIN // GPU CULLING
+ */
+
+/**
+ *	The cull dispatch is recorded into the graphics command buffers, so the
+ *	graphics queue family has to support compute as well.
+ */
+bool meshlet_cull_supported(struct _application *ref)
+{
+	uint32_t family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(PHYSDEV(0), &family_count, NULL);
+
+	VkQueueFamilyProperties families[family_count > 0 ? family_count : 1];
+	vkGetPhysicalDeviceQueueFamilyProperties(PHYSDEV(0), &family_count, families);
+
+	if (ref->graphics_queue_family_index >= family_count) {
+		return false;
+	}
+
+	return (families[ref->graphics_queue_family_index].queueFlags & VK_QUEUE_COMPUTE_BIT) != 0;
+}
+
+/**
+ *	Build the meshlets of `ref->mesh` and upload them. Per image state
+ *	follows in `create_meshlet_cull_frames()`.
+ */
+void init_meshlet_cull(struct _application *ref, meshlet_cull_t *cull)
+{
+	PROFILE_ZONE("init_meshlet_cull");
+
+	init_meshlets(&cull->meshlets);
+	meshlet_build(ref->mesh, &cull->meshlets);
+
+	cull->meshlet_count = (uint32_t) array_size(&cull->meshlets.meshlets);
+	cull->triangle_count = (uint32_t) array_size(&cull->meshlets.triangles) / 3;
+
+	const meshlet_t *meshlets = (const meshlet_t *) array_data(&cull->meshlets.meshlets);
+	const meshlet_bounds_t *bounds = (const meshlet_bounds_t *) array_data(&cull->meshlets.bounds);
+	const uint8_t *triangles = (const uint8_t *) array_data(&cull->meshlets.triangles);
+
+	gpu_meshlet_t *gpu_meshlets = malloc(sizeof(gpu_meshlet_t) * (cull->meshlet_count > 0 ? cull->meshlet_count : 1));
+	uint32_t *packed = malloc(sizeof(uint32_t) * (cull->triangle_count > 0 ? cull->triangle_count : 1));
+
+	for (uint32_t i = 0; i < cull->meshlet_count; i++) {
+		glm_vec4(bounds[i].center, bounds[i].radius, gpu_meshlets[i].sphere);
+		glm_vec4(bounds[i].cone_axis, bounds[i].cone_cutoff, gpu_meshlets[i].cone);
+
+		gpu_meshlets[i].vertex_offset = meshlets[i].vertex_offset;
+		gpu_meshlets[i].triangle_offset = meshlets[i].triangle_offset / 3;
+		gpu_meshlets[i].triangle_count = meshlets[i].triangle_count;
+		gpu_meshlets[i].lod_range = meshlets[i].lod_min | (meshlets[i].lod_max << 16);
+	}
+
+	for (uint32_t i = 0; i < cull->triangle_count; i++) {
+		packed[i] = triangles[i * 3] | (triangles[i * 3 + 1] << 8) | (triangles[i * 3 + 2] << 16);
+	}
+
+	VkDeviceSize meshlet_size = sizeof(gpu_meshlet_t) * (cull->meshlet_count > 0 ? cull->meshlet_count : 1);
+	VkDeviceSize vertex_size = sizeof(uint32_t) * (array_size(&cull->meshlets.vertices) > 0 ? array_size(&cull->meshlets.vertices) : 1);
+	VkDeviceSize triangle_size = sizeof(uint32_t) * (cull->triangle_count > 0 ? cull->triangle_count : 1);
+
+	create_compute_buffer(ref, meshlet_size, 0, false, &cull->meshlet_buffer);
+	create_compute_buffer(ref, vertex_size, 0, false, &cull->vertex_buffer);
+	create_compute_buffer(ref, triangle_size, 0, false, &cull->triangle_buffer);
+
+	compute_upload(ref, &cull->meshlet_buffer, gpu_meshlets, meshlet_size);
+	compute_upload(ref, &cull->vertex_buffer, array_data(&cull->meshlets.vertices), sizeof(uint32_t) * array_size(&cull->meshlets.vertices));
+	compute_upload(ref, &cull->triangle_buffer, packed, sizeof(uint32_t) * cull->triangle_count);
+
+	free(gpu_meshlets);
+	free(packed);
+
+	array_init(&cull->index_buffers, sizeof(compute_buffer_t));
+	array_init(&cull->indirect_buffers, sizeof(compute_buffer_t));
+}
+
+void destroy_meshlet_cull(struct _application *ref, meshlet_cull_t *cull)
+{
+	destroy_compute_buffer(ref, &cull->meshlet_buffer);
+	destroy_compute_buffer(ref, &cull->vertex_buffer);
+	destroy_compute_buffer(ref, &cull->triangle_buffer);
+
+	array_free(&cull->index_buffers);
+	array_free(&cull->indirect_buffers);
+
+	free_meshlets(&cull->meshlets);
+}
+
+/**
+ *	Output index buffer, indirect command and descriptor set per swapchain
+ *	image, so a frame in flight never sees the next one's cull results.
+ *	Needs `ref->uniform_buffers` and `ref->instance_buffers`, call after
+ *	`create_uniform_buffers()`.
+ */
+void create_meshlet_cull_frames(struct _application *ref, meshlet_cull_t *cull)
+{
+	uint32_t image_count = (uint32_t) array_size(&ref->swapc_imgs);
+
+	create_compute_pipeline(ref, SHADER_PATH("meshlet_cull.comp", "meshlet_cull.spv"), meshlet_cull_bindings, sizeof(meshlet_cull_bindings) / sizeof(meshlet_cull_bindings[0]),
+		sizeof(meshlet_cull_push_t), image_count, NULL, &cull->pipeline);
+
+	array_resize(&cull->index_buffers, image_count, true);
+	array_resize(&cull->indirect_buffers, image_count, true);
+
+	compute_buffer_t *index_buffers = (compute_buffer_t *) array_data(&cull->index_buffers);
+	compute_buffer_t *indirect_buffers = (compute_buffer_t *) array_data(&cull->indirect_buffers);
+
+	VkDeviceSize index_size = sizeof(uint32_t) * 3 * (cull->triangle_count > 0 ? cull->triangle_count : 1);
+
+	for (uint32_t i = 0; i < image_count; i++) {
+		create_compute_buffer(ref, index_size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, false, &index_buffers[i]);
+		create_compute_buffer(ref, sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, false, &indirect_buffers[i]);
+
+		compute_bind_buffer(ref, &cull->pipeline, i, 0, ((VkBuffer *) array_data(&ref->uniform_buffers))[i], 0, sizeof(ubo_t));
+		compute_bind_buffer(ref, &cull->pipeline, i, 1, cull->meshlet_buffer.buffer, 0, VK_WHOLE_SIZE);
+		compute_bind_buffer(ref, &cull->pipeline, i, 2, cull->vertex_buffer.buffer, 0, VK_WHOLE_SIZE);
+		compute_bind_buffer(ref, &cull->pipeline, i, 3, cull->triangle_buffer.buffer, 0, VK_WHOLE_SIZE);
+		compute_bind_buffer(ref, &cull->pipeline, i, 4, index_buffers[i].buffer, 0, VK_WHOLE_SIZE);
+		compute_bind_buffer(ref, &cull->pipeline, i, 5, indirect_buffers[i].buffer, 0, VK_WHOLE_SIZE);
+		compute_bind_buffer(ref, &cull->pipeline, i, 6, ((VkBuffer *) array_data(&ref->instance_buffers))[i], 0, sizeof(mat4));
+	}
+}
+
+void destroy_meshlet_cull_frames(struct _application *ref, meshlet_cull_t *cull)
+{
+	for (int i = 0; i < array_size(&cull->index_buffers); i++) {
+		destroy_compute_buffer(ref, &((compute_buffer_t *) array_data(&cull->index_buffers))[i]);
+		destroy_compute_buffer(ref, &((compute_buffer_t *) array_data(&cull->indirect_buffers))[i]);
+	}
+
+	cull->index_buffers.size = 0;
+	cull->indirect_buffers.size = 0;
+
+	destroy_compute_pipeline(ref, &cull->pipeline);
+}
+
+/**
+ *	Record the cull of image `image`, outside of the render pass: reset the
+ *	indirect command and dispatch one workgroup per meshlet. The render
+ *	graph makes the results visible to the index fetch and the indirect
+ *	draw (see `create_render_graph()`).
+ */
+void meshlet_cmd_cull(struct _application *ref, meshlet_cull_t *cull, VkCommandBuffer cmd, uint32_t image)
+{
+	compute_buffer_t *indirect = &((compute_buffer_t *) array_data(&cull->indirect_buffers))[image];
+
+	VkDrawIndexedIndirectCommand reset = {};
+	reset.indexCount = 0;
+	reset.instanceCount = 1;
+	reset.firstIndex = 0;
+	reset.vertexOffset = 0;
+	reset.firstInstance = 0;
+
+	vkCmdUpdateBuffer(cmd, indirect->buffer, 0, sizeof(reset), &reset);
+
+	VkMemoryBarrier reset_barrier = {};
+	reset_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	reset_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	reset_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &reset_barrier, 0, NULL, 0, NULL);
+
+	meshlet_cull_push_t push = {};
+	push.meshlet_count = cull->meshlet_count;
+	push.lod_count = ref->mesh->lod_count;
+	push.lod_threshold = MESH_LOD_THRESHOLD_PIXELS * 2.0f / (float) ref->swapc_extent.height;
+
+	memcpy(push.lod_error, ref->mesh->lod_error, sizeof(push.lod_error));
+
+	vec3 extent;
+	glm_vec3_sub(ref->mesh->max, ref->mesh->min, extent);
+	glm_vec3_center(ref->mesh->min, ref->mesh->max, push.mesh_sphere);
+	push.mesh_sphere[3] = glm_vec3_norm(extent) * 0.5f;
+
+	if (ref->vertex_format == VERTEX_FORMAT_PACKED) {
+		mat4 dequantize;
+		mesh_dequantize_matrix(ref->mesh, dequantize);
+		glm_mat4_inv(dequantize, push.quantize);
+	}
+	else {
+		glm_mat4_identity(push.quantize);
+	}
+
+	VkDescriptorSet set = ((VkDescriptorSet *) array_data(&cull->pipeline.descriptor_sets))[image];
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, cull->pipeline.pipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, cull->pipeline.layout, 0, 1, &set, 0, NULL);
+	vkCmdPushConstants(cmd, cull->pipeline.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+
+	/**
+	 * Workgroup counts are only guaranteed up to 65535 per dimension, wrap
+	 * larger meshlet counts into Y.
+	 */
+
+	uint32_t groups_x = cull->meshlet_count < 65535 ? cull->meshlet_count : 65535;
+	uint32_t groups_y = groups_x > 0 ? (cull->meshlet_count + groups_x - 1) / groups_x : 0;
+
+	uint32_t timer_slot = gpu_timer_begin(ref->gpu_timer, cmd, image, gpu_timer_scope(ref->gpu_timer, "meshlet_cull"), false);
+
+	if (groups_x > 0) {
+		vkCmdDispatch(cmd, groups_x, groups_y, 1);
+	}
+
+	gpu_timer_end(ref->gpu_timer, cmd, image, timer_slot);
+}
+
+/**
+ *	Draw the surviving triangles, inside the render pass with the graphics
+ *	pipeline and vertex buffer bound. Indices are absolute.
+ */
+void meshlet_cmd_draw(struct _application *ref, meshlet_cull_t *cull, VkCommandBuffer cmd, uint32_t image)
+{
+	compute_buffer_t *indices = &((compute_buffer_t *) array_data(&cull->index_buffers))[image];
+	compute_buffer_t *indirect = &((compute_buffer_t *) array_data(&cull->indirect_buffers))[image];
+
+	vkCmdBindIndexBuffer(cmd, indices->buffer, 0, VK_INDEX_TYPE_UINT32);
+	vkCmdDrawIndexedIndirect(cmd, indirect->buffer, 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+}
+
+/**
+ *	// END // GPU CULLING
+ */
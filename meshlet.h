@@ -0,0 +1,119 @@
+#ifndef _MESHLET_H_
+#define _MESHLET_H_
+
+#include "mesh.h"
+#include "compute.h"
+
+/**
+ *	Cluster limits, 64 vertices / 124 triangles keeps a meshlet's local
+ *	indices in 8 bits and matches the sweet spot of mesh shader hardware,
+ *	should the culling move there later.
+ */
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+/**
+ *	Loaded models below this many triangles are drawn directly, culling
+ *	clusters costs more than it saves on them.
+ */
+#define MESHLET_MIN_TRIANGLES 16384
+
+/**
+ *	A cluster of one level of detail of a submesh. `vertex_offset` indexes
+ *	`meshlets_t.vertices`, which holds absolute vertex buffer indices,
+ *	`triangle_offset` indexes `meshlets_t.triangles`, three 8 bit local
+ *	vertex indices per triangle. The meshlet is drawn while the selected
+ *	mesh level is within `lod_min` and `lod_max`, the coarsest level of a
+ *	submesh covering all coarser mesh levels.
+ */
+typedef struct _meshlet_t
+{
+	uint32_t vertex_offset;
+	uint32_t triangle_offset;
+	uint32_t vertex_count;
+	uint32_t triangle_count;
+
+	uint32_t lod_min;
+	uint32_t lod_max;
+}
+meshlet_t;
+
+/**
+ *	Bounding sphere and normal cone of a meshlet, in mesh space. A cluster
+ *	faces away from `camera` when
+ *	`dot(center - camera, cone_axis) >= cone_cutoff * length(center - camera) + radius`,
+ *	a cutoff of 1 never culls.
+ */
+typedef struct _meshlet_bounds_t
+{
+	vec3 center;
+	float radius;
+
+	vec3 cone_axis;
+	float cone_cutoff;
+}
+meshlet_bounds_t;
+
+typedef struct _meshlets_t
+{
+	array meshlets;
+	array bounds;
+
+	array vertices;
+	array triangles;
+}
+meshlets_t;
+
+/**
+ *	Cluster culling on the graphics queue: `meshlet_cull.comp` selects the
+ *	level of detail from the projected error of the mesh, tests every
+ *	meshlet of that level against the frustum and its normal cone and
+ *	appends the triangles of the survivors to a per swapchain image index buffer, whose
+ *	length lands in a `VkDrawIndexedIndirectCommand`. Plain compute and
+ *	`vkCmdDrawIndexedIndirect`, no mesh shaders or draw count extension.
+ */
+typedef struct _meshlet_cull_t
+{
+	meshlets_t meshlets;
+
+	uint32_t meshlet_count;
+	uint32_t triangle_count;
+
+	compute_buffer_t meshlet_buffer;
+	compute_buffer_t vertex_buffer;
+	compute_buffer_t triangle_buffer;
+
+	/**
+	 * Per swapchain image, recreated with the swapchain.
+	 */
+
+	compute_pipeline_t pipeline;
+
+	array index_buffers;
+	array indirect_buffers;
+}
+meshlet_cull_t;
+
+void init_meshlets(meshlets_t *meshlets);
+
+void free_meshlets(meshlets_t *meshlets);
+
+void meshlet_build(mesh_t *mesh, meshlets_t *meshlets);
+
+void meshlet_compute_bounds(mesh_t *mesh, meshlets_t *meshlets, const meshlet_t *meshlet, meshlet_bounds_t *bounds);
+
+bool meshlet_cull_supported(struct _application *ref);
+
+void init_meshlet_cull(struct _application *ref, meshlet_cull_t *cull);
+
+void destroy_meshlet_cull(struct _application *ref, meshlet_cull_t *cull);
+
+void create_meshlet_cull_frames(struct _application *ref, meshlet_cull_t *cull);
+
+void destroy_meshlet_cull_frames(struct _application *ref, meshlet_cull_t *cull);
+
+void meshlet_cmd_cull(struct _application *ref, meshlet_cull_t *cull, VkCommandBuffer cmd, uint32_t image);
+
+void meshlet_cmd_draw(struct _application *ref, meshlet_cull_t *cull, VkCommandBuffer cmd, uint32_t image);
+
+#endif
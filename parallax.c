@@ -1,7 +1,29 @@
 #include "stdlib.h"
 #include "stdio.h"
+#include "string.h"
 
 #include "application.h"
+#include "compute.h"
+#include "gpu_prims.h"
+#include "prims.h"
+#include "profiler.h"
+#include "host_alloc.h"
+#include "mesh_opt.h"
+#include "lib/hashmap.h"
+
+static const char *trace_path = NULL;
+
+/**
+ *	Write the recorded zones on exit, whichever mode ran.
+ */
+static void export_trace()
+{
+	if (profiler_export_chrome(trace_path)) {
+		printf("trace written to %s\n", trace_path);
+	}
+
+	profiler_shutdown();
+}
 
 int main(int argc, char* argv[])
 {
@@ -9,7 +31,155 @@ int main(int argc, char* argv[])
 	 *	Test initialization. 
 	 */
 
-	application *app = malloc(sizeof(application));
+	application *app = calloc(1, sizeof(application));
+
+	/**
+	 *	Options, in any order after the mode:
+	 *
+	 *	`--trace out.json`             CPU / GPU zone trace.
+	 *	`--model path`                 Render an OBJ / binary glTF model instead
+	 *	                               of the built-in quads.
+	 *	`--full-vertices`              Keep 32 byte float vertices instead of
+	 *	                               packing them.
+	 *	`--no-meshlets`                Draw large models directly instead of
+	 *	                               culling their meshlets.
+	 *	`--depth-prepass`              Lay down depth in a position only
+	 *	                               pre-pass before shading.
+	 *	`--debug-view uv|color`        Replace shading with the texture
+	 *	                               coordinates or the vertex colors.
+	 *	`--instances N`                Draw a grid of N copies of the mesh.
+	 *	`--textures N`                 Texture the instances from N bindless
+	 *	                               textures.
+	 *	`--no-descriptor-indexing`     Force the texture array fallback.
+	 *	`--cmd-arena`                  Serve command scope Vulkan host
+	 *	                               allocations from a per thread arena.
+	 */
+
+	bool cmd_arena = false;
+
+	for (int i = 1; i < argc; i++) {
+		const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+		if (strcmp(argv[i], "--full-vertices") == 0) {
+			app->full_vertices = true;
+		}
+		else if (strcmp(argv[i], "--no-meshlets") == 0) {
+			app->no_meshlets = true;
+		}
+		else if (strcmp(argv[i], "--depth-prepass") == 0) {
+			app->depth_prepass = true;
+		}
+		else if (strcmp(argv[i], "--no-descriptor-indexing") == 0) {
+			app->no_descriptor_indexing = true;
+		}
+		else if (strcmp(argv[i], "--cmd-arena") == 0) {
+			cmd_arena = true;
+		}
+		else if (value == NULL) {
+			continue;
+		}
+		else if (strcmp(argv[i], "--trace") == 0) {
+			trace_path = value;
+			i++;
+		}
+		else if (strcmp(argv[i], "--model") == 0) {
+			app->model_path = value;
+			i++;
+		}
+		else if (strcmp(argv[i], "--debug-view") == 0) {
+			if (strcmp(value, "uv") == 0) {
+				app->debug_view = DEBUG_VIEW_TEX_COORDS;
+			}
+			else if (strcmp(value, "color") == 0) {
+				app->debug_view = DEBUG_VIEW_VERTEX_COLOR;
+			}
+
+			i++;
+		}
+		else if (strcmp(argv[i], "--instances") == 0) {
+			app->instance_count = (uint32_t) strtoul(value, NULL, 10);
+			i++;
+		}
+		else if (strcmp(argv[i], "--textures") == 0) {
+			app->texture_count = (uint32_t) strtoul(value, NULL, 10);
+			i++;
+		}
+	}
+
+	if (trace_path) {
+		profiler_init();
+		atexit(export_trace);
+	}
+
+	if (cmd_arena) {
+		init_host_alloc(true);
+	}
+
+	/**
+	 *	Offline mesh optimization: `--optimize-mesh in.(obj|glb) out.obj`.
+	 */
+
+	if (argc > 3 && strcmp(argv[1], "--optimize-mesh") == 0) {
+		mesh_t mesh;
+		init_mesh(&mesh);
+
+		if (!mesh_load(&mesh, argv[2])) {
+			fprintf(stderr, "ERR: failed to load `%s`\n", argv[2]);
+			return 1;
+		}
+
+		mesh_optimize(&mesh);
+
+		bool ok = mesh_write_obj(&mesh, argv[3]);
+		free_mesh(&mesh);
+
+		return ok ? 0 : 1;
+	}
+
+	/**
+	 *	Headless batch compute benchmarks, no window required.
+	 */
+
+	if (argc > 1 && strcmp(argv[1], "--bench-prims") == 0) {
+		bench_prims(app);
+
+		return 0;
+	}
+
+	if (argc > 1 && strcmp(argv[1], "--bench-gpu-prims") == 0) {
+		init_compute_headless(app);
+		bench_gpu_prims(app);
+		cleanup_compute_headless(app);
+
+		return 0;
+	}
+
+	if (argc > 1 && strcmp(argv[1], "--bench-hashmap") == 0) {
+		hashmap_bench();
+
+		return 0;
+	}
+
+	/**
+	 *	Headless offscreen rendering benchmark: `--headless WxH frames`.
+	 */
+
+	if (argc > 1 && strcmp(argv[1], "--headless") == 0) {
+		app->headless = true;
+		app->width = 1280;
+		app->height = 720;
+		app->headless_frames = 1000;
+
+		if (argc > 2 && argv[2][0] != '-' && (sscanf(argv[2], "%ux%u", &app->width, &app->height) != 2 || app->width == 0 || app->height == 0)) {
+			fprintf(stderr, "ERR: invalid size `%s`, expected WxH\n", argv[2]);
+			return 1;
+		}
+
+		if (argc > 3 && argv[2][0] != '-' && argv[3][0] != '-') {
+			app->headless_frames = (uint32_t) strtoul(argv[3], NULL, 10);
+		}
+	}
+
 	run(app);
 
 	return 0;
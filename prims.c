@@ -0,0 +1,432 @@
+#include "prims.h"
+#include "cpu_prims.h"
+#include "gpu_prims.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ *	GPU backend: host arrays are staged through persistently mapped storage
+ *	buffers, so the timings include the transfer a host-side workload pays.
+ */
+
+typedef struct _gpu_backend_ctx_t
+{
+	struct _application *ref;
+	bool owns_device;
+
+	gpu_prims_t prims;
+
+	compute_buffer_t io[3];
+}
+gpu_backend_ctx_t;
+
+static void reserve_io(gpu_backend_ctx_t *ctx, int slot, VkDeviceSize size)
+{
+	compute_buffer_t *buf = &ctx->io[slot];
+
+	if (buf->buffer != VK_NULL_HANDLE && buf->size >= size) {
+		return;
+	}
+
+	if (buf->buffer != VK_NULL_HANDLE) {
+		destroy_compute_buffer(ctx->ref, buf);
+	}
+
+	create_compute_buffer(ctx->ref, size > 4 ? size : 4, 0, true, buf);
+}
+
+static uint32_t gpu_backend_reduce(void *arg, const uint32_t *in, uint32_t count, prim_reduce_op_t op)
+{
+	gpu_backend_ctx_t *ctx = arg;
+
+	reserve_io(ctx, 0, sizeof(uint32_t) * (VkDeviceSize) count);
+	memcpy(ctx->io[0].mapped, in, sizeof(uint32_t) * count);
+
+	return gpu_reduce_u32(ctx->ref, &ctx->prims, &ctx->io[0], count, op);
+}
+
+static void gpu_backend_scan(void *arg, const uint32_t *in, uint32_t *out, uint32_t count, bool inclusive)
+{
+	gpu_backend_ctx_t *ctx = arg;
+
+	reserve_io(ctx, 0, sizeof(uint32_t) * (VkDeviceSize) count);
+	reserve_io(ctx, 2, sizeof(uint32_t) * (VkDeviceSize) count);
+	memcpy(ctx->io[0].mapped, in, sizeof(uint32_t) * count);
+
+	gpu_scan_u32(ctx->ref, &ctx->prims, &ctx->io[0], &ctx->io[2], count, inclusive);
+
+	memcpy(out, ctx->io[2].mapped, sizeof(uint32_t) * count);
+}
+
+static uint32_t gpu_backend_compact(void *arg, const uint32_t *values, const uint32_t *flags, uint32_t *out, uint32_t count)
+{
+	gpu_backend_ctx_t *ctx = arg;
+
+	reserve_io(ctx, 0, sizeof(uint32_t) * (VkDeviceSize) count);
+	reserve_io(ctx, 1, sizeof(uint32_t) * (VkDeviceSize) count);
+	reserve_io(ctx, 2, sizeof(uint32_t) * (VkDeviceSize) count);
+	memcpy(ctx->io[0].mapped, values, sizeof(uint32_t) * count);
+	memcpy(ctx->io[1].mapped, flags, sizeof(uint32_t) * count);
+
+	uint32_t kept = gpu_compact_u32(ctx->ref, &ctx->prims, &ctx->io[0], &ctx->io[1], &ctx->io[2], count);
+
+	memcpy(out, ctx->io[2].mapped, sizeof(uint32_t) * kept);
+
+	return kept;
+}
+
+static void gpu_backend_sort(void *arg, uint32_t *keys, uint32_t *values, uint32_t count, uint32_t key_bits)
+{
+	gpu_backend_ctx_t *ctx = arg;
+	size_t key_size = sizeof(uint32_t) * (size_t) count * (key_bits / 32);
+
+	reserve_io(ctx, 0, key_size);
+	memcpy(ctx->io[0].mapped, keys, key_size);
+
+	if (values) {
+		reserve_io(ctx, 1, sizeof(uint32_t) * (VkDeviceSize) count);
+		memcpy(ctx->io[1].mapped, values, sizeof(uint32_t) * count);
+	}
+
+	gpu_radix_sort(ctx->ref, &ctx->prims, &ctx->io[0], values ? &ctx->io[1] : NULL, count, key_bits);
+
+	memcpy(keys, ctx->io[0].mapped, key_size);
+
+	if (values) {
+		memcpy(values, ctx->io[1].mapped, sizeof(uint32_t) * count);
+	}
+}
+
+static void gpu_backend_destroy(void *arg)
+{
+	gpu_backend_ctx_t *ctx = arg;
+
+	for (int i = 0; i < 3; i++) {
+		if (ctx->io[i].buffer != VK_NULL_HANDLE) {
+			destroy_compute_buffer(ctx->ref, &ctx->io[i]);
+		}
+	}
+
+	destroy_gpu_prims(ctx->ref, &ctx->prims);
+
+	if (ctx->owns_device) {
+		cleanup_compute_headless(ctx->ref);
+		ctx->ref->device = VK_NULL_HANDLE;
+	}
+}
+
+/**
+ *	CPU backend.
+ */
+
+static uint32_t cpu_backend_reduce(void *ctx, const uint32_t *in, uint32_t count, prim_reduce_op_t op)
+{
+	return cpu_reduce_u32(ctx, in, count, op);
+}
+
+static void cpu_backend_scan(void *ctx, const uint32_t *in, uint32_t *out, uint32_t count, bool inclusive)
+{
+	cpu_scan_u32(ctx, in, out, count, inclusive);
+}
+
+static uint32_t cpu_backend_compact(void *ctx, const uint32_t *values, const uint32_t *flags, uint32_t *out, uint32_t count)
+{
+	return cpu_compact_u32(ctx, values, flags, out, count);
+}
+
+static void cpu_backend_sort(void *ctx, uint32_t *keys, uint32_t *values, uint32_t count, uint32_t key_bits)
+{
+	cpu_radix_sort(ctx, keys, values, count, key_bits);
+}
+
+static void cpu_backend_destroy(void *ctx)
+{
+	destroy_cpu_prims(ctx);
+}
+
+static bool init_gpu_backend(struct _application *ref, prims_backend_t *backend)
+{
+	gpu_backend_ctx_t *ctx = calloc(1, sizeof(gpu_backend_ctx_t));
+	ctx->ref = ref;
+
+	if (ref->device == VK_NULL_HANDLE) {
+		if (!compute_device_available()) {
+			free(ctx);
+			return false;
+		}
+
+		init_compute_headless(ref);
+		ctx->owns_device = true;
+	}
+
+	init_gpu_prims(ref, &ctx->prims);
+
+	if (!ctx->prims.supported) {
+		gpu_backend_destroy(ctx);
+		free(ctx);
+		return false;
+	}
+
+	backend->kind = PRIMS_BACKEND_GPU;
+	backend->name = "gpu";
+	backend->ctx = ctx;
+	backend->reduce_u32 = gpu_backend_reduce;
+	backend->scan_u32 = gpu_backend_scan;
+	backend->compact_u32 = gpu_backend_compact;
+	backend->radix_sort = gpu_backend_sort;
+	backend->destroy = gpu_backend_destroy;
+
+	return true;
+}
+
+static void init_cpu_backend(prims_backend_t *backend)
+{
+	cpu_prims_t *ctx = malloc(sizeof(cpu_prims_t));
+	init_cpu_prims(ctx, 0);
+
+	backend->kind = PRIMS_BACKEND_CPU;
+	backend->name = ctx->avx2 ? "cpu-avx2" : ctx->sse41 ? "cpu-sse4.1" : "cpu-scalar";
+	backend->ctx = ctx;
+	backend->reduce_u32 = cpu_backend_reduce;
+	backend->scan_u32 = cpu_backend_scan;
+	backend->compact_u32 = cpu_backend_compact;
+	backend->radix_sort = cpu_backend_sort;
+	backend->destroy = cpu_backend_destroy;
+}
+
+/**
+ *	Pick a backend. `PRIMS_BACKEND_AUTO` prefers the GPU and falls back to the
+ *	CPU when no usable Vulkan device (or subgroup support) is found. When
+ *	`ref->device` is not initialized yet a headless compute device is brought
+ *	up and owned by the backend.
+ */
+bool init_prims_backend(struct _application *ref, prims_backend_t *backend, prims_backend_kind_t kind)
+{
+	memset(backend, 0, sizeof(prims_backend_t));
+
+	if (kind == PRIMS_BACKEND_GPU || kind == PRIMS_BACKEND_AUTO) {
+		if (init_gpu_backend(ref, backend)) {
+			return true;
+		}
+
+		if (kind == PRIMS_BACKEND_GPU) {
+			return false;
+		}
+
+		fprintf(stderr, "WARN: no usable Vulkan compute device, falling back to CPU primitives\n");
+	}
+
+	init_cpu_backend(backend);
+
+	return true;
+}
+
+void destroy_prims_backend(prims_backend_t *backend)
+{
+	if (backend->destroy) {
+		backend->destroy(backend->ctx);
+	}
+
+	free(backend->ctx);
+	memset(backend, 0, sizeof(prims_backend_t));
+}
+
+/**
+ *	Benchmark.
+ */
+
+enum
+{
+	BENCH_REDUCE,
+	BENCH_SCAN,
+	BENCH_COMPACT,
+	BENCH_SORT32,
+	BENCH_SORT64,
+	BENCH_OP_COUNT
+};
+
+static const char *bench_op_names[BENCH_OP_COUNT] = {"reduce", "scan", "compact", "sort32 kv", "sort64 kv"};
+
+#define BENCH_MIN_LOG2 10
+#define BENCH_MAX_LOG2 24
+#define BENCH_SIZES (((BENCH_MAX_LOG2 - BENCH_MIN_LOG2) / 2) + 1)
+
+/**
+ *	Shared by the benchmarks of gpu_prims.c.
+ */
+double now_seconds()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ *	xorshift64, reproducible benchmark input.
+ */
+uint32_t bench_rand(uint64_t *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+
+	return (uint32_t) (*state >> 16);
+}
+
+/**
+ *	Run one operation `iterations` times on a backend and return elements per
+ *	second. The last result is left in `out` / `out_values` for comparison.
+ */
+static double bench_op(prims_backend_t *backend, int op, const uint32_t *data, const uint32_t *flags, uint32_t n, int iterations,
+	uint32_t *out, uint32_t *out_values, uint32_t *out_count)
+{
+	double elapsed = 0.0;
+
+	for (int it = 0; it < iterations; it++) {
+		uint32_t words = op == BENCH_SORT64 ? 2 : 1;
+
+		if (op == BENCH_SORT32 || op == BENCH_SORT64) {
+			memcpy(out, data, sizeof(uint32_t) * n * words);
+			for (uint32_t i = 0; i < n; i++) {
+				out_values[i] = i;
+			}
+		}
+
+		double t0 = now_seconds();
+
+		switch (op) {
+		case BENCH_REDUCE:
+			*out_count = backend->reduce_u32(backend->ctx, data, n, PRIM_REDUCE_ADD);
+			break;
+		case BENCH_SCAN:
+			backend->scan_u32(backend->ctx, data, out, n, false);
+			break;
+		case BENCH_COMPACT:
+			*out_count = backend->compact_u32(backend->ctx, data, flags, out, n);
+			break;
+		default:
+			backend->radix_sort(backend->ctx, out, out_values, n, words * 32);
+			break;
+		}
+
+		elapsed += now_seconds() - t0;
+	}
+
+	return (n * (double) iterations) / elapsed;
+}
+
+/**
+ *	Compare the CPU and GPU backends over sizes from 1K to 16M elements, check
+ *	that both produce identical results and report, per operation, the
+ *	smallest size from which the GPU stays ahead (the crossover point).
+ */
+void bench_prims(struct _application *ref)
+{
+	prims_backend_t backends[2];
+	int backend_count = 0;
+
+	init_prims_backend(ref, &backends[backend_count++], PRIMS_BACKEND_CPU);
+
+	if (init_prims_backend(ref, &backends[backend_count], PRIMS_BACKEND_GPU)) {
+		backend_count++;
+	}
+	else {
+		fprintf(stderr, "WARN: no usable Vulkan compute device, reporting CPU numbers only\n");
+	}
+
+	double rates[2][BENCH_OP_COUNT][BENCH_SIZES] = {};
+	uint64_t seed = 0x9e3779b97f4a7c15ull;
+
+	printf("%-10s %-10s %-10s %14s\n", "op", "backend", "n", "Melem/s");
+
+	for (int s = 0; s < BENCH_SIZES; s++) {
+		uint32_t n = 1u << (BENCH_MIN_LOG2 + s * 2);
+		int iterations = n >= (1 << 20) ? 5 : 20;
+
+		uint32_t *data = malloc(sizeof(uint32_t) * n * 2);
+		uint32_t *flags = malloc(sizeof(uint32_t) * n);
+		uint32_t *out[2] = {malloc(sizeof(uint32_t) * n * 2), malloc(sizeof(uint32_t) * n * 2)};
+		uint32_t *out_values[2] = {malloc(sizeof(uint32_t) * n), malloc(sizeof(uint32_t) * n)};
+
+		for (uint32_t i = 0; i < n * 2; i++) {
+			data[i] = bench_rand(&seed);
+		}
+
+		for (uint32_t i = 0; i < n; i++) {
+			flags[i] = data[i] & 1;
+		}
+
+		for (int op = 0; op < BENCH_OP_COUNT; op++) {
+			uint32_t counts[2] = {0, 0};
+
+			for (int b = 0; b < backend_count; b++) {
+				rates[b][op][s] = bench_op(&backends[b], op, data, flags, n, iterations, out[b], out_values[b], &counts[b]);
+			}
+
+			/**
+			 * The CPU backend is the reference for the GPU results.
+			 */
+
+			const char *status = "";
+
+			if (backend_count > 1) {
+				size_t words = 0;
+				bool values = false;
+
+				switch (op) {
+				case BENCH_SCAN:	words = n; break;
+				case BENCH_COMPACT:	words = counts[0]; break;
+				case BENCH_SORT32:	words = n; values = true; break;
+				case BENCH_SORT64:	words = (size_t) n * 2; values = true; break;
+				default:		break;
+				}
+
+				bool ok = counts[0] == counts[1] && memcmp(out[0], out[1], sizeof(uint32_t) * words) == 0;
+
+				if (values) {
+					ok = ok && memcmp(out_values[0], out_values[1], sizeof(uint32_t) * n) == 0;
+				}
+
+				status = ok ? "ok" : "MISMATCH";
+			}
+
+			for (int b = 0; b < backend_count; b++) {
+				printf("%-10s %-10s %-10u %14.2f %s\n", bench_op_names[op], backends[b].name, n, rates[b][op][s] * 1e-6, b > 0 ? status : "");
+			}
+		}
+
+		free(data);
+		free(flags);
+		free(out[0]);
+		free(out[1]);
+		free(out_values[0]);
+		free(out_values[1]);
+	}
+
+	if (backend_count > 1) {
+		printf("\ncrossover (smallest n from which the GPU stays faster):\n");
+
+		for (int op = 0; op < BENCH_OP_COUNT; op++) {
+			int crossover = -1;
+
+			for (int s = BENCH_SIZES - 1; s >= 0 && rates[1][op][s] > rates[0][op][s]; s--) {
+				crossover = s;
+			}
+
+			if (crossover < 0) {
+				printf("  %-10s never\n", bench_op_names[op]);
+			}
+			else {
+				printf("  %-10s n >= %u\n", bench_op_names[op], 1u << (BENCH_MIN_LOG2 + crossover * 2));
+			}
+		}
+	}
+
+	for (int b = 0; b < backend_count; b++) {
+		destroy_prims_backend(&backends[b]);
+	}
+}
@@ -0,0 +1,57 @@
+#ifndef _PRIMS_H_
+#define _PRIMS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct _application;
+
+typedef enum _prim_reduce_op_t
+{
+	PRIM_REDUCE_ADD = 0,
+	PRIM_REDUCE_MIN = 1,
+	PRIM_REDUCE_MAX = 2
+}
+prim_reduce_op_t;
+
+typedef enum _prims_backend_kind_t
+{
+	PRIMS_BACKEND_AUTO = 0,
+	PRIMS_BACKEND_GPU = 1,
+	PRIMS_BACKEND_CPU = 2
+}
+prims_backend_kind_t;
+
+/**
+ *	One dispatch interface for the data-parallel primitives, implemented by
+ *	the Vulkan compute path (gpu_prims) and the SIMD / threaded CPU path
+ *	(cpu_prims). All entry points work on host memory, so a workload can run
+ *	on either backend and compare results.
+ */
+typedef struct _prims_backend_t
+{
+	prims_backend_kind_t kind;
+	const char *name;
+
+	void *ctx;
+
+	uint32_t (*reduce_u32)(void *ctx, const uint32_t *in, uint32_t count, prim_reduce_op_t op);
+	void (*scan_u32)(void *ctx, const uint32_t *in, uint32_t *out, uint32_t count, bool inclusive);
+	uint32_t (*compact_u32)(void *ctx, const uint32_t *values, const uint32_t *flags, uint32_t *out, uint32_t count);
+	void (*radix_sort)(void *ctx, uint32_t *keys, uint32_t *values, uint32_t count, uint32_t key_bits);
+
+	void (*destroy)(void *ctx);
+}
+prims_backend_t;
+
+bool init_prims_backend(struct _application *ref, prims_backend_t *backend, prims_backend_kind_t kind);
+
+void destroy_prims_backend(prims_backend_t *backend);
+
+void bench_prims(struct _application *ref);
+
+double now_seconds();
+
+uint32_t bench_rand(uint64_t *state);
+
+#endif
@@ -0,0 +1,214 @@
+#include "profiler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define PROFILER_GPU_RING_SIZE (1 << 14)
+
+bool profiler_active = false;
+__thread profiler_ring_t *profiler_ring = NULL;
+
+static pthread_mutex_t rings_lock = PTHREAD_MUTEX_INITIALIZER;
+static profiler_ring_t *rings[PROFILER_MAX_THREADS];
+static uint32_t ring_count = 0;
+
+static profiler_gpu_event_t *gpu_events = NULL;
+static uint64_t gpu_head = 0;
+
+/**
+ *	Tick / nanosecond pair taken at init, the second pair is taken at
+ *	export time to derive the tick rate.
+ */
+static uint64_t base_ticks;
+static uint64_t base_ns;
+
+uint64_t profiler_now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/**
+ *	Start recording. Zones opened before this call are dropped.
+ */
+void profiler_init()
+{
+	gpu_events = calloc(PROFILER_GPU_RING_SIZE, sizeof(profiler_gpu_event_t));
+	gpu_head = 0;
+
+	base_ns = profiler_now_ns();
+	base_ticks = profiler_ticks();
+
+	profiler_active = true;
+}
+
+/**
+ *	Allocate the calling thread's ring on its first zone. Only this path
+ *	takes a lock, recording itself is lock free.
+ */
+profiler_ring_t *profiler_register_thread()
+{
+	profiler_ring_t *ring = calloc(1, sizeof(profiler_ring_t));
+
+	pthread_mutex_lock(&rings_lock);
+
+	if (ring_count == PROFILER_MAX_THREADS) {
+		pthread_mutex_unlock(&rings_lock);
+
+		fprintf(stderr, "ERR: too many profiled threads\n // Assertion: `ring_count < PROFILER_MAX_THREADS`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	ring->thread_index = ring_count;
+	rings[ring_count++] = ring;
+
+	pthread_mutex_unlock(&rings_lock);
+
+	profiler_ring = ring;
+
+	return ring;
+}
+
+/**
+ *	Record a GPU zone. Called from the thread collecting GPU queries.
+ */
+void profiler_gpu_zone(const char *name, uint64_t begin_ns, uint64_t end_ns)
+{
+	if (!profiler_active) {
+		return;
+	}
+
+	profiler_gpu_event_t *event = &gpu_events[gpu_head & (PROFILER_GPU_RING_SIZE - 1)];
+	snprintf(event->name, sizeof(event->name), "%s", name);
+	event->begin_ns = begin_ns;
+	event->end_ns = end_ns;
+
+	gpu_head++;
+}
+
+/**
+ *	Zone names come from source text (see `PROFILE_CALL`), escape what
+ *	would break a JSON string.
+ */
+static void write_json_string(FILE *f, const char *str)
+{
+	fputc('"', f);
+
+	for (; *str; str++) {
+		if (*str == '"' || *str == '\\') {
+			fputc('\\', f);
+		}
+
+		fputc(*str, f);
+	}
+
+	fputc('"', f);
+}
+
+/**
+ *	Write every recorded zone as Chrome trace JSON (chrome://tracing,
+ *	ui.perfetto.dev). CPU threads get one track each, GPU zones go to a
+ *	separate "GPU" track.
+ */
+bool profiler_export_chrome(const char *path)
+{
+	if (gpu_events == NULL) {
+		return false;
+	}
+
+	FILE *f = fopen(path, "w");
+
+	if (f == NULL) {
+		fprintf(stderr, "ERR: failed to open trace file `%s`\n", path);
+		return false;
+	}
+
+	uint64_t now_ticks = profiler_ticks();
+	uint64_t now_ns = profiler_now_ns();
+
+	double ns_per_tick = now_ticks > base_ticks ? (double) (now_ns - base_ns) / (double) (now_ticks - base_ticks) : 1.0;
+
+	fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"parallax\"}}");
+
+	pthread_mutex_lock(&rings_lock);
+
+	for (uint32_t t = 0; t < ring_count; t++) {
+		profiler_ring_t *ring = rings[t];
+
+		fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s %u\"}}",
+			t + 1, t == 0 ? "main" : "worker", t);
+
+		uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+		uint64_t first = head > PROFILER_RING_SIZE ? head - PROFILER_RING_SIZE : 0;
+
+		for (uint64_t i = first; i < head; i++) {
+			profiler_event_t *event = &ring->events[i & (PROFILER_RING_SIZE - 1)];
+
+			if (event->start < base_ticks) {
+				continue;
+			}
+
+			double ts_us = (event->start - base_ticks) * ns_per_tick * 1e-3;
+			double dur_us = (event->end - event->start) * ns_per_tick * 1e-3;
+
+			fprintf(f, ",\n{\"name\":");
+			write_json_string(f, event->name);
+			fprintf(f, ",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", t + 1, ts_us, dur_us);
+		}
+	}
+
+	pthread_mutex_unlock(&rings_lock);
+
+	if (gpu_head > 0) {
+		fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"GPU\"}}");
+	}
+
+	uint64_t first = gpu_head > PROFILER_GPU_RING_SIZE ? gpu_head - PROFILER_GPU_RING_SIZE : 0;
+
+	for (uint64_t i = first; i < gpu_head; i++) {
+		profiler_gpu_event_t *event = &gpu_events[i & (PROFILER_GPU_RING_SIZE - 1)];
+
+		if (event->begin_ns < base_ns) {
+			continue;
+		}
+
+		fprintf(f, ",\n{\"name\":");
+		write_json_string(f, event->name);
+		fprintf(f, ",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f}",
+			(event->begin_ns - base_ns) * 1e-3, (event->end_ns - event->begin_ns) * 1e-3);
+	}
+
+	fprintf(f, "\n]}\n");
+	fclose(f);
+
+	return true;
+}
+
+/**
+ *	Stop recording and release the buffers. Rings of threads that are still
+ *	alive must not record afterwards.
+ */
+void profiler_shutdown()
+{
+	profiler_active = false;
+
+	pthread_mutex_lock(&rings_lock);
+
+	for (uint32_t t = 0; t < ring_count; t++) {
+		free(rings[t]);
+	}
+
+	ring_count = 0;
+
+	pthread_mutex_unlock(&rings_lock);
+
+	profiler_ring = NULL;
+
+	free(gpu_events);
+	gpu_events = NULL;
+}
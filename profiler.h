@@ -0,0 +1,136 @@
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILER_RDTSC
+#endif
+
+#define PROFILER_RING_SIZE (1 << 16)
+#define PROFILER_MAX_THREADS 64
+
+/**
+ *	An open CPU zone, closed by `profiler_zone_end()`.
+ */
+typedef struct _profiler_zone_t
+{
+	const char *name;
+	uint64_t start;
+}
+profiler_zone_t;
+
+typedef struct _profiler_event_t
+{
+	const char *name;
+	uint64_t start;
+	uint64_t end;
+}
+profiler_event_t;
+
+/**
+ *	Single producer ring owned by one thread. `head` only grows, the
+ *	oldest events are overwritten once it wraps.
+ */
+typedef struct _profiler_ring_t
+{
+	uint64_t head;
+	uint32_t thread_index;
+
+	profiler_event_t events[PROFILER_RING_SIZE];
+}
+profiler_ring_t;
+
+/**
+ *	GPU zone, already converted to the CPU timebase in nanoseconds.
+ */
+typedef struct _profiler_gpu_event_t
+{
+	char name[32];
+	uint64_t begin_ns;
+	uint64_t end_ns;
+}
+profiler_gpu_event_t;
+
+extern bool profiler_active;
+extern __thread profiler_ring_t *profiler_ring;
+
+/**
+ *	Raw CPU ticks: the TSC on x86, CLOCK_MONOTONIC_RAW nanoseconds otherwise.
+ */
+static inline uint64_t profiler_ticks()
+{
+#ifdef PROFILER_RDTSC
+	return __rdtsc();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+profiler_ring_t *profiler_register_thread();
+
+static inline profiler_zone_t profiler_zone_begin(const char *name)
+{
+	profiler_zone_t zone = {NULL, 0};
+
+	if (profiler_active) {
+		zone.name = name;
+		zone.start = profiler_ticks();
+	}
+
+	return zone;
+}
+
+static inline void profiler_zone_end(profiler_zone_t *zone)
+{
+	if (zone->name == NULL) {
+		return;
+	}
+
+	uint64_t end = profiler_ticks();
+
+	profiler_ring_t *ring = profiler_ring ? profiler_ring : profiler_register_thread();
+	uint64_t head = ring->head;
+
+	profiler_event_t *event = &ring->events[head & (PROFILER_RING_SIZE - 1)];
+	event->name = zone->name;
+	event->start = zone->start;
+	event->end = end;
+
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ *	Scoped zones: `PROFILE_ZONE("name");` closes at the end of the enclosing
+ *	block, `PROFILE_CALL(fn(ref));` times a single statement. Both compile to
+ *	nothing with PARALLAX_NO_PROFILER.
+ */
+#ifdef PARALLAX_NO_PROFILER
+#define PROFILE_ZONE(name)
+#define PROFILE_CALL(stmt) stmt
+#else
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_ZONE(name) \
+	profiler_zone_t PROFILE_CONCAT(_profile_zone_, __LINE__) __attribute__((cleanup(profiler_zone_end))) = profiler_zone_begin(name)
+#define PROFILE_CALL(stmt) \
+	do { PROFILE_ZONE(#stmt); stmt; } while (0)
+#endif
+
+void profiler_init();
+
+uint64_t profiler_now_ns();
+
+void profiler_gpu_zone(const char *name, uint64_t begin_ns, uint64_t end_ns);
+
+bool profiler_export_chrome(const char *path);
+
+void profiler_shutdown();
+
+#endif
@@ -0,0 +1,644 @@
+#include "render_graph.h"
+#include "mem_budget.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ *	Synchronization state of a resource while the passes are walked in
+ *	`place_barriers()`: the last write (or layout transition), the stages
+ *	it has been made visible to and the reads since.
+ */
+typedef struct _rg_track_t
+{
+	VkImageLayout layout;
+
+	VkPipelineStageFlags write_stages;
+	VkAccessFlags write_access;
+
+	VkPipelineStageFlags visible_stages;
+	VkAccessFlags visible_access;
+
+	VkPipelineStageFlags read_stages;
+}
+rg_track_t;
+
+void init_render_graph(render_graph_t *graph)
+{
+	memset(graph, 0, sizeof(render_graph_t));
+
+	array_init(&graph->blocks, sizeof(rg_block_t));
+	array_init(&graph->final_barriers, sizeof(rg_barrier_t));
+
+	init_barrier_batch(&graph->batch);
+}
+
+void destroy_render_graph(struct _application *ref, render_graph_t *graph)
+{
+	for (uint32_t i = 0; i < graph->resource_count; i++) {
+		rg_resource_t *res = &graph->resources[i];
+
+		if (!res->transient) {
+			continue;
+		}
+
+		if (res->view != VK_NULL_HANDLE) {
+			vkDestroyImageView(ref->device, res->view, HOST_ALLOC(IMAGE_VIEW));
+		}
+
+		if (res->image != VK_NULL_HANDLE) {
+			vkDestroyImage(ref->device, res->image, HOST_ALLOC(IMAGE));
+		}
+	}
+
+	for (int i = 0; i < array_size(&graph->blocks); i++) {
+		mem_budget_free(ref, ((rg_block_t *) array_data(&graph->blocks))[i].memory);
+	}
+
+	for (uint32_t i = 0; i < graph->pass_count; i++) {
+		array_free(&graph->passes[i].barriers);
+	}
+
+	array_free(&graph->blocks);
+	array_free(&graph->final_barriers);
+
+	destroy_barrier_batch(&graph->batch);
+}
+
+static rg_resource_t *add_resource(render_graph_t *graph, const char *name, rg_resource_type_t type)
+{
+	if (graph->resource_count == RG_MAX_RESOURCES) {
+		fprintf(stderr, "ERR: too many render graph resources\n // Assertion: `graph->resource_count < RG_MAX_RESOURCES`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	rg_resource_t *res = &graph->resources[graph->resource_count++];
+
+	snprintf(res->name, sizeof(res->name), "%s", name);
+	res->type = type;
+	res->first_pass = -1;
+	res->last_pass = -1;
+	res->block = -1;
+	res->alias_prev = RG_NO_RESOURCE;
+
+	return res;
+}
+
+/**
+ *	`final` (optional) is the state the image is left in at the end of the
+ *	frame, eg. `PRESENT_SRC_KHR`. Imported images with a final state are
+ *	the outputs of the graph.
+ */
+uint32_t rg_import_image(render_graph_t *graph, const char *name, VkImageAspectFlags aspect, rg_state_t initial, const rg_state_t *final)
+{
+	rg_resource_t *res = add_resource(graph, name, RG_IMAGE);
+
+	res->aspect = aspect;
+	res->initial = initial;
+
+	if (final) {
+		res->final = *final;
+		res->has_final = true;
+	}
+
+	return graph->resource_count - 1;
+}
+
+uint32_t rg_import_buffer(render_graph_t *graph, const char *name, rg_state_t initial)
+{
+	rg_resource_t *res = add_resource(graph, name, RG_BUFFER);
+
+	res->initial = initial;
+
+	return graph->resource_count - 1;
+}
+
+uint32_t rg_create_image(render_graph_t *graph, const char *name, VkFormat format, VkExtent2D extent, VkImageUsageFlags usage, VkImageAspectFlags aspect)
+{
+	rg_resource_t *res = add_resource(graph, name, RG_IMAGE);
+
+	res->transient = true;
+	res->format = format;
+	res->extent = extent;
+	res->usage = usage;
+	res->aspect = aspect;
+
+	return graph->resource_count - 1;
+}
+
+/**
+ *	Bind the handles of an imported resource, eg. the swapchain image being
+ *	recorded, before `rg_execute()`.
+ */
+void rg_set_image(render_graph_t *graph, uint32_t resource, VkImage image, VkImageView view)
+{
+	graph->resources[resource].image = image;
+	graph->resources[resource].view = view;
+}
+
+void rg_set_buffer(render_graph_t *graph, uint32_t resource, VkBuffer buffer)
+{
+	graph->resources[resource].buffer = buffer;
+}
+
+/**
+ *	View of a transient image, valid after `rg_compile()`. VK_NULL_HANDLE
+ *	when every pass using it was culled.
+ */
+VkImageView rg_image_view(const render_graph_t *graph, uint32_t resource)
+{
+	return graph->resources[resource].view;
+}
+
+uint32_t rg_add_pass(render_graph_t *graph, const char *name, rg_record_fn record, void *user, bool side_effect)
+{
+	if (graph->pass_count == RG_MAX_PASSES) {
+		fprintf(stderr, "ERR: too many render graph passes\n // Assertion: `graph->pass_count < RG_MAX_PASSES`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	rg_pass_t *pass = &graph->passes[graph->pass_count++];
+
+	snprintf(pass->name, sizeof(pass->name), "%s", name);
+	pass->record = record;
+	pass->user = user;
+	pass->side_effect = side_effect;
+
+	array_init(&pass->barriers, sizeof(rg_barrier_t));
+
+	return graph->pass_count - 1;
+}
+
+/**
+ *	A pass both reading and writing a resource declares it twice, the uses
+ *	are merged into one access and must agree on the layout.
+ */
+static void add_access(render_graph_t *graph, uint32_t pass_index, uint32_t resource, rg_state_t state, bool write)
+{
+	rg_pass_t *pass = &graph->passes[pass_index];
+
+	for (uint32_t i = 0; i < pass->access_count; i++) {
+		rg_access_t *access = &pass->accesses[i];
+
+		if (access->resource != resource) {
+			continue;
+		}
+
+		if (access->state.layout != state.layout) {
+			fprintf(stderr, "ERR: pass `%s` uses `%s` in two layouts\n // Assertion: `access->state.layout == state.layout`\n",
+				pass->name, graph->resources[resource].name);
+			exit(EXIT_FAILURE);
+		}
+
+		access->state.stages |= state.stages;
+		access->state.access |= state.access;
+		access->write |= write;
+
+		return;
+	}
+
+	if (pass->access_count == RG_MAX_ACCESSES) {
+		fprintf(stderr, "ERR: pass `%s` uses too many resources\n // Assertion: `pass->access_count < RG_MAX_ACCESSES`\n", pass->name);
+		exit(EXIT_FAILURE);
+	}
+
+	rg_access_t *access = &pass->accesses[pass->access_count++];
+
+	access->resource = resource;
+	access->state = state;
+	access->write = write;
+}
+
+/**
+ *	`layout` is ignored for buffers.
+ */
+void rg_read(render_graph_t *graph, uint32_t pass, uint32_t resource, VkPipelineStageFlags stages, VkAccessFlags access, VkImageLayout layout)
+{
+	rg_state_t state = {stages, access, layout};
+	add_access(graph, pass, resource, state, false);
+}
+
+void rg_write(render_graph_t *graph, uint32_t pass, uint32_t resource, VkPipelineStageFlags stages, VkAccessFlags access, VkImageLayout layout)
+{
+	rg_state_t state = {stages, access, layout};
+	add_access(graph, pass, resource, state, true);
+}
+
+/**
+ *	Walk the passes backwards from the outputs: a pass survives when it has
+ *	side effects or writes a resource a later surviving pass (or the end
+ *	of the frame) needs, and then needs everything it reads.
+ */
+static void cull_passes(render_graph_t *graph)
+{
+	bool needed[RG_MAX_RESOURCES] = {};
+
+	for (uint32_t i = 0; i < graph->resource_count; i++) {
+		needed[i] = !graph->resources[i].transient && graph->resources[i].has_final;
+	}
+
+	for (int32_t p = (int32_t) graph->pass_count - 1; p >= 0; p--) {
+		rg_pass_t *pass = &graph->passes[p];
+		bool alive = pass->side_effect;
+
+		for (uint32_t a = 0; a < pass->access_count; a++) {
+			if (pass->accesses[a].write && needed[pass->accesses[a].resource]) {
+				alive = true;
+			}
+		}
+
+		pass->culled = !alive;
+
+		if (!alive) {
+			continue;
+		}
+
+		for (uint32_t a = 0; a < pass->access_count; a++) {
+			if (!pass->accesses[a].write || pass->accesses[a].state.access & ~BARRIER_WRITE_ACCESS) {
+				needed[pass->accesses[a].resource] = true;
+			}
+		}
+	}
+}
+
+static void compute_lifetimes(render_graph_t *graph)
+{
+	for (uint32_t p = 0; p < graph->pass_count; p++) {
+		rg_pass_t *pass = &graph->passes[p];
+
+		if (pass->culled) {
+			continue;
+		}
+
+		for (uint32_t a = 0; a < pass->access_count; a++) {
+			rg_resource_t *res = &graph->resources[pass->accesses[a].resource];
+
+			if (res->first_pass < 0) {
+				res->first_pass = (int32_t) p;
+			}
+
+			res->last_pass = (int32_t) p;
+		}
+	}
+}
+
+/**
+ *	Create the transient images and place them in memory blocks. Images are
+ *	taken in order of their first use and go into a block whose last user
+ *	is done by then (the largest such block with a compatible memory type),
+ *	or into a new block. Greedy by start time colors interval lifetimes
+ *	with the fewest blocks, a block grows to its largest image.
+ */
+static void alias_transients(struct _application *ref, render_graph_t *graph)
+{
+	uint32_t order[RG_MAX_RESOURCES];
+	uint32_t count = 0;
+
+	for (uint32_t i = 0; i < graph->resource_count; i++) {
+		rg_resource_t *res = &graph->resources[i];
+
+		if (!res->transient || res->first_pass < 0) {
+			continue;
+		}
+
+		res->lazy = (res->usage & ~RG_ATTACHMENT_USAGE) == 0;
+
+		VkImageCreateInfo image_info = {};
+		image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		image_info.imageType = VK_IMAGE_TYPE_2D;
+		image_info.extent.width = res->extent.width;
+		image_info.extent.height = res->extent.height;
+		image_info.extent.depth = 1;
+		image_info.mipLevels = 1;
+		image_info.arrayLayers = 1;
+		image_info.format = res->format;
+		image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+		image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		image_info.usage = res->usage | (res->lazy ? VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : 0);
+		image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+		image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if (vkCreateImage(ref->device, &image_info, HOST_ALLOC(IMAGE), &res->image) != VK_SUCCESS) {
+			fprintf(stderr, "ERR: failed to create transient image `%s`\n // Assertion: `vkCreateImage == VK_SUCCESS`\n", res->name);
+			exit(EXIT_FAILURE);
+		}
+
+		vkGetImageMemoryRequirements(ref->device, res->image, &res->requirements);
+
+		uint32_t j = count++;
+
+		while (j > 0 && graph->resources[order[j - 1]].first_pass > res->first_pass) {
+			order[j] = order[j - 1];
+			j--;
+		}
+
+		order[j] = i;
+	}
+
+	for (uint32_t k = 0; k < count; k++) {
+		rg_resource_t *res = &graph->resources[order[k]];
+		rg_block_t *blocks = (rg_block_t *) array_data(&graph->blocks);
+
+		int32_t best = -1;
+
+		for (int b = 0; b < array_size(&graph->blocks); b++) {
+			if (blocks[b].last_pass >= res->first_pass || blocks[b].lazy != res->lazy || !(blocks[b].type_bits & res->requirements.memoryTypeBits)) {
+				continue;
+			}
+
+			if (best < 0 || blocks[b].size > blocks[best].size) {
+				best = b;
+			}
+		}
+
+		if (best < 0) {
+			rg_block_t block = {};
+			block.type_bits = res->requirements.memoryTypeBits;
+			block.lazy = res->lazy;
+			block.last_resource = RG_NO_RESOURCE;
+
+			array_append(&graph->blocks, &block);
+
+			best = array_size(&graph->blocks) - 1;
+			blocks = (rg_block_t *) array_data(&graph->blocks);
+		}
+
+		rg_block_t *block = &blocks[best];
+
+		res->block = best;
+		res->alias_prev = block->last_resource;
+
+		block->type_bits &= res->requirements.memoryTypeBits;
+		block->last_pass = res->last_pass;
+		block->last_resource = order[k];
+
+		VkDeviceSize size = (res->requirements.size + res->requirements.alignment - 1) / res->requirements.alignment * res->requirements.alignment;
+
+		if (size > block->size) {
+			block->size = size;
+		}
+	}
+
+	for (int b = 0; b < array_size(&graph->blocks); b++) {
+		rg_block_t *block = &((rg_block_t *) array_data(&graph->blocks))[b];
+
+		VkMemoryAllocateInfo alloc_info = {};
+		alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		alloc_info.allocationSize = block->size;
+		alloc_info.memoryTypeIndex = block->lazy ? find_transient_memory_type(ref, block->type_bits) :
+			find_memory_type(ref, block->type_bits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		if (mem_budget_allocate(ref, &alloc_info, &block->memory) != VK_SUCCESS) {
+			fprintf(stderr, "ERR: failed to allocate transient memory\n // Assertion: `mem_budget_allocate == VK_SUCCESS`\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	for (uint32_t k = 0; k < count; k++) {
+		rg_resource_t *res = &graph->resources[order[k]];
+
+		vkBindImageMemory(ref->device, res->image, ((rg_block_t *) array_data(&graph->blocks))[res->block].memory, 0);
+
+		VkImageViewCreateInfo view_info = {};
+		view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		view_info.image = res->image;
+		view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		view_info.format = res->format;
+		view_info.subresourceRange.aspectMask = res->aspect;
+		view_info.subresourceRange.baseMipLevel = 0;
+		view_info.subresourceRange.levelCount = 1;
+		view_info.subresourceRange.baseArrayLayer = 0;
+		view_info.subresourceRange.layerCount = 1;
+
+		if (vkCreateImageView(ref->device, &view_info, HOST_ALLOC(IMAGE_VIEW), &res->view) != VK_SUCCESS) {
+			fprintf(stderr, "ERR: failed to create transient image view `%s`\n // Assertion: `vkCreateImageView == VK_SUCCESS`\n", res->name);
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+/**
+ *	State a resource is left in by the last surviving pass using it.
+ */
+static rg_state_t last_state(const render_graph_t *graph, uint32_t resource)
+{
+	rg_state_t state = {};
+	const rg_pass_t *pass = &graph->passes[graph->resources[resource].last_pass];
+
+	for (uint32_t a = 0; a < pass->access_count; a++) {
+		if (pass->accesses[a].resource == resource) {
+			state = pass->accesses[a].state;
+		}
+	}
+
+	return state;
+}
+
+static void push_barrier(array *barriers, uint32_t resource, rg_state_t src, rg_state_t dst)
+{
+	rg_barrier_t barrier = {resource, src, dst};
+	array_append(barriers, &barrier);
+}
+
+/**
+ *	Walk the surviving passes in order and place a barrier wherever a use
+ *	depends on an earlier one: reads after a write that was not yet made
+ *	visible to their stages, writes after reads or writes, and layout
+ *	changes. Reads following reads need none.
+ *
+ *	Transient images start the frame undefined, but wait for the last
+ *	image that used their memory, which for the first image of a block is
+ *	the last one of the previous frame.
+ */
+static void place_barriers(render_graph_t *graph)
+{
+	rg_track_t tracks[RG_MAX_RESOURCES] = {};
+
+	for (uint32_t i = 0; i < graph->resource_count; i++) {
+		rg_resource_t *res = &graph->resources[i];
+		rg_track_t *track = &tracks[i];
+
+		if (res->transient) {
+			if (res->first_pass < 0) {
+				continue;
+			}
+
+			uint32_t prev = res->alias_prev != RG_NO_RESOURCE ? res->alias_prev : ((rg_block_t *) array_data(&graph->blocks))[res->block].last_resource;
+			rg_state_t prev_state = last_state(graph, prev);
+
+			track->layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			track->write_stages = prev_state.stages;
+			track->write_access = prev_state.access & BARRIER_WRITE_ACCESS;
+			track->read_stages = prev_state.stages;
+		}
+		else {
+			track->layout = res->initial.layout;
+			track->write_stages = res->initial.access & BARRIER_WRITE_ACCESS ? res->initial.stages : 0;
+			track->write_access = res->initial.access & BARRIER_WRITE_ACCESS;
+			track->read_stages = res->initial.stages;
+		}
+
+		track->visible_stages = 0;
+		track->visible_access = 0;
+	}
+
+	for (uint32_t p = 0; p < graph->pass_count; p++) {
+		rg_pass_t *pass = &graph->passes[p];
+
+		pass->barriers.size = 0;
+
+		if (pass->culled) {
+			continue;
+		}
+
+		for (uint32_t a = 0; a < pass->access_count; a++) {
+			rg_access_t *access = &pass->accesses[a];
+			rg_resource_t *res = &graph->resources[access->resource];
+			rg_track_t *track = &tracks[access->resource];
+
+			bool transition = res->type == RG_IMAGE && access->state.layout != track->layout;
+			bool barrier = false;
+
+			rg_state_t src = {0, 0, track->layout};
+
+			if (transition || access->write) {
+				src.stages = track->write_stages | track->read_stages;
+				src.access = track->write_access;
+				barrier = transition || src.stages != 0;
+			}
+			else if (track->write_stages && ((access->state.stages & ~track->visible_stages) || (access->state.access & ~track->visible_access))) {
+				src.stages = track->write_stages;
+				src.access = track->write_access;
+				barrier = true;
+			}
+
+			if (barrier) {
+				push_barrier(&pass->barriers, access->resource, src, access->state);
+			}
+
+			if (access->write || transition) {
+				track->layout = access->state.layout;
+				track->write_stages = access->state.stages;
+				track->write_access = access->write ? access->state.access & BARRIER_WRITE_ACCESS : 0;
+				track->visible_stages = access->state.stages;
+				track->visible_access = access->state.access;
+				track->read_stages = access->write ? 0 : access->state.stages;
+			}
+			else {
+				track->read_stages |= access->state.stages;
+
+				if (barrier) {
+					track->visible_stages |= access->state.stages;
+					track->visible_access |= access->state.access;
+				}
+			}
+		}
+	}
+
+	graph->final_barriers.size = 0;
+
+	for (uint32_t i = 0; i < graph->resource_count; i++) {
+		rg_resource_t *res = &graph->resources[i];
+		rg_track_t *track = &tracks[i];
+
+		if (!res->has_final || (track->layout == res->final.layout && res->final.access == 0)) {
+			continue;
+		}
+
+		rg_state_t src = {track->write_stages | track->read_stages, track->write_access, track->layout};
+		push_barrier(&graph->final_barriers, i, src, res->final);
+	}
+}
+
+/**
+ *	Cull, create the transient images and place the barriers. Called once
+ *	after every pass and resource has been declared.
+ */
+void rg_compile(struct _application *ref, render_graph_t *graph)
+{
+	cull_passes(graph);
+	compute_lifetimes(graph);
+	alias_transients(ref, graph);
+	place_barriers(graph);
+
+	graph->compiled = true;
+}
+
+static void cmd_barriers(struct _application *ref, render_graph_t *graph, VkCommandBuffer cmd, array *barriers)
+{
+	for (int i = 0; i < array_size(barriers); i++) {
+		rg_barrier_t *barrier = &((rg_barrier_t *) array_data(barriers))[i];
+		rg_resource_t *res = &graph->resources[barrier->resource];
+
+		if (res->type == RG_IMAGE) {
+			barrier_image(&graph->batch, res->image, res->aspect, barrier->src.stages, barrier->src.access, barrier->src.layout,
+				barrier->dst.stages, barrier->dst.access, barrier->dst.layout);
+		}
+		else {
+			barrier_buffer(&graph->batch, res->buffer, barrier->src.stages, barrier->src.access, barrier->dst.stages, barrier->dst.access);
+		}
+	}
+
+	barrier_flush(ref, &graph->batch, cmd);
+}
+
+/**
+ *	Record the frame for swapchain image `image`: each surviving pass behind
+ *	its batched barrier, then the transitions into the final states.
+ */
+void rg_execute(struct _application *ref, render_graph_t *graph, VkCommandBuffer cmd, uint32_t image)
+{
+	if (!graph->compiled) {
+		fprintf(stderr, "ERR: render graph executed before compiling\n // Assertion: `graph->compiled`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (uint32_t p = 0; p < graph->pass_count; p++) {
+		rg_pass_t *pass = &graph->passes[p];
+
+		if (pass->culled) {
+			continue;
+		}
+
+		cmd_barriers(ref, graph, cmd, &pass->barriers);
+
+		pass->record(ref, cmd, image, pass->user);
+	}
+
+	cmd_barriers(ref, graph, cmd, &graph->final_barriers);
+}
+
+void rg_report(const render_graph_t *graph)
+{
+	uint32_t culled = 0;
+	uint32_t barriers = array_size((array *) &graph->final_barriers);
+	uint32_t batches = barriers > 0;
+
+	for (uint32_t p = 0; p < graph->pass_count; p++) {
+		culled += graph->passes[p].culled;
+		barriers += array_size((array *) &graph->passes[p].barriers);
+		batches += array_size((array *) &graph->passes[p].barriers) > 0;
+	}
+
+	VkDeviceSize unaliased = 0;
+	VkDeviceSize aliased = 0;
+	VkDeviceSize lazy = 0;
+
+	for (uint32_t i = 0; i < graph->resource_count; i++) {
+		if (graph->resources[i].transient && graph->resources[i].first_pass >= 0) {
+			unaliased += graph->resources[i].requirements.size;
+		}
+	}
+
+	for (int b = 0; b < array_size((array *) &graph->blocks); b++) {
+		rg_block_t *block = &((rg_block_t *) array_data((array *) &graph->blocks))[b];
+
+		aliased += block->size;
+		lazy += block->lazy ? block->size : 0;
+	}
+
+	printf("Render graph: %u passes (%u culled), %u barriers in %u batches, transient memory %.1f MiB in %d blocks (%.1f MiB unaliased, %.1f MiB lazy)\n",
+		graph->pass_count, culled, barriers, batches, (double) aliased / (1024.0 * 1024.0), array_size((array *) &graph->blocks),
+		(double) unaliased / (1024.0 * 1024.0), (double) lazy / (1024.0 * 1024.0));
+}
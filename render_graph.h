@@ -0,0 +1,192 @@
+#ifndef _RENDER_GRAPH_H_
+#define _RENDER_GRAPH_H_
+
+#include "application.h"
+#include "barrier.h"
+
+#define RG_MAX_RESOURCES 32
+#define RG_MAX_PASSES 32
+#define RG_MAX_ACCESSES 8
+
+#define RG_NO_RESOURCE UINT32_MAX
+
+/**
+ *	Usage of transient images that never leave a render pass.
+ */
+#define RG_ATTACHMENT_USAGE (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT)
+
+typedef enum _rg_resource_type_t
+{
+	RG_IMAGE,
+	RG_BUFFER
+}
+rg_resource_type_t;
+
+/**
+ *	How a resource is used: pipeline stages, access and, for images, the
+ *	layout they must be in.
+ */
+typedef struct _rg_state_t
+{
+	VkPipelineStageFlags stages;
+	VkAccessFlags access;
+	VkImageLayout layout;
+}
+rg_state_t;
+
+/**
+ *	A resource of the frame. Imported ones are owned outside the graph and
+ *	may change per swapchain image (see `rg_set_image()`), their state is
+ *	`initial` when the frame starts and, when `has_final` is set, brought
+ *	to `final` when it ends. Transient images are created by
+ *	`rg_compile()` and only live within the frame, so images whose
+ *	lifetimes do not overlap share memory. Those used as attachments only
+ *	are never loaded or stored outside a render pass, they are `lazy`:
+ *	created as transient attachments in lazily allocated memory.
+ */
+typedef struct _rg_resource_t
+{
+	char name[32];
+	rg_resource_type_t type;
+	bool transient;
+
+	VkFormat format;
+	VkExtent2D extent;
+	VkImageUsageFlags usage;
+	VkImageAspectFlags aspect;
+
+	VkImage image;
+	VkImageView view;
+	VkBuffer buffer;
+
+	rg_state_t initial;
+	rg_state_t final;
+	bool has_final;
+
+	/**
+	 * Compiled: first and last pass using the resource, the memory block
+	 * of a transient image and the image that used the block before it.
+	 */
+
+	int32_t first_pass;
+	int32_t last_pass;
+	int32_t block;
+	uint32_t alias_prev;
+	bool lazy;
+	VkMemoryRequirements requirements;
+}
+rg_resource_t;
+
+typedef struct _rg_access_t
+{
+	uint32_t resource;
+	rg_state_t state;
+	bool write;
+}
+rg_access_t;
+
+/**
+ *	A barrier `rg_compile()` placed in front of a pass, from the state
+ *	the resource was left in to the one the pass needs.
+ */
+typedef struct _rg_barrier_t
+{
+	uint32_t resource;
+	rg_state_t src;
+	rg_state_t dst;
+}
+rg_barrier_t;
+
+typedef void (*rg_record_fn)(struct _application *ref, VkCommandBuffer cmd, uint32_t image, void *user);
+
+typedef struct _rg_pass_t
+{
+	char name[32];
+
+	rg_record_fn record;
+	void *user;
+
+	rg_access_t accesses[RG_MAX_ACCESSES];
+	uint32_t access_count;
+
+	/**
+	 * Kept even when nothing reads what it writes.
+	 */
+
+	bool side_effect;
+	bool culled;
+
+	array barriers;
+}
+rg_pass_t;
+
+typedef struct _rg_block_t
+{
+	VkDeviceMemory memory;
+	VkDeviceSize size;
+	uint32_t type_bits;
+	bool lazy;
+	int32_t last_pass;
+	uint32_t last_resource;
+}
+rg_block_t;
+
+/**
+ *	Frame render graph. Passes are added in submission order and declare
+ *	the resources they read and write, `rg_compile()` then culls the passes
+ *	that contribute to no output, places the pipeline barriers in between,
+ *	flushed as one batch per pass (see barrier.h), and creates and
+ *	aliases the transient images. `rg_execute()` records the compiled frame
+ *	into a command buffer.
+ */
+typedef struct _render_graph_t
+{
+	rg_resource_t resources[RG_MAX_RESOURCES];
+	uint32_t resource_count;
+
+	rg_pass_t passes[RG_MAX_PASSES];
+	uint32_t pass_count;
+
+	array blocks;
+
+	/**
+	 * Transitions of imported resources into their final state.
+	 */
+
+	array final_barriers;
+
+	barrier_batch_t batch;
+
+	bool compiled;
+}
+render_graph_t;
+
+void init_render_graph(render_graph_t *graph);
+
+void destroy_render_graph(struct _application *ref, render_graph_t *graph);
+
+uint32_t rg_import_image(render_graph_t *graph, const char *name, VkImageAspectFlags aspect, rg_state_t initial, const rg_state_t *final);
+
+uint32_t rg_import_buffer(render_graph_t *graph, const char *name, rg_state_t initial);
+
+uint32_t rg_create_image(render_graph_t *graph, const char *name, VkFormat format, VkExtent2D extent, VkImageUsageFlags usage, VkImageAspectFlags aspect);
+
+void rg_set_image(render_graph_t *graph, uint32_t resource, VkImage image, VkImageView view);
+
+void rg_set_buffer(render_graph_t *graph, uint32_t resource, VkBuffer buffer);
+
+VkImageView rg_image_view(const render_graph_t *graph, uint32_t resource);
+
+uint32_t rg_add_pass(render_graph_t *graph, const char *name, rg_record_fn record, void *user, bool side_effect);
+
+void rg_read(render_graph_t *graph, uint32_t pass, uint32_t resource, VkPipelineStageFlags stages, VkAccessFlags access, VkImageLayout layout);
+
+void rg_write(render_graph_t *graph, uint32_t pass, uint32_t resource, VkPipelineStageFlags stages, VkAccessFlags access, VkImageLayout layout);
+
+void rg_compile(struct _application *ref, render_graph_t *graph);
+
+void rg_execute(struct _application *ref, render_graph_t *graph, VkCommandBuffer cmd, uint32_t image);
+
+void rg_report(const render_graph_t *graph);
+
+#endif
@@ -0,0 +1,403 @@
+#include "residency.h"
+#include "mem_budget.h"
+#include "profiler.h"
+#include "barrier.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEXTURE(res, id) (&((resident_texture_t *) array_data(&(res)->textures))[id])
+
+#define TEXEL_SIZE 4
+
+typedef struct _lru_entry_t
+{
+	uint64_t last_used;
+	uint32_t id;
+}
+lru_entry_t;
+
+static int compare_lru(const void *a, const void *b)
+{
+	uint64_t x = ((const lru_entry_t *) a)->last_used;
+	uint64_t y = ((const lru_entry_t *) b)->last_used;
+
+	return (x > y) - (x < y);
+}
+
+static uint64_t residency_frame(struct _application *ref)
+{
+	return ref->mem_budget ? ref->mem_budget->frame : 0;
+}
+
+static uint32_t lod_extent(uint32_t extent, uint32_t lod)
+{
+	return (extent >> lod) > 0 ? extent >> lod : 1;
+}
+
+/**
+ *	Halve `src` with a 2x2 box filter, odd edges reuse their last texel.
+ */
+static void downsample(const uint8_t *src, uint32_t src_w, uint32_t src_h, uint8_t *dst, uint32_t dst_w, uint32_t dst_h)
+{
+	for (uint32_t y = 0; y < dst_h; y++) {
+		uint32_t y0 = y * 2 < src_h ? y * 2 : src_h - 1;
+		uint32_t y1 = y * 2 + 1 < src_h ? y * 2 + 1 : src_h - 1;
+
+		for (uint32_t x = 0; x < dst_w; x++) {
+			uint32_t x0 = x * 2 < src_w ? x * 2 : src_w - 1;
+			uint32_t x1 = x * 2 + 1 < src_w ? x * 2 + 1 : src_w - 1;
+
+			for (uint32_t c = 0; c < TEXEL_SIZE; c++) {
+				uint32_t sum = src[(y0 * src_w + x0) * TEXEL_SIZE + c] + src[(y0 * src_w + x1) * TEXEL_SIZE + c]
+					+ src[(y1 * src_w + x0) * TEXEL_SIZE + c] + src[(y1 * src_w + x1) * TEXEL_SIZE + c];
+
+				dst[(y * dst_w + x) * TEXEL_SIZE + c] = (uint8_t) ((sum + 2) / 4);
+			}
+		}
+	}
+}
+
+/**
+ *	Build the texture's image at its current `lod` from the host copy.
+ */
+static void upload_texture(struct _application *ref, resident_texture_t *tex)
+{
+	PROFILE_ZONE("residency_upload");
+
+	uint32_t w = tex->width;
+	uint32_t h = tex->height;
+	uint8_t *pixels = tex->pixels;
+
+	for (uint32_t i = 0; i < tex->lod; i++) {
+		uint32_t next_w = lod_extent(w, 1);
+		uint32_t next_h = lod_extent(h, 1);
+
+		uint8_t *next = malloc((size_t) next_w * next_h * TEXEL_SIZE);
+		downsample(pixels, w, h, next, next_w, next_h);
+
+		if (pixels != tex->pixels) {
+			free(pixels);
+		}
+
+		pixels = next;
+		w = next_w;
+		h = next_h;
+	}
+
+	VkDeviceSize img_size = (VkDeviceSize) w * h * TEXEL_SIZE;
+
+	VkDeviceMemory staging_buffer_memory;
+	VkBuffer staging_buffer;
+
+	create_buffer(ref, img_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &staging_buffer, &staging_buffer_memory);
+
+	void *data;
+
+	vkMapMemory(ref->device, staging_buffer_memory, 0, img_size, 0, &data);
+	memcpy(data, pixels, (size_t) img_size);
+	vkUnmapMemory(ref->device, staging_buffer_memory);
+
+	if (pixels != tex->pixels) {
+		free(pixels);
+	}
+
+	create_image(ref, w, h, tex->format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &tex->image, &tex->memory);
+
+	/**
+	 * Both transitions and the copy go in one submission.
+	 */
+
+	VkCommandBuffer command_buffer = begin_single_time_commands(ref);
+
+	barrier_batch_t batch;
+	init_barrier_batch(&batch);
+
+	barrier_image_layout(&batch, tex->image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	barrier_flush(ref, &batch, command_buffer);
+
+	cmd_copy_buffer_to_image(command_buffer, staging_buffer, tex->image, w, h);
+
+	barrier_image_layout(&batch, tex->image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	barrier_flush(ref, &batch, command_buffer);
+
+	destroy_barrier_batch(&batch);
+
+	end_single_time_commands(ref, command_buffer);
+
+	vkDestroyBuffer(ref->device, staging_buffer, HOST_ALLOC(BUFFER));
+	mem_budget_free(ref, staging_buffer_memory);
+
+	create_texture_image_view(ref, tex->image, tex->format, &tex->view);
+
+	VkMemoryRequirements mem_req;
+	vkGetImageMemoryRequirements(ref->device, tex->image, &mem_req);
+
+	tex->size = mem_req.size;
+	tex->heap = mem_budget_heap(ref, tex->memory);
+	tex->resident = true;
+}
+
+/**
+ *	Destroy the texture's image, keeping the host copy. Callers make sure the
+ *	GPU is done with it.
+ */
+static void unload_texture(struct _application *ref, resident_texture_t *tex)
+{
+	if (!tex->resident) {
+		return;
+	}
+
+	vkDestroyImageView(ref->device, tex->view, HOST_ALLOC(IMAGE_VIEW));
+	vkDestroyImage(ref->device, tex->image, HOST_ALLOC(IMAGE));
+	mem_budget_free(ref, tex->memory);
+
+	tex->image = VK_NULL_HANDLE;
+	tex->memory = VK_NULL_HANDLE;
+	tex->view = VK_NULL_HANDLE;
+	tex->size = 0;
+	tex->resident = false;
+}
+
+static void notify_texture(struct _application *ref, uint32_t id)
+{
+	resident_texture_t *tex = TEXTURE(ref->residency, id);
+
+	if (tex->changed) {
+		tex->changed(ref, id, tex->user);
+	}
+}
+
+void init_residency(residency_t *res)
+{
+	memset(res, 0, sizeof(residency_t));
+	array_init(&res->textures, sizeof(resident_texture_t));
+}
+
+void destroy_residency(struct _application *ref, residency_t *res)
+{
+	for (int i = 0; i < array_size(&res->textures); i++) {
+		residency_release_texture(ref, (uint32_t) i);
+	}
+
+	array_free(&res->textures);
+}
+
+/**
+ *	Copy `pixels` and upload them at full resolution. The returned id stays
+ *	valid until `residency_release_texture()`, the owner is told about every
+ *	change of the image through `changed`, starting with this upload.
+ */
+uint32_t residency_register_texture(struct _application *ref, const uint8_t *pixels, uint32_t width, uint32_t height, VkFormat format,
+	residency_changed_fn changed, void *user)
+{
+	residency_t *res = ref->residency;
+
+	resident_texture_t tex = {};
+	tex.format = format;
+	tex.width = width;
+	tex.height = height;
+	tex.alive = true;
+	tex.heap = RESIDENCY_NO_HEAP;
+	tex.last_used = residency_frame(ref);
+	tex.changed = changed;
+	tex.user = user;
+
+	tex.pixels = malloc((size_t) width * height * TEXEL_SIZE);
+	if (!tex.pixels) {
+		fprintf(stderr, "ERR: failed to allocate texture host copy\n // Assertion: `malloc() != NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	memcpy(tex.pixels, pixels, (size_t) width * height * TEXEL_SIZE);
+
+	uint32_t id = (uint32_t) array_size(&res->textures);
+	array_append(&res->textures, &tex);
+
+	upload_texture(ref, TEXTURE(res, id));
+	notify_texture(ref, id);
+
+	return id;
+}
+
+void residency_release_texture(struct _application *ref, uint32_t id)
+{
+	resident_texture_t *tex = TEXTURE(ref->residency, id);
+
+	if (!tex->alive) {
+		return;
+	}
+
+	unload_texture(ref, tex);
+
+	free(tex->pixels);
+	tex->pixels = NULL;
+	tex->alive = false;
+}
+
+resident_texture_t *residency_get(struct _application *ref, uint32_t id)
+{
+	return TEXTURE(ref->residency, id);
+}
+
+/**
+ *	Mark the texture as used this frame. An evicted or degraded texture that
+ *	is touched gets restored by `residency_update()` once it fits.
+ */
+void residency_touch(struct _application *ref, uint32_t id)
+{
+	TEXTURE(ref->residency, id)->last_used = residency_frame(ref);
+}
+
+/**
+ *	Keep the texture resident at full resolution, for fallbacks that must
+ *	stay bindable while others are evicted.
+ */
+void residency_pin(struct _application *ref, uint32_t id)
+{
+	TEXTURE(ref->residency, id)->pinned = true;
+}
+
+/**
+ *	Free at least `bytes` of `heap`, least recently used textures first.
+ *	Textures untouched for `RESIDENCY_EVICT_AGE` frames are evicted, recently
+ *	used ones lose their top mip instead, one level per pass so the cost is
+ *	spread over all of them. Waits for the device once, before touching the
+ *	first image. Returns the amount freed, which may fall short.
+ */
+VkDeviceSize residency_evict(struct _application *ref, uint32_t heap, VkDeviceSize bytes)
+{
+	residency_t *res = ref->residency;
+
+	if (res->evicting) {
+		return 0;
+	}
+
+	PROFILE_ZONE("residency_evict");
+
+	res->evicting = true;
+
+	uint64_t frame = residency_frame(ref);
+
+	size_t count = 0;
+	lru_entry_t entries[array_size(&res->textures) + 1];
+
+	for (int i = 0; i < array_size(&res->textures); i++) {
+		resident_texture_t *tex = TEXTURE(res, i);
+
+		if (tex->alive && tex->resident && !tex->pinned && tex->heap == heap) {
+			entries[count].last_used = tex->last_used;
+			entries[count].id = (uint32_t) i;
+			count++;
+		}
+	}
+
+	qsort(entries, count, sizeof(lru_entry_t), compare_lru);
+
+	VkDeviceSize freed = 0;
+	bool idle = false;
+
+	for (uint32_t pass = 0; pass <= RESIDENCY_MAX_LOD && freed < bytes; pass++) {
+		bool progress = false;
+
+		for (size_t i = 0; i < count && freed < bytes; i++) {
+			uint32_t id = entries[i].id;
+			resident_texture_t *tex = TEXTURE(res, id);
+
+			bool evict = frame - tex->last_used >= RESIDENCY_EVICT_AGE;
+			bool degrade = tex->lod < RESIDENCY_MAX_LOD && (lod_extent(tex->width, tex->lod) > 1 || lod_extent(tex->height, tex->lod) > 1);
+
+			if (!tex->resident || (!evict && !degrade)) {
+				continue;
+			}
+
+			if (!idle) {
+				vkDeviceWaitIdle(ref->device);
+				idle = true;
+			}
+
+			VkDeviceSize old_size = tex->size;
+			unload_texture(ref, tex);
+
+			if (evict) {
+				tex->evicted_at = frame;
+				res->evictions++;
+			}
+			else {
+				tex->lod++;
+				upload_texture(ref, tex);
+				res->degradations++;
+			}
+
+			freed += old_size > tex->size ? old_size - tex->size : 0;
+			progress = true;
+
+			notify_texture(ref, id);
+		}
+
+		if (!progress) {
+			break;
+		}
+	}
+
+	res->evicting = false;
+
+	if (freed > 0) {
+		fprintf(stderr, "WARN: memory budget exceeded on heap %u, freed %.1f MiB of textures\n", heap, (double) freed / (1024.0 * 1024.0));
+	}
+
+	return freed;
+}
+
+/**
+ *	Restore one wanted texture to full resolution if it fits under the low
+ *	watermark. Called once per frame, restoring waits for the device so it is
+ *	spread over frames.
+ */
+void residency_update(struct _application *ref)
+{
+	residency_t *res = ref->residency;
+	mem_budget_t *budget = ref->mem_budget;
+
+	uint64_t frame = budget->frame;
+
+	for (int i = 0; i < array_size(&res->textures); i++) {
+		resident_texture_t *tex = TEXTURE(res, i);
+
+		if (!tex->alive || (tex->resident && tex->lod == 0)) {
+			continue;
+		}
+
+		bool wanted = tex->resident ? frame - tex->last_used < RESIDENCY_EVICT_AGE : tex->last_used > tex->evicted_at;
+
+		if (!wanted || tex->heap == RESIDENCY_NO_HEAP) {
+			continue;
+		}
+
+		VkDeviceSize full_size = (VkDeviceSize) tex->width * tex->height * TEXEL_SIZE;
+		VkDeviceSize low = (VkDeviceSize) (budget->heaps[tex->heap].budget * MEM_BUDGET_LOW_WATERMARK);
+
+		if (mem_budget_usage(budget, tex->heap) - tex->size + full_size > low) {
+			continue;
+		}
+
+		PROFILE_ZONE("residency_restore");
+
+		vkDeviceWaitIdle(ref->device);
+
+		unload_texture(ref, tex);
+		tex->lod = 0;
+		upload_texture(ref, tex);
+
+		res->restores++;
+		notify_texture(ref, (uint32_t) i);
+
+		return;
+	}
+}
+
+void residency_report(const residency_t *res)
+{
+	printf("Texture residency: %u evictions, %u mip drops, %u restores\n", res->evictions, res->degradations, res->restores);
+}
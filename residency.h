@@ -0,0 +1,109 @@
+#ifndef _RESIDENCY_H_
+#define _RESIDENCY_H_
+
+#include "application.h"
+
+/**
+ *	Most mips a texture can lose before it has to be evicted outright, 4
+ *	leaves 1/256th of its memory.
+ */
+#define RESIDENCY_MAX_LOD 4
+
+/**
+ *	Frames without `residency_touch()` after which a texture is evicted
+ *	instead of losing mips.
+ */
+#define RESIDENCY_EVICT_AGE 120
+
+#define RESIDENCY_NO_HEAP UINT32_MAX
+
+struct _resident_texture_t;
+
+/**
+ *	Called whenever a texture's image, memory or view changes, so the owner
+ *	can update the descriptors pointing at it. `view` is VK_NULL_HANDLE while
+ *	the texture is evicted.
+ */
+typedef void (*residency_changed_fn)(struct _application *ref, uint32_t id, void *user);
+
+/**
+ *	Sampled 2D texture with 4 bytes per texel. The full resolution texels stay
+ *	in host memory so the image can be rebuilt at any level of detail.
+ */
+typedef struct _resident_texture_t
+{
+	VkImage image;
+	VkDeviceMemory memory;
+	VkImageView view;
+
+	VkFormat format;
+
+	uint32_t width;
+	uint32_t height;
+	uint8_t *pixels;
+
+	/**
+	 * Mips dropped from the top, the image is `width >> lod` wide.
+	 */
+
+	uint32_t lod;
+
+	bool alive;
+	bool resident;
+
+	/**
+	 * Set by `residency_pin()`, the texture is never evicted nor degraded.
+	 */
+
+	bool pinned;
+
+	VkDeviceSize size;
+	uint32_t heap;
+
+	uint64_t last_used;
+	uint64_t evicted_at;
+
+	residency_changed_fn changed;
+	void *user;
+}
+resident_texture_t;
+
+typedef struct _residency_t
+{
+	array textures;
+
+	/**
+	 * Set while evicting, allocations made on the way (eg. a texture rebuilt
+	 * at a lower level of detail) must not evict again.
+	 */
+
+	bool evicting;
+
+	uint32_t evictions;
+	uint32_t degradations;
+	uint32_t restores;
+}
+residency_t;
+
+void init_residency(residency_t *res);
+
+void destroy_residency(struct _application *ref, residency_t *res);
+
+uint32_t residency_register_texture(struct _application *ref, const uint8_t *pixels, uint32_t width, uint32_t height, VkFormat format,
+	residency_changed_fn changed, void *user);
+
+void residency_release_texture(struct _application *ref, uint32_t id);
+
+resident_texture_t *residency_get(struct _application *ref, uint32_t id);
+
+void residency_touch(struct _application *ref, uint32_t id);
+
+void residency_pin(struct _application *ref, uint32_t id);
+
+VkDeviceSize residency_evict(struct _application *ref, uint32_t heap, VkDeviceSize bytes);
+
+void residency_update(struct _application *ref);
+
+void residency_report(const residency_t *res);
+
+#endif
@@ -0,0 +1,345 @@
+#include "resources.h"
+#include "mem_budget.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GROW(field, capacity) grow_array((void **) &(field), sizeof(*(field)), (capacity))
+
+static void grow_array(void **data, size_t member_size, uint32_t capacity)
+{
+	void *grown = realloc(*data, member_size * capacity);
+
+	if (grown == NULL) {
+		fprintf(stderr, "ERR: failed to grow resource pool\n // Assertion: `realloc != NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	*data = grown;
+}
+
+static void grow_buffers(buffer_pool_t *pool)
+{
+	uint32_t capacity = handle_pool_capacity(&pool->handles);
+
+	GROW(pool->buffers, capacity);
+	GROW(pool->memory, capacity);
+	GROW(pool->sizes, capacity);
+}
+
+static void grow_images(image_pool_t *pool)
+{
+	uint32_t capacity = handle_pool_capacity(&pool->handles);
+
+	GROW(pool->images, capacity);
+	GROW(pool->memory, capacity);
+	GROW(pool->views, capacity);
+	GROW(pool->formats, capacity);
+	GROW(pool->extents, capacity);
+}
+
+static void grow_meshes(mesh_pool_t *pool)
+{
+	uint32_t capacity = handle_pool_capacity(&pool->handles);
+
+	GROW(pool->streams, capacity);
+	GROW(pool->index_counts, capacity);
+	GROW(pool->index_types, capacity);
+	GROW(pool->materials, capacity);
+}
+
+static void grow_materials(material_pool_t *pool)
+{
+	uint32_t capacity = handle_pool_capacity(&pool->handles);
+
+	GROW(pool->texture_ids, capacity);
+}
+
+/**
+ *	Allocate a slot, calling `grow` when the pool outgrew its arrays.
+ */
+#define ALLOC_SLOT(pool, grow) ({ \
+	uint32_t _capacity = handle_pool_capacity(&(pool)->handles); \
+	handle_t _handle = handle_pool_alloc(&(pool)->handles); \
+	if (handle_pool_capacity(&(pool)->handles) != _capacity) { \
+		grow(pool); \
+	} \
+	_handle; \
+})
+
+/**
+ *	Slot index of `handle`, or -1 (counted) when it is stale.
+ */
+static int64_t lookup(resources_t *res, const handle_pool *pool, handle_t handle)
+{
+	if (!handle_pool_valid(pool, handle)) {
+		if (handle != HANDLE_NULL) {
+			res->stale_lookups++;
+		}
+
+		return -1;
+	}
+
+	return handle_index(handle);
+}
+
+void init_resources(resources_t *res)
+{
+	memset(res, 0, sizeof(resources_t));
+
+	handle_pool_init(&res->buffers.handles);
+	handle_pool_init(&res->images.handles);
+	handle_pool_init(&res->meshes.handles);
+	handle_pool_init(&res->materials.handles);
+
+	grow_buffers(&res->buffers);
+	grow_images(&res->images);
+	grow_meshes(&res->meshes);
+	grow_materials(&res->materials);
+}
+
+/**
+ *	Destroy what is still alive and free the pools. The device must be
+ *	idle.
+ */
+void destroy_resources(struct _application *ref, resources_t *res)
+{
+	uint32_t leaked = handle_pool_count(&res->meshes.handles) + handle_pool_count(&res->materials.handles);
+	uint32_t it = 0;
+	handle_t handle;
+
+	while (handle_pool_next(&res->meshes.handles, &it, &handle)) {
+		resource_destroy_mesh(ref, res, handle);
+	}
+
+	it = 0;
+
+	while (handle_pool_next(&res->materials.handles, &it, &handle)) {
+		resource_destroy_material(res, handle);
+	}
+
+	leaked += handle_pool_count(&res->buffers.handles) + handle_pool_count(&res->images.handles);
+	it = 0;
+
+	while (handle_pool_next(&res->buffers.handles, &it, &handle)) {
+		resource_destroy_buffer(ref, res, handle);
+	}
+
+	it = 0;
+
+	while (handle_pool_next(&res->images.handles, &it, &handle)) {
+		resource_destroy_image(ref, res, handle);
+	}
+
+	if (leaked > 0) {
+		fprintf(stderr, "WARN: %u resources still alive at shutdown\n", leaked);
+	}
+
+	free(res->buffers.buffers);
+	free(res->buffers.memory);
+	free(res->buffers.sizes);
+
+	free(res->images.images);
+	free(res->images.memory);
+	free(res->images.views);
+	free(res->images.formats);
+	free(res->images.extents);
+
+	free(res->meshes.streams);
+	free(res->meshes.index_counts);
+	free(res->meshes.index_types);
+	free(res->meshes.materials);
+
+	free(res->materials.texture_ids);
+
+	handle_pool_free(&res->buffers.handles);
+	handle_pool_free(&res->images.handles);
+	handle_pool_free(&res->meshes.handles);
+	handle_pool_free(&res->materials.handles);
+}
+
+handle_t resource_create_buffer(struct _application *ref, resources_t *res, VkDeviceSize size, VkBufferUsageFlags usage,
+	VkMemoryPropertyFlags properties)
+{
+	buffer_pool_t *pool = &res->buffers;
+	handle_t handle = ALLOC_SLOT(pool, grow_buffers);
+	uint32_t i = handle_index(handle);
+
+	create_buffer(ref, size, usage, properties, &pool->buffers[i], &pool->memory[i]);
+	pool->sizes[i] = size;
+
+	return handle;
+}
+
+void resource_destroy_buffer(struct _application *ref, resources_t *res, handle_t buffer)
+{
+	buffer_pool_t *pool = &res->buffers;
+	int64_t i = lookup(res, &pool->handles, buffer);
+
+	if (i < 0) {
+		return;
+	}
+
+	vkDestroyBuffer(ref->device, pool->buffers[i], HOST_ALLOC(BUFFER));
+	mem_budget_free(ref, pool->memory[i]);
+
+	pool->buffers[i] = VK_NULL_HANDLE;
+	pool->memory[i] = VK_NULL_HANDLE;
+
+	handle_pool_release(&pool->handles, buffer);
+}
+
+VkBuffer resource_buffer(resources_t *res, handle_t buffer)
+{
+	int64_t i = lookup(res, &res->buffers.handles, buffer);
+
+	return i < 0 ? VK_NULL_HANDLE : res->buffers.buffers[i];
+}
+
+VkDeviceMemory resource_buffer_memory(resources_t *res, handle_t buffer)
+{
+	int64_t i = lookup(res, &res->buffers.handles, buffer);
+
+	return i < 0 ? VK_NULL_HANDLE : res->buffers.memory[i];
+}
+
+handle_t resource_create_image(struct _application *ref, resources_t *res, uint32_t width, uint32_t height, VkFormat format,
+	VkImageUsageFlags usage, VkMemoryPropertyFlags properties)
+{
+	image_pool_t *pool = &res->images;
+	handle_t handle = ALLOC_SLOT(pool, grow_images);
+	uint32_t i = handle_index(handle);
+
+	create_image(ref, width, height, format, VK_IMAGE_TILING_OPTIMAL, usage, properties, &pool->images[i], &pool->memory[i]);
+
+	pool->views[i] = VK_NULL_HANDLE;
+	pool->formats[i] = format;
+	pool->extents[i].width = width;
+	pool->extents[i].height = height;
+
+	if (usage & VK_IMAGE_USAGE_SAMPLED_BIT) {
+		create_texture_image_view(ref, pool->images[i], format, &pool->views[i]);
+	}
+
+	return handle;
+}
+
+void resource_destroy_image(struct _application *ref, resources_t *res, handle_t image)
+{
+	image_pool_t *pool = &res->images;
+	int64_t i = lookup(res, &pool->handles, image);
+
+	if (i < 0) {
+		return;
+	}
+
+	if (pool->views[i] != VK_NULL_HANDLE) {
+		vkDestroyImageView(ref->device, pool->views[i], HOST_ALLOC(IMAGE_VIEW));
+	}
+
+	vkDestroyImage(ref->device, pool->images[i], HOST_ALLOC(IMAGE));
+	mem_budget_free(ref, pool->memory[i]);
+
+	pool->images[i] = VK_NULL_HANDLE;
+	pool->memory[i] = VK_NULL_HANDLE;
+	pool->views[i] = VK_NULL_HANDLE;
+
+	handle_pool_release(&pool->handles, image);
+}
+
+VkImage resource_image(resources_t *res, handle_t image)
+{
+	int64_t i = lookup(res, &res->images.handles, image);
+
+	return i < 0 ? VK_NULL_HANDLE : res->images.images[i];
+}
+
+VkImageView resource_image_view(resources_t *res, handle_t image)
+{
+	int64_t i = lookup(res, &res->images.handles, image);
+
+	return i < 0 ? VK_NULL_HANDLE : res->images.views[i];
+}
+
+/**
+ *	The mesh takes ownership of the stream buffers, `resource_destroy_mesh()`
+ *	destroys them.
+ */
+handle_t resource_create_mesh(resources_t *res, const handle_t streams[MESH_STREAM_COUNT], uint32_t index_count, VkIndexType index_type,
+	handle_t material)
+{
+	mesh_pool_t *pool = &res->meshes;
+	handle_t handle = ALLOC_SLOT(pool, grow_meshes);
+	uint32_t i = handle_index(handle);
+
+	memcpy(pool->streams[i], streams, sizeof(handle_t) * MESH_STREAM_COUNT);
+	pool->index_counts[i] = index_count;
+	pool->index_types[i] = index_type;
+	pool->materials[i] = material;
+
+	return handle;
+}
+
+void resource_destroy_mesh(struct _application *ref, resources_t *res, handle_t mesh)
+{
+	mesh_pool_t *pool = &res->meshes;
+	int64_t i = lookup(res, &pool->handles, mesh);
+
+	if (i < 0) {
+		return;
+	}
+
+	for (int stream = 0; stream < MESH_STREAM_COUNT; stream++) {
+		resource_destroy_buffer(ref, res, pool->streams[i][stream]);
+		pool->streams[i][stream] = HANDLE_NULL;
+	}
+
+	handle_pool_release(&pool->handles, mesh);
+}
+
+/**
+ *	VK_NULL_HANDLE when the mesh is stale or lacks the stream.
+ */
+VkBuffer resource_mesh_buffer(resources_t *res, handle_t mesh, mesh_stream_t stream)
+{
+	int64_t i = lookup(res, &res->meshes.handles, mesh);
+
+	return i < 0 ? VK_NULL_HANDLE : resource_buffer(res, res->meshes.streams[i][stream]);
+}
+
+handle_t resource_create_material(resources_t *res, uint32_t texture_id)
+{
+	material_pool_t *pool = &res->materials;
+	handle_t handle = ALLOC_SLOT(pool, grow_materials);
+
+	pool->texture_ids[handle_index(handle)] = texture_id;
+
+	return handle;
+}
+
+void resource_destroy_material(resources_t *res, handle_t material)
+{
+	if (lookup(res, &res->materials.handles, material) < 0) {
+		return;
+	}
+
+	handle_pool_release(&res->materials.handles, material);
+}
+
+/**
+ *	UINT32_MAX when the material is stale.
+ */
+uint32_t resource_material_texture(resources_t *res, handle_t material)
+{
+	int64_t i = lookup(res, &res->materials.handles, material);
+
+	return i < 0 ? UINT32_MAX : res->materials.texture_ids[i];
+}
+
+void resources_report(const resources_t *res)
+{
+	printf("Resources: %u buffers, %u images, %u meshes, %u materials alive, %u stale handle lookups\n",
+		handle_pool_count(&res->buffers.handles), handle_pool_count(&res->images.handles), handle_pool_count(&res->meshes.handles),
+		handle_pool_count(&res->materials.handles), res->stale_lookups);
+}
@@ -0,0 +1,128 @@
+#ifndef _RESOURCES_H_
+#define _RESOURCES_H_
+
+#include "application.h"
+#include "lib/handle_pool.h"
+
+typedef enum _mesh_stream_t
+{
+	MESH_STREAM_VERTEX,
+	MESH_STREAM_POSITION,
+	MESH_STREAM_INDEX,
+	MESH_STREAM_COUNT
+}
+mesh_stream_t;
+
+/**
+ *	Each pool keeps one array per field, indexed by `handle_index()` and
+ *	grown with its `handle_pool`: recording walks only the arrays it reads.
+ */
+
+typedef struct _buffer_pool_t
+{
+	handle_pool handles;
+
+	VkBuffer *buffers;
+	VkDeviceMemory *memory;
+	VkDeviceSize *sizes;
+}
+buffer_pool_t;
+
+/**
+ *	Images with `VK_IMAGE_USAGE_SAMPLED_BIT` get a color view, others leave
+ *	`views` at VK_NULL_HANDLE.
+ */
+typedef struct _image_pool_t
+{
+	handle_pool handles;
+
+	VkImage *images;
+	VkDeviceMemory *memory;
+	VkImageView *views;
+	VkFormat *formats;
+	VkExtent2D *extents;
+}
+image_pool_t;
+
+/**
+ *	Buffer handles of a mesh's streams, HANDLE_NULL for a stream it lacks
+ *	(eg. positions without the depth pre-pass). The mesh owns them.
+ */
+typedef struct _mesh_pool_t
+{
+	handle_pool handles;
+
+	handle_t (*streams)[MESH_STREAM_COUNT];
+	uint32_t *index_counts;
+	VkIndexType *index_types;
+	handle_t *materials;
+}
+mesh_pool_t;
+
+/**
+ *	`texture_ids` are residency.h textures, the pool does not own them.
+ */
+typedef struct _material_pool_t
+{
+	handle_pool handles;
+
+	uint32_t *texture_ids;
+}
+material_pool_t;
+
+/**
+ *	GPU resources behind generational handles, see lib/handle_pool.h. A
+ *	lookup through a destroyed resource's handle returns VK_NULL_HANDLE
+ *	(HANDLE_NULL for handles) and is counted in `stale_lookups`.
+ *	Destruction is immediate, the caller makes sure the GPU is done with
+ *	the resource.
+ */
+typedef struct _resources_t
+{
+	buffer_pool_t buffers;
+	image_pool_t images;
+	mesh_pool_t meshes;
+	material_pool_t materials;
+
+	uint32_t stale_lookups;
+}
+resources_t;
+
+void init_resources(resources_t *res);
+
+void destroy_resources(struct _application *ref, resources_t *res);
+
+handle_t resource_create_buffer(struct _application *ref, resources_t *res, VkDeviceSize size, VkBufferUsageFlags usage,
+	VkMemoryPropertyFlags properties);
+
+void resource_destroy_buffer(struct _application *ref, resources_t *res, handle_t buffer);
+
+VkBuffer resource_buffer(resources_t *res, handle_t buffer);
+
+VkDeviceMemory resource_buffer_memory(resources_t *res, handle_t buffer);
+
+handle_t resource_create_image(struct _application *ref, resources_t *res, uint32_t width, uint32_t height, VkFormat format,
+	VkImageUsageFlags usage, VkMemoryPropertyFlags properties);
+
+void resource_destroy_image(struct _application *ref, resources_t *res, handle_t image);
+
+VkImage resource_image(resources_t *res, handle_t image);
+
+VkImageView resource_image_view(resources_t *res, handle_t image);
+
+handle_t resource_create_mesh(resources_t *res, const handle_t streams[MESH_STREAM_COUNT], uint32_t index_count, VkIndexType index_type,
+	handle_t material);
+
+void resource_destroy_mesh(struct _application *ref, resources_t *res, handle_t mesh);
+
+VkBuffer resource_mesh_buffer(resources_t *res, handle_t mesh, mesh_stream_t stream);
+
+handle_t resource_create_material(resources_t *res, uint32_t texture_id);
+
+void resource_destroy_material(resources_t *res, handle_t material);
+
+uint32_t resource_material_texture(resources_t *res, handle_t material);
+
+void resources_report(const resources_t *res);
+
+#endif
@@ -0,0 +1,305 @@
+#include "shader_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_SHADERC
+#include <shaderc/shaderc.h>
+#endif
+
+/**
+ *	Whole file into a malloc'd buffer with a terminating NUL past `size`,
+ *	NULL when it can not be read.
+ */
+static void *read_file(const char *path, size_t *size)
+{
+	FILE *f_in = fopen(path, "rb");
+
+	if (f_in == NULL) {
+		return NULL;
+	}
+
+	fseek(f_in, 0, SEEK_END);
+	*size = (size_t) ftell(f_in);
+	fseek(f_in, 0, SEEK_SET);
+
+	void *data = malloc(*size + 1);
+
+	if (data == NULL || fread(data, 1, *size, f_in) != *size) {
+		free(data);
+		fclose(f_in);
+
+		return NULL;
+	}
+
+	fclose(f_in);
+
+	((char *) data)[*size] = '\0';
+
+	return data;
+}
+
+static bool is_spirv(const char *path)
+{
+	size_t len = strlen(path);
+
+	return len > 4 && strcmp(path + len - 4, ".spv") == 0;
+}
+
+#ifdef HAVE_SHADERC
+/**
+ *	Compile GLSL to SPIR-V, the stage comes from the file extension.
+ *	Sources using subgroup operations target Vulkan 1.1, as compile.sh
+ *	does for them. NULL, with the compiler output printed, on failure.
+ */
+static void *compile_glsl(const char *path, const char *source, size_t source_size, size_t *size)
+{
+	const char *ext = strrchr(path, '.');
+
+	shaderc_shader_kind kind = shaderc_glsl_infer_from_source;
+
+	if (ext && strcmp(ext, ".vert") == 0) {
+		kind = shaderc_vertex_shader;
+	}
+	else if (ext && strcmp(ext, ".frag") == 0) {
+		kind = shaderc_fragment_shader;
+	}
+	else if (ext && strcmp(ext, ".comp") == 0) {
+		kind = shaderc_compute_shader;
+	}
+
+	shaderc_compiler_t compiler = shaderc_compiler_initialize();
+	shaderc_compile_options_t options = shaderc_compile_options_initialize();
+
+	if (strstr(source, "GL_KHR_shader_subgroup")) {
+		shaderc_compile_options_set_target_env(options, shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_1);
+	}
+
+	shaderc_compilation_result_t result = shaderc_compile_into_spv(compiler, source, source_size, kind, path, "main", options);
+
+	void *code = NULL;
+
+	if (shaderc_result_get_compilation_status(result) == shaderc_compilation_status_success) {
+		*size = shaderc_result_get_length(result);
+		code = malloc(*size);
+		memcpy(code, shaderc_result_get_bytes(result), *size);
+	}
+	else {
+		fprintf(stderr, "%s", shaderc_result_get_error_message(result));
+	}
+
+	shaderc_result_release(result);
+	shaderc_compile_options_release(options);
+	shaderc_compiler_release(compiler);
+
+	return code;
+}
+#endif
+
+/**
+ *	SPIR-V of a GLSL source hashing to `hash`: from the disk cache when the
+ *	same content was compiled before, compiled and stored otherwise.
+ */
+static void *load_glsl(shader_cache_t *cache, const char *path, const char *source, size_t source_size, uint64_t hash, size_t *size)
+{
+#ifdef HAVE_SHADERC
+	char cached[64];
+	snprintf(cached, sizeof(cached), "%s/%016llx.spv", SHADER_CACHE_DIR, (unsigned long long) hash);
+
+	void *code = read_file(cached, size);
+
+	if (code) {
+		cache->disk_hits++;
+		return code;
+	}
+
+	code = compile_glsl(path, source, source_size, size);
+
+	if (code == NULL) {
+		return NULL;
+	}
+
+	cache->compiles++;
+
+	mkdir(SHADER_CACHE_DIR, 0755);
+
+	FILE *f_out = fopen(cached, "wb");
+
+	if (f_out == NULL || fwrite(code, 1, *size, f_out) != *size) {
+		fprintf(stderr, "WARN: failed to write `%s`, shader will be compiled again next run\n", cached);
+	}
+
+	if (f_out) {
+		fclose(f_out);
+	}
+
+	return code;
+#else
+	fprintf(stderr, "ERR: `%s` is GLSL but built without libshaderc\n // Assertion: `HAVE_SHADERC`\n", path);
+	exit(EXIT_FAILURE);
+#endif
+}
+
+void init_shader_cache(shader_cache_t *cache)
+{
+	memset(cache, 0, sizeof(shader_cache_t));
+
+	array_init(&cache->entries, sizeof(shader_entry_t));
+	array_init(&cache->retired, sizeof(VkShaderModule));
+	hashmap_init(&cache->index, sizeof(((shader_entry_t *) 0)->path), sizeof(uint32_t));
+
+	pthread_mutex_init(&cache->lock, NULL);
+}
+
+void destroy_shader_cache(struct _application *ref, shader_cache_t *cache)
+{
+	for (int i = 0; i < array_size(&cache->entries); i++) {
+		vkDestroyShaderModule(ref->device, ((shader_entry_t *) array_data(&cache->entries))[i].module, HOST_ALLOC(SHADER));
+	}
+
+	for (int i = 0; i < array_size(&cache->retired); i++) {
+		vkDestroyShaderModule(ref->device, ((VkShaderModule *) array_data(&cache->retired))[i], HOST_ALLOC(SHADER));
+	}
+
+	array_free(&cache->entries);
+	array_free(&cache->retired);
+	hashmap_free(&cache->index);
+
+	pthread_mutex_destroy(&cache->lock);
+}
+
+/**
+ *	Module for the SPIR-V or GLSL file at `path`, owned by the cache. Safe
+ *	to call from any thread.
+ */
+VkShaderModule shader_cache_get(struct _application *ref, shader_cache_t *cache, const char *path)
+{
+	pthread_mutex_lock(&cache->lock);
+
+	struct stat st;
+
+	if (stat(path, &st) != 0) {
+		fprintf(stderr, "ERR: failed to read shader file `%s`, run compile.sh\n // Assertion: `stat == 0`\n", path);
+		exit(EXIT_FAILURE);
+	}
+
+	char key[sizeof(((shader_entry_t *) 0)->path)] = {};
+	snprintf(key, sizeof(key), "%s", path);
+
+	uint32_t *found = hashmap_get(&cache->index, key);
+
+	shader_entry_t *entry = found ? &((shader_entry_t *) array_data(&cache->entries))[*found] : NULL;
+
+	if (entry && entry->mtime == st.st_mtime && entry->size == st.st_size) {
+		cache->hits++;
+		pthread_mutex_unlock(&cache->lock);
+
+		return entry->module;
+	}
+
+	size_t size;
+	void *content = read_file(path, &size);
+
+	if (content == NULL) {
+		fprintf(stderr, "ERR: failed to read shader file `%s`\n // Assertion: `read_file != NULL`\n", path);
+		exit(EXIT_FAILURE);
+	}
+
+	/**
+	 * The extension picks the stage GLSL compiles to, it is part of the
+	 * key as much as the content.
+	 */
+
+	const char *ext = strrchr(path, '.');
+
+	uint64_t hash = hashmap_hash(content, size, HASHMAP_HASH_SEED);
+	hash = hashmap_hash(ext ? ext : "", ext ? strlen(ext) : 0, hash);
+
+	if (entry && entry->hash == hash) {
+		entry->mtime = st.st_mtime;
+		entry->size = st.st_size;
+
+		free(content);
+
+		cache->hits++;
+		pthread_mutex_unlock(&cache->lock);
+
+		return entry->module;
+	}
+
+	void *code = content;
+	size_t code_size = size;
+
+	if (!is_spirv(path)) {
+		code = load_glsl(cache, path, content, size, hash, &code_size);
+		free(content);
+
+		/**
+		 * A broken edit keeps the module that was working.
+		 */
+
+		if (code == NULL && entry) {
+			fprintf(stderr, "WARN: `%s` failed to compile, keeping the previous version\n", path);
+
+			entry->mtime = st.st_mtime;
+			entry->size = st.st_size;
+
+			pthread_mutex_unlock(&cache->lock);
+
+			return entry->module;
+		}
+
+		if (code == NULL) {
+			fprintf(stderr, "ERR: failed to compile `%s`\n // Assertion: `compile_glsl != NULL`\n", path);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	VkShaderModuleCreateInfo shader_ci = {};
+	shader_ci.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	shader_ci.codeSize = code_size;
+	shader_ci.pCode = code;
+
+	VkShaderModule module;
+
+	if (vkCreateShaderModule(ref->device, &shader_ci, HOST_ALLOC(SHADER), &module) != VK_SUCCESS) {
+		fprintf(stderr, "ERR: failed to create shader module for `%s`\n // Assertion: `vkCreateShaderModule == VK_SUCCESS`\n", path);
+		exit(EXIT_FAILURE);
+	}
+
+	free(code);
+
+	if (entry) {
+		array_append(&cache->retired, &entry->module);
+		cache->reloads++;
+	}
+	else {
+		shader_entry_t fresh = {};
+		memcpy(fresh.path, key, sizeof(key));
+
+		uint32_t index = (uint32_t) array_size(&cache->entries);
+
+		array_append(&cache->entries, &fresh);
+		hashmap_put(&cache->index, key, &index);
+
+		entry = &((shader_entry_t *) array_data(&cache->entries))[index];
+
+		cache->loads++;
+	}
+
+	entry->mtime = st.st_mtime;
+	entry->size = st.st_size;
+	entry->hash = hash;
+	entry->module = module;
+
+	pthread_mutex_unlock(&cache->lock);
+
+	return module;
+}
+
+void shader_cache_report(const shader_cache_t *cache)
+{
+	printf("Shaders: %u modules (%u reloaded), %u requests served from memory, %u compiled, %u from the disk cache\n",
+		cache->loads, cache->reloads, cache->hits, cache->compiles, cache->disk_hits);
+}
@@ -0,0 +1,83 @@
+#ifndef _SHADER_CACHE_H_
+#define _SHADER_CACHE_H_
+
+#include "application.h"
+#include "lib/hashmap.h"
+
+#include <pthread.h>
+#include <sys/stat.h>
+
+/**
+ *	Directory compiled SPIR-V is kept in, one `<hash>.spv` per source
+ *	content.
+ */
+#define SHADER_CACHE_DIR ".shader_cache"
+
+/**
+ *	Shader to load: the GLSL source when built with libshaderc
+ *	(`-DHAVE_SHADERC`), otherwise the SPIR-V compile.sh made from it. The
+ *	SPIR-V is a build output, not tracked, so it never lags the GLSL.
+ */
+#ifdef HAVE_SHADERC
+#define SHADER_PATH(source, spv) ("shaders/" source)
+#else
+#define SHADER_PATH(source, spv) ("shaders/" spv)
+#endif
+
+typedef struct _shader_entry_t
+{
+	char path[128];
+
+	/**
+	 * File the module was made from, a changed `mtime` or `size` has the
+	 * file read and hashed again.
+	 */
+
+	time_t mtime;
+	off_t size;
+	uint64_t hash;
+
+	VkShaderModule module;
+}
+shader_entry_t;
+
+/**
+ *	Shader modules by path, created once and kept until
+ *	`destroy_shader_cache()`: pipeline rebuilds (eg. on swapchain
+ *	recreation) only `stat()` the file. An edited file is loaded again on
+ *	the next rebuild, GLSL sources are compiled through libshaderc with the
+ *	SPIR-V cached on disk by content hash. Modules replaced by a reload are
+ *	retired rather than destroyed, pipelines may still be built from them
+ *	on another thread.
+ */
+typedef struct _shader_cache_t
+{
+	array entries;
+	array retired;
+
+	/**
+	 * Path, zero padded to `shader_entry_t.path`, to its index in
+	 * `entries`.
+	 */
+
+	hashmap index;
+
+	pthread_mutex_t lock;
+
+	uint32_t hits;
+	uint32_t loads;
+	uint32_t reloads;
+	uint32_t compiles;
+	uint32_t disk_hits;
+}
+shader_cache_t;
+
+void init_shader_cache(shader_cache_t *cache);
+
+void destroy_shader_cache(struct _application *ref, shader_cache_t *cache);
+
+VkShaderModule shader_cache_get(struct _application *ref, shader_cache_t *cache, const char *path);
+
+void shader_cache_report(const shader_cache_t *cache);
+
+#endif
@@ -0,0 +1,22 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout (binding = 0) uniform ubo_t 
+{
+	mat4 model;
+	mat4 view;
+	mat4 proj;
+} ubo;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 3) in mat4 inModel;
+
+/**
+ * Same transform as hellotriangle.vert, the main pass tests depth EQUAL.
+ */
+
+invariant gl_Position;
+
+void main() {
+    	gl_Position = ubo.proj * ubo.view * inModel * ubo.model * vec4(inPosition, 1.0);
+}
@@ -8,7 +8,21 @@ layout(location = 1) in vec2 fragTexCoord;
 
 layout(location = 0) out vec4 outColor;
 
+/**
+ *	`debug_view_t` in application.h, specialized per pipeline variant so
+ *	only the selected view is compiled in.
+ */
+layout(constant_id = 0) const uint DEBUG_VIEW = 0;
+
 
 void main() {
-	outColor = texture(texSampler, fragTexCoord);
+	if (DEBUG_VIEW == 1) {
+		outColor = vec4(fragTexCoord, 0.0, 1.0);
+	}
+	else if (DEBUG_VIEW == 2) {
+		outColor = vec4(fragColor, 1.0);
+	}
+	else {
+		outColor = texture(texSampler, fragTexCoord);
+	}
 }
\ No newline at end of file
@@ -11,12 +11,22 @@ layout (binding = 0) uniform ubo_t
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoord;
+layout(location = 3) in mat4 inModel;
+layout(location = 7) in uint inTexture;
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragTexture;
+
+/**
+ * Matches the depth pre-pass bit for bit, see depth_prepass.vert.
+ */
+
+invariant gl_Position;
 
 void main() {
-    	gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+    	gl_Position = ubo.proj * ubo.view * inModel * ubo.model * vec4(inPosition, 1.0);
     	fragColor = inColor;
     	fragTexCoord = inTexCoord;
+    	fragTexture = inTexture;
 }
\ No newline at end of file
@@ -0,0 +1,34 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : require
+
+/**
+ *	Bindless textures, `BINDLESS_MAX_TEXTURES` in bindless.h. Instances of one
+ *	draw sample different textures, hence the non uniform index.
+ */
+layout(set = 1, binding = 0) uniform sampler2D textures[4096];
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) flat in uint fragTexture;
+
+layout(location = 0) out vec4 outColor;
+
+/**
+ *	`debug_view_t` in application.h, specialized per pipeline variant so
+ *	only the selected view is compiled in.
+ */
+layout(constant_id = 0) const uint DEBUG_VIEW = 0;
+
+
+void main() {
+	if (DEBUG_VIEW == 1) {
+		outColor = vec4(fragTexCoord, 0.0, 1.0);
+	}
+	else if (DEBUG_VIEW == 2) {
+		outColor = vec4(fragColor, 1.0);
+	}
+	else {
+		outColor = texture(textures[nonuniformEXT(fragTexture)], fragTexCoord);
+	}
+}
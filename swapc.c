@@ -1,4 +1,12 @@
 #include "swapc.h"
+#include "headless.h"
+#include "gpu_timer.h"
+#include "profiler.h"
+#include "mem_budget.h"
+#include "meshlet.h"
+#include "render_graph.h"
+#include "variant_cache.h"
+#include "vk_cache.h"
 
 VkSurfaceFormatKHR choose_swp_surf_format(array available_formats)
 {
@@ -137,7 +145,7 @@ void init_swapchain(struct _application *ref)
 
 	swp_ci.oldSwapchain = VK_NULL_HANDLE;
 
-	VkResult res = vkCreateSwapchainKHR(ref->device, &swp_ci, NULL, &ref->swapchain);
+	VkResult res = vkCreateSwapchainKHR(ref->device, &swp_ci, HOST_ALLOC(SWAPCHAIN), &ref->swapchain);
 		if (res != VK_SUCCESS) {
 			fprintf(stderr, "ERR: failed to initialize Swapchain\n // Assertion: `vkCreateSwapchainKHR != VK_SUCCESS`\n");
 			exit(EXIT_FAILURE);
@@ -160,27 +168,63 @@ void cleanup_swapchain(struct _application *ref)
 	for (int i = 0; i < array_size(&ref->swapc_framebuffers); i++) {
 
 		VkFramebuffer framebuffer = arr_get(ref->swapc_framebuffers, VkFramebuffer, i);
-		vkDestroyFramebuffer(ref->device, framebuffer, NULL);
+		vkDestroyFramebuffer(ref->device, framebuffer, HOST_ALLOC(FRAMEBUFFER));
 	}
 
-	vkDestroyPipeline(ref->device, ref->graphics_pipeline, NULL);
-	vkDestroyPipelineLayout(ref->device, ref->pipeline_layout, NULL);
-	vkDestroyRenderPass(ref->device, ref->render_pass, NULL);
+	vkDestroyPipeline(ref->device, ref->graphics_pipeline, HOST_ALLOC(PIPELINE));
+	variant_cache_clear(ref, ref->variants);
+
+	if (ref->depth_prepass) {
+		vkDestroyPipeline(ref->device, ref->depth_prepass_pipeline, HOST_ALLOC(PIPELINE));
+	}
+
+	vkDestroyPipelineLayout(ref->device, ref->pipeline_layout, HOST_ALLOC(PIPELINE_LAYOUT));
+	vk_cache_release_render_pass(ref->vk_cache, ref->render_pass);
 
 	for (int i = 0; i < array_size(&ref->swapc_img_views); i++) {
 
 		VkImageView img_view = arr_get(ref->swapc_img_views, VkImageView, i);
-		vkDestroyImageView(ref->device, img_view, NULL);
+		vkDestroyImageView(ref->device, img_view, HOST_ALLOC(IMAGE_VIEW));
 	}
 
-	vkDestroySwapchainKHR(ref->device, ref->swapchain, NULL);
+	if (ref->headless) {
+		cleanup_offscreen_targets(ref);
+	}
+	else {
+		vkDestroySwapchainKHR(ref->device, ref->swapchain, HOST_ALLOC(SWAPCHAIN));
+	}
+
+	if (ref->meshlet_cull) {
+		destroy_meshlet_cull_frames(ref, ref->meshlet_cull);
+	}
 
 	for (size_t i = 0; i < array_size(&ref->swapc_imgs); i++) {
-		vkDestroyBuffer(ref->device, ((VkBuffer *) array_data(&ref->uniform_buffers))[i], NULL);
-		vkFreeMemory(ref->device, ((VkDeviceMemory *) array_data(&ref->uniform_buffers_memory))[i], NULL);
+		vkDestroyBuffer(ref->device, ((VkBuffer *) array_data(&ref->uniform_buffers))[i], HOST_ALLOC(BUFFER));
+		mem_budget_free(ref, ((VkDeviceMemory *) array_data(&ref->uniform_buffers_memory))[i]);
+
+		vkDestroyBuffer(ref->device, ((VkBuffer *) array_data(&ref->lod_draw_buffers))[i], HOST_ALLOC(BUFFER));
+		mem_budget_free(ref, ((VkDeviceMemory *) array_data(&ref->lod_draw_buffers_memory))[i]);
+	}
+
+	array_free(&ref->lod_draw_buffers);
+	array_free(&ref->lod_draw_buffers_memory);
+
+	for (int i = 0; i < array_size(&ref->instance_buffers); i++) {
+		vkUnmapMemory(ref->device, ((VkDeviceMemory *) array_data(&ref->instance_buffers_memory))[i]);
+		vkDestroyBuffer(ref->device, ((VkBuffer *) array_data(&ref->instance_buffers))[i], HOST_ALLOC(BUFFER));
+		mem_budget_free(ref, ((VkDeviceMemory *) array_data(&ref->instance_buffers_memory))[i]);
 	}
 
-	vkDestroyDescriptorPool(ref->device, ref->descriptor_pool, NULL);
+	array_free(&ref->instance_buffers);
+	array_free(&ref->instance_buffers_memory);
+	array_free(&ref->instance_mapped);
+
+	array_free(&ref->descriptor_sets);
+	ref->descriptor_sets.size = 0;
+
+	destroy_render_graph(ref, ref->render_graph);
+	free(ref->render_graph);
+	ref->render_graph = NULL;
 }
 
 void recreate_swapchain(struct _application *ref)
@@ -192,19 +236,30 @@ void recreate_swapchain(struct _application *ref)
 		glfwWaitEvents();
 	}
 
+	PROFILE_ZONE("recreate_swapchain");
+
 	vkDeviceWaitIdle(ref->device);
 
 	cleanup_swapchain(ref);
 
 	init_swapchain(ref);
+	reset_image_fences(ref);
 	init_image_views(ref);
 	create_renderpass(ref);
 	create_graphics_pipeline(ref);
-	create_depth_resources(ref);
-	create_framebuffers(ref);
 
 	create_uniform_buffers(ref);
-	create_descriptor_pool(ref);
 	create_descriptor_sets(ref);
+
+	if (ref->meshlet_cull) {
+		create_meshlet_cull_frames(ref, ref->meshlet_cull);
+	}
+
+	create_render_graph(ref);
+	create_framebuffers(ref);
+
+	destroy_gpu_timer(ref, ref->gpu_timer);
+	init_gpu_timer(ref, ref->gpu_timer, ref->graphics_queue_family_index, array_size(&ref->swapc_imgs), true);
+
 	create_command_buffers(ref);
 }
\ No newline at end of file
@@ -0,0 +1,510 @@
+#include "transform.h"
+#include "profiler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TRANSFORM_X86
+#endif
+
+/**
+ *	Local matrix kernel over [begin, end), writing the local matrices of
+ *	dirty transforms into `world`. Selected once in `init_transforms()`.
+ */
+typedef void (*local_kernel_fn)(transforms_t *transforms, uint32_t begin, uint32_t end);
+
+static local_kernel_fn local_kernel;
+
+typedef struct _transform_task_t
+{
+	transforms_t *transforms;
+
+	const uint32_t *nodes;
+	uint32_t count;
+
+	mat4 *dst;
+	const uint32_t *order;
+}
+transform_task_t;
+
+/**
+ *	Column major TRS matrix of transform `i`.
+ */
+static inline void compose_scalar(const transforms_t *t, uint32_t i, float *m)
+{
+	float x = t->rot[0][i], y = t->rot[1][i], z = t->rot[2][i], w = t->rot[3][i];
+	float sx = t->scale[0][i], sy = t->scale[1][i], sz = t->scale[2][i];
+
+	float xx = x * x, yy = y * y, zz = z * z;
+	float xy = x * y, xz = x * z, yz = y * z;
+	float wx = w * x, wy = w * y, wz = w * z;
+
+	m[0] = (1.0f - 2.0f * (yy + zz)) * sx;
+	m[1] = 2.0f * (xy + wz) * sx;
+	m[2] = 2.0f * (xz - wy) * sx;
+	m[3] = 0.0f;
+
+	m[4] = 2.0f * (xy - wz) * sy;
+	m[5] = (1.0f - 2.0f * (xx + zz)) * sy;
+	m[6] = 2.0f * (yz + wx) * sy;
+	m[7] = 0.0f;
+
+	m[8] = 2.0f * (xz + wy) * sz;
+	m[9] = 2.0f * (yz - wx) * sz;
+	m[10] = (1.0f - 2.0f * (xx + yy)) * sz;
+	m[11] = 0.0f;
+
+	m[12] = t->pos[0][i];
+	m[13] = t->pos[1][i];
+	m[14] = t->pos[2][i];
+	m[15] = 1.0f;
+}
+
+static void local_scalar(transforms_t *t, uint32_t begin, uint32_t end)
+{
+	for (uint32_t i = begin; i < end; i++) {
+		if (t->dirty[i]) {
+			compose_scalar(t, i, (float *) t->world[i]);
+		}
+	}
+}
+
+#ifdef TRANSFORM_X86
+
+/**
+ *	Store column `column` of 4 transforms from one vector per matrix row,
+ *	skipping clean lanes.
+ */
+static inline void store_column_sse(transforms_t *t, uint32_t i, uint32_t dirty, int column, __m128 r0, __m128 r1, __m128 r2, __m128 r3)
+{
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+	__m128 lanes[4] = {r0, r1, r2, r3};
+
+	for (int l = 0; l < 4; l++) {
+		if (dirty & (0xffu << (l * 8))) {
+			_mm_storeu_ps(t->world[i + l][column], lanes[l]);
+		}
+	}
+}
+
+/**
+ *	SSE kernel, 4 transforms per batch.
+ */
+static void local_sse(transforms_t *t, uint32_t begin, uint32_t end)
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 zero = _mm_setzero_ps();
+
+	uint32_t i = begin;
+
+	for (; i + 4 <= end; i += 4) {
+		uint32_t dirty;
+		memcpy(&dirty, &t->dirty[i], sizeof(dirty));
+
+		if (dirty == 0) {
+			continue;
+		}
+
+		__m128 x = _mm_loadu_ps(&t->rot[0][i]);
+		__m128 y = _mm_loadu_ps(&t->rot[1][i]);
+		__m128 z = _mm_loadu_ps(&t->rot[2][i]);
+		__m128 w = _mm_loadu_ps(&t->rot[3][i]);
+
+		__m128 sx = _mm_loadu_ps(&t->scale[0][i]);
+		__m128 sy = _mm_loadu_ps(&t->scale[1][i]);
+		__m128 sz = _mm_loadu_ps(&t->scale[2][i]);
+
+		__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+		__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+		__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+		__m128 m00 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+		__m128 m01 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+		__m128 m02 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+
+		__m128 m10 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+		__m128 m11 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+		__m128 m12 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+
+		__m128 m20 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+		__m128 m21 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+		__m128 m22 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+
+		store_column_sse(t, i, dirty, 0, m00, m01, m02, zero);
+		store_column_sse(t, i, dirty, 1, m10, m11, m12, zero);
+		store_column_sse(t, i, dirty, 2, m20, m21, m22, zero);
+		store_column_sse(t, i, dirty, 3, _mm_loadu_ps(&t->pos[0][i]), _mm_loadu_ps(&t->pos[1][i]), _mm_loadu_ps(&t->pos[2][i]), one);
+	}
+
+	local_scalar(t, i, end);
+}
+
+__attribute__((target("avx")))
+static inline void store_column_avx(transforms_t *t, uint32_t i, uint64_t dirty, int column, __m256 r0, __m256 r1, __m256 r2, __m256 r3)
+{
+	store_column_sse(t, i, (uint32_t) dirty, column,
+		_mm256_castps256_ps128(r0), _mm256_castps256_ps128(r1), _mm256_castps256_ps128(r2), _mm256_castps256_ps128(r3));
+
+	store_column_sse(t, i + 4, (uint32_t) (dirty >> 32), column,
+		_mm256_extractf128_ps(r0, 1), _mm256_extractf128_ps(r1, 1), _mm256_extractf128_ps(r2, 1), _mm256_extractf128_ps(r3, 1));
+}
+
+/**
+ *	AVX kernel, 8 transforms per batch.
+ */
+__attribute__((target("avx")))
+static void local_avx(transforms_t *t, uint32_t begin, uint32_t end)
+{
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 two = _mm256_set1_ps(2.0f);
+	const __m256 zero = _mm256_setzero_ps();
+
+	uint32_t i = begin;
+
+	for (; i + 8 <= end; i += 8) {
+		uint64_t dirty;
+		memcpy(&dirty, &t->dirty[i], sizeof(dirty));
+
+		if (dirty == 0) {
+			continue;
+		}
+
+		__m256 x = _mm256_loadu_ps(&t->rot[0][i]);
+		__m256 y = _mm256_loadu_ps(&t->rot[1][i]);
+		__m256 z = _mm256_loadu_ps(&t->rot[2][i]);
+		__m256 w = _mm256_loadu_ps(&t->rot[3][i]);
+
+		__m256 sx = _mm256_loadu_ps(&t->scale[0][i]);
+		__m256 sy = _mm256_loadu_ps(&t->scale[1][i]);
+		__m256 sz = _mm256_loadu_ps(&t->scale[2][i]);
+
+		__m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+		__m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+		__m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+
+		__m256 m00 = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz))), sx);
+		__m256 m01 = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xy, wz)), sx);
+		__m256 m02 = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xz, wy)), sx);
+
+		__m256 m10 = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xy, wz)), sy);
+		__m256 m11 = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz))), sy);
+		__m256 m12 = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(yz, wx)), sy);
+
+		__m256 m20 = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xz, wy)), sz);
+		__m256 m21 = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(yz, wx)), sz);
+		__m256 m22 = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy))), sz);
+
+		store_column_avx(t, i, dirty, 0, m00, m01, m02, zero);
+		store_column_avx(t, i, dirty, 1, m10, m11, m12, zero);
+		store_column_avx(t, i, dirty, 2, m20, m21, m22, zero);
+		store_column_avx(t, i, dirty, 3, _mm256_loadu_ps(&t->pos[0][i]), _mm256_loadu_ps(&t->pos[1][i]), _mm256_loadu_ps(&t->pos[2][i]), one);
+	}
+
+	local_sse(t, i, end);
+}
+
+#endif
+
+static void *alloc_aligned(size_t size)
+{
+	void *ptr = aligned_alloc(32, (size + 31) & ~(size_t) 31);
+
+	if (ptr == NULL) {
+		fprintf(stderr, "ERR: failed to allocate transforms\n // Assertion: `aligned_alloc != NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	return ptr;
+}
+
+static void *grow_aligned(void *old, size_t old_size, size_t new_size)
+{
+	void *ptr = alloc_aligned(new_size);
+
+	if (old) {
+		memcpy(ptr, old, old_size);
+		free(old);
+	}
+
+	return ptr;
+}
+
+static void reserve_transforms(transforms_t *t, uint32_t capacity)
+{
+	capacity = (capacity + 7) & ~7u;
+
+	if (capacity <= t->capacity) {
+		return;
+	}
+
+	for (int c = 0; c < 3; c++) {
+		t->pos[c] = grow_aligned(t->pos[c], sizeof(float) * t->capacity, sizeof(float) * capacity);
+		t->scale[c] = grow_aligned(t->scale[c], sizeof(float) * t->capacity, sizeof(float) * capacity);
+	}
+
+	for (int c = 0; c < 4; c++) {
+		t->rot[c] = grow_aligned(t->rot[c], sizeof(float) * t->capacity, sizeof(float) * capacity);
+	}
+
+	t->parent = grow_aligned(t->parent, sizeof(int32_t) * t->capacity, sizeof(int32_t) * capacity);
+	t->dirty = grow_aligned(t->dirty, t->capacity, capacity);
+	t->world = grow_aligned(t->world, sizeof(mat4) * t->capacity, sizeof(mat4) * capacity);
+
+	free(t->level_nodes);
+	t->level_nodes = malloc(sizeof(uint32_t) * capacity);
+
+	t->capacity = capacity;
+}
+
+/**
+ *	`threads` as in `tpool_init()`, 0 for one per online CPU.
+ */
+void init_transforms(transforms_t *transforms, uint32_t capacity, int threads)
+{
+	memset(transforms, 0, sizeof(transforms_t));
+
+	reserve_transforms(transforms, capacity > 0 ? capacity : 8);
+	tpool_init(&transforms->pool, threads);
+
+	local_kernel = local_scalar;
+
+#ifdef TRANSFORM_X86
+	__builtin_cpu_init();
+
+	transforms->sse = __builtin_cpu_supports("sse2");
+	transforms->avx = transforms->sse && __builtin_cpu_supports("avx");
+
+	if (transforms->avx) {
+		local_kernel = local_avx;
+	}
+	else if (transforms->sse) {
+		local_kernel = local_sse;
+	}
+#endif
+}
+
+void destroy_transforms(transforms_t *transforms)
+{
+	tpool_free(&transforms->pool);
+
+	for (int c = 0; c < 3; c++) {
+		free(transforms->pos[c]);
+		free(transforms->scale[c]);
+	}
+
+	for (int c = 0; c < 4; c++) {
+		free(transforms->rot[c]);
+	}
+
+	free(transforms->parent);
+	free(transforms->dirty);
+	free(transforms->world);
+	free(transforms->level_nodes);
+	free(transforms->level_offsets);
+
+	memset(transforms, 0, sizeof(transforms_t));
+}
+
+/**
+ *	Append an identity transform below `parent`, which has to exist already
+ *	(or be `TRANSFORM_NO_PARENT`), keeping parents ahead of their children.
+ */
+uint32_t transform_add(transforms_t *transforms, int32_t parent)
+{
+	if (parent >= (int32_t) transforms->count) {
+		fprintf(stderr, "ERR: transform parent added after its child\n // Assertion: `parent < count`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (transforms->count == transforms->capacity) {
+		reserve_transforms(transforms, transforms->capacity * 2);
+	}
+
+	uint32_t id = transforms->count++;
+
+	for (int c = 0; c < 3; c++) {
+		transforms->pos[c][id] = 0.0f;
+		transforms->scale[c][id] = 1.0f;
+	}
+
+	transforms->rot[0][id] = 0.0f;
+	transforms->rot[1][id] = 0.0f;
+	transforms->rot[2][id] = 0.0f;
+	transforms->rot[3][id] = 1.0f;
+
+	transforms->parent[id] = parent;
+	transforms->dirty[id] = 1;
+	transforms->levels_dirty = true;
+
+	return id;
+}
+
+void transform_set(transforms_t *transforms, uint32_t id, const vec3 pos, const versor rot, const vec3 scale)
+{
+	for (int c = 0; c < 3; c++) {
+		transforms->pos[c][id] = pos[c];
+		transforms->scale[c][id] = scale[c];
+	}
+
+	transform_set_rotation(transforms, id, rot);
+}
+
+void transform_set_rotation(transforms_t *transforms, uint32_t id, const versor rot)
+{
+	for (int c = 0; c < 4; c++) {
+		transforms->rot[c][id] = rot[c];
+	}
+
+	transforms->dirty[id] = 1;
+}
+
+/**
+ *	Counting sort of the non root transforms by depth.
+ */
+static void build_levels(transforms_t *t)
+{
+	uint32_t *depth = malloc(sizeof(uint32_t) * (t->count > 0 ? t->count : 1));
+	uint32_t max_depth = 0;
+
+	for (uint32_t i = 0; i < t->count; i++) {
+		depth[i] = t->parent[i] == TRANSFORM_NO_PARENT ? 0 : depth[t->parent[i]] + 1;
+		max_depth = depth[i] > max_depth ? depth[i] : max_depth;
+	}
+
+	free(t->level_offsets);
+	t->level_offsets = calloc(max_depth + 1, sizeof(uint32_t));
+	t->level_count = max_depth;
+
+	for (uint32_t i = 0; i < t->count; i++) {
+		if (depth[i] > 0) {
+			t->level_offsets[depth[i]]++;
+		}
+	}
+
+	for (uint32_t d = 1; d <= max_depth; d++) {
+		t->level_offsets[d] += t->level_offsets[d - 1];
+	}
+
+	uint32_t *cursor = malloc(sizeof(uint32_t) * (max_depth + 1));
+	memcpy(cursor, t->level_offsets, sizeof(uint32_t) * (max_depth + 1));
+
+	for (uint32_t i = 0; i < t->count; i++) {
+		if (depth[i] > 0) {
+			t->level_nodes[cursor[depth[i] - 1]++] = i;
+		}
+	}
+
+	free(cursor);
+	free(depth);
+
+	t->levels_dirty = false;
+}
+
+static void local_task(void *ctx, int index)
+{
+	transform_task_t *task = (transform_task_t *) ctx;
+
+	uint32_t begin = (uint32_t) index * TRANSFORM_CHUNK;
+	uint32_t end = begin + TRANSFORM_CHUNK < task->count ? begin + TRANSFORM_CHUNK : task->count;
+
+	local_kernel(task->transforms, begin, end);
+}
+
+static void level_task(void *ctx, int index)
+{
+	transform_task_t *task = (transform_task_t *) ctx;
+	transforms_t *t = task->transforms;
+
+	uint32_t begin = (uint32_t) index * TRANSFORM_CHUNK;
+	uint32_t end = begin + TRANSFORM_CHUNK < task->count ? begin + TRANSFORM_CHUNK : task->count;
+
+	for (uint32_t k = begin; k < end; k++) {
+		uint32_t node = task->nodes[k];
+
+		if (t->dirty[node]) {
+			glm_mat4_mul(t->world[t->parent[node]], t->world[node], t->world[node]);
+		}
+	}
+}
+
+static void write_task(void *ctx, int index)
+{
+	transform_task_t *task = (transform_task_t *) ctx;
+	transforms_t *t = task->transforms;
+
+	uint32_t begin = (uint32_t) index * TRANSFORM_CHUNK;
+	uint32_t end = begin + TRANSFORM_CHUNK < task->count ? begin + TRANSFORM_CHUNK : task->count;
+
+	if (task->order == NULL) {
+		memcpy(task->dst[begin], t->world[begin], sizeof(mat4) * (end - begin));
+		return;
+	}
+
+	for (uint32_t k = begin; k < end; k++) {
+		memcpy(task->dst[k], t->world[task->order[k]], sizeof(mat4));
+	}
+}
+
+static int chunks_of(uint32_t count)
+{
+	return (int) ((count + TRANSFORM_CHUNK - 1) / TRANSFORM_CHUNK);
+}
+
+/**
+ *	Recompute the world matrices of dirty transforms and of everything
+ *	below them: local matrices in SIMD batches across the workers, then
+ *	one parallel for per depth multiplying in the parent's world matrix.
+ */
+void transforms_update(transforms_t *transforms)
+{
+	PROFILE_ZONE("transforms_update");
+
+	transforms_t *t = transforms;
+
+	if (t->levels_dirty) {
+		build_levels(t);
+	}
+
+	for (uint32_t i = 0; i < t->count; i++) {
+		if (t->parent[i] != TRANSFORM_NO_PARENT) {
+			t->dirty[i] |= t->dirty[t->parent[i]];
+		}
+	}
+
+	transform_task_t task = {};
+	task.transforms = t;
+	task.count = t->count;
+
+	tpool_parallel_for(&t->pool, chunks_of(t->count), local_task, &task);
+
+	for (uint32_t d = 0; d < t->level_count; d++) {
+		task.nodes = &t->level_nodes[t->level_offsets[d]];
+		task.count = t->level_offsets[d + 1] - t->level_offsets[d];
+
+		tpool_parallel_for(&t->pool, chunks_of(task.count), level_task, &task);
+	}
+
+	memset(t->dirty, 0, t->count);
+}
+
+/**
+ *	Copy `count` world matrices to `dst`, eg. a mapped instance buffer,
+ *	`dst[k]` being transform `order[k]`, or transform `k` without `order`.
+ */
+void transforms_write(transforms_t *transforms, mat4 *dst, const uint32_t *order, uint32_t count)
+{
+	PROFILE_ZONE("transforms_write");
+
+	transform_task_t task = {};
+	task.transforms = transforms;
+	task.count = count;
+	task.dst = dst;
+	task.order = order;
+
+	tpool_parallel_for(&transforms->pool, chunks_of(count), write_task, &task);
+}
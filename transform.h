@@ -0,0 +1,71 @@
+#ifndef _TRANSFORM_H_
+#define _TRANSFORM_H_
+
+#include "lib/tpool.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <cglm/cglm.h>
+
+#define TRANSFORM_NO_PARENT -1
+
+/**
+ *	Transforms per parallel for task, a multiple of the widest batch.
+ */
+#define TRANSFORM_CHUNK 4096
+
+/**
+ *	Scene transform hierarchy. Local translation, rotation (quaternion) and
+ *	scale live in structure of arrays form so world matrices are built 4 or
+ *	8 at a time with SSE / AVX. Parents always precede their children, which
+ *	`transform_add()` guarantees, so dirty flags propagate in one forward
+ *	sweep; the children of each depth are combined with their parents in
+ *	parallel once the depth above is done.
+ */
+typedef struct _transforms_t
+{
+	uint32_t count;
+	uint32_t capacity;
+
+	float *pos[3];
+	float *rot[4];
+	float *scale[3];
+
+	int32_t *parent;
+	uint8_t *dirty;
+
+	mat4 *world;
+
+	/**
+	 * Non root transforms grouped by depth, rebuilt after `transform_add()`.
+	 * Depth `d` (from 1) spans `level_offsets[d - 1]` to `level_offsets[d]`.
+	 */
+
+	uint32_t *level_nodes;
+	uint32_t *level_offsets;
+	uint32_t level_count;
+	bool levels_dirty;
+
+	tpool pool;
+
+	bool sse;
+	bool avx;
+}
+transforms_t;
+
+void init_transforms(transforms_t *transforms, uint32_t capacity, int threads);
+
+void destroy_transforms(transforms_t *transforms);
+
+uint32_t transform_add(transforms_t *transforms, int32_t parent);
+
+void transform_set(transforms_t *transforms, uint32_t id, const vec3 pos, const versor rot, const vec3 scale);
+
+void transform_set_rotation(transforms_t *transforms, uint32_t id, const versor rot);
+
+void transforms_update(transforms_t *transforms);
+
+void transforms_write(transforms_t *transforms, mat4 *dst, const uint32_t *order, uint32_t count);
+
+#endif
@@ -0,0 +1,246 @@
+#include "variant_cache.h"
+#include "profiler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct _build_task_t
+{
+	variant_cache_t *cache;
+	uint32_t variants[VARIANT_CACHE_MAX];
+}
+build_task_t;
+
+static void build_task(void *ctx, int index)
+{
+	build_task_t *task = ctx;
+	variant_cache_t *cache = task->cache;
+	pipeline_variant_t *variant = &cache->variants[task->variants[index]];
+
+	VkSpecializationMapEntry entries[VARIANT_MAX_CONSTANTS];
+
+	for (uint32_t i = 0; i < variant->constant_count; i++) {
+		entries[i].constantID = i;
+		entries[i].offset = sizeof(uint32_t) * i;
+		entries[i].size = sizeof(uint32_t);
+	}
+
+	VkSpecializationInfo spec = {};
+	spec.mapEntryCount = variant->constant_count;
+	spec.pMapEntries = entries;
+	spec.dataSize = sizeof(uint32_t) * variant->constant_count;
+	spec.pData = variant->constants;
+
+	uint64_t t0 = profiler_now_ns();
+
+	variant->pipeline = variant->build(cache->ref, variant->state, &spec);
+
+	__atomic_add_fetch(&cache->build_ns, profiler_now_ns() - t0, __ATOMIC_RELAXED);
+	__atomic_store_n(&variant->status, VARIANT_READY, __ATOMIC_RELEASE);
+	__atomic_add_fetch(&cache->completed, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ *	Take everything queued and build it in one parallel for, until shut
+ *	down.
+ */
+static void *variant_driver(void *arg)
+{
+	variant_cache_t *cache = arg;
+
+	pthread_mutex_lock(&cache->lock);
+
+	for (;;) {
+		while (!cache->shutdown && cache->queued == 0) {
+			pthread_cond_wait(&cache->work_cond, &cache->lock);
+		}
+
+		if (cache->shutdown) {
+			break;
+		}
+
+		build_task_t task;
+		task.cache = cache;
+
+		uint32_t count = cache->queued;
+		memcpy(task.variants, cache->queue, sizeof(uint32_t) * count);
+
+		cache->queued = 0;
+		cache->busy = true;
+
+		pthread_mutex_unlock(&cache->lock);
+		tpool_parallel_for(&cache->pool, (int) count, build_task, &task);
+		pthread_mutex_lock(&cache->lock);
+
+		cache->built += count;
+		cache->busy = false;
+
+		pthread_cond_broadcast(&cache->idle_cond);
+	}
+
+	pthread_mutex_unlock(&cache->lock);
+
+	return NULL;
+}
+
+/**
+ *	`threads` as in `tpool_init()`, 0 for one per online CPU.
+ */
+void init_variant_cache(struct _application *ref, variant_cache_t *cache, int threads)
+{
+	memset(cache, 0, sizeof(variant_cache_t));
+
+	cache->ref = ref;
+
+	hashmap_init(&cache->index, sizeof(uint64_t), sizeof(uint32_t));
+
+	tpool_init(&cache->pool, threads);
+
+	pthread_mutex_init(&cache->lock, NULL);
+	pthread_cond_init(&cache->work_cond, NULL);
+	pthread_cond_init(&cache->idle_cond, NULL);
+
+	if (pthread_create(&cache->thread, NULL, variant_driver, cache) != 0) {
+		fprintf(stderr, "ERR: failed to start pipeline variant thread\n // Assertion: `pthread_create == 0`\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+void destroy_variant_cache(struct _application *ref, variant_cache_t *cache)
+{
+	variant_cache_clear(ref, cache);
+
+	pthread_mutex_lock(&cache->lock);
+	cache->shutdown = true;
+	pthread_cond_broadcast(&cache->work_cond);
+	pthread_mutex_unlock(&cache->lock);
+
+	pthread_join(cache->thread, NULL);
+
+	pthread_cond_destroy(&cache->idle_cond);
+	pthread_cond_destroy(&cache->work_cond);
+	pthread_mutex_destroy(&cache->lock);
+
+	tpool_free(&cache->pool);
+	hashmap_free(&cache->index);
+}
+
+/**
+ *	Variant of the pipeline `build` makes from `state`, specialized with
+ *	`constants`. Queued for the workers unless an identical one was
+ *	requested before, either way the returned index is valid at once.
+ */
+uint32_t variant_cache_request(variant_cache_t *cache, const char *name, variant_build_fn build, const void *state, uint32_t state_size,
+	const uint32_t *constants, uint32_t constant_count)
+{
+	if (state_size > VARIANT_MAX_STATE || constant_count > VARIANT_MAX_CONSTANTS) {
+		fprintf(stderr, "ERR: pipeline variant `%s` too large\n // Assertion: `state_size <= VARIANT_MAX_STATE && constant_count <= VARIANT_MAX_CONSTANTS`\n", name);
+		exit(EXIT_FAILURE);
+	}
+
+	uint64_t key = hashmap_hash(name, strlen(name), HASHMAP_HASH_SEED);
+	key = hashmap_hash(&build, sizeof(build), key);
+	key = hashmap_hash(state, state_size, key);
+	key = hashmap_hash(constants, sizeof(uint32_t) * constant_count, key);
+
+	uint32_t *found = hashmap_get(&cache->index, &key);
+
+	if (found) {
+		cache->hits++;
+		return *found;
+	}
+
+	if (cache->variant_count == VARIANT_CACHE_MAX) {
+		fprintf(stderr, "ERR: too many pipeline variants\n // Assertion: `variant_count < VARIANT_CACHE_MAX`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	uint32_t index = cache->variant_count++;
+	pipeline_variant_t *variant = &cache->variants[index];
+
+	memset(variant, 0, sizeof(pipeline_variant_t));
+	snprintf(variant->name, sizeof(variant->name), "%s", name);
+
+	variant->key = key;
+	variant->build = build;
+	variant->state_size = state_size;
+	variant->constant_count = constant_count;
+	variant->status = VARIANT_QUEUED;
+
+	memcpy(variant->state, state, state_size);
+	memcpy(variant->constants, constants, sizeof(uint32_t) * constant_count);
+
+	hashmap_put(&cache->index, &key, &index);
+
+	pthread_mutex_lock(&cache->lock);
+	cache->queue[cache->queued++] = index;
+	pthread_cond_signal(&cache->work_cond);
+	pthread_mutex_unlock(&cache->lock);
+
+	return index;
+}
+
+/**
+ *	The variant's pipeline once built, `fallback` until then or when
+ *	`variant` is `VARIANT_NONE`.
+ */
+VkPipeline variant_cache_get(variant_cache_t *cache, uint32_t variant, VkPipeline fallback)
+{
+	if (variant == VARIANT_NONE || __atomic_load_n(&cache->variants[variant].status, __ATOMIC_ACQUIRE) != VARIANT_READY) {
+		return fallback;
+	}
+
+	return cache->variants[variant].pipeline;
+}
+
+/**
+ *	True when variants finished since the last poll, recorded command
+ *	buffers still bind their fallbacks.
+ */
+bool variant_cache_poll(variant_cache_t *cache)
+{
+	uint32_t completed = __atomic_load_n(&cache->completed, __ATOMIC_ACQUIRE);
+	bool fresh = completed != cache->polled;
+
+	cache->polled = completed;
+
+	return fresh;
+}
+
+/**
+ *	Block until every queued variant is built.
+ */
+void variant_cache_wait(variant_cache_t *cache)
+{
+	pthread_mutex_lock(&cache->lock);
+
+	while (cache->queued > 0 || cache->busy) {
+		pthread_cond_wait(&cache->idle_cond, &cache->lock);
+	}
+
+	pthread_mutex_unlock(&cache->lock);
+}
+
+/**
+ *	Destroy every variant, for when the state they were built from goes
+ *	away (eg. the render pass with the swapchain). The device must be idle.
+ */
+void variant_cache_clear(struct _application *ref, variant_cache_t *cache)
+{
+	variant_cache_wait(cache);
+
+	for (uint32_t i = 0; i < cache->variant_count; i++) {
+		vkDestroyPipeline(ref->device, cache->variants[i].pipeline, HOST_ALLOC(PIPELINE));
+	}
+
+	cache->variant_count = 0;
+	hashmap_clear(&cache->index);
+	cache->polled = __atomic_load_n(&cache->completed, __ATOMIC_ACQUIRE);
+}
+
+void variant_cache_report(const variant_cache_t *cache)
+{
+	printf("Pipeline variants: %u built in %.1f ms on %d threads, %lu requests served from the cache\n", cache->built,
+		(double) cache->build_ns / 1e6, tpool_size((tpool *) &cache->pool), (unsigned long) cache->hits);
+}
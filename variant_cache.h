@@ -0,0 +1,115 @@
+#ifndef _VARIANT_CACHE_H_
+#define _VARIANT_CACHE_H_
+
+#include "application.h"
+#include "lib/tpool.h"
+#include "lib/hashmap.h"
+
+#include <pthread.h>
+
+#define VARIANT_CACHE_MAX 64
+#define VARIANT_MAX_CONSTANTS 8
+#define VARIANT_MAX_STATE 64
+
+#define VARIANT_NONE UINT32_MAX
+
+/**
+ *	Build a pipeline from the caller's `state`, specialized by `spec`. Runs
+ *	on a worker thread while the main thread goes on: everything it
+ *	depends on must be in `state`, `ref` only provides the device.
+ */
+typedef VkPipeline (*variant_build_fn)(struct _application *ref, const void *state, const VkSpecializationInfo *spec);
+
+typedef enum _variant_status_t
+{
+	VARIANT_QUEUED,
+	VARIANT_READY
+}
+variant_status_t;
+
+/**
+ *	A pipeline variant. Constant `i` goes to `constant_id = i` of the
+ *	shaders, every constant is 32 bits wide (bools included).
+ */
+typedef struct _pipeline_variant_t
+{
+	char name[32];
+	uint64_t key;
+
+	variant_build_fn build;
+	uint8_t state[VARIANT_MAX_STATE];
+	uint32_t state_size;
+
+	uint32_t constants[VARIANT_MAX_CONSTANTS];
+	uint32_t constant_count;
+
+	/**
+	 * Written by the worker, `pipeline` is valid once `status` reads
+	 * `VARIANT_READY`.
+	 */
+
+	VkPipeline pipeline;
+	uint32_t status;
+}
+pipeline_variant_t;
+
+/**
+ *	Cache of specialized pipelines, keyed by a hash of the shader name, the
+ *	build function, the pipeline state and the specialization constants. A
+ *	request returns at once, a driver thread builds the queued variants in
+ *	parallel on `pool`. Until a variant is ready `variant_cache_get()` hands
+ *	out the caller's fallback, `variant_cache_poll()` tells when finished
+ *	variants are waiting to be recorded.
+ */
+typedef struct _variant_cache_t
+{
+	struct _application *ref;
+
+	pipeline_variant_t variants[VARIANT_CACHE_MAX];
+	uint32_t variant_count;
+
+	/**
+	 * Variant key to its index in `variants`.
+	 */
+
+	hashmap index;
+
+	tpool pool;
+	pthread_t thread;
+
+	pthread_mutex_t lock;
+	pthread_cond_t work_cond;
+	pthread_cond_t idle_cond;
+
+	uint32_t queue[VARIANT_CACHE_MAX];
+	uint32_t queued;
+	bool busy;
+	bool shutdown;
+
+	uint32_t completed;
+	uint32_t polled;
+
+	uint64_t build_ns;
+	uint32_t built;
+	uint64_t hits;
+}
+variant_cache_t;
+
+void init_variant_cache(struct _application *ref, variant_cache_t *cache, int threads);
+
+void destroy_variant_cache(struct _application *ref, variant_cache_t *cache);
+
+uint32_t variant_cache_request(variant_cache_t *cache, const char *name, variant_build_fn build, const void *state, uint32_t state_size,
+	const uint32_t *constants, uint32_t constant_count);
+
+VkPipeline variant_cache_get(variant_cache_t *cache, uint32_t variant, VkPipeline fallback);
+
+bool variant_cache_poll(variant_cache_t *cache);
+
+void variant_cache_wait(variant_cache_t *cache);
+
+void variant_cache_clear(struct _application *ref, variant_cache_t *cache);
+
+void variant_cache_report(const variant_cache_t *cache);
+
+#endif
@@ -0,0 +1,372 @@
+#include "vk_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern const int MAX_FRAMES_IN_FLIGHT;
+
+static const size_t key_sizes[VK_CACHE_KIND_COUNT] = {
+	sizeof(vk_sampler_key_t),
+	sizeof(vk_set_layout_key_t),
+	sizeof(vk_render_pass_key_t)
+};
+
+static const char *kind_names[VK_CACHE_KIND_COUNT] = {
+	"samplers",
+	"set layouts",
+	"render passes"
+};
+
+/**
+ *	Non-dispatchable handles are 64 bits wide, a pointer or an integer
+ *	depending on the platform.
+ */
+#define TO_HANDLE(object) ({ uint64_t _h = 0; memcpy(&_h, &(object), sizeof(object)); _h; })
+#define FROM_HANDLE(object, handle) memcpy(&(object), &(handle), sizeof(object))
+
+static void destroy_object(struct _application *ref, vk_cache_kind_t kind, uint64_t handle)
+{
+	switch (kind) {
+		case VK_CACHE_SAMPLER: {
+			VkSampler sampler;
+			FROM_HANDLE(sampler, handle);
+			vkDestroySampler(ref->device, sampler, HOST_ALLOC(SAMPLER));
+			break;
+		}
+		case VK_CACHE_SET_LAYOUT: {
+			VkDescriptorSetLayout layout;
+			FROM_HANDLE(layout, handle);
+			vkDestroyDescriptorSetLayout(ref->device, layout, HOST_ALLOC(DESCRIPTOR));
+			break;
+		}
+		case VK_CACHE_RENDER_PASS: {
+			VkRenderPass render_pass;
+			FROM_HANDLE(render_pass, handle);
+			vkDestroyRenderPass(ref->device, render_pass, HOST_ALLOC(RENDER_PASS));
+			break;
+		}
+		default:
+			break;
+	}
+}
+
+/**
+ *	Take a reference on the object made from `key`, 0 when there is none
+ *	yet and the caller has to create it.
+ */
+static uint64_t acquire(vk_cache_t *cache, vk_cache_kind_t kind, const void *key)
+{
+	vk_cache_table_t *table = &cache->tables[kind];
+	vk_cache_entry_t *entry = hashmap_get(&table->by_key, key);
+
+	if (entry == NULL) {
+		return 0;
+	}
+
+	entry->refs++;
+	table->reused++;
+
+	return entry->handle;
+}
+
+static void insert(vk_cache_t *cache, vk_cache_kind_t kind, const void *key, uint64_t handle)
+{
+	vk_cache_table_t *table = &cache->tables[kind];
+
+	vk_cache_entry_t entry = {};
+	entry.handle = handle;
+	entry.refs = 1;
+
+	hashmap_put(&table->by_key, key, &entry);
+	hashmap_put(&table->by_handle, &handle, key);
+
+	table->created++;
+}
+
+static void release(vk_cache_t *cache, vk_cache_kind_t kind, uint64_t handle)
+{
+	if (handle == 0) {
+		return;
+	}
+
+	vk_cache_table_t *table = &cache->tables[kind];
+	void *key = hashmap_get(&table->by_handle, &handle);
+	vk_cache_entry_t *entry = key ? hashmap_get(&table->by_key, key) : NULL;
+
+	if (entry == NULL || entry->refs == 0) {
+		fprintf(stderr, "ERR: released %s handle not owned by the cache\n // Assertion: `entry != NULL && entry->refs > 0`\n", kind_names[kind]);
+		exit(EXIT_FAILURE);
+	}
+
+	if (--entry->refs > 0) {
+		return;
+	}
+
+	entry->released_frame = cache->frame;
+
+	if (entry->queued) {
+		return;
+	}
+
+	entry->queued = true;
+
+	vk_cache_release_t released = {};
+	released.kind = kind;
+	released.handle = handle;
+
+	array_append(&cache->released, &released);
+}
+
+void init_vk_cache(vk_cache_t *cache)
+{
+	memset(cache, 0, sizeof(vk_cache_t));
+
+	for (int kind = 0; kind < VK_CACHE_KIND_COUNT; kind++) {
+		hashmap_init(&cache->tables[kind].by_key, key_sizes[kind], sizeof(vk_cache_entry_t));
+		hashmap_init(&cache->tables[kind].by_handle, sizeof(uint64_t), key_sizes[kind]);
+	}
+
+	array_init(&cache->released, sizeof(vk_cache_release_t));
+}
+
+/**
+ *	Destroy every object, released or not. The device must be idle.
+ */
+void destroy_vk_cache(struct _application *ref, vk_cache_t *cache)
+{
+	for (int kind = 0; kind < VK_CACHE_KIND_COUNT; kind++) {
+		vk_cache_table_t *table = &cache->tables[kind];
+
+		uint32_t it = 0;
+		void *key;
+		void *value;
+
+		while (hashmap_next(&table->by_key, &it, &key, &value)) {
+			destroy_object(ref, kind, ((vk_cache_entry_t *) value)->handle);
+			table->destroyed++;
+		}
+
+		hashmap_free(&table->by_key);
+		hashmap_free(&table->by_handle);
+	}
+
+	array_free(&cache->released);
+}
+
+VkSampler vk_cache_sampler(struct _application *ref, vk_cache_t *cache, const VkSamplerCreateInfo *info)
+{
+	if (info->pNext != NULL) {
+		fprintf(stderr, "ERR: cached sampler with extension structs\n // Assertion: `info->pNext == NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	vk_sampler_key_t key;
+	memset(&key, 0, sizeof(key));
+
+	key.flags = info->flags;
+	key.mag_filter = info->magFilter;
+	key.min_filter = info->minFilter;
+	key.mipmap_mode = info->mipmapMode;
+	key.address_mode[0] = info->addressModeU;
+	key.address_mode[1] = info->addressModeV;
+	key.address_mode[2] = info->addressModeW;
+	key.mip_lod_bias = info->mipLodBias;
+	key.anisotropy_enable = info->anisotropyEnable;
+	key.max_anisotropy = info->maxAnisotropy;
+	key.compare_enable = info->compareEnable;
+	key.compare_op = info->compareOp;
+	key.min_lod = info->minLod;
+	key.max_lod = info->maxLod;
+	key.border_color = info->borderColor;
+	key.unnormalized_coordinates = info->unnormalizedCoordinates;
+
+	VkSampler sampler;
+	uint64_t handle = acquire(cache, VK_CACHE_SAMPLER, &key);
+
+	if (handle) {
+		FROM_HANDLE(sampler, handle);
+		return sampler;
+	}
+
+	if (vkCreateSampler(ref->device, info, HOST_ALLOC(SAMPLER), &sampler) != VK_SUCCESS) {
+		fprintf(stderr, "ERR: failed to create texture sampler\n // Assertion: `vkCreateSampler == VK_SUCCESS`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	insert(cache, VK_CACHE_SAMPLER, &key, TO_HANDLE(sampler));
+
+	return sampler;
+}
+
+/**
+ *	Bindings are kept in the given order, layouts listing the same bindings
+ *	differently are separate objects.
+ */
+VkDescriptorSetLayout vk_cache_set_layout(struct _application *ref, vk_cache_t *cache, const VkDescriptorSetLayoutCreateInfo *info)
+{
+	if (info->pNext != NULL || info->bindingCount > VK_CACHE_MAX_BINDINGS) {
+		fprintf(stderr, "ERR: descriptor set layout can not be cached\n // Assertion: `info->pNext == NULL && info->bindingCount <= VK_CACHE_MAX_BINDINGS`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	vk_set_layout_key_t key;
+	memset(&key, 0, sizeof(key));
+
+	key.flags = info->flags;
+	key.binding_count = info->bindingCount;
+
+	for (uint32_t i = 0; i < info->bindingCount; i++) {
+		const VkDescriptorSetLayoutBinding *binding = &info->pBindings[i];
+
+		if (binding->pImmutableSamplers != NULL) {
+			fprintf(stderr, "ERR: cached descriptor set layout with immutable samplers\n // Assertion: `pImmutableSamplers == NULL`\n");
+			exit(EXIT_FAILURE);
+		}
+
+		key.bindings[i].binding = binding->binding;
+		key.bindings[i].type = binding->descriptorType;
+		key.bindings[i].count = binding->descriptorCount;
+		key.bindings[i].stages = binding->stageFlags;
+	}
+
+	VkDescriptorSetLayout layout;
+	uint64_t handle = acquire(cache, VK_CACHE_SET_LAYOUT, &key);
+
+	if (handle) {
+		FROM_HANDLE(layout, handle);
+		return layout;
+	}
+
+	if (vkCreateDescriptorSetLayout(ref->device, info, HOST_ALLOC(DESCRIPTOR), &layout) != VK_SUCCESS) {
+		fprintf(stderr, "ERR: failed to create descriptor set layout\n // Assertion: `vkCreateDescriptorSetLayout == VK_SUCCESS`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	insert(cache, VK_CACHE_SET_LAYOUT, &key, TO_HANDLE(layout));
+
+	return layout;
+}
+
+VkRenderPass vk_cache_render_pass(struct _application *ref, vk_cache_t *cache, const VkRenderPassCreateInfo *info)
+{
+	const VkSubpassDescription *subpass = info->pSubpasses;
+
+	if (info->pNext != NULL || info->subpassCount != 1 || info->attachmentCount > VK_CACHE_MAX_ATTACHMENTS ||
+		info->dependencyCount > VK_CACHE_MAX_DEPENDENCIES || subpass->colorAttachmentCount > VK_CACHE_MAX_ATTACHMENTS ||
+		subpass->inputAttachmentCount > 0 || subpass->pResolveAttachments != NULL || subpass->preserveAttachmentCount > 0) {
+		fprintf(stderr, "ERR: render pass can not be cached\n // Assertion: `subpassCount == 1 && only color and depth attachments`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	vk_render_pass_key_t key;
+	memset(&key, 0, sizeof(key));
+
+	key.attachment_count = info->attachmentCount;
+	key.color_count = subpass->colorAttachmentCount;
+	key.dependency_count = info->dependencyCount;
+
+	for (uint32_t i = 0; i < info->attachmentCount; i++) {
+		key.attachments[i] = info->pAttachments[i];
+	}
+
+	for (uint32_t i = 0; i < subpass->colorAttachmentCount; i++) {
+		key.colors[i] = subpass->pColorAttachments[i];
+	}
+
+	key.depth.attachment = VK_ATTACHMENT_UNUSED;
+
+	if (subpass->pDepthStencilAttachment) {
+		key.depth = *subpass->pDepthStencilAttachment;
+	}
+
+	for (uint32_t i = 0; i < info->dependencyCount; i++) {
+		key.dependencies[i] = info->pDependencies[i];
+	}
+
+	VkRenderPass render_pass;
+	uint64_t handle = acquire(cache, VK_CACHE_RENDER_PASS, &key);
+
+	if (handle) {
+		FROM_HANDLE(render_pass, handle);
+		return render_pass;
+	}
+
+	if (vkCreateRenderPass(ref->device, info, HOST_ALLOC(RENDER_PASS), &render_pass) != VK_SUCCESS) {
+		fprintf(stderr, "ERR: failed to create render pass\n // Assertion: `vkCreateRenderPass == VK_SUCCESS`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	insert(cache, VK_CACHE_RENDER_PASS, &key, TO_HANDLE(render_pass));
+
+	return render_pass;
+}
+
+void vk_cache_release_sampler(vk_cache_t *cache, VkSampler sampler)
+{
+	release(cache, VK_CACHE_SAMPLER, TO_HANDLE(sampler));
+}
+
+void vk_cache_release_set_layout(vk_cache_t *cache, VkDescriptorSetLayout layout)
+{
+	release(cache, VK_CACHE_SET_LAYOUT, TO_HANDLE(layout));
+}
+
+void vk_cache_release_render_pass(vk_cache_t *cache, VkRenderPass render_pass)
+{
+	release(cache, VK_CACHE_RENDER_PASS, TO_HANDLE(render_pass));
+}
+
+/**
+ *	Called once a frame after its fence: destroys objects released
+ *	`MAX_FRAMES_IN_FLIGHT` frames ago that nobody requested again since.
+ */
+void vk_cache_frame(struct _application *ref, vk_cache_t *cache)
+{
+	cache->frame++;
+
+	vk_cache_release_t *released = (vk_cache_release_t *) array_data(&cache->released);
+	uint32_t kept = 0;
+
+	for (uint32_t i = 0; i < (uint32_t) array_size(&cache->released); i++) {
+		vk_cache_table_t *table = &cache->tables[released[i].kind];
+		void *key = hashmap_get(&table->by_handle, &released[i].handle);
+		vk_cache_entry_t *entry = hashmap_get(&table->by_key, key);
+
+		/**
+		 * Revived by a request since the release.
+		 */
+
+		if (entry->refs > 0) {
+			entry->queued = false;
+			continue;
+		}
+
+		if (entry->released_frame + MAX_FRAMES_IN_FLIGHT > cache->frame) {
+			released[kept++] = released[i];
+			continue;
+		}
+
+		destroy_object(ref, released[i].kind, released[i].handle);
+		table->destroyed++;
+
+		hashmap_remove(&table->by_key, key);
+		hashmap_remove(&table->by_handle, &released[i].handle);
+	}
+
+	cache->released.size = kept;
+}
+
+void vk_cache_report(const vk_cache_t *cache)
+{
+	printf("Vulkan objects:");
+
+	for (int kind = 0; kind < VK_CACHE_KIND_COUNT; kind++) {
+		const vk_cache_table_t *table = &cache->tables[kind];
+
+		printf("%s %s %u created / %u reused / %u destroyed", kind == 0 ? "" : ",", kind_names[kind], table->created, table->reused,
+			table->destroyed);
+	}
+
+	printf("\n");
+}
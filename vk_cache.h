@@ -0,0 +1,153 @@
+#ifndef _VK_CACHE_H_
+#define _VK_CACHE_H_
+
+#include "application.h"
+#include "lib/hashmap.h"
+
+#define VK_CACHE_MAX_BINDINGS 16
+#define VK_CACHE_MAX_ATTACHMENTS 4
+#define VK_CACHE_MAX_DEPENDENCIES 2
+
+typedef enum _vk_cache_kind_t
+{
+	VK_CACHE_SAMPLER,
+	VK_CACHE_SET_LAYOUT,
+	VK_CACHE_RENDER_PASS,
+	VK_CACHE_KIND_COUNT
+}
+vk_cache_kind_t;
+
+/**
+ *	Keys are the create infos flattened into zeroed structs of 32 bit
+ *	fields, without sType, pNext or padding, so they hash as bytes.
+ */
+
+typedef struct _vk_sampler_key_t
+{
+	VkSamplerCreateFlags flags;
+	VkFilter mag_filter;
+	VkFilter min_filter;
+	VkSamplerMipmapMode mipmap_mode;
+	VkSamplerAddressMode address_mode[3];
+	float mip_lod_bias;
+	VkBool32 anisotropy_enable;
+	float max_anisotropy;
+	VkBool32 compare_enable;
+	VkCompareOp compare_op;
+	float min_lod;
+	float max_lod;
+	VkBorderColor border_color;
+	VkBool32 unnormalized_coordinates;
+}
+vk_sampler_key_t;
+
+typedef struct _vk_binding_key_t
+{
+	uint32_t binding;
+	VkDescriptorType type;
+	uint32_t count;
+	VkShaderStageFlags stages;
+}
+vk_binding_key_t;
+
+typedef struct _vk_set_layout_key_t
+{
+	VkDescriptorSetLayoutCreateFlags flags;
+	uint32_t binding_count;
+	vk_binding_key_t bindings[VK_CACHE_MAX_BINDINGS];
+}
+vk_set_layout_key_t;
+
+/**
+ *	Render passes of a single subpass with color and depth attachments,
+ *	what the engine records.
+ */
+typedef struct _vk_render_pass_key_t
+{
+	uint32_t attachment_count;
+	VkAttachmentDescription attachments[VK_CACHE_MAX_ATTACHMENTS];
+
+	uint32_t color_count;
+	VkAttachmentReference colors[VK_CACHE_MAX_ATTACHMENTS];
+	VkAttachmentReference depth;
+
+	uint32_t dependency_count;
+	VkSubpassDependency dependencies[VK_CACHE_MAX_DEPENDENCIES];
+}
+vk_render_pass_key_t;
+
+typedef struct _vk_cache_entry_t
+{
+	uint64_t handle;
+	uint32_t refs;
+
+	/**
+	 * Frame of the last release to zero references, and whether the
+	 * handle sits in `vk_cache_t.released`.
+	 */
+
+	uint64_t released_frame;
+	bool queued;
+}
+vk_cache_entry_t;
+
+/**
+ *	Objects of one kind: key to entry, and handle back to key for
+ *	releases.
+ */
+typedef struct _vk_cache_table_t
+{
+	hashmap by_key;
+	hashmap by_handle;
+
+	uint32_t created;
+	uint32_t reused;
+	uint32_t destroyed;
+}
+vk_cache_table_t;
+
+typedef struct _vk_cache_release_t
+{
+	vk_cache_kind_t kind;
+	uint64_t handle;
+}
+vk_cache_release_t;
+
+/**
+ *	Deduplicated samplers, descriptor set layouts and render passes.
+ *	Requests with an equal create info share one reference counted
+ *	object. The last release only queues it in `released`, it is destroyed
+ *	by `vk_cache_frame()` once the frames in flight that may use it have
+ *	completed, and revived if requested again before that (eg. the render
+ *	pass across a swapchain recreation).
+ */
+typedef struct _vk_cache_t
+{
+	vk_cache_table_t tables[VK_CACHE_KIND_COUNT];
+
+	array released;
+	uint64_t frame;
+}
+vk_cache_t;
+
+void init_vk_cache(vk_cache_t *cache);
+
+void destroy_vk_cache(struct _application *ref, vk_cache_t *cache);
+
+VkSampler vk_cache_sampler(struct _application *ref, vk_cache_t *cache, const VkSamplerCreateInfo *info);
+
+VkDescriptorSetLayout vk_cache_set_layout(struct _application *ref, vk_cache_t *cache, const VkDescriptorSetLayoutCreateInfo *info);
+
+VkRenderPass vk_cache_render_pass(struct _application *ref, vk_cache_t *cache, const VkRenderPassCreateInfo *info);
+
+void vk_cache_release_sampler(vk_cache_t *cache, VkSampler sampler);
+
+void vk_cache_release_set_layout(vk_cache_t *cache, VkDescriptorSetLayout layout);
+
+void vk_cache_release_render_pass(vk_cache_t *cache, VkRenderPass render_pass);
+
+void vk_cache_frame(struct _application *ref, vk_cache_t *cache);
+
+void vk_cache_report(const vk_cache_t *cache);
+
+#endif